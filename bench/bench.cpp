@@ -0,0 +1,383 @@
+/**
+ * animepahe-bench
+ * micro-benchmarks for the CPU-bound paths (page parsing, kwik decoding, zipping)
+ * on the recorded fixtures in bench/fixtures. Results can be written as JSON and
+ * compared against a previous run to spot regressions between commits.
+ *
+ *   animepahe-bench --json results.json
+ *   animepahe-bench --compare baseline.json --filter kwik
+ */
+#include <cxxopts.hpp>
+#include <fmt/core.h>
+#include <fmt/color.h>
+#include <nlohmann/json.hpp>
+#include <re2/re2.h>
+#include <client.hpp>
+#include <kwikpahe.hpp>
+#include <utils.hpp>
+#include <ziputils.hpp>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef ANIMEPAHE_BENCH_FIXTURES
+#define ANIMEPAHE_BENCH_FIXTURES "bench/fixtures"
+#endif
+
+using json = nlohmann::json;
+using namespace AnimepaheCLI;
+namespace fs = std::filesystem;
+
+namespace
+{
+    struct Result
+    {
+        std::string name;
+        uint64_t iterations = 0;
+        double ns_per_op = 0.0;
+        size_t bytes_per_op = 0;
+    };
+
+    /* keeps results alive so the optimizer cannot drop the benchmarked call */
+    volatile size_t sink = 0;
+
+    std::string readFixture(const fs::path &dir, const std::string &name)
+    {
+        std::ifstream file(dir / name, std::ios::binary);
+        if (!file.is_open())
+        {
+            throw std::runtime_error(fmt::format("Missing fixture: {}", (dir / name).string()));
+        }
+        std::ostringstream oss;
+        oss << file.rdbuf();
+        return oss.str();
+    }
+
+    /* run fn in growing batches until min_time has passed, report the mean time per call */
+    Result measure(const std::string &name, size_t bytes, double min_time, const std::function<size_t()> &fn)
+    {
+        using clock = std::chrono::steady_clock;
+        sink = sink + fn(); /* warm-up */
+
+        uint64_t batch = 1;
+        uint64_t total_iterations = 0;
+        double total_seconds = 0.0;
+        while (total_seconds < min_time)
+        {
+            auto start = clock::now();
+            for (uint64_t i = 0; i < batch; ++i)
+            {
+                sink = sink + fn();
+            }
+            std::chrono::duration<double> elapsed = clock::now() - start;
+            total_seconds += elapsed.count();
+            total_iterations += batch;
+            if (elapsed.count() < min_time / 10)
+            {
+                batch *= 2;
+            }
+        }
+
+        Result result;
+        result.name = name;
+        result.iterations = total_iterations;
+        result.ns_per_op = total_seconds * 1e9 / total_iterations;
+        result.bytes_per_op = bytes;
+        return result;
+    }
+
+    double megabytesPerSecond(const Result &result)
+    {
+        if (result.bytes_per_op == 0 || result.ns_per_op <= 0)
+        {
+            return 0.0;
+        }
+        return (result.bytes_per_op / (1024.0 * 1024.0)) / (result.ns_per_op / 1e9);
+    }
+
+    /* synthetic season: incompressible "video" files plus small text sidecars */
+    size_t createSyntheticSeason(const fs::path &dir, int videos, size_t videoSize, int sidecars)
+    {
+        fs::create_directories(dir / "videos");
+        std::mt19937_64 rng(1337);
+        size_t total = 0;
+
+        std::vector<char> buffer(videoSize);
+        for (int i = 0; i < videos; ++i)
+        {
+            for (size_t b = 0; b + 8 <= buffer.size(); b += 8)
+            {
+                uint64_t value = rng();
+                std::memcpy(&buffer[b], &value, 8);
+            }
+            std::ofstream out(dir / "videos" / fmt::format("AnimePahe_Bench_-_{}_1080p.mp4", padIntWithZero(i + 1)), std::ios::binary);
+            out.write(buffer.data(), buffer.size());
+            total += buffer.size();
+        }
+        for (int i = 0; i < sidecars; ++i)
+        {
+            std::ofstream out(dir / fmt::format("episode_{}.nfo", padIntWithZero(i + 1)));
+            for (int line = 0; line < 200; ++line)
+            {
+                out << "<episodedetails><title>Episode " << i + 1 << "</title><season>1</season></episodedetails>\n";
+            }
+            out.flush();
+            total += static_cast<size_t>(out.tellp());
+        }
+        return total;
+    }
+
+    /* zip a synthetic directory once, check the archive with verify_archive and time the whole run */
+    Result zipOnce(const std::string &name, const std::function<size_t(const fs::path &)> &populate, size_t expectedEntries)
+    {
+        fs::path work = fs::temp_directory_path() / fmt::format("animepahe-bench-{}", std::chrono::steady_clock::now().time_since_epoch().count());
+        fs::path source = work / "source";
+        fs::create_directories(source);
+        size_t bytes = populate(source);
+
+        fs::path archive = work / "source.zip";
+        auto start = std::chrono::steady_clock::now();
+        ZipUtils::zip_directory(source.string(), archive.string(), false, nullptr);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        size_t entries = ZipUtils::verify_archive(archive.string());
+        fs::remove_all(work);
+
+        if (entries != expectedEntries)
+        {
+            throw std::runtime_error(fmt::format("{}: archive has {} entries, expected {}", name, entries, expectedEntries));
+        }
+
+        Result result;
+        result.name = name;
+        result.iterations = 1;
+        result.ns_per_op = elapsed.count() * 1e9;
+        result.bytes_per_op = bytes;
+        return result;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    cxxopts::Options options("animepahe-bench", "AnimePahe CLI micro-benchmarks");
+    options.add_options()
+    ("fixtures", "Directory with recorded page fixtures", cxxopts::value<std::string>()->default_value(ANIMEPAHE_BENCH_FIXTURES))
+    ("filter", "Only run benchmarks whose name contains this text", cxxopts::value<std::string>()->default_value(""))
+    ("min-time", "Minimum measuring time per benchmark in milliseconds", cxxopts::value<int>()->default_value("500"))
+    ("json", "Write results as JSON to this file ('-' for stdout)", cxxopts::value<std::string>()->default_value(""))
+    ("compare", "Compare against a previous --json result file", cxxopts::value<std::string>()->default_value(""))
+    ("skip-zip", "Skip the zip benchmark (writes ~64MB to the temp directory)", cxxopts::value<bool>()->default_value("false"))
+    ("zip64", "Also zip a sparse 4.5GB file and 70,000 small files (writes ~4.5GB to the temp directory)", cxxopts::value<bool>()->default_value("false"))
+    ("h,help", "Print usage");
+
+    try
+    {
+        auto args = options.parse(argc, argv);
+        if (args.count("help"))
+        {
+            fmt::print("{}\n", options.help());
+            return 0;
+        }
+
+        const fs::path fixtures = args["fixtures"].as<std::string>();
+        const std::string filter = args["filter"].as<std::string>();
+        const double min_time = std::max(1, args["min-time"].as<int>()) / 1000.0;
+        const std::string json_path = args["json"].as<std::string>();
+        const bool quiet = json_path == "-";
+
+        const std::string play_page = readFixture(fixtures, "play_page.html");
+        const std::string release_page = readFixture(fixtures, "release_page.json");
+        const std::string kwik_page = readFixture(fixtures, "kwik_page.html");
+
+        /* the same extraction fetch_kwik_dlink performs before decoding */
+        std::string encoded, alphabet, offset_str, base_str;
+        if (!RE2::PartialMatch(
+                kwik_page,
+                R"re(\(\s*"([^",]*)"\s*,\s*\d+\s*,\s*"([^",]*)"\s*,\s*(\d+)\s*,\s*(\d+)\s*,\s*\d+[a-zA-Z]?\s*\))re",
+                &encoded, &alphabet, &offset_str, &base_str))
+        {
+            throw std::runtime_error("kwik_page.html does not contain packed parameters");
+        }
+        const int offset = std::stoi(offset_str);
+        const int base = std::stoi(base_str);
+
+        /* invalid bytes sprinkled into a real page */
+        std::string dirty_page = play_page;
+        for (size_t i = 97; i < dirty_page.size(); i += 997)
+        {
+            dirty_page[i] = static_cast<char>(0xC3 + (i % 3));
+        }
+
+        const std::string title = "Kaguya-sama wa Kokurasetai: Tensai-tachi no Renai Zunousen &amp; &quot;Ultra Romantic&quot; &#8211; Season 3";
+        const std::string release_id = "dcb2b21f-a70d-84f7-fbab-580701484066";
+
+        KwikPahe kwik;
+        std::vector<std::pair<std::string, std::function<Result()>>> benchmarks = {
+            {"kwik/_0xe16c", [&]() {
+                return measure("kwik/_0xe16c", 0, min_time, [&]() { return static_cast<size_t>(kwik._0xe16c("5467", base, 10)); });
+            }},
+            {"kwik/decodeJSStyle", [&]() {
+                return measure("kwik/decodeJSStyle", encoded.size(), min_time, [&]() {
+                    return kwik.decodeJSStyle(encoded, 17, alphabet, offset, base, 29).size();
+                });
+            }},
+            {"utils/sanitize_utf8", [&]() {
+                return measure("utils/sanitize_utf8", dirty_page.size(), min_time, [&]() { return sanitize_utf8(dirty_page).size(); });
+            }},
+            {"utils/unescape_html_entities", [&]() {
+                return measure("utils/unescape_html_entities", title.size(), min_time, [&]() { return unescape_html_entities(title).size(); });
+            }},
+            {"animepahe/play_page_anchors", [&]() {
+                return measure("animepahe/play_page_anchors", play_page.size(), min_time, [&]() {
+                    auto variants = Client::parseEpisodeVariants(play_page);
+                    return Client::selectVariant(variants, 0).paheLink.size();
+                });
+            }},
+            {"animepahe/release_page_json", [&]() {
+                return measure("animepahe/release_page_json", release_page.size(), min_time, [&]() {
+                    return Client::parseReleasePage(release_page, release_id).links.size();
+                });
+            }},
+        };
+
+        if (!args["skip-zip"].as<bool>())
+        {
+            benchmarks.push_back({"zip/zip_directory", [&]() {
+                fs::path work = fs::temp_directory_path() / fmt::format("animepahe-bench-{}", std::chrono::steady_clock::now().time_since_epoch().count());
+                fs::path season = work / "season";
+                size_t bytes = createSyntheticSeason(season, 4, 16 * 1024 * 1024, 24);
+                fs::path archive = work / "season.zip";
+                Result result = measure("zip/zip_directory", bytes, min_time, [&]() {
+                    ZipUtils::zip_directory(season.string(), archive.string(), false, nullptr);
+                    std::error_code ec;
+                    size_t size = fs::file_size(archive, ec);
+                    fs::remove(archive, ec);
+                    return size;
+                });
+                fs::remove_all(work);
+                return result;
+            }});
+        }
+
+        if (args["zip64"].as<bool>())
+        {
+            /* entry and archive past 4 GB: ZIP64 sizes, offsets and end records */
+            benchmarks.push_back({"zip/zip64_large_entry", [&]() {
+                return zipOnce("zip/zip64_large_entry", [](const fs::path &dir) {
+                    const uint64_t size = 4608ull << 20;
+                    std::ofstream(dir / "AnimePahe_Bench_-_01_1080p.mkv", std::ios::binary).close();
+                    fs::resize_file(dir / "AnimePahe_Bench_-_01_1080p.mkv", size); /* sparse where supported */
+                    std::ofstream(dir / "episode_02.nfo") << "<episodedetails><title>Episode 2</title></episodedetails>\n";
+                    return static_cast<size_t>(size);
+                }, 2);
+            }});
+            /* more entries than the 16-bit end record can count */
+            benchmarks.push_back({"zip/zip64_entry_count", [&]() {
+                return zipOnce("zip/zip64_entry_count", [](const fs::path &dir) {
+                    size_t total = 0;
+                    for (int i = 0; i < 70000; ++i)
+                    {
+                        std::ofstream out(dir / fmt::format("{}.nfo", i));
+                        out << "<episode>" << i << "</episode>\n";
+                        total += static_cast<size_t>(out.tellp());
+                    }
+                    return total;
+                }, 70000);
+            }});
+        }
+
+        /* previous results, keyed by name */
+        std::map<std::string, double> baseline;
+        if (!args["compare"].as<std::string>().empty())
+        {
+            std::ifstream file(args["compare"].as<std::string>());
+            if (!file.is_open())
+            {
+                throw std::runtime_error(fmt::format("Cannot open baseline {}", args["compare"].as<std::string>()));
+            }
+            json previous = json::parse(file);
+            for (const auto &entry : previous.value("benchmarks", json::array()))
+            {
+                baseline[entry.value("name", "")] = entry.value("ns_per_op", 0.0);
+            }
+        }
+
+        if (!quiet)
+        {
+            fmt::print("\n * animepahe-bench (min-time {}ms)\n\n", static_cast<int>(min_time * 1000));
+            fmt::print("   {:<32}{:>12}{:>16}{:>12}{:>10}\n", "benchmark", "iterations", "ns/op", "MB/s", "delta");
+        }
+
+        json output = {
+            {"min_time_ms", static_cast<int>(min_time * 1000)},
+            {"timestamp", std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count()},
+            {"benchmarks", json::array()}};
+
+        for (auto &[name, bench] : benchmarks)
+        {
+            if (!filter.empty() && name.find(filter) == std::string::npos)
+            {
+                continue;
+            }
+            Result result = bench();
+            double mbps = megabytesPerSecond(result);
+
+            std::string delta = "-";
+            auto previous = baseline.find(result.name);
+            if (previous != baseline.end() && previous->second > 0)
+            {
+                delta = fmt::format("{:+.1f}%", (result.ns_per_op / previous->second - 1.0) * 100.0);
+            }
+
+            if (!quiet)
+            {
+                fmt::print("   {:<32}{:>12}{:>16.1f}{:>12}", result.name, result.iterations, result.ns_per_op, mbps > 0 ? fmt::format("{:.1f}", mbps) : "-");
+                if (delta.front() == '+' && previous->second * 1.05 < result.ns_per_op)
+                {
+                    fmt::print(fmt::fg(fmt::color::indian_red), "{:>10}\n", delta);
+                }
+                else
+                {
+                    fmt::print("{:>10}\n", delta);
+                }
+            }
+
+            output["benchmarks"].push_back({
+                {"name", result.name},
+                {"iterations", result.iterations},
+                {"ns_per_op", result.ns_per_op},
+                {"bytes_per_op", result.bytes_per_op},
+                {"mb_per_s", mbps}});
+        }
+
+        if (json_path == "-")
+        {
+            fmt::print("{}\n", output.dump(2));
+        }
+        else if (!json_path.empty())
+        {
+            std::ofstream out(json_path, std::ios::trunc);
+            out << output.dump(2) << "\n";
+            fmt::print("\n * Results : {}\n", json_path);
+        }
+        if (!quiet)
+        {
+            fmt::print("\n");
+        }
+    }
+    catch (const std::exception &e)
+    {
+        fmt::print("\n * ");
+        fmt::print(fmt::fg(fmt::color::indian_red), "ERROR :");
+        fmt::print(" {} \n\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#ifndef AES_HPP
+#define AES_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace AnimepaheCLI
+{
+    /* AES-128 (FIPS 197) in CBC mode with PKCS#7 padding, what HLS uses for METHOD=AES-128 segments */
+    class Aes128
+    {
+    public:
+        /* key holds 16 bytes */
+        explicit Aes128(const std::string &key);
+
+        /* the padding is removed, throws when data is not whole blocks or the padding is broken */
+        std::string decryptCbc(const std::string &data, const std::string &iv) const;
+        std::string encryptCbc(const std::string &data, const std::string &iv) const;
+
+    private:
+        void encryptBlock(uint8_t *block) const;
+        void decryptBlock(uint8_t *block) const;
+
+        std::array<uint32_t, 44> encrypt_; /* round keys */
+        std::array<uint32_t, 44> decrypt_; /* for the equivalent inverse cipher */
+    };
+}
+
+#endif
@@ -3,39 +3,66 @@
 #ifndef ANIMEPAHE_HPP
 #define ANIMEPAHE_HPP
 
-#include <cpr/cpr.h>
-#include <map>
+#include <client.hpp>
+#include <executor.hpp>
+#include <livestream.hpp>
+#include <linkexport.hpp>
+#include <manifest.hpp>
+#include <packer.hpp>
+#include <ziputils.hpp>
+#include <cstdint>
 #include <vector>
 #include <string>
 
 namespace AnimepaheCLI
 {
+    /* terminal front-end of the CLI, all network work goes through Client */
     class Animepahe
     {
     private:
-        cpr::Header getHeaders(const std::string &link);
-        std::map<std::string, std::string> fetch_episode(const std::string &link, const int &targetRes);
-        int get_series_episode_count(const std::string& link);
-        std::vector<std::string> fetch_series(const std::string &link, const int epCount, bool isAllEpisodes, const std::vector<int> &episodes);
-        std::string extract_link_metadata(const std::string &link, bool isSeries);
-        std::vector<std::map<std::string, std::string>> extract_link_content(
-            const std::string &link,
-            const std::vector<int> &episodes,
-            const int targetRes,
-            bool isSeries,
-            bool isAllEpisodes
-        );
+        Executor executor_{2};
+        Client client_{executor_};
+
+        SeriesInfo extract_link_metadata(const std::string &link, bool isSeries);
+        std::vector<Episode> fetch_series(EpisodeCursor &cursor);
+        std::vector<Episode> fetch_selection(const std::string &link, const std::vector<EpisodeRange> &ranges);
+        std::vector<std::pair<Episode, Variant>> extract_link_content(const std::vector<Episode> &list, const int targetRes, bool isSeries);
+        /* the episodes of a batch the manifest has no complete copy of, present ones go into archive or packer when there is one */
+        std::vector<Episode> skip_present(std::vector<Episode> batch, Manifest &manifest, int targetRes, ZipUtils::ZipWriter *archive, Packer *packer);
+        /* an episode complete in videos/ goes into archive or packer, false when the archive could not read it and it has to be downloaded */
+        bool keep_present(const Episode &episode, const Manifest::Entry &entry, Manifest &manifest, ZipUtils::ZipWriter *archive, Packer *packer);
+        /* direct links of a batch in order, each one also goes to exporter the moment it resolves and its episode to resolved */
+        std::vector<std::string> resolve_direct_links(const std::vector<std::pair<Episode, Variant>> &epData, LinkExport *exporter = nullptr,
+                                                      std::vector<std::pair<Episode, Variant>> *resolved = nullptr);
+        /**
+         * Sizes of links (0 = unknown), throws when they and `later` more
+         * episodes of the same average size would not fit. archived are
+         * bytes already on disk that the archive will hold as well; a link
+         * whose size equals its `present` bytes (a file already in videos/)
+         * or cannot be told needs no room.
+         */
+        std::vector<uint64_t> preflight(const std::vector<std::string> &links, bool keepFiles, bool createArchive, size_t later = 0, uint64_t archived = 0,
+                                        const std::vector<uint64_t> &present = {});
     public:
+        /* series link for a title, from the local catalog or the site search, throws when nothing matches */
+        std::string find_series(const std::string &query);
+
         void extractor(
             bool isSeries,
             const std::string &link,
             const int targetRes,
             bool isAllEpisodes,
-            const std::vector<int> &episodes,
+            const std::vector<EpisodeRange> &episodes,
             const std::string &export_filename,
             bool exportLinks = false,
             bool createZip = false,
-            bool removeSource = false
+            bool removeSource = false,
+            bool streamZip = false,
+            const std::string &archiveFormat = "zip",
+            const std::string &order = "index",
+            LiveStream *live = nullptr,
+            const std::string &exportFormat = "",
+            uint64_t diskLimit = 0
         );
     };
 }
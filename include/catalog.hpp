@@ -0,0 +1,48 @@
+#pragma once
+
+#ifndef CATALOG_HPP
+#define CATALOG_HPP
+
+#include <string>
+#include <vector>
+
+namespace AnimepaheCLI
+{
+    namespace Catalog
+    {
+        /**
+         * Local index of series titles for -l "<title>". Every series the
+         * site search returned or the CLI visited is kept with its title and
+         * alternative names (synonyms, English, Japanese) in a JSON file next
+         * to the session. Names are folded to lowercase alphanumerics and cut
+         * into trigrams with posting lists built in memory on open, so a
+         * lookup only scores the names sharing a trigram with the query and
+         * tolerates typos and word order. Once a series was seen the lookup
+         * needs no network at all. All functions are thread safe.
+         */
+        void open(const std::string &path);
+
+        /* catalog.json in userCacheDirectory(), empty when there is none */
+        std::string defaultPath();
+
+        struct Match
+        {
+            std::string id; /* series id, the part after anime/ */
+            std::string title;
+            double score = 0.0; /* 1.0 for an exact name, trigram similarity otherwise */
+        };
+
+        /* add a series or merge new names into a known one */
+        void remember(const std::string &id, const std::string &title, const std::vector<std::string> &names = {});
+
+        /* best matching series first, at most limit, weak matches (< 0.3) left out */
+        std::vector<Match> search(const std::string &query, size_t limit = 5);
+
+        size_t size();
+
+        /* write the catalog if it changed, false if the file cannot be written */
+        bool save();
+    }
+}
+
+#endif
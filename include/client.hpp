@@ -0,0 +1,192 @@
+#pragma once
+
+#ifndef CLIENT_HPP
+#define CLIENT_HPP
+
+#include <task.hpp>
+#include <executor.hpp>
+#include <utils.hpp>
+#include <cpr/cpr.h>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace AnimepaheCLI
+{
+    /* what the series (anime/<id>) or episode (play/<id>/<session>) page says about itself */
+    struct SeriesInfo
+    {
+        std::string link;
+        std::string id;
+        std::string title;
+        std::string type;     /* series only */
+        std::string episodes; /* series only, as listed ("?" while airing) */
+        std::string episode;  /* episode links only */
+        std::vector<std::string> alternatives; /* series only, synonyms, English and Japanese names */
+        bool isSeries = true;
+    };
+
+    struct Episode
+    {
+        int number = 0; /* position in the release list, 1-based */
+        std::string link;
+    };
+
+    /* one download option of an episode, e.g. "SubsPlease · 1080p (190MB)" */
+    struct Variant
+    {
+        std::string name;
+        int resolution = 0; /* 0 when the name carries none */
+        std::string paheLink;
+    };
+
+    struct ReleasePage
+    {
+        int total = 0;
+        std::vector<std::string> links;
+    };
+
+    struct DownloadProgress
+    {
+        size_t bytes = 0;
+        size_t totalBytes = 0; /* 0 until the server sent a length */
+        double elapsed = 0.0;  /* seconds */
+    };
+
+    struct DownloadCallbacks
+    {
+        /* every received chunk, after it was written to the file if any (event loop thread, or one segment worker at a time for playlists; keep it short) */
+        std::function<void(const char *data, size_t size)> onData;
+        /* periodic progress, return false to abort the transfer */
+        std::function<bool(const DownloadProgress &)> onProgress;
+        /* flush the file after every chunk so readers of path see bytes as they land */
+        bool flush = false;
+    };
+
+    struct DownloadResult
+    {
+        std::string path;
+        size_t bytes = 0;
+        int status = 0;
+        double elapsed = 0.0; /* seconds */
+        bool ok = false;
+    };
+
+    /**
+     * Non-printing, embeddable AnimePahe API.
+     * Every operation is a lazily started coroutine. Transfers run on the
+     * shared curl multi event loop and parsing continues on the executor, so
+     * hundreds of resolutions can be in flight at once (whenAll) on a fixed
+     * number of threads. Failures are thrown as std::runtime_error from the
+     * awaited task.
+     *
+     *   Executor executor(4);
+     *   Client client(executor);
+     *   auto episodes = syncWait(client.listEpisodes(link, 1, 12));
+     */
+    class Client
+    {
+    public:
+        explicit Client(Executor &executor) : executor_(executor) {}
+
+        /* series or episode page metadata */
+        Task<SeriesInfo> resolveSeries(std::string link);
+
+        /* site search, series only (link, id, title, type, episodes) */
+        Task<std::vector<SeriesInfo>> search(std::string query);
+
+        /* release list entries first..last (last = 0 for all), pages fetched concurrently */
+        Task<std::vector<Episode>> listEpisodes(std::string link, int first = 1, int last = 0);
+
+        /* sparse selection, only the API pages holding selected entries are fetched */
+        Task<std::vector<Episode>> listEpisodes(std::string link, std::vector<EpisodeRange> ranges);
+
+        /* one page (30 entries) of the release list, page 1 is the first */
+        Task<ReleasePage> fetchReleasePage(std::string link, int page);
+
+        /* download options listed on an episode's play page */
+        Task<std::vector<Variant>> resolveVariants(std::string episodeLink);
+
+        /**
+         * pahe.win -> kwik -> direct CDN link, retried while kwik serves broken
+         * pages. Depending on Hls::source() the kwik player's playlist is
+         * taken instead, before or after the download route (Hls::makeLink).
+         */
+        Task<std::string> resolveDirectLink(std::string paheLink);
+
+        /* Content-Length of a direct link (HEAD), 0 when the server does not send one */
+        Task<uint64_t> contentLength(std::string url);
+
+        /**
+         * Stream a direct link to path, or only to callbacks.onData when path is
+         * empty. A known expectedSize is reserved on disk before the transfer
+         * starts (Linux), so a full volume fails the download up front.
+         * A playlist link (Hls::isLink) is fetched segment by segment in
+         * parallel and written in order, the callbacks see one stream.
+         */
+        Task<DownloadResult> download(std::string url, std::string path, DownloadCallbacks callbacks = {}, uint64_t expectedSize = 0);
+
+        /* page parsers, free of network access (benchmarked on fixtures) */
+        static SeriesInfo parseSeriesPage(std::string html, bool isSeries);
+        static std::vector<Variant> parseEpisodeVariants(std::string html);
+        static ReleasePage parseReleasePage(const std::string &body, const std::string &id);
+        static std::vector<SeriesInfo> parseSearchResults(const std::string &body);
+
+        /**
+         * Pick the variant for a target resolution: 0 = highest, -1 = lowest,
+         * otherwise an exact match falling back to the highest.
+         */
+        static Variant selectVariant(const std::vector<Variant> &variants, int targetRes);
+
+    private:
+        Task<cpr::Response> fetchPage(std::string span, std::string url, std::string referer);
+        Task<std::string> resolveKwikLink(std::string kwikLink, int retries);
+        /* playlist link of the kwik player (/e/) for a kwik download page */
+        Task<std::string> resolveStreamLink(std::string kwikLink);
+        Task<DownloadResult> downloadPlaylist(std::string url, std::string path, DownloadCallbacks callbacks);
+        /* POST the kwik form, the redirect Location or empty when kwik refused it */
+        Task<std::string> postKwikForm(std::string action, std::string token, std::string cookie, bool reused);
+
+        Executor &executor_;
+    };
+
+    /**
+     * Lazy walk over the selected entries of a release list. Each next()
+     * returns the following API page that holds part of the selection, so
+     * a long series is held one page (30 entries) at a time and the first
+     * episodes can be resolved before the last page was ever requested.
+     * The page after the returned one is already being fetched while the
+     * caller works through it.
+     *
+     *   EpisodeCursor cursor(client, link, ranges);
+     *   for (auto page = syncWait(cursor.next()); !page.empty(); page = syncWait(cursor.next()))
+     */
+    class EpisodeCursor
+    {
+    public:
+        /* empty ranges select every episode */
+        EpisodeCursor(Client &client, std::string link, std::vector<EpisodeRange> ranges);
+
+        /* selected entries of the next page, empty once the selection is exhausted */
+        Task<std::vector<Episode>> next();
+
+        /* release list length and selected entries in it, 0 until the first page arrived */
+        int total() const { return total_; }
+        size_t selected() const { return selected_; }
+
+    private:
+        Client &client_;
+        std::string link_;
+        std::vector<EpisodeRange> ranges_;
+        std::vector<int> pages_; /* still to fetch, known after the first page */
+        size_t position_ = 0;
+        Spawned<ReleasePage> prefetched_; /* pages_[position_], in flight */
+        bool started_ = false;
+        int total_ = 0;
+        size_t selected_ = 0;
+    };
+}
+
+#endif
@@ -1,18 +1,45 @@
-#include <cpr/cpr.h>
+#include <client.hpp>
+#include <ziputils.hpp>
+#include <livestream.hpp>
+#include <manifest.hpp>
+#include <packer.hpp>
 #include <filesystem>
 #include <vector>
 #include <string>
 
 class Downloader {
 public:
-    Downloader(const std::vector<std::string>& urls);
+    Downloader(AnimepaheCLI::Client& client, const std::vector<std::string>& urls);
     void setDownloadDirectory(const std::string& dir);
+    /* write every episode into a stored entry of archive while it downloads, keepFiles also writes videos/ */
+    void setArchive(ZipUtils::ZipWriter* archive, bool keepFiles);
+    /* Content-Length per url from the preflight (0 = unknown), reserved on disk before each download */
+    void setExpectedSizes(const std::vector<uint64_t>& sizes);
+    /* the next slice of a longer selection, download_started counts it from firstIndex of total */
+    void setBatch(const std::vector<std::string>& urls, size_t firstIndex, size_t total);
+    /* hand every episode to the --stream server or pipe while it downloads */
+    void setLiveStream(AnimepaheCLI::LiveStream* live);
+    /* record every episode kept in videos/, episodes are the ones behind each url of the batch */
+    void setManifest(AnimepaheCLI::Manifest* manifest);
+    void setEpisodes(const std::vector<std::pair<AnimepaheCLI::Episode, AnimepaheCLI::Variant>>& episodes);
+    /* hand every finished episode to packer, which deletes it once packed; downloads wait for its room */
+    void setPacker(AnimepaheCLI::Packer* packer);
     void startDownloads();
 
 private:
+    AnimepaheCLI::Client& client_;
     std::vector<std::string> urls_;
+    size_t first_index_ = 0;
+    size_t total_;
     std::string download_dir_;
+    ZipUtils::ZipWriter* archive_ = nullptr;
+    bool keep_files_ = true;
+    std::vector<uint64_t> expected_sizes_;
+    AnimepaheCLI::LiveStream* live_ = nullptr;
+    AnimepaheCLI::Manifest* manifest_ = nullptr;
+    AnimepaheCLI::Packer* packer_ = nullptr;
+    std::vector<std::pair<AnimepaheCLI::Episode, AnimepaheCLI::Variant>> episodes_;
 
     std::string extractFilename(const std::string& url) const;
-    bool downloadFile(const std::string& url, const std::string& filepath);
+    bool downloadFile(const std::string& url, const std::string& filepath, uint64_t expected, size_t& bytes);
 };
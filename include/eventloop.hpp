@@ -0,0 +1,93 @@
+#pragma once
+
+#ifndef EVENTLOOP_HPP
+#define EVENTLOOP_HPP
+
+#include <curl/curl.h>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace AnimepaheCLI
+{
+    /**
+     * One thread driving every transfer through a curl multi handle.
+     * On Linux sockets are watched with epoll (curl's socket/timer callbacks),
+     * elsewhere curl_multi_poll is used. Transfers share curl's connection
+     * cache, and the number in flight does not change the thread count.
+     */
+    class EventLoop
+    {
+    public:
+        using Completion = std::function<void(CURLcode)>;
+
+        EventLoop();
+        ~EventLoop();
+        EventLoop(const EventLoop &) = delete;
+        EventLoop &operator=(const EventLoop &) = delete;
+
+        /* process-wide loop, started on first use */
+        static EventLoop &shared();
+
+        /**
+         * Run a fully configured easy handle. `done` is called on the loop
+         * thread once the transfer finished, after the handle left the multi
+         * handle; the caller keeps ownership of the handle. Safe from any thread.
+         */
+        void add(CURL *handle, Completion done);
+
+        /* run fn on the loop thread once delay has passed. Safe from any thread */
+        void after(std::chrono::milliseconds delay, std::function<void()> fn);
+
+        /**
+         * Abort a transfer that was added and has not completed yet; its
+         * completion runs right away with CURLE_ABORTED_BY_CALLBACK. Only from
+         * the loop thread (inside a completion or timer).
+         */
+        void cancel(CURL *handle);
+
+        /* transfers queued or running */
+        size_t active() const { return active_; }
+
+    private:
+        struct Job
+        {
+            CURL *handle;
+            Completion done;
+        };
+
+        struct Timer
+        {
+            std::chrono::steady_clock::time_point due;
+            std::function<void()> fn;
+        };
+
+        void run();
+        void wake();
+        void attachPending();
+        void finishTransfers();
+        /* fire due timers, returns the next due time (max when none is left) */
+        std::chrono::steady_clock::time_point runTimers();
+
+        static int onSocket(CURL *easy, curl_socket_t socket, int what, void *loop, void *socketData);
+        static int onTimer(CURLM *multi, long timeoutMs, void *loop);
+
+        CURLM *multi_ = nullptr;
+        std::mutex mutex_;
+        std::vector<Job *> pending_;
+        std::vector<Timer> timers_;
+        std::atomic<size_t> active_{0};
+        std::atomic<bool> stopping_{false};
+        long timeoutMs_ = -1; /* last timer curl asked for, -1 = none */
+        bool timerChanged_ = false;
+        int epoll_ = -1;
+        int wakeFd_ = -1;
+        std::thread thread_;
+    };
+}
+
+#endif
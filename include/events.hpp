@@ -0,0 +1,59 @@
+#pragma once
+
+#ifndef EVENTS_HPP
+#define EVENTS_HPP
+
+#include <fmt/core.h>
+#include <fmt/color.h>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <utility>
+
+namespace AnimepaheCLI
+{
+    namespace Events
+    {
+        /**
+         * Switch between the interactive terminal output (default) and the
+         * machine-readable NDJSON stream (--events json). In JSON mode every
+         * lifecycle event is written to stdout as a single line and all
+         * terminal output (colors, cursor movement) is suppressed.
+         */
+        void setJsonMode(bool enabled);
+        bool isJsonMode();
+
+        /* human output on a terminal, false for --events json, pipes and cron */
+        bool isInteractive();
+
+        /* minimum interval between two download_progress events (milliseconds) */
+        void setProgressInterval(int milliseconds);
+        int getProgressInterval();
+
+        /**
+         * Write one event line, e.g. {"event":"page_fetched","ts":"...","t_ms":12,...}
+         * Does nothing unless JSON mode is enabled. Safe to call from any thread.
+         */
+        void emit(const std::string &event, nlohmann::json fields = nlohmann::json::object());
+
+        /* terminal output, suppressed in JSON mode */
+        template <typename... T>
+        void print(fmt::format_string<T...> format, T &&...args)
+        {
+            if (!isJsonMode())
+            {
+                fmt::print(format, std::forward<T>(args)...);
+            }
+        }
+
+        template <typename... T>
+        void print(const fmt::text_style &style, fmt::format_string<T...> format, T &&...args)
+        {
+            if (!isJsonMode())
+            {
+                fmt::print(style, "{}", fmt::format(format, std::forward<T>(args)...));
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,57 @@
+#pragma once
+
+#ifndef EXECUTOR_HPP
+#define EXECUTOR_HPP
+
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace AnimepaheCLI
+{
+    /**
+     * Fixed pool of worker threads that resumes coroutines.
+     * `co_await executor.schedule()` moves the rest of a coroutine onto the
+     * pool, so any number of tasks shares the same few threads.
+     */
+    class Executor
+    {
+    public:
+        /* 0 = one thread per hardware thread */
+        explicit Executor(size_t threads = 0);
+        ~Executor();
+        Executor(const Executor &) = delete;
+        Executor &operator=(const Executor &) = delete;
+
+        struct ScheduleAwaiter
+        {
+            Executor &executor;
+
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> handle) { executor.post(handle); }
+            void await_resume() const noexcept {}
+        };
+
+        ScheduleAwaiter schedule() { return ScheduleAwaiter{*this}; }
+
+        /* queue a suspended coroutine for resumption on a worker */
+        void post(std::coroutine_handle<> handle);
+
+        size_t size() const { return threads_.size(); }
+
+    private:
+        void run();
+
+        std::mutex mutex_;
+        std::condition_variable wakeup_;
+        std::deque<std::coroutine_handle<>> queue_;
+        std::vector<std::thread> threads_;
+        bool stopping_ = false;
+    };
+}
+
+#endif
@@ -5,15 +5,24 @@
 #include <vector>
 #include <optional>
 #include <functional>
+#include <chrono>
+#include <cstdint>
 
 class GitHubUpdater {
 public:
+    struct Asset {
+        std::string name;
+        std::string url;      /* browser_download_url */
+        uint64_t size = 0;
+        std::string digest;   /* "sha256:<hex>" when GitHub lists one */
+    };
+
     struct Release {
         std::string tag_name;
         std::string name;
         std::string body;
-        bool prerelease;
-        std::vector<std::pair<std::string, std::string>> assets; /* name, download_url */
+        bool prerelease = false;
+        std::vector<Asset> assets;
     };
 
     GitHubUpdater(
@@ -25,18 +34,41 @@ public:
     
     /* Check for latest release */
     std::optional<Release> checkForUpdate();
+
+    /**
+     * Same check answered from cache_path while the last successful lookup
+     * is younger than interval, so repeated runs do not ask GitHub again; a
+     * failed one is not cached. Prints nothing, safe to run on a background
+     * thread.
+     */
+    std::optional<Release> checkForUpdateCached(const std::string& cache_path, std::chrono::seconds interval);
     
     /* Check and update if available */
     bool checkAndUpdate(bool auto_update = false);
+
+    /* let performUpdate install a release that publishes no SHA-256 (size-checked only) */
+    void allowUnverified(bool allow) { allow_unverified = allow; }
     
-    /* Download file with progress callback */
+    /**
+     * Download file with progress callback, resuming a partial filepath with
+     * Range requests. expected_size (0 = unknown) is what a leftover file must
+     * hold to count as complete when the server answers 416.
+     */
     bool downloadFile(
         const std::string& url,
         const std::string& filepath,
-        std::function<void(double)> progress_callback = nullptr
+        std::function<void(double)> progress_callback = nullptr,
+        uint64_t expected_size = 0
     );
     
-    /* Perform the update */
+    /**
+     * Perform the update: a zstd delta against the running version
+     * (<asset>.patch-from-<version>.zst, made with zstd --patch-from) or the
+     * compressed binary (<asset>.zst) is preferred over the plain one, and the
+     * result must have the plain asset's size and match the published
+     * SHA-256 before it is applied. Without a published digest nothing is
+     * installed unless allowUnverified(true) was set.
+     */
     bool performUpdate(const Release& release);
 
 private:
@@ -44,12 +76,22 @@ private:
     std::string repo_name;
     std::string current_version;
     std::string github_token;
+    bool allow_unverified = false;
     
+    /* GET releases/latest through Http (honours --endpoint), nullopt on any failure */
+    std::optional<Release> fetchLatestRelease(std::string* error = nullptr);
+
     /* Compare version strings (simple semantic versioning) */
     bool isNewerVersion(const std::string& latest, const std::string& current);
     
-    /* Find the appropriate asset for current platform */
-    std::string findPlatformAsset(const Release& release);
+    /* Find the appropriate asset for current platform, nullptr when there is none */
+    const Asset* findPlatformAsset(const Release& release);
+
+    /* hex SHA-256 of an asset from its API digest, <asset>.sha256 or SHA256SUMS, empty when none is published */
+    std::string publishedSha256(const Release& release, const Asset& asset);
+
+    /* decompress a .zst asset, dictionary_file is the old binary for a --patch-from delta */
+    bool unpackAsset(const std::string& packed, const std::string& output, const std::string& dictionary_file);
     
     /* Get current executable path */
     std::string getCurrentExecutablePath();
@@ -0,0 +1,92 @@
+#pragma once
+
+#ifndef HLS_HPP
+#define HLS_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace AnimepaheCLI
+{
+    /**
+     * HLS playlists of the kwik player, the fallback when the kwik download
+     * (/f/) does not resolve. A playlist direct link is the .m3u8 url with
+     * the file name and referer in its fragment, so it travels through the
+     * export, preflight and Downloader like any other direct link and only
+     * Client::download tells it apart. Segments are fetched in parallel,
+     * decrypted and written in order, so the file is one MPEG-TS stream.
+     */
+    namespace Hls
+    {
+        /* where direct links come from (--source) */
+        enum class Source
+        {
+            Download, /* kwik /f/ only */
+            Auto,     /* kwik /f/, the player's playlist when that fails */
+            Stream    /* the player's playlist, kwik /f/ when that fails */
+        };
+
+        /* parallel = segments in flight per download */
+        void configure(Source source, int parallel);
+        Source source();
+        int parallel();
+
+        /* EXT-X-KEY METHOD=AES-128 */
+        struct Key
+        {
+            std::string uri;
+            std::string iv; /* 16 bytes, empty = the segment's media sequence number */
+        };
+
+        struct Segment
+        {
+            std::string url;
+            double duration = 0.0;
+            uint64_t sequence = 0;
+            int key = -1; /* into Playlist::keys, -1 = clear */
+        };
+
+        /* EXT-X-STREAM-INF entry of a master playlist */
+        struct Rendition
+        {
+            std::string url;
+            uint64_t bandwidth = 0;
+            int height = 0;
+        };
+
+        struct Playlist
+        {
+            std::vector<Rendition> renditions; /* master playlists only */
+            std::vector<Key> keys;
+            std::vector<Segment> segments;
+            double duration = 0.0; /* seconds */
+        };
+
+        /**
+         * Master or media playlist, relative urls resolved against url.
+         * Throws on a body that is no playlist and on what cannot be written
+         * out as plain segments (SAMPLE-AES, byte ranges, fMP4 init sections).
+         */
+        Playlist parse(const std::string &text, const std::string &url);
+
+        /* reference relative to the playlist at base */
+        std::string resolve(const std::string &base, const std::string &reference);
+
+        /* the IV of a segment under key */
+        std::string segmentIv(const Key &key, uint64_t sequence);
+
+        /* playlist direct links, <url>#file=<name>&referer=<referer> */
+        struct Link
+        {
+            std::string url;
+            std::string file;
+            std::string referer;
+        };
+        std::string makeLink(const Link &link);
+        bool isLink(const std::string &url);
+        Link parseLink(const std::string &url);
+    }
+}
+
+#endif
@@ -0,0 +1,187 @@
+#pragma once
+
+#ifndef HTTP_HPP
+#define HTTP_HPP
+
+#include <cpr/cpr.h>
+#include <coroutine>
+#include <functional>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace AnimepaheCLI
+{
+    namespace Http
+    {
+        enum class Method
+        {
+            Get,
+            Post,
+            Head
+        };
+
+        /**
+         * Send every request to a local replay server instead of the real hosts
+         * (--endpoint http://127.0.0.1:8088). https://host/path?query becomes
+         * http://127.0.0.1:8088/host/path?query, so links scraped from pages keep
+         * working without being rewritten. Empty restores direct access.
+         */
+        void setEndpoint(const std::string &endpoint);
+        const std::string &getEndpoint();
+
+        /* rewrite a request url for the configured endpoint (identity without one) */
+        std::string resolveUrl(const std::string &url);
+
+        /**
+         * Record every response (status, headers, body) to a directory (--record DIR)
+         * as index.jsonl plus one file per body, for animepahe-mock to replay.
+         * Streamed download bodies are not stored, only their size.
+         */
+        void setRecordDirectory(const std::string &directory);
+
+        /**
+         * Hedged requests (--hedge P). An AsyncGet marked with Http::Hedge{}
+         * that has not answered within the P-th percentile of the latencies
+         * seen for its span is sent a second time; the first answer wins and
+         * the other transfer is cancelled. Until enough latencies are known
+         * nothing is hedged, and at most budget (a fraction) of the marked
+         * requests get a duplicate. percentile 0 turns hedging off.
+         */
+        void setHedging(double percentile, double budget);
+
+        /* option for AsyncGet: the request is idempotent and may be hedged */
+        struct Hedge
+        {
+        };
+
+        /**
+         * Run a prepared session and record it (trace span with curl timings,
+         * recording). Every request in the project goes through here or
+         * AsyncRequest, so cross-cutting behaviour only has to be added in one place.
+         */
+        cpr::Response perform(const std::string &span, cpr::Session &session, const std::string &url, Method method);
+
+        namespace detail
+        {
+            template <typename T>
+            void setOption(cpr::Session &session, std::string &, T &&option)
+                requires(!std::is_same_v<std::decay_t<T>, cpr::Url> && !std::is_same_v<std::decay_t<T>, Hedge>)
+            {
+                session.SetOption(std::forward<T>(option));
+            }
+
+            inline void setOption(cpr::Session &session, std::string &url, const cpr::Url &option)
+            {
+                url = option.str();
+                session.SetOption(cpr::Url{resolveUrl(url)});
+            }
+
+            /* read by AsyncGet, nothing to set on the session */
+            inline void setOption(cpr::Session &, std::string &, const Hedge &) {}
+
+            template <typename... Ts>
+            constexpr bool hasHedge = (std::is_same_v<std::decay_t<Ts>, Hedge> || ...);
+        }
+
+        /* drop-in replacements for cpr::Get / cpr::Post / cpr::Head with a span name */
+        template <typename... Ts>
+        cpr::Response Get(const std::string &span, Ts &&...ts)
+        {
+            cpr::Session session;
+            std::string url;
+            (detail::setOption(session, url, std::forward<Ts>(ts)), ...);
+            return perform(span, session, url, Method::Get);
+        }
+
+        template <typename... Ts>
+        cpr::Response Post(const std::string &span, Ts &&...ts)
+        {
+            cpr::Session session;
+            std::string url;
+            (detail::setOption(session, url, std::forward<Ts>(ts)), ...);
+            return perform(span, session, url, Method::Post);
+        }
+
+        template <typename... Ts>
+        cpr::Response Head(const std::string &span, Ts &&...ts)
+        {
+            cpr::Session session;
+            std::string url;
+            (detail::setOption(session, url, std::forward<Ts>(ts)), ...);
+            return perform(span, session, url, Method::Head);
+        }
+
+        /**
+         * Awaitable request on the shared event loop (curl multi). No thread
+         * blocks while it is in flight; the awaiting coroutine resumes on the
+         * event loop thread, so move heavy work elsewhere (Executor::schedule).
+         */
+        class AsyncRequest
+        {
+        public:
+            AsyncRequest(const std::string &span, Method method)
+                : span_(span), method_(method), session_(std::make_shared<cpr::Session>()) {}
+
+            using Configure = std::function<void(cpr::Session &, std::string &)>;
+
+            cpr::Session &session() { return *session_; }
+            std::string &url() { return url_; }
+
+            /* builds the duplicate session of a hedged request */
+            void setHedge(Configure configure) { configure_ = std::move(configure); }
+
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> handle);
+            cpr::Response await_resume() { return std::move(response_); }
+
+        private:
+            void suspendHedged(std::coroutine_handle<> handle, long delayMs);
+
+            std::string span_;
+            Method method_;
+            std::shared_ptr<cpr::Session> session_;
+            std::string url_;
+            int64_t start_ = 0;
+            cpr::Response response_;
+            Configure configure_;
+        };
+
+        /* co_await Http::AsyncGet("GET kwik", cpr::Url{link}, ..., Http::Hedge{}) */
+        template <typename... Ts>
+        AsyncRequest AsyncGet(const std::string &span, Ts &&...ts)
+        {
+            AsyncRequest request(span, Method::Get);
+            if constexpr (detail::hasHedge<Ts...>)
+            {
+                /* the options are kept so a duplicate can be configured the same way */
+                request.setHedge([options = std::make_tuple(std::decay_t<Ts>(ts)...)](cpr::Session &session, std::string &url)
+                                 { std::apply([&session, &url](const auto &...option)
+                                              { (detail::setOption(session, url, option), ...); },
+                                              options); });
+            }
+            (detail::setOption(request.session(), request.url(), std::forward<Ts>(ts)), ...);
+            return request;
+        }
+
+        template <typename... Ts>
+        AsyncRequest AsyncPost(const std::string &span, Ts &&...ts)
+        {
+            AsyncRequest request(span, Method::Post);
+            (detail::setOption(request.session(), request.url(), std::forward<Ts>(ts)), ...);
+            return request;
+        }
+
+        template <typename... Ts>
+        AsyncRequest AsyncHead(const std::string &span, Ts &&...ts)
+        {
+            AsyncRequest request(span, Method::Head);
+            (detail::setOption(request.session(), request.url(), std::forward<Ts>(ts)), ...);
+            return request;
+        }
+    }
+}
+
+#endif
@@ -7,15 +7,45 @@
 
 namespace AnimepaheCLI
 {
+    /* decoding and parsing of the pahe.win and kwik pages, no network access */
     class KwikPahe
     {
-    private:
+    public:
+        /* hidden form on the kwik page, POSTed to get the CDN redirect */
+        struct KwikForm
+        {
+            std::string action;
+            std::string token;
+            std::string session; /* kwik_session cookie */
+        };
+
+        /* HLS source of the kwik player (kwik.si/e/) */
+        struct KwikStream
+        {
+            std::string source; /* .m3u8 url */
+            std::string title;  /* page title, usually the file name of the /f/ download */
+        };
+
+        /* decoder for the packed kwik/pahe.win scripts, public for the benchmarks */
         int _0xe16c(const std::string &IS, int Iy, int ms);
         std::string decodeJSStyle(const std::string &Hb, int zp, const std::string &Wg, int Of, int Jg, int gj_placeholder);
-        std::string fetch_kwik_dlink(const std::string& kwikLink, int retries = 5); 
-        std::string fetch_kwik_direct(const std::string &kwikLink, const std::string &token, const std::string &kwik_session);
-    public:
-        std::string extract_kwik_link(const std::string& link);
+
+        /* kwik.si/f/ link of a pahe.win page, throws when there is none */
+        std::string parse_pahe_page(const std::string &html);
+
+        /* form of a kwik page, empty action when the page did not decode (kwik serves those now and then) */
+        KwikForm parse_kwik_page(const std::string &html, const std::string &rawHeader);
+
+        /* playlist of a kwik embed page, throws when there is none */
+        KwikStream parse_embed_page(const std::string &html);
+
+        /* Location of the kwik POST redirect, empty when missing */
+        static std::string parse_redirect_location(const std::string &rawHeader);
+
+    private:
+        bool decode_packed(const std::string &text, std::string &decoded);
+        /* eval(function(p,a,c,k,e,d){...}) packer of the player script */
+        static bool unpack_eval(const std::string &text, std::string &decoded);
     };
 }
 
@@ -0,0 +1,43 @@
+#pragma once
+
+#ifndef LINKEXPORT_HPP
+#define LINKEXPORT_HPP
+
+#include <client.hpp>
+#include <fstream>
+#include <string>
+
+namespace AnimepaheCLI
+{
+    /**
+     * Export file for -x. Every link is written and flushed the moment its
+     * episode resolves, so a downloader tailing the file can start on the
+     * first episode while the rest of the series is still being resolved.
+     *
+     *   txt    one url per line
+     *   aria2  aria2c --input-file entries with out=, dir= and split options
+     *   jsonl  one JSON object per episode (episode, file, dir, quality, url)
+     *   m3u    extended m3u playlist for players that stream http
+     */
+    class LinkExport
+    {
+    public:
+        /* throws std::runtime_error for an unknown format or a file that cannot be created */
+        LinkExport(const std::string &path, const std::string &format, const std::string &seriesDir);
+
+        /* txt, aria2, jsonl or m3u from the extension of path (.aria2, .jsonl/.json, .m3u/.m3u8), txt otherwise */
+        static std::string formatFor(const std::string &path);
+        static bool isFormat(const std::string &format);
+
+        void add(const Episode &episode, const Variant &variant, const std::string &url);
+        size_t count() const { return count_; }
+
+    private:
+        std::ofstream file_;
+        std::string format_;
+        std::string dir_;
+        size_t count_ = 0;
+    };
+}
+
+#endif
@@ -0,0 +1,93 @@
+#pragma once
+
+#ifndef LIVESTREAM_HPP
+#define LIVESTREAM_HPP
+
+#include <localserver.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace AnimepaheCLI
+{
+    /**
+     * Watch-while-downloading (--stream). The episode being downloaded is
+     * either served on http://127.0.0.1:<port>/ with Range support, reading
+     * the bytes back from its file as soon as they were flushed, or piped to
+     * stdout (terminal output moves to stderr). Requests for bytes that have
+     * not arrived yet wait for them. The pipe is written by its own thread,
+     * so a player that reads slowly never holds up a download thread; it
+     * reads the episode back from its file too, and only an episode without
+     * one waits in a bounded queue. A player that quit (EPIPE) only ends
+     * the pipe, the downloads go on.
+     */
+    class LiveStream
+    {
+    public:
+        /* "http", "http:<port>" or "stdout"; throws std::runtime_error for anything else or a busy port */
+        explicit LiveStream(const std::string &mode);
+        ~LiveStream();
+        LiveStream(const LiveStream &) = delete;
+        LiveStream &operator=(const LiveStream &) = delete;
+
+        bool isHttp() const { return !toStdout_; }
+        std::string url() const;
+
+        /* a new episode starts downloading to path (empty in stdout mode when nothing is kept) */
+        void begin(const std::string &name, const std::string &path, uint64_t expected);
+        /* total size once the server sent one */
+        void setTotal(uint64_t total);
+        /* a chunk that reached the file (flushed), or the bytes to pipe */
+        void append(const char *data, size_t size);
+        void end(bool ok);
+
+        /* after the last episode: wait until no player is still reading, then stop serving */
+        void finish();
+
+    private:
+        struct Episode
+        {
+            std::string name;
+            std::string path;
+            uint64_t total = 0;
+            uint64_t available = 0;
+            bool finished = false;
+            bool failed = false;
+
+            /* stdout mode: read back from path, or, without a file, chunks waiting for the pipe */
+            std::shared_ptr<std::ifstream> source;
+            bool memory = false;
+            std::deque<std::string> chunks;
+            size_t queued = 0;
+        };
+
+        /* shared with the connection threads, which may outlive a request */
+        struct State
+        {
+            std::mutex mutex;
+            std::condition_variable changed;
+            std::shared_ptr<Episode> current;
+            int readers = 0;
+            bool stopping = false;
+            std::deque<std::shared_ptr<Episode>> piped; /* begun and not fully written to the pipe yet */
+            bool pipeClosed = false;
+        };
+
+        static void serve(const std::shared_ptr<State> &state, const LocalServer::Request &request, LocalServer::Connection &connection);
+        /* the stdout writer thread, episodes in the order they began */
+        static void pipeEpisodes(const std::shared_ptr<State> &state, int pipe);
+
+        std::shared_ptr<State> state_ = std::make_shared<State>();
+        LocalServer server_;
+        bool toStdout_ = false;
+        int pipe_ = -1; /* the original stdout in stdout mode */
+        std::thread writer_;
+    };
+}
+
+#endif
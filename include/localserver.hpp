@@ -0,0 +1,83 @@
+#pragma once
+
+#ifndef LOCALSERVER_HPP
+#define LOCALSERVER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <thread>
+
+namespace AnimepaheCLI
+{
+    /**
+     * Minimal HTTP/1.1 server for localhost tooling (mock site, stream mode).
+     * One thread per connection, keep-alive, request bodies via Content-Length.
+     * Not meant to face the internet.
+     */
+    class LocalServer
+    {
+    public:
+        struct Request
+        {
+            std::string method;
+            std::string target; /* raw request target, path + query */
+            std::string path;
+            std::string query;
+            std::map<std::string, std::string> headers; /* lower-case names */
+            std::string body;
+
+            std::string header(const std::string &name, const std::string &fallback = "") const;
+        };
+
+        /* response writer handed to the handler, supports streaming bodies */
+        class Connection
+        {
+        public:
+            explicit Connection(intptr_t socket) : socket_(socket) {}
+
+            /* status line and headers; Content-Length decides keep-alive */
+            bool sendHead(int status, const std::map<std::string, std::string> &headers);
+            bool send(const char *data, size_t size);
+            bool send(const std::string &data) { return send(data.data(), data.size()); }
+
+            /* complete response in one call */
+            bool respond(int status, const std::string &body, const std::map<std::string, std::string> &headers = {});
+
+            bool keepAlive() const { return keepAlive_; }
+
+        private:
+            intptr_t socket_;
+            bool keepAlive_ = true;
+        };
+
+        using Handler = std::function<void(const Request &, Connection &)>;
+
+        LocalServer() = default;
+        ~LocalServer();
+        LocalServer(const LocalServer &) = delete;
+        LocalServer &operator=(const LocalServer &) = delete;
+
+        /* bind and start accepting in the background; port 0 picks a free port */
+        void start(const std::string &host, uint16_t port, Handler handler);
+        void stop();
+        uint16_t port() const { return port_; }
+
+        static const char *statusText(int status);
+
+    private:
+        void acceptLoop();
+        void serveConnection(intptr_t client);
+
+        intptr_t listener_ = -1;
+        uint16_t port_ = 0;
+        Handler handler_;
+        std::atomic<bool> running_{false};
+        std::atomic<int> activeConnections_{0};
+        std::thread acceptThread_;
+    };
+}
+
+#endif
@@ -0,0 +1,71 @@
+#pragma once
+
+#ifndef MANIFEST_HPP
+#define MANIFEST_HPP
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace AnimepaheCLI
+{
+    /**
+     * What is already downloaded into <series>/videos/, kept in
+     * <series>/.manifest.json. Every finished episode is recorded with its
+     * file, size and quality, keyed by its play page session, so a rerun
+     * can skip it before any play page or kwik request. Folders from before
+     * the manifest are matched by file name ("_-_12_1080p_"), except for
+     * the file that was being downloaded when a run stopped; such a file is
+     * only recorded once its size matched the server's.
+     */
+    class Manifest
+    {
+    public:
+        struct Entry
+        {
+            std::string session; /* last part of the play link */
+            int number = 0;
+            std::string file;   /* name inside videos/ */
+            uint64_t bytes = 0;
+            int resolution = 0; /* 0 when unknown */
+        };
+
+        /* reads the manifest and lists videos/ once, a missing folder is an empty one */
+        explicit Manifest(const std::string &seriesDir);
+
+        /* the recorded complete copy of an episode at targetRes (0 and -1 take any), nullopt when there is none */
+        std::optional<Entry> find(const std::string &episodeLink, int targetRes) const;
+
+        /* a file in videos/ the manifest does not know whose name matches the episode, not checked against anything */
+        std::optional<Entry> findNamed(int number, int targetRes) const;
+        /* a file from findNamed() whose size matched the server's, recorded as the episode's copy */
+        void adopt(const std::string &episodeLink, const Entry &entry);
+
+        /* numbers of the episodes find() or findNamed() would probably match at targetRes, without checking any file */
+        std::vector<int> present(int targetRes) const;
+
+        /* path of an entry's file */
+        std::string pathOf(const Entry &entry) const;
+
+        /* mark the file a download is about to write, it is never matched by name */
+        void start(const std::string &file);
+        /* a finished download */
+        void record(const Entry &entry);
+
+        static std::string sessionOf(const std::string &episodeLink);
+        /* the manifest or its temporary file, folder archivers leave them out */
+        static bool isManifestFile(const std::string &fileName);
+
+    private:
+        std::string dir_;
+        std::map<std::string, Entry> entries_; /* session -> entry */
+        std::vector<Entry> named_;             /* videos/ files not in the manifest, by name */
+        std::string downloading_;
+
+        void save() const;
+    };
+}
+
+#endif
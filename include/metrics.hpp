@@ -0,0 +1,80 @@
+#pragma once
+
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace AnimepaheCLI
+{
+    namespace Metrics
+    {
+        /* pipeline phases that are timed individually */
+        enum class Phase
+        {
+            Metadata,   /* extract_link_metadata */
+            Pagination, /* release API pages */
+            PlayPage,   /* fetch_episode */
+            Kwik,       /* extract_kwik_link (pahe.win -> kwik -> direct link) */
+            Download,   /* one episode file */
+            Zip         /* archive creation */
+        };
+
+        const char *phaseName(Phase phase);
+
+        /* record one completed operation of a phase */
+        void observe(Phase phase, double seconds, size_t bytes, bool ok);
+
+        /* count a retry inside a phase (the retried attempt is not a new observation) */
+        void retry(Phase phase);
+
+        /* hedged requests (--hedge): duplicates sent, duplicates that answered first, duplicates the budget refused */
+        enum class Hedge
+        {
+            Sent,
+            Won,
+            Capped
+        };
+        void hedge(Hedge outcome);
+
+        /**
+         * Times a scope and records it on destruction (and as a trace span with --trace).
+         * Without an explicit success()/failure() call the operation counts as failed,
+         * so a phase left through an exception is recorded correctly.
+         */
+        class Timer
+        {
+        public:
+            explicit Timer(Phase phase);
+            ~Timer();
+            Timer(const Timer &) = delete;
+            Timer &operator=(const Timer &) = delete;
+
+            void success(size_t bytes = 0);
+            void failure(size_t bytes = 0);
+
+        private:
+            void finish(bool ok, size_t bytes);
+
+            Phase phase_;
+            std::chrono::steady_clock::time_point start_;
+            int64_t traceStart_;
+            bool finished_ = false;
+        };
+
+        /* end-of-run table (--stats); emitted as a "stats" event in JSON mode */
+        void printSummary();
+
+        /**
+         * Write all metrics in the Prometheus text exposition format.
+         * The file is written next to the target and renamed into place so the
+         * node_exporter textfile collector never reads a partial file.
+         */
+        bool writePrometheus(const std::string &path);
+    }
+}
+
+#endif
@@ -0,0 +1,87 @@
+#pragma once
+
+#ifndef PACKER_HPP
+#define PACKER_HPP
+
+#include <ziputils.hpp>
+#include <tarutils.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace AnimepaheCLI
+{
+    /**
+     * Archive for -z --rm-source when the episodes cannot be streamed into
+     * it (tar, tar.zst, --zip-mode after). Every finished episode is added
+     * on a background thread while the next one downloads, and its file is
+     * deleted as soon as the entry is flushed and synced, so the disk holds
+     * the archive plus the few episodes that are not packed yet instead of
+     * the whole season twice. With a limit, downloads wait in waitForRoom()
+     * until packing caught up.
+     */
+    class Packer
+    {
+    public:
+        /* format zip, tar or tar.zst; limit in bytes of staged (downloaded, not yet packed) episodes, 0 = none */
+        Packer(const std::string &archiveName, const std::string &format, uint64_t limit);
+        /**
+         * Stops the worker. An archive that was not finished is removed, or,
+         * once any source was deleted, finished with the entries committed
+         * so far and reported with its path.
+         */
+        ~Packer();
+        Packer(const Packer &) = delete;
+        Packer &operator=(const Packer &) = delete;
+
+        /* a finished file, packed as name and then deleted */
+        void add(const std::string &path, const std::string &name);
+
+        /* block while the staged files and expected more bytes would be over the limit */
+        void waitForRoom(uint64_t expected);
+
+        /* pack everything queued and close the archive, throws the first error (naming the partial archive, if one is kept) */
+        void finish();
+
+        /* the archive after finish() */
+        size_t entries() const;
+        uint64_t bytes() const;
+        /* seconds downloads spent waiting for room */
+        double waited() const { return waited_; }
+
+    private:
+        struct Item
+        {
+            std::string path;
+            std::string name;
+            uint64_t size = 0;
+        };
+
+        void run();
+        /* the archive of an aborted run, returns reason plus where the packed episodes are */
+        std::string abort(const std::string &reason);
+
+        std::unique_ptr<ZipUtils::ZipWriter> zip_;
+        std::unique_ptr<TarUtils::TarStream> tar_;
+        std::string archiveName_;
+        uint64_t limit_;
+
+        std::mutex mutex_;
+        std::condition_variable changed_;
+        std::deque<Item> queue_;
+        uint64_t staged_ = 0; /* queued and in progress */
+        bool stopping_ = false;
+        bool finished_ = false;
+        size_t removed_ = 0; /* sources deleted, they only exist in the archive now */
+        std::exception_ptr error_;
+        double waited_ = 0.0;
+        std::thread worker_;
+    };
+}
+
+#endif
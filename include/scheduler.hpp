@@ -0,0 +1,45 @@
+#pragma once
+
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+#include <functional>
+#include <string>
+
+namespace AnimepaheCLI
+{
+    namespace Scheduler
+    {
+        /**
+         * Per-host concurrency limits for every request (animepahe, pahe.win,
+         * kwik, each CDN node). A host's limit grows by one per window of
+         * good answers and is cut when it pushes back: halved on 429/503,
+         * another 5xx or a transport error, shrunk by a fifth when time to
+         * first byte inflates well past the best seen. At most one cut happens per window, and
+         * the limit stays within the configured floor and ceiling. Requests
+         * over the limit wait for a slot instead of being sent. Hosts are the
+         * original ones, so a replay --endpoint still separates them. All
+         * functions are thread safe.
+         */
+        void configure(int floor, int ceiling);
+
+        enum class Outcome
+        {
+            Ok,
+            Throttled, /* 429 or 503 */
+            Failed,    /* reset, refused, timed out, or another 5xx (500, 502, 504) */
+            Cancelled  /* aborted on our side, says nothing about the host */
+        };
+
+        /* call start now when the url's host has a free slot, otherwise once one frees up (from release) */
+        void acquire(const std::string &url, std::function<void()> start);
+
+        /* the transfer holding a slot finished; ttfb in seconds feeds the latency signal */
+        void release(const std::string &url, Outcome outcome, double ttfb);
+
+        /* limit per host at the end of the run for --stats ("host_limits" event in json mode) */
+        void printSummary();
+    }
+}
+
+#endif
@@ -0,0 +1,43 @@
+#pragma once
+
+#ifndef SESSION_HPP
+#define SESSION_HPP
+
+#include <string>
+
+namespace AnimepaheCLI
+{
+    namespace Session
+    {
+        /**
+         * Cookie jar and kwik form token shared by every request of the run and
+         * kept in a JSON file between runs (--session-file). DDoS-Guard cookies
+         * and the kwik session survive until they expire, so a warm start skips
+         * the challenge and the kwik page of each resolution. Entries are keyed
+         * by the host of the original (not --endpoint rewritten) url. All
+         * functions are thread safe.
+         */
+        void open(const std::string &path);
+
+        /* session.json in userCacheDirectory(), empty when there is none */
+        std::string defaultPath();
+
+        /* "name=value; ..." of the live cookies for the url's host, empty when there are none */
+        std::string cookieHeader(const std::string &url);
+
+        /* keep the Set-Cookie lines of a raw response header, cookies without an expiry live 30 minutes */
+        void storeCookies(const std::string &url, const std::string &rawHeader);
+
+        /* _token accepted with the host's kwik_session, empty when either is missing or expired */
+        std::string kwikToken(const std::string &url);
+        void storeKwikToken(const std::string &url, const std::string &token);
+
+        /* forget the token and kwik_session of the host after kwik rejected them */
+        void dropKwik(const std::string &url);
+
+        /* write the jar if it changed, false if the file cannot be written */
+        bool save();
+    }
+}
+
+#endif
@@ -0,0 +1,37 @@
+#pragma once
+
+#ifndef SHA256_HPP
+#define SHA256_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace AnimepaheCLI
+{
+    /* incremental SHA-256 (FIPS 180-4), for checking downloads against published digests */
+    class Sha256
+    {
+    public:
+        Sha256();
+
+        void update(const void *data, size_t size);
+
+        /* lowercase hex digest, the object is reset afterwards */
+        std::string finish();
+
+        /* digest of a whole file, empty when it cannot be read */
+        static std::string file(const std::string &path);
+
+    private:
+        void compress(const uint8_t *block);
+
+        std::array<uint32_t, 8> state_;
+        std::array<uint8_t, 64> buffer_;
+        size_t buffered_ = 0;
+        uint64_t length_ = 0;
+    };
+}
+
+#endif
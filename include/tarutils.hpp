@@ -0,0 +1,96 @@
+#pragma once
+
+#include "ziputils.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace TarUtils {
+
+    /**
+     * Same shape as the ZIP progress callback
+     * Parameters: current_file_index, total_files, current_file_path, bytes_processed, total_bytes
+     */
+    using ProgressCallback = ZipUtils::ProgressCallback;
+
+    enum class Compression {
+        None,   // .tar, every body copied by the kernel
+        Zstd    // .tar.zst, media bodies in raw zstd blocks (kernel copied), everything else compressed
+    };
+
+    /**
+     * Summary of one tar_directory run
+     */
+    struct TarStats {
+        size_t entries = 0;          // files and directories written
+        size_t copied = 0;           // file bodies copied without compression
+        size_t compressed = 0;       // file bodies compressed with zstd
+        uint64_t input_bytes = 0;    // size of all source files
+        uint64_t archive_bytes = 0;  // size of the finished archive
+        uint64_t kernel_bytes = 0;   // bytes moved by copy_file_range/sendfile
+        double seconds = 0.0;        // total wall time
+    };
+
+    /**
+     * Packs a directory into a POSIX (pax) tar archive.
+     *
+     * Headers are written here; file bodies are copied with copy_file_range,
+     * falling back to sendfile and then to read/write, so on Linux the video
+     * data never passes through user space and packing runs at disk speed.
+     * With Compression::Zstd the archive is a sequence of zstd frames: media
+     * bodies go into raw (stored) blocks, still copied by the kernel, while
+     * headers and the small sidecar files are compressed. Any zstd
+     * decompressor (`tar --zstd -xf`) reads the result.
+     *
+     * @param directory_path Path to the directory to pack
+     * @param tar_name Name/path for the output archive
+     * @param compression None for .tar, Zstd for .tar.zst
+     * @param delete_source If true, deletes the source directory after successful packing
+     * @param progress_callback Optional callback function for progress updates
+     * @param stats Optional, filled with the summary of the run
+     * @return true if successful
+     * @throws std::runtime_error if directory doesn't exist or writing fails
+     */
+    /**
+     * Append-only .tar or .tar.zst for files that become ready one at a
+     * time, e.g. episodes packed as soon as they finished downloading.
+     * Bodies are copied like in tar_directory(); commit() makes everything
+     * added so far durable, so the source files can go.
+     */
+    class TarStream {
+    public:
+        /** @throws std::runtime_error if the file cannot be created */
+        TarStream(const std::string& tar_name, Compression compression);
+        /** removes the archive unless close() succeeded or close_committed() ran */
+        ~TarStream();
+        TarStream(const TarStream&) = delete;
+        TarStream& operator=(const TarStream&) = delete;
+
+        void add_file(const std::string& path, const std::string& name);
+        void commit();
+        /** end blocks, the archive is complete afterwards */
+        void close();
+        /**
+         * close() for an aborted run: whatever was added after the last
+         * commit() is cut off and the committed entries get the end blocks.
+         * The file is kept even when this throws.
+         */
+        void close_committed();
+
+        size_t entries() const;
+        uint64_t bytes() const;   // archive size so far (compressed)
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> impl_;
+    };
+
+    bool tar_directory(
+        const std::string& directory_path,
+        const std::string& tar_name,
+        Compression compression = Compression::None,
+        bool delete_source = false,
+        ProgressCallback progress_callback = nullptr,
+        TarStats* stats = nullptr
+    );
+}
@@ -0,0 +1,388 @@
+#pragma once
+
+#ifndef TASK_HPP
+#define TASK_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace AnimepaheCLI
+{
+    template <typename T = void>
+    class Task;
+
+    namespace detail
+    {
+        /* resume whoever awaited the task, or return to the resumer when nobody did */
+        struct FinalAwaiter
+        {
+            bool await_ready() const noexcept { return false; }
+
+            template <typename Promise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+            {
+                auto continuation = handle.promise().continuation;
+                return continuation ? continuation : std::noop_coroutine();
+            }
+
+            void await_resume() const noexcept {}
+        };
+
+        struct PromiseBase
+        {
+            std::coroutine_handle<> continuation;
+            std::exception_ptr exception;
+
+            std::suspend_always initial_suspend() const noexcept { return {}; }
+            FinalAwaiter final_suspend() const noexcept { return {}; }
+            void unhandled_exception() noexcept { exception = std::current_exception(); }
+        };
+
+        template <typename T>
+        struct Promise : PromiseBase
+        {
+            std::optional<T> value;
+
+            Task<T> get_return_object() noexcept;
+
+            template <typename U>
+            void return_value(U &&result)
+            {
+                value.emplace(std::forward<U>(result));
+            }
+
+            T result()
+            {
+                if (exception)
+                {
+                    std::rethrow_exception(exception);
+                }
+                return std::move(*value);
+            }
+        };
+
+        template <>
+        struct Promise<void> : PromiseBase
+        {
+            Task<void> get_return_object() noexcept;
+
+            void return_void() noexcept {}
+
+            void result()
+            {
+                if (exception)
+                {
+                    std::rethrow_exception(exception);
+                }
+            }
+        };
+    }
+
+    /**
+     * Lazily started coroutine producing a T (or an exception).
+     * Nothing runs until the task is awaited or handed to syncWait/whenAll,
+     * and the awaiting coroutine continues on whichever thread finished it.
+     */
+    template <typename T>
+    class Task
+    {
+    public:
+        using promise_type = detail::Promise<T>;
+        using value_type = T;
+
+        Task() = default;
+        explicit Task(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+        Task(Task &&other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+        Task &operator=(Task &&other) noexcept
+        {
+            if (this != &other)
+            {
+                if (handle_)
+                {
+                    handle_.destroy();
+                }
+                handle_ = std::exchange(other.handle_, {});
+            }
+            return *this;
+        }
+        Task(const Task &) = delete;
+        Task &operator=(const Task &) = delete;
+
+        ~Task()
+        {
+            if (handle_)
+            {
+                handle_.destroy();
+            }
+        }
+
+        auto operator co_await() noexcept
+        {
+            struct Awaiter
+            {
+                std::coroutine_handle<promise_type> handle;
+
+                bool await_ready() const noexcept { return !handle || handle.done(); }
+
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+                {
+                    handle.promise().continuation = awaiting;
+                    return handle;
+                }
+
+                T await_resume() { return handle.promise().result(); }
+            };
+            return Awaiter{handle_};
+        }
+
+    private:
+        std::coroutine_handle<promise_type> handle_;
+    };
+
+    namespace detail
+    {
+        template <typename T>
+        Task<T> Promise<T>::get_return_object() noexcept
+        {
+            return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+        }
+
+        inline Task<void> Promise<void>::get_return_object() noexcept
+        {
+            return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+        }
+
+        /* fire-and-forget driver, the frame frees itself when done */
+        struct Detached
+        {
+            struct promise_type
+            {
+                Detached get_return_object() noexcept { return {}; }
+                std::suspend_never initial_suspend() const noexcept { return {}; }
+                std::suspend_never final_suspend() const noexcept { return {}; }
+                void return_void() noexcept {}
+                void unhandled_exception() noexcept { std::terminate(); }
+            };
+        };
+
+        template <typename T>
+        struct Slot
+        {
+            std::optional<T> value;
+            std::exception_ptr exception;
+        };
+
+        template <>
+        struct Slot<void>
+        {
+            std::exception_ptr exception;
+        };
+
+        template <typename T, typename Done>
+        Detached drive(Task<T> &task, Slot<T> &slot, Done done)
+        {
+            try
+            {
+                if constexpr (std::is_void_v<T>)
+                {
+                    co_await task;
+                }
+                else
+                {
+                    slot.value.emplace(co_await task);
+                }
+            }
+            catch (...)
+            {
+                slot.exception = std::current_exception();
+            }
+            done();
+        }
+
+        template <typename T>
+        struct WhenAllAwaiter
+        {
+            std::vector<Task<T>> &tasks;
+            std::vector<Slot<T>> &slots;
+            std::atomic<size_t> remaining{0};
+            std::coroutine_handle<> continuation;
+
+            bool await_ready() const noexcept { return tasks.empty(); }
+
+            bool await_suspend(std::coroutine_handle<> awaiting)
+            {
+                continuation = awaiting;
+                /* one extra count for this function, so a task finishing early cannot resume us twice */
+                remaining = tasks.size() + 1;
+                for (size_t i = 0; i < tasks.size(); ++i)
+                {
+                    drive(tasks[i], slots[i], [this]() {
+                        if (--remaining == 0)
+                        {
+                            continuation.resume();
+                        }
+                    });
+                }
+                return --remaining != 0;
+            }
+
+            void await_resume() const noexcept {}
+        };
+    }
+
+    /**
+     * Block the calling thread until the task finishes and return its result.
+     * The bridge between plain code (the CLI, tests) and the coroutine API.
+     */
+    template <typename T>
+    T syncWait(Task<T> task)
+    {
+        std::mutex mutex;
+        std::condition_variable finished;
+        bool done = false;
+        detail::Slot<T> slot;
+
+        detail::drive(task, slot, [&]() {
+            /* notify under the lock, the waiter owns these locals */
+            std::lock_guard<std::mutex> lock(mutex);
+            done = true;
+            finished.notify_all();
+        });
+
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [&]() { return done; });
+
+        if (slot.exception)
+        {
+            std::rethrow_exception(slot.exception);
+        }
+        if constexpr (!std::is_void_v<T>)
+        {
+            return std::move(*slot.value);
+        }
+    }
+
+    /**
+     * A task that was started right away and is awaited later, so its work
+     * overlaps with whatever the caller does in between (the next release
+     * page while the current one is being resolved). Awaiting it more than
+     * once is not allowed; dropping it unawaited lets the task finish and
+     * discards the result.
+     */
+    template <typename T>
+    class Spawned
+    {
+    public:
+        Spawned() = default;
+
+        explicit Spawned(Task<T> task) : state_(std::make_shared<State>())
+        {
+            state_->task = std::move(task);
+            detail::drive(state_->task, state_->slot, [state = state_]() {
+                std::coroutine_handle<> waiter;
+                {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    state->done = true;
+                    waiter = std::exchange(state->waiter, {});
+                }
+                if (waiter)
+                {
+                    waiter.resume();
+                }
+            });
+        }
+
+        explicit operator bool() const { return state_ != nullptr; }
+
+        auto operator co_await() noexcept
+        {
+            struct Awaiter
+            {
+                std::shared_ptr<typename Spawned::State> state;
+
+                bool await_ready() const noexcept
+                {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    return state->done;
+                }
+
+                bool await_suspend(std::coroutine_handle<> awaiting) noexcept
+                {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    if (state->done)
+                    {
+                        return false;
+                    }
+                    state->waiter = awaiting;
+                    return true;
+                }
+
+                T await_resume()
+                {
+                    if (state->slot.exception)
+                    {
+                        std::rethrow_exception(state->slot.exception);
+                    }
+                    if constexpr (!std::is_void_v<T>)
+                    {
+                        return std::move(*state->slot.value);
+                    }
+                }
+            };
+            return Awaiter{std::exchange(state_, {})};
+        }
+
+    private:
+        struct State
+        {
+            std::mutex mutex;
+            bool done = false;
+            std::coroutine_handle<> waiter;
+            Task<T> task;
+            detail::Slot<T> slot;
+        };
+
+        std::shared_ptr<State> state_;
+    };
+
+    /**
+     * Start every task at once and finish when all of them have, results in
+     * input order. The first exception (by position) is rethrown after all
+     * tasks completed.
+     */
+    template <typename T>
+    Task<std::conditional_t<std::is_void_v<T>, void, std::vector<T>>> whenAll(std::vector<Task<T>> tasks)
+    {
+        std::vector<detail::Slot<T>> slots(tasks.size());
+        co_await detail::WhenAllAwaiter<T>{tasks, slots};
+
+        for (auto &slot : slots)
+        {
+            if (slot.exception)
+            {
+                std::rethrow_exception(slot.exception);
+            }
+        }
+
+        if constexpr (!std::is_void_v<T>)
+        {
+            std::vector<T> results;
+            results.reserve(slots.size());
+            for (auto &slot : slots)
+            {
+                results.push_back(std::move(*slot.value));
+            }
+            co_return results;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,73 @@
+#pragma once
+
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <nlohmann/json.hpp>
+#include <cstdint>
+#include <string>
+
+namespace AnimepaheCLI
+{
+    namespace Trace
+    {
+        /**
+         * Record spans for HTTP requests and pipeline stages (--trace FILE).
+         * The file is written in the Chrome trace-event format and loads in
+         * Perfetto (ui.perfetto.dev) or chrome://tracing.
+         */
+        void enable(const std::string &path);
+        bool isEnabled();
+
+        /* microseconds since process start, the trace clock */
+        int64_t now();
+
+        /* curl's timing breakdown of a single transfer, microseconds from the start of the request */
+        struct HttpTimings
+        {
+            int64_t dns = 0;       /* CURLINFO_NAMELOOKUP_TIME_T */
+            int64_t connect = 0;   /* CURLINFO_CONNECT_TIME_T */
+            int64_t tls = 0;       /* CURLINFO_APPCONNECT_TIME_T, 0 for plain http or reused connections */
+            int64_t ttfb = 0;      /* CURLINFO_STARTTRANSFER_TIME_T */
+            int64_t total = 0;     /* CURLINFO_TOTAL_TIME_T */
+            int64_t redirect = 0;  /* CURLINFO_REDIRECT_TIME_T */
+        };
+
+        /* a finished span on the calling thread */
+        void complete(const std::string &name, const std::string &category, int64_t start, int64_t end, nlohmann::json args = nlohmann::json::object());
+
+        /* an async request span (own track per request) with nested dns/connect/tls/wait/transfer slices */
+        void httpRequest(
+            const std::string &name,
+            const std::string &method,
+            const std::string &url,
+            int64_t start,
+            const HttpTimings &timings,
+            long status,
+            int64_t bytes
+        );
+
+        /* scoped pipeline span, recorded when it goes out of scope */
+        class Span
+        {
+        public:
+            Span(std::string name, std::string category = "stage");
+            ~Span();
+            Span(const Span &) = delete;
+            Span &operator=(const Span &) = delete;
+
+            void arg(const std::string &key, nlohmann::json value);
+
+        private:
+            std::string name_;
+            std::string category_;
+            int64_t start_;
+            nlohmann::json args_;
+        };
+
+        /* write the collected events, returns false if the file cannot be written */
+        bool write();
+    }
+}
+
+#endif
@@ -3,6 +3,7 @@
 #ifndef UTILS_HPP
 #define UTILS_HPP
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <map>
@@ -10,6 +11,13 @@
 
 namespace AnimepaheCLI
 {
+    /* one item of an episode selection, last = 0 for an open end ("400-") */
+    struct EpisodeRange
+    {
+        int first = 1;
+        int last = 0;
+    };
+
     std::string replaceSpacesWithUnderscore(std::string text);
     std::string sanitizeForWindowsPath(std::string name);
     int getPage(int number);
@@ -19,9 +27,29 @@ namespace AnimepaheCLI
     bool isFullSeriesURL(const std::string &url);
     bool isEpisodeURL(const std::string &url);
     bool isValidEpisodeRangeFormat(const std::string &input);
-    std::vector<int> parseEpisodeRange(const std::string &input);
+    std::vector<EpisodeRange> parseEpisodeRange(const std::string &input);
+    std::vector<int> getSelectionPages(const std::vector<EpisodeRange> &ranges, int total);
+    bool isEpisodeSelected(const std::vector<EpisodeRange> &ranges, int number);
+    std::string selectionToString(const std::vector<EpisodeRange> &ranges);
     std::string unescape_html_entities(const std::string &input);
     std::string padIntWithZero(int num);
+
+    /* file= query parameter of a direct link (the name kwik serves the episode under) or fragment field of a playlist link, empty when there is none */
+    std::string fileParameter(const std::string &url);
+
+    /* "40G", "512M", "1.5TiB" or plain bytes, binary multiples; false when it does not parse */
+    bool parseByteSize(const std::string &text, uint64_t &bytes);
+
+    /* $XDG_CACHE_HOME, ~/.cache or %LOCALAPPDATA% + /animepahe-cli, empty when none is known */
+    std::string userCacheDirectory();
+
+    /**
+     * Replace path with contents through <path>.tmp and a rename, so a crash
+     * never leaves half a file; missing parent folders are created. ownerOnly
+     * makes the file readable by its owner only. False when anything failed,
+     * path is then untouched.
+     */
+    bool writeFileAtomically(const std::string &path, const std::string &contents, bool ownerOnly = false);
     
     template <typename T>
     std::string vectorToString(const std::vector<T> &vec)
@@ -1,44 +1,143 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <functional>
+#include <memory>
 
 namespace ZipUtils {
-    
+
     /**
      * Progress callback function type
      * Parameters: current_file_index, total_files, current_file_path, bytes_processed, total_bytes
      */
     using ProgressCallback = std::function<void(size_t, size_t, const std::string&, size_t, size_t)>;
-    
+
+    /**
+     * Summary of one zip_directory run
+     */
+    struct ZipStats {
+        size_t entries = 0;          // files and directories written
+        size_t stored = 0;           // media and incompressible files, written as-is
+        size_t deflated = 0;         // files deflated on the worker threads
+        size_t threads = 0;          // deflate workers used
+        uint64_t input_bytes = 0;    // size of all source files
+        uint64_t archive_bytes = 0;  // size of the finished archive
+        double seconds = 0.0;        // total wall time
+    };
+
+    /**
+     * Append-only archive for entries produced on the fly, e.g. episodes
+     * written into stored entries while they download, so their data never
+     * has to be read back. One entry is open at a time and its CRC-32 is
+     * computed from the chunks passed to write(), which may run on another
+     * thread than begin_entry()/end_entry() as long as the calls do not overlap.
+     */
+    class ZipWriter {
+    public:
+        /**
+         * Writes <zip_name>.part, an existing zip_name is only replaced by
+         * close(). @throws std::runtime_error if the file cannot be created
+         */
+        explicit ZipWriter(const std::string& zip_name);
+        /** removes the .part file unless close() succeeded or close_committed() ran */
+        ~ZipWriter();
+        ZipWriter(const ZipWriter&) = delete;
+        ZipWriter& operator=(const ZipWriter&) = delete;
+
+        /** start a stored entry, sizes and CRC are filled in by end_entry() */
+        void begin_entry(const std::string& name);
+        void write(const char* data, size_t size);
+        void end_entry();
+
+        /** drop the open entry (failed download), its space is reused */
+        void discard_entry();
+
+        /** a finished file as one stored entry, read in chunks */
+        void add_file(const std::string& path, const std::string& name);
+
+        /** flush and sync everything written so far, e.g. before deleting the sources of it */
+        void commit();
+
+        /** write the central directory and verify_archive() the result, an open entry is discarded */
+        void close();
+        /**
+         * close() for an aborted run: entries added after the last commit()
+         * are dropped and the central directory lists the committed ones.
+         * The file is kept even when this throws, under zip_name unless an
+         * archive of that name already exists, see path().
+         */
+        void close_committed();
+
+        /** where the archive is now: the .part file until it was renamed */
+        std::string path() const;
+
+        size_t entries() const;
+        size_t committed() const; // entries as of the last commit()
+        uint64_t bytes() const;   // archive size so far
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> impl_;
+    };
+
+    /**
+     * Structural check of a finished archive: end records (ZIP64 included),
+     * every central directory entry against its local header, and entry data
+     * that neither overlaps nor runs into the central directory. Data and
+     * CRCs are not read back.
+     *
+     * @return number of entries
+     * @throws std::runtime_error describing the first problem found
+     */
+    size_t verify_archive(const std::string& zip_name);
+
+    /**
+     * True for files that are already compressed (video, audio, images, archives).
+     * Deflating them costs CPU and saves nothing, so they are stored.
+     */
+    bool is_compressed_media(const std::string& path);
+
     /**
      * Zips a directory with optional deletion of source content and progress reporting
-     * 
+     *
+     * Media files are stored (method 0) and copied straight into the archive.
+     * Every other file is deflated as an independent entry on a pool of worker
+     * threads while the archive is being written, so a season of episodes costs
+     * little more than a file copy. ZIP64 records are written when sizes,
+     * offsets or the entry count need them. Stored files are copied in
+     * fixed-size chunks, deflate buffers are capped by a memory budget, and
+     * progress_callback also fires while large files are being copied. The
+     * finished archive is checked with verify_archive().
+     *
      * @param directory_path Path to the directory to zip
      * @param zip_name Name/path for the output ZIP file
      * @param delete_source If true, deletes the source directory after successful zipping
      * @param progress_callback Optional callback function for progress updates
+     * @param stats Optional, filled with the summary of the run
      * @return true if successful, false otherwise
      * @throws std::runtime_error if directory doesn't exist or ZIP creation fails
      */
     bool zip_directory(
-        const std::string& directory_path, 
-        const std::string& zip_name, 
+        const std::string& directory_path,
+        const std::string& zip_name,
         bool delete_source = false,
-        ProgressCallback progress_callback = nullptr
+        ProgressCallback progress_callback = nullptr,
+        ZipStats* stats = nullptr
     );
-    
+
     /**
      * Overloaded version with just directory path and zip name
      */
     bool zip_directory(const std::string& directory_path, const std::string& zip_name);
-    
+
     /**
      * Overloaded version with progress callback but no source deletion
      */
     bool zip_directory(
-        const std::string& directory_path, 
-        const std::string& zip_name, 
+        const std::string& directory_path,
+        const std::string& zip_name,
         ProgressCallback progress_callback
     );
 }
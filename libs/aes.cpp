@@ -0,0 +1,254 @@
+#include <aes.hpp>
+#include <stdexcept>
+
+namespace AnimepaheCLI
+{
+    namespace
+    {
+        inline uint8_t xtime(uint8_t b)
+        {
+            return static_cast<uint8_t>((b << 1) ^ (b & 0x80 ? 0x1b : 0x00));
+        }
+
+        uint8_t multiply(uint8_t a, uint8_t b)
+        {
+            uint8_t product = 0;
+            while (b)
+            {
+                if (b & 1)
+                {
+                    product ^= a;
+                }
+                a = xtime(a);
+                b >>= 1;
+            }
+            return product;
+        }
+
+        inline uint8_t rotl8(uint8_t x, int n)
+        {
+            return static_cast<uint8_t>((x << n) | (x >> (8 - n)));
+        }
+
+        inline uint32_t rotr(uint32_t x, int n)
+        {
+            return (x >> n) | (x << (32 - n));
+        }
+
+        /**
+         * S-boxes and the round tables that fold SubBytes, ShiftRows and
+         * (Inv)MixColumns into four lookups per column, so a segment of a few
+         * megabytes decrypts in milliseconds.
+         */
+        struct Tables
+        {
+            uint8_t sbox[256];
+            uint8_t inverse[256];
+            uint32_t te[4][256];
+            uint32_t td[4][256];
+
+            Tables()
+            {
+                /* walks GF(2^8) with generator 3 and its inverse together, then applies the affine map */
+                uint8_t p = 1, q = 1;
+                do
+                {
+                    p = static_cast<uint8_t>(p ^ (p << 1) ^ (p & 0x80 ? 0x1b : 0x00));
+                    q ^= static_cast<uint8_t>(q << 1);
+                    q ^= static_cast<uint8_t>(q << 2);
+                    q ^= static_cast<uint8_t>(q << 4);
+                    if (q & 0x80)
+                    {
+                        q ^= 0x09;
+                    }
+                    sbox[p] = static_cast<uint8_t>(q ^ rotl8(q, 1) ^ rotl8(q, 2) ^ rotl8(q, 3) ^ rotl8(q, 4) ^ 0x63);
+                } while (p != 1);
+                sbox[0] = 0x63;
+
+                for (int i = 0; i < 256; ++i)
+                {
+                    inverse[sbox[i]] = static_cast<uint8_t>(i);
+                }
+                for (int i = 0; i < 256; ++i)
+                {
+                    uint8_t s = sbox[i];
+                    uint8_t v = inverse[i];
+                    te[0][i] = uint32_t(multiply(s, 2)) << 24 | uint32_t(s) << 16 | uint32_t(s) << 8 | multiply(s, 3);
+                    td[0][i] = uint32_t(multiply(v, 14)) << 24 | uint32_t(multiply(v, 9)) << 16 | uint32_t(multiply(v, 13)) << 8 | multiply(v, 11);
+                    for (int r = 1; r < 4; ++r)
+                    {
+                        te[r][i] = rotr(te[0][i], 8 * r);
+                        td[r][i] = rotr(td[0][i], 8 * r);
+                    }
+                }
+            }
+        };
+
+        const Tables &tables()
+        {
+            static const Tables instance;
+            return instance;
+        }
+
+        inline uint32_t load(const uint8_t *bytes)
+        {
+            return uint32_t(bytes[0]) << 24 | uint32_t(bytes[1]) << 16 | uint32_t(bytes[2]) << 8 | bytes[3];
+        }
+
+        inline void store(uint8_t *bytes, uint32_t word)
+        {
+            bytes[0] = static_cast<uint8_t>(word >> 24);
+            bytes[1] = static_cast<uint8_t>(word >> 16);
+            bytes[2] = static_cast<uint8_t>(word >> 8);
+            bytes[3] = static_cast<uint8_t>(word);
+        }
+
+        /* box applied to the top byte of a, second of b, third of c and last of d (the final round has no MixColumns) */
+        inline uint32_t substitute(const uint8_t *box, uint32_t a, uint32_t b, uint32_t c, uint32_t d)
+        {
+            return uint32_t(box[a >> 24]) << 24 | uint32_t(box[(b >> 16) & 0xff]) << 16 | uint32_t(box[(c >> 8) & 0xff]) << 8 | box[d & 0xff];
+        }
+    }
+
+    Aes128::Aes128(const std::string &key)
+    {
+        if (key.size() != 16)
+        {
+            throw std::runtime_error("AES-128 key must be 16 bytes");
+        }
+        const Tables &t = tables();
+
+        for (int i = 0; i < 4; ++i)
+        {
+            encrypt_[i] = load(reinterpret_cast<const uint8_t *>(key.data()) + 4 * i);
+        }
+        uint8_t rcon = 1;
+        for (int i = 4; i < 44; ++i)
+        {
+            uint32_t word = encrypt_[i - 1];
+            if (i % 4 == 0)
+            {
+                /* RotWord, SubWord, Rcon */
+                word = substitute(t.sbox, word << 8, word << 8, word << 8, word >> 24) ^ uint32_t(rcon) << 24;
+                rcon = xtime(rcon);
+            }
+            encrypt_[i] = encrypt_[i - 4] ^ word;
+        }
+
+        /* equivalent inverse cipher: round keys reversed, InvMixColumns applied to the inner ones */
+        for (int round = 0; round <= 10; ++round)
+        {
+            for (int j = 0; j < 4; ++j)
+            {
+                uint32_t word = encrypt_[4 * (10 - round) + j];
+                if (round > 0 && round < 10)
+                {
+                    word = t.td[0][t.sbox[word >> 24]] ^ t.td[1][t.sbox[(word >> 16) & 0xff]] ^
+                           t.td[2][t.sbox[(word >> 8) & 0xff]] ^ t.td[3][t.sbox[word & 0xff]];
+                }
+                decrypt_[4 * round + j] = word;
+            }
+        }
+    }
+
+    void Aes128::encryptBlock(uint8_t *block) const
+    {
+        const Tables &t = tables();
+        const uint32_t *key = encrypt_.data();
+        uint32_t s0 = load(block) ^ key[0], s1 = load(block + 4) ^ key[1], s2 = load(block + 8) ^ key[2], s3 = load(block + 12) ^ key[3];
+        for (int round = 1; round < 10; ++round)
+        {
+            key += 4;
+            uint32_t t0 = t.te[0][s0 >> 24] ^ t.te[1][(s1 >> 16) & 0xff] ^ t.te[2][(s2 >> 8) & 0xff] ^ t.te[3][s3 & 0xff] ^ key[0];
+            uint32_t t1 = t.te[0][s1 >> 24] ^ t.te[1][(s2 >> 16) & 0xff] ^ t.te[2][(s3 >> 8) & 0xff] ^ t.te[3][s0 & 0xff] ^ key[1];
+            uint32_t t2 = t.te[0][s2 >> 24] ^ t.te[1][(s3 >> 16) & 0xff] ^ t.te[2][(s0 >> 8) & 0xff] ^ t.te[3][s1 & 0xff] ^ key[2];
+            uint32_t t3 = t.te[0][s3 >> 24] ^ t.te[1][(s0 >> 16) & 0xff] ^ t.te[2][(s1 >> 8) & 0xff] ^ t.te[3][s2 & 0xff] ^ key[3];
+            s0 = t0, s1 = t1, s2 = t2, s3 = t3;
+        }
+        key += 4;
+        store(block, substitute(t.sbox, s0, s1, s2, s3) ^ key[0]);
+        store(block + 4, substitute(t.sbox, s1, s2, s3, s0) ^ key[1]);
+        store(block + 8, substitute(t.sbox, s2, s3, s0, s1) ^ key[2]);
+        store(block + 12, substitute(t.sbox, s3, s0, s1, s2) ^ key[3]);
+    }
+
+    void Aes128::decryptBlock(uint8_t *block) const
+    {
+        const Tables &t = tables();
+        const uint32_t *key = decrypt_.data();
+        uint32_t s0 = load(block) ^ key[0], s1 = load(block + 4) ^ key[1], s2 = load(block + 8) ^ key[2], s3 = load(block + 12) ^ key[3];
+        for (int round = 1; round < 10; ++round)
+        {
+            key += 4;
+            uint32_t t0 = t.td[0][s0 >> 24] ^ t.td[1][(s3 >> 16) & 0xff] ^ t.td[2][(s2 >> 8) & 0xff] ^ t.td[3][s1 & 0xff] ^ key[0];
+            uint32_t t1 = t.td[0][s1 >> 24] ^ t.td[1][(s0 >> 16) & 0xff] ^ t.td[2][(s3 >> 8) & 0xff] ^ t.td[3][s2 & 0xff] ^ key[1];
+            uint32_t t2 = t.td[0][s2 >> 24] ^ t.td[1][(s1 >> 16) & 0xff] ^ t.td[2][(s0 >> 8) & 0xff] ^ t.td[3][s3 & 0xff] ^ key[2];
+            uint32_t t3 = t.td[0][s3 >> 24] ^ t.td[1][(s2 >> 16) & 0xff] ^ t.td[2][(s1 >> 8) & 0xff] ^ t.td[3][s0 & 0xff] ^ key[3];
+            s0 = t0, s1 = t1, s2 = t2, s3 = t3;
+        }
+        key += 4;
+        store(block, substitute(t.inverse, s0, s3, s2, s1) ^ key[0]);
+        store(block + 4, substitute(t.inverse, s1, s0, s3, s2) ^ key[1]);
+        store(block + 8, substitute(t.inverse, s2, s1, s0, s3) ^ key[2]);
+        store(block + 12, substitute(t.inverse, s3, s2, s1, s0) ^ key[3]);
+    }
+
+    std::string Aes128::decryptCbc(const std::string &data, const std::string &iv) const
+    {
+        if (iv.size() != 16 || data.empty() || data.size() % 16 != 0)
+        {
+            throw std::runtime_error("AES-128 data is not whole blocks");
+        }
+        std::string plain(data);
+        const uint8_t *previous = reinterpret_cast<const uint8_t *>(iv.data());
+        const uint8_t *cipher = reinterpret_cast<const uint8_t *>(data.data());
+        for (size_t offset = 0; offset < plain.size(); offset += 16)
+        {
+            uint8_t *block = reinterpret_cast<uint8_t *>(plain.data()) + offset;
+            decryptBlock(block);
+            for (int i = 0; i < 16; ++i)
+            {
+                block[i] ^= previous[i];
+            }
+            previous = cipher + offset;
+        }
+
+        uint8_t padding = static_cast<uint8_t>(plain.back());
+        if (padding == 0 || padding > 16)
+        {
+            throw std::runtime_error("AES-128 padding is broken, wrong key or IV");
+        }
+        for (size_t i = plain.size() - padding; i < plain.size(); ++i)
+        {
+            if (static_cast<uint8_t>(plain[i]) != padding)
+            {
+                throw std::runtime_error("AES-128 padding is broken, wrong key or IV");
+            }
+        }
+        plain.resize(plain.size() - padding);
+        return plain;
+    }
+
+    std::string Aes128::encryptCbc(const std::string &data, const std::string &iv) const
+    {
+        if (iv.size() != 16)
+        {
+            throw std::runtime_error("AES-128 IV must be 16 bytes");
+        }
+        size_t padding = 16 - data.size() % 16;
+        std::string cipher(data);
+        cipher.append(padding, static_cast<char>(padding));
+        const uint8_t *previous = reinterpret_cast<const uint8_t *>(iv.data());
+        for (size_t offset = 0; offset < cipher.size(); offset += 16)
+        {
+            uint8_t *block = reinterpret_cast<uint8_t *>(cipher.data()) + offset;
+            for (int i = 0; i < 16; ++i)
+            {
+                block[i] ^= previous[i];
+            }
+            encryptBlock(block);
+            previous = block;
+        }
+        return cipher;
+    }
+}
@@ -1,364 +1,441 @@
 #include <animepahe.hpp>
-#include <kwikpahe.hpp>
 #include <downloader.hpp>
-#include <cpr/cpr.h>
-#include <re2/re2.h>
 #include <fmt/core.h>
 #include <fmt/color.h>
 #include <utils.hpp>
-#include <nlohmann/json.hpp>
 #include <fstream>
 #include <ziputils.hpp>
+#include <tarutils.hpp>
+#include <events.hpp>
+#include <metrics.hpp>
+#include <trace.hpp>
+#include <catalog.hpp>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <iomanip>
 #include <iostream>
-
-using json = nlohmann::json;
+#include <memory>
+#include <algorithm>
+#include <iterator>
+#include <optional>
+#include <utility>
 
 namespace AnimepaheCLI
 {
-    cpr::Cookies cookies = cpr::Cookies{{"__ddg2_", ""}};
     const char *CLEAR_LINE = "\033[2K"; // Clear entire line
     const char *MOVE_UP = "\033[1A";    // Move cursor up 1 line
     const char *CURSOR_START = "\r";    // Return to start of line
 
-    /* Extract Kwik from pahe.win */
-    KwikPahe kwikpahe;
-
-    cpr::Header Animepahe::getHeaders(const std::string &link)
-    {
-        const cpr::Header HEADERS = {
-            {"accept", "application/json, text/javascript, */*; q=0.0"},
-            {"accept-language", "en-US,en;q=0.9"},
-            {"referer", link},
-            {"user-agent", "Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/138.0.0.0 Safari/537.36 Edg/138.0.0.0"}};
-        return HEADERS;
-    }
-
-    std::string Animepahe::extract_link_metadata(const std::string &link, bool isSeries)
+    namespace
     {
-        fmt::print("\n\r * Requesting Info..");
-        cpr::Response response = cpr::Get(
-            cpr::Url{link},
-            cpr::Header{getHeaders(link)}, cookies);
-
-        fmt::print("\r * Requesting Info : ");
-
-        /* series_name */
-        std::string series_title;
-
-        if (response.status_code != 200)
+        std::string formatGB(uint64_t bytes)
         {
-            fmt::print(fmt::fg(fmt::color::indian_red), "FAILED!\n");
-            throw std::runtime_error(fmt::format("Failed to fetch {}, StatusCode: {}", link, response.status_code));
+            return fmt::format("{:.2f} GB", static_cast<double>(bytes) / (1024.0 * 1024.0 * 1024.0));
         }
-        else
+
+        /* an episode already on disk becomes an entry of the streamed archive as it is, false when it cannot be read */
+        bool archiveExisting(ZipUtils::ZipWriter &archive, const std::string &path, const std::string &name)
         {
-            fmt::print(fmt::fg(fmt::color::lime_green), "OK!\n");
+            std::ifstream file(path, std::ios::binary);
+            if (!file)
+            {
+                return false;
+            }
+            archive.begin_entry("videos/" + name);
+            std::vector<char> chunk(1 << 20);
+            while (file.read(chunk.data(), static_cast<std::streamsize>(chunk.size())) || file.gcount() > 0)
+            {
+                archive.write(chunk.data(), static_cast<size_t>(file.gcount()));
+            }
+            if (file.bad())
+            {
+                archive.discard_entry();
+                return false;
+            }
+            archive.end_entry();
+            return true;
         }
 
-        RE2::GlobalReplace(&response.text, R"((\r\n|\r|\n))", "");
-
-        if (isSeries)
+        /* close an aborted streamed zip with the entries committed so far, the message of the error that ends the run */
+        std::string keepStreamedArchive(ZipUtils::ZipWriter &archive, const std::string &reason)
         {
-            re2::StringPiece TITLE_CONSUME = response.text;
-            re2::StringPiece TYPE_CONSUME = response.text;
-            re2::StringPiece EP_CONSUME = response.text;
-            std::string title;
-            std::string type;
-            std::string episodesCount;
-
-            if (RE2::FindAndConsume(&TITLE_CONSUME, R"re(style=[^=]+title="([^"]+)")re", &title))
+            std::string closeError;
+            try
             {
-                title = unescape_html_entities(title);
-                series_title = title;
+                archive.close_committed();
             }
-
-            if (RE2::FindAndConsume(&TYPE_CONSUME, R"re(Type:[^>]*title="[^"]*"[^>]*>([^<]+)</a>)re", &type))
+            catch (const std::exception &e)
             {
-                type = unescape_html_entities(type);
+                closeError = e.what();
             }
-
-            if (RE2::FindAndConsume(&TYPE_CONSUME, R"re(Episode[^>]*>\s*(\S*)</p)re", &episodesCount))
+            std::string name = archive.path();
+            Events::emit("archive_partial", {{"archive", name}, {"entries", archive.entries()}, {"error", reason}, {"close_error", closeError}});
+            if (!closeError.empty())
             {
-                episodesCount = unescape_html_entities(episodesCount);
+                return fmt::format("{}; {} episodes were only in the archive, {} is kept but could not be finished ({})", reason, archive.committed(), name, closeError);
             }
-
-            fmt::print("\n * Anime: {}\n", title);
-            fmt::print(" * Type: {}\n", type);
-            fmt::print(" * Episodes: {}\n", episodesCount);
+            return fmt::format("{}; the {} episodes streamed before it are kept in {}", reason, archive.entries(), name);
         }
-        else
-        {
-            re2::StringPiece TITLE_TYPE_CONSUME = response.text;
-            std::string title;
-            std::string episode;
 
-            if (RE2::FindAndConsume(&TITLE_TYPE_CONSUME, R"re(title="[^>]*>([^<]*)</a>\D*(\d*)<span)re", &title, &episode))
+        /* bytes of every file below path, 0 when it does not exist */
+        uint64_t directoryBytes(const std::string &path)
+        {
+            uint64_t bytes = 0;
+            std::error_code ec;
+            for (auto it = std::filesystem::recursive_directory_iterator(path, ec); !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec))
             {
-                episode = unescape_html_entities(episode);
-                title = unescape_html_entities(title);
-                series_title = title;
+                std::error_code sizeError;
+                if (it->is_regular_file(sizeError))
+                {
+                    uint64_t size = it->file_size(sizeError);
+                    bytes += sizeError ? 0 : size;
+                }
             }
-
-            fmt::print("\n * Anime: {}\n", title);
-            fmt::print(" * Episode: {}\n", episode);
+            return bytes;
         }
-        /* return series_name */
-        return series_title;
-    }
 
-    std::map<std::string, std::string> Animepahe::fetch_episode(const std::string &link, const int &targetRes)
-    {
-        std::vector<std::map<std::string, std::string>> episodeData;
-        cpr::Response response = cpr::Get(
-            cpr::Url{link},
-            cpr::Header{getHeaders(link)}, cookies);
+        /* a catalog hit this good is taken without asking the site */
+        constexpr double CONFIDENT_MATCH = 0.6;
 
-        if (response.status_code != 200)
+        bool isConfident(const std::vector<Catalog::Match> &matches)
         {
-            fmt::print("\n * Error: Failed to fetch {}, StatusCode {}\n", link, response.status_code);
-            return {};
+            return !matches.empty() && matches[0].score >= CONFIDENT_MATCH &&
+                   (matches.size() == 1 || matches[0].score - matches[1].score >= 0.1 || matches[0].score == 1.0);
         }
+    }
 
-        RE2::GlobalReplace(&response.text, R"((\r\n|\r|\n))", "");
-        re2::StringPiece EP_CONSUME = response.text;
-        std::string dPaheLink;
-        std::string epName;
+    std::string Animepahe::find_series(const std::string &query)
+    {
+        Events::print("\n\r * Searching..");
 
-        while (RE2::FindAndConsume(&EP_CONSUME, R"re(href="(https://pahe\.win/\S*)"[^>]*>([^)]*\))[^<]*<)re", &dPaheLink, &epName))
+        /* the local catalog answers offline, the site search only fills it in when it is unsure */
+        std::vector<Catalog::Match> matches = Catalog::search(query);
+        bool searched = false;
+        if (!isConfident(matches))
         {
-            std::map<std::string, std::string> content;
-            content["dPaheLink"] = unescape_html_entities(dPaheLink);
-            content["epName"] = unescape_html_entities(epName);
-
-            re2::StringPiece RES_CONSUME = epName;
-            std::string epRes;
-            if (RE2::FindAndConsume(&RES_CONSUME, R"re(\b(\d{3,4})p\b)re", &epRes))
+            try
             {
-                epRes = unescape_html_entities(epRes);
+                for (const auto &series : syncWait(client_.search(query)))
+                {
+                    Catalog::remember(series.id, series.title);
+                }
+                searched = true;
+                matches = Catalog::search(query);
             }
-            else
+            catch (const std::exception &)
             {
-                epRes = "0";
+                if (matches.empty())
+                {
+                    Events::print("\r * Searching : ");
+                    Events::print(fmt::fg(fmt::color::indian_red), "FAILED!\n");
+                    throw;
+                }
             }
-
-            content["epRes"] = epRes;
-            episodeData.push_back(content);
         }
 
-        if (episodeData.empty())
+        Events::print("\r * Searching : ");
+        if (matches.empty())
         {
-            throw std::runtime_error(fmt::format("\n No episodes found in {}", link));
+            Events::print(fmt::fg(fmt::color::indian_red), "NOT FOUND!\n");
+            throw std::runtime_error(fmt::format("No series matches \"{}\", use the series link instead", query));
         }
+        Events::print(fmt::fg(fmt::color::lime_green), "{}\n", searched ? "OK!" : "OK! (catalog)");
 
-        /**
-         * check if there is a provided resolution
-         * if there is a match then return it otherwise Find the episode with the highest resolution
-         * Since Animepahe sort JPN episodes at top this selects the highest resolution
-         * JPN Episode and igore all others. btw who wants to watch anime in ENG anyway ?
-         */
-        std::map<std::string, std::string>* selectedEpMap = nullptr;
-        std::map<std::string, std::string>* maxEpMap = nullptr;
-        std::map<std::string, std::string>* minEpMap = nullptr;
+        const Catalog::Match &best = matches.front();
+        Events::print(" * Series : {} ({:.0f}%)\n", best.title, best.score * 100.0);
+        for (size_t i = 1; i < matches.size() && i < 4; ++i)
+        {
+            Events::print(fmt::fg(fmt::color::gray), "   also : {} ({:.0f}%)\n", matches[i].title, matches[i].score * 100.0);
+        }
 
-        int maxEpRes = 0;
-        int minEpRes = INT_MAX; /* use INT_MAX to ensure proper min comparison */
+        nlohmann::json alternatives = nlohmann::json::array();
+        for (size_t i = 1; i < matches.size(); ++i)
+        {
+            alternatives.push_back({{"id", matches[i].id}, {"title", matches[i].title}, {"score", matches[i].score}});
+        }
+        Events::emit("series_found", {{"query", query}, {"id", best.id}, {"title", best.title}, {"score", best.score}, {"searched", searched}, {"alternatives", alternatives}});
+        return fmt::format("https://animepahe.si/anime/{}", best.id);
+    }
 
-        bool selectHighestQuality = (targetRes == 0);
-        bool selectLowestQuality  = (targetRes == -1);
-        bool isCustomQualityProvided = (targetRes > 0); /* only valid custom inputs are > 0 */
+    SeriesInfo Animepahe::extract_link_metadata(const std::string &link, bool isSeries)
+    {
+        Events::print("\n\r * Requesting Info..");
 
-        for (auto& episode : episodeData)
+        SeriesInfo info;
+        try
         {
-            int epResValue = std::stoi(episode.at("epRes"));
-
-            /* Track highest */
-            if (epResValue > maxEpRes)
-            {
-                maxEpRes = epResValue;
-                maxEpMap = &episode;
-            }
+            info = syncWait(client_.resolveSeries(link));
+        }
+        catch (const std::exception &)
+        {
+            Events::print("\r * Requesting Info : ");
+            Events::print(fmt::fg(fmt::color::indian_red), "FAILED!\n");
+            throw;
+        }
 
-            /* Track lowest */
-            if (epResValue < minEpRes)
-            {
-                minEpRes = epResValue;
-                minEpMap = &episode;
-            }
+        Events::print("\r * Requesting Info : ");
+        Events::print(fmt::fg(fmt::color::lime_green), "OK!\n");
 
-            /* If custom quality requested */
-            if (isCustomQualityProvided && epResValue == targetRes)
-            {
-                selectedEpMap = &episode;
-                break; /* exact match found, no need to continue */
-            }
+        if (isSeries)
+        {
+            /* every visited series can be found by name next time, offline */
+            Catalog::remember(info.id, info.title, info.alternatives);
+            Events::print("\n * Anime: {}\n", info.title);
+            Events::print(" * Type: {}\n", info.type);
+            Events::print(" * Episodes: {}\n", info.episodes);
+            Events::emit("metadata", {{"title", info.title}, {"type", info.type}, {"episodes", info.episodes}});
         }
+        else
+        {
+            Events::print("\n * Anime: {}\n", info.title);
+            Events::print(" * Episode: {}\n", info.episode);
+            Events::emit("metadata", {{"title", info.title}, {"episode", info.episode}});
+        }
+        return info;
+    }
 
-        /* Final decision */
-        if (selectedEpMap == nullptr)
+    /* the next release page with selected entries, empty once the selection is exhausted */
+    std::vector<Episode> Animepahe::fetch_series(EpisodeCursor &cursor)
+    {
+        Events::print("\n\r * Requesting Page..");
+        fflush(stdout);
+
+        std::vector<Episode> page = syncWait(cursor.next());
+        if (page.empty())
         {
-            if (selectHighestQuality) {
-                selectedEpMap = maxEpMap;
-            } else if (selectLowestQuality) {
-                selectedEpMap = minEpMap;
-            }
-            /* else (custom and not found) fallback to max */
-            else {
-                selectedEpMap = maxEpMap;
-            }
+            Events::print("\r{}", CLEAR_LINE);
+            return page;
         }
 
-        return *selectedEpMap;
+        Events::print("\r * Requesting Page : EP{}-EP{}", padIntWithZero(page.front().number), padIntWithZero(page.back().number));
+        Events::print(fmt::fg(fmt::color::lime_green), " OK!\n\r");
+        return page;
     }
 
-    std::vector<std::string> Animepahe::fetch_series(
-        const std::string &link,
-        const int epCount,
-        bool isAllEpisodes,
-        const std::vector<int> &episodes)
+    /* the whole selection at once, every page it touches is requested concurrently */
+    std::vector<Episode> Animepahe::fetch_selection(const std::string &link, const std::vector<EpisodeRange> &ranges)
     {
-        std::vector<std::string> links;
-        std::vector<int> paginationPages;
+        Events::print("\n\r * Requesting Pages..");
+        fflush(stdout);
 
-        if (isAllEpisodes)
+        std::vector<Episode> list;
+        try
         {
-            paginationPages = getPaginationRange(1, epCount);
+            list = syncWait(client_.listEpisodes(link, ranges));
         }
-        else
+        catch (const std::exception &)
         {
-            paginationPages = getPaginationRange(episodes[0], episodes[1]);
+            Events::print("\r * Requesting Pages : ");
+            Events::print(fmt::fg(fmt::color::indian_red), "FAILED!\n");
+            throw;
         }
 
-        std::string id;
-        RE2::PartialMatch(link, R"(anime/([a-f0-9-]{36}))", &id);
-        fmt::print("\n\r * Requesting Pages..");
-        for (auto &page : paginationPages)
-        {
-            fmt::print("\r * Requesting Pages : {}", page);
-            fflush(stdout);
-            cpr::Response response = cpr::Get(
-                cpr::Url{
-                    fmt::format("https://animepahe.si/api?m=release&id={}&sort=episode_asc&page={}", id, page)},
-                cpr::Header{getHeaders(link)}, cookies);
+        Events::print("\r * Requesting Pages : {} episodes", list.size());
+        Events::print(fmt::fg(fmt::color::lime_green), " OK!\n\r");
+        return list;
+    }
 
-            if (response.status_code != 200)
+    std::vector<std::pair<Episode, Variant>> Animepahe::extract_link_content(const std::vector<Episode> &list, const int targetRes, bool isSeries)
+    {
+        std::vector<std::pair<Episode, Variant>> episodeListData;
+        for (const auto &episode : list)
+        {
+            if (isSeries)
             {
-                throw std::runtime_error(fmt::format("\n * Error: Failed to fetch {}, StatusCode {}\n", link, response.status_code));
+                Events::print("\r * Requesting Episode : EP{} ", padIntWithZero(episode.number));
+                fflush(stdout);
             }
 
-            auto parsed = json::parse(response.text);
-
-            if (parsed.contains("data") && parsed["data"].is_array())
+            try
             {
-                for (const auto &episode : parsed["data"])
-                {
-                    std::string session = episode.value("session", "unknown");
-                    std::string episodeLink = fmt::format("https://animepahe.si/play/{}/{}", id, session);
-                    links.push_back(episodeLink);
-                }
+                std::vector<Variant> variants = syncWait(client_.resolveVariants(episode.link));
+                episodeListData.emplace_back(episode, Client::selectVariant(variants, targetRes));
+            }
+            catch (const std::exception &e)
+            {
+                Events::print("\n * Error: {}\n", e.what());
             }
         }
-        fmt::print("\r * Requesting Pages :");
-        fmt::print(fmt::fg(fmt::color::lime_green), " OK!\n\r");
 
-        return links;
+        Events::print("\r * Requesting Episodes : {} ", episodeListData.size());
+        Events::print(fmt::fg(fmt::color::lime_green), "OK!\n");
+        return episodeListData;
     }
 
-    int Animepahe::get_series_episode_count(const std::string &link)
+    std::vector<Episode> Animepahe::skip_present(std::vector<Episode> batch, Manifest &manifest, int targetRes, ZipUtils::ZipWriter *archive, Packer *packer)
     {
-        std::string id;
-        RE2::PartialMatch(link, R"(anime/([a-f0-9-]{36}))", &id);
-
-        cpr::Response response = cpr::Get(
-            cpr::Url{
-                fmt::format("https://animepahe.si/api?m=release&id={}&sort=episode_asc&page={}", id, 1)},
-            cpr::Header{getHeaders(link)}, cookies);
-
-        if (response.status_code != 200)
+        std::vector<Episode> missing;
+        size_t present = 0;
+        for (auto &episode : batch)
         {
-            throw std::runtime_error(fmt::format("\n * Error: Failed to fetch {}, StatusCode {}\n", link, response.status_code));
+            std::optional<Manifest::Entry> entry = manifest.find(episode.link, targetRes);
+            if (!entry || !keep_present(episode, *entry, manifest, archive, packer))
+            {
+                missing.push_back(std::move(episode));
+                continue;
+            }
+            present++;
         }
 
-        auto parsed = json::parse(response.text);
-        int epCount = 0;
-        if (parsed.contains("total") && parsed["total"].is_number_integer())
+        if (present > 0)
         {
-            epCount = parsed["total"];
+            Events::print(" * Present : ");
+            Events::print(fmt::fg(fmt::color::lime_green), "{}", present);
+            Events::print(" of {} episodes already downloaded, skipped\n", batch.size());
         }
-
-        return epCount;
+        return missing;
     }
 
-    std::vector<std::map<std::string, std::string>> Animepahe::extract_link_content(
-        const std::string &link,
-        const std::vector<int> &episodes,
-        const int targetRes,
-        bool isSeries,
-        bool isAllEpisodes)
+    bool Animepahe::keep_present(const Episode &episode, const Manifest::Entry &entry, Manifest &manifest, ZipUtils::ZipWriter *archive, Packer *packer)
     {
-        std::vector<std::map<std::string, std::string>> episodeListData;
+        if (archive && !archiveExisting(*archive, manifest.pathOf(entry), entry.file))
+        {
+            return false;
+        }
+        if (packer)
+        {
+            packer->add(manifest.pathOf(entry), "videos/" + entry.file);
+        }
+        Events::emit("episode_skipped", {{"episode", episode.number}, {"file", entry.file}, {"bytes", entry.bytes}, {"reason", "present"}});
+        return true;
+    }
 
-        if (isSeries)
+    std::vector<std::string> Animepahe::resolve_direct_links(const std::vector<std::pair<Episode, Variant>> &epData, LinkExport *exporter, std::vector<std::pair<Episode, Variant>> *resolved)
+    {
+        std::vector<std::string> directLinks;
+        for (const auto &[episode, variant] : epData)
         {
-            const int epCount = get_series_episode_count(link);
-            std::vector<std::string> seriesEpLinks = fetch_series(link, epCount, isAllEpisodes, episodes);
+            Events::print("\n\r * Processing :");
+            Events::print(fmt::fg(fmt::color::cyan), " EP{}", padIntWithZero(episode.number));
+            Events::print("\n\r * Extracting Kwik Link...");
+            fflush(stdout);
 
-            if (isAllEpisodes)
+            Trace::Span span(fmt::format("resolve EP{}", padIntWithZero(episode.number)));
+            std::string directLink;
+            std::string error;
+            try
             {
-                for (int i = 0; i < seriesEpLinks.size(); ++i)
-                {
-                    const std::string &pLink = seriesEpLinks[i];
-                    fmt::print("\r * Requesting Episode : EP{} ", padIntWithZero(i + 1));
-                    std::map<std::string, std::string> epContent = fetch_episode(pLink, targetRes);
-                    fflush(stdout);
-                    if (!epContent.empty())
-                    {
-                        episodeListData.push_back(epContent);
-                    }
-                }
+                directLink = syncWait(client_.resolveDirectLink(variant.paheLink));
+            }
+            catch (const std::exception &e)
+            {
+                error = e.what();
+            }
+
+            /* drop the "Extracting" line and rewrite the "Processing" one */
+            Events::print("{}{}{}{}", CLEAR_LINE, MOVE_UP, CLEAR_LINE, CURSOR_START);
+            Events::print("\r * Processing : EP{}", padIntWithZero(episode.number));
+            if (directLink.empty())
+            {
+                Events::print(fmt::fg(fmt::color::indian_red), " FAIL!");
+                Events::print(" {}", error);
+                Events::emit("episode_failed", {{"episode", episode.number}, {"stage", "resolve"}, {"error", error}});
             }
             else
             {
-                if (episodes[0] > epCount || episodes[1] > epCount)
+                if (exporter)
                 {
-                    throw std::runtime_error(fmt::format("Invalid episode range: {}-{} for series with {} episodes", episodes[0], episodes[1], epCount));
+                    exporter->add(episode, variant, directLink);
                 }
-
-                std::vector<int> paginationPages = getPaginationRange(episodes[0], episodes[1]);
-                int offset = paginationPages[0] == 1 ? 0 : (30 * (paginationPages[0] - 1));
-
-                for (int i = offset; i < (seriesEpLinks.size() + offset); ++i)
+                if (resolved)
                 {
-                    const std::string &pLink = seriesEpLinks[i - offset];
-
-                    if ((i >= episodes[0] - 1 && i <= episodes[1] - 1))
-                    {
-                        fmt::print("\r * Requesting Episode : EP{} ", padIntWithZero(i + 1));
-                        std::map<std::string, std::string> epContent = fetch_episode(pLink, targetRes);
-                        fflush(stdout);
-                        if (!epContent.empty())
-                        {
-                            episodeListData.push_back(epContent);
-                        }
-                    }
+                    resolved->emplace_back(episode, variant);
                 }
+                directLinks.push_back(directLink);
+                Events::print(fmt::fg(fmt::color::lime_green), " OK!");
+                Events::emit("episode_resolved", {{"episode", episode.number}, {"quality", std::to_string(variant.resolution)}, {"direct_link", directLink}});
             }
         }
-        else
+        return directLinks;
+    }
+
+    std::vector<uint64_t> Animepahe::preflight(const std::vector<std::string> &links, bool keepFiles, bool createArchive, size_t later, uint64_t archived,
+                                               const std::vector<uint64_t> &present)
+    {
+        Events::print("\n * Preflight..");
+        fflush(stdout);
+
+        /* HEAD every direct link at once, a failed request only leaves that size unknown */
+        std::vector<uint64_t> sizes(links.size(), 0);
+        try
         {
+            std::vector<Task<uint64_t>> lengths;
+            for (const auto &link : links)
+            {
+                lengths.push_back(client_.contentLength(link));
+            }
+            sizes = syncWait(whenAll(std::move(lengths)));
+        }
+        catch (const std::exception &)
+        {
+        }
 
-            std::map<std::string, std::string> epContent = fetch_episode(link, targetRes);
-            if (epContent.empty())
+        /* files already in videos/ that are (or may be) the episode are not downloaded again */
+        uint64_t known = 0;
+        size_t sized = 0;
+        size_t kept = 0;
+        for (size_t i = 0; i < sizes.size(); ++i)
+        {
+            if (i < present.size() && present[i] > 0 && (sizes[i] == 0 || sizes[i] == present[i]))
             {
-                fmt::print("\n * Error: No episode data found for {}\n", link);
-                return {};
+                kept++;
+                continue;
             }
+            known += sizes[i];
+            sized += sizes[i] > 0 ? 1 : 0;
+        }
 
-            episodeListData.push_back(epContent);
+        size_t episodes = links.size() - kept + later;
+        Events::print("\r * Preflight : ");
+        if (sized == 0)
+        {
+            Events::print("sizes unknown, skipped\n");
+            Events::emit("preflight", {{"episodes", episodes}, {"batch", links.size()}, {"sized", 0}, {"ok", true}});
+            return sizes;
         }
 
-        fmt::print("\r * Requesting Episodes : {} ", episodeListData.size());
-        fmt::print(fmt::fg(fmt::color::lime_green), "OK!\n");
-        return episodeListData;
+        /* episodes without a Content-Length, and those of pages not requested yet, are assumed to be as large as the average known one */
+        uint64_t video = known + known / sized * (episodes - sized);
+        uint64_t archive = createArchive ? video + archived : 0;
+        uint64_t needed = (keepFiles ? video : 0) + archive;
+        needed += needed / 100; /* headers, filesystem slack */
+
+        std::error_code ec;
+        std::filesystem::space_info space = std::filesystem::space(std::filesystem::current_path(), ec);
+        bool fits = ec || needed <= space.available;
+
+        std::string summary = fmt::format("{} episodes, {}", episodes, formatGB(video));
+        if (sized < episodes)
+        {
+            summary += fmt::format(" (estimated, {} without size)", episodes - sized);
+        }
+        if (createArchive)
+        {
+            summary += fmt::format(" + {} archive", formatGB(archive));
+        }
+        if (!ec)
+        {
+            summary += fmt::format(", {} free", formatGB(space.available));
+        }
+
+        fits ? Events::print(fmt::fg(fmt::color::lime_green), "OK ") : Events::print(fmt::fg(fmt::color::indian_red), "FAIL! ");
+        Events::print("{}\n", summary);
+        Events::emit("preflight", {{"episodes", episodes},
+                                   {"batch", links.size()},
+                                   {"sized", sized},
+                                   {"video_bytes", video},
+                                   {"needed_bytes", needed},
+                                   {"free_bytes", ec ? 0 : space.available},
+                                   {"ok", fits}});
+
+        if (!fits)
+        {
+            throw std::runtime_error(fmt::format(
+                "Not enough free space in {}: the selection needs about {} more but only {} is available",
+                std::filesystem::current_path().string(), formatGB(needed), formatGB(space.available)));
+        }
+        return sizes;
     }
 
     void Animepahe::extractor(
@@ -366,112 +443,386 @@ namespace AnimepaheCLI
         const std::string &link,
         const int targetRes,
         bool isAllEpisodes,
-        const std::vector<int> &episodes,
+        const std::vector<EpisodeRange> &episodes,
         const std::string &export_filename,
         bool exportLinks,
         bool createZip,
-        bool removeSource
+        bool removeSource,
+        bool streamZip,
+        const std::string &archiveFormat,
+        const std::string &order,
+        LiveStream *live,
+        const std::string &exportFormat,
+        uint64_t diskLimit
     )
     {
         /* print config */
-        fmt::print("\n * targetResolution: ");
+        Events::print("\n * targetResolution: ");
         if (targetRes == 0)
         {
-            fmt::print("Max Available\n");
+            Events::print("Max Available\n");
         }
         else if (targetRes == -1)
         {
-            fmt::print(fmt::fg(fmt::color::cyan), "Lowest Available\n");
+            Events::print(fmt::fg(fmt::color::cyan), "Lowest Available\n");
         }
         else
         {
-            fmt::print(fmt::fg(fmt::color::cyan), fmt::format("{}p\n", targetRes));
+            Events::print(fmt::fg(fmt::color::cyan), "{}p\n", targetRes);
         }
-        fmt::print(" * exportLinks: ");
-        exportLinks ? fmt::print(fmt::fg(fmt::color::cyan), "true") : fmt::print("false");
-        (exportLinks && export_filename != "links.txt") ? fmt::print(fmt::fg(fmt::color::cyan), fmt::format(" [{}]\n", export_filename)) : fmt::print("\n");
-        fmt::print(" * createZip: ", createZip);
-        createZip ? fmt::print(fmt::fg(fmt::color::cyan), "true") : fmt::print("false\n");
+        Events::print(" * exportLinks: ");
+        exportLinks ? Events::print(fmt::fg(fmt::color::cyan), "true") : Events::print("false");
+        std::string format = exportFormat.empty() ? LinkExport::formatFor(export_filename) : exportFormat;
+        (exportLinks && (export_filename != "links.txt" || format != "txt")) ? Events::print(fmt::fg(fmt::color::cyan), " [{}, {}]\n", export_filename, format) : Events::print("\n");
+        Events::print(" * createZip: ", createZip);
+        createZip ? Events::print(fmt::fg(fmt::color::cyan), "true") : Events::print("false\n");
         if (createZip && removeSource)
         {
-            fmt::print(fmt::fg(fmt::color::cyan), " [Remove Source]\n");
+            Events::print(fmt::fg(fmt::color::cyan), " [Remove Source]\n");
         }
         else if (createZip && !removeSource)
         {
-            std::cout << std::endl;
+            Events::print("\n");
         }
 
         /* Requested Episodes Range */
         if (isSeries)
         {
-            fmt::print(" * episodesRange: ");
-            isAllEpisodes ? fmt::print("All") : fmt::print(fmt::fg(fmt::color::cyan), vectorToString(episodes));
-            fmt::print("\n");
+            Events::print(" * episodesRange: ");
+            isAllEpisodes ? Events::print("All") : Events::print(fmt::fg(fmt::color::cyan), "{}", selectionToString(episodes));
+            Events::print("\n");
         }
         /* Request Metadata */
-        std::string series_name = extract_link_metadata(link, isSeries);
+        SeriesInfo info = extract_link_metadata(link, isSeries);
+        std::string series_name = info.title;
 
-        /* Extract Links */
-        const std::vector<std::map<std::string, std::string>> epData = extract_link_content(link, episodes, targetRes, isSeries, isAllEpisodes);
-
-        std::vector<std::string> directLinks;
-        int logEpNum = isAllEpisodes ? 1 : episodes[0];
-        for (int i = 0; i < epData.size(); ++i)
+        /**
+         * Release pages flow through resolution and download one at a time, so
+         * memory stays flat and the first episode starts before the last page
+         * arrived; the cursor fetches each page while the one before it is
+         * resolved. Sorting by size needs every size first, so --order
+         * smallest|largest requests all pages at once into one batch.
+         */
+        bool wholeSelection = !exportLinks && order != "index";
+        std::vector<EpisodeRange> ranges = isAllEpisodes ? std::vector<EpisodeRange>{EpisodeRange{}} : episodes;
+        std::unique_ptr<EpisodeCursor> cursor;
+        std::vector<Episode> single;
+        if (isSeries && wholeSelection)
         {
-            fmt::print("\n\r * Processing :");
-            fmt::print(fmt::fg(fmt::color::cyan), fmt::format(" EP{}", padIntWithZero(logEpNum)));
-            std::string link = kwikpahe.extract_kwik_link(epData[i].at("dPaheLink"));
-            for (int i = 0; i < 3; ++i)
-            {
-                fmt::print("{}{}{}", MOVE_UP, CLEAR_LINE, CURSOR_START);
-            }
-            fmt::print("\r * Processing : EP{}", padIntWithZero(logEpNum));
-            if (link.empty())
-            {
-                fmt::print(fmt::fg(fmt::color::indian_red), " FAIL!");
-            }
-            else
-            {
-                directLinks.push_back(link);
-                fmt::print(fmt::fg(fmt::color::lime_green), " OK!");
-            }
-            logEpNum++;
+            single = fetch_selection(link, ranges);
+        }
+        else if (isSeries)
+        {
+            cursor = std::make_unique<EpisodeCursor>(client_, link, ranges);
         }
+        else
+        {
+            single.push_back(Episode{info.episode.empty() ? 1 : std::stoi(info.episode), link});
+        }
+        auto nextBatch = [this, &cursor, &single]()
+        {
+            return cursor ? fetch_series(*cursor) : std::exchange(single, {});
+        };
 
         if (exportLinks)
         {
-            std::ofstream exportfile(export_filename);
-            if (exportfile.is_open())
+            /* every link is flushed to the file as soon as its episode resolves */
+            LinkExport exporter(export_filename, format, sanitizeForWindowsPath(series_name));
+            for (auto batch = nextBatch(); !batch.empty(); batch = nextBatch())
             {
-                for (auto &link : directLinks)
-                {
-                    exportfile << link << "\n";
-                }
-                exportfile.close();
+                resolve_direct_links(extract_link_content(batch, targetRes, isSeries), &exporter);
             }
-            fmt::print("\n\n * Exported : {}\n\n", export_filename);
+            Events::print("\n\n * Exported : {}\n\n", export_filename);
+            Events::emit("export_done", {{"file", export_filename}, {"format", format}, {"links", exporter.count()}});
         }
         else
         {
             /* sanitize anime name for windows support */
             std::string dirName = sanitizeForWindowsPath(series_name);
-            Downloader downloader(directLinks);
+            std::string zipName = replaceSpacesWithUnderscore(dirName);
+            bool streamedArchive = createZip && streamZip && archiveFormat == "zip";
+
+            /* episodes a previous run finished are matched before any of their pages is requested */
+            Manifest manifest(dirName);
+
+            Downloader downloader(client_, {});
             downloader.setDownloadDirectory(dirName);
-            downloader.startDownloads();
-            fmt::print("\n\x1b[2K\r");
+            downloader.setLiveStream(live);
+            downloader.setManifest(&manifest);
+
+            /* episodes go into stored entries as they arrive, nothing is read back afterwards */
+            std::unique_ptr<ZipUtils::ZipWriter> archive;
+            auto streamStarted = std::chrono::steady_clock::now();
+            if (streamedArchive)
+            {
+                archive = std::make_unique<ZipUtils::ZipWriter>(fmt::format("{}.zip", zipName));
+                downloader.setArchive(archive.get(), !removeSource);
+            }
+
+            /* formats that cannot be streamed are packed episode by episode behind the downloads, sources go as they are packed */
+            std::unique_ptr<Packer> packer;
+            std::string packedName = fmt::format("{}.{}", zipName, archiveFormat);
+            if (createZip && removeSource && !streamedArchive)
+            {
+                packer = std::make_unique<Packer>(packedName, archiveFormat, diskLimit);
+                downloader.setPacker(packer.get());
+            }
+
+            /* a season zipped after the downloads needs room for everything in its folder once more */
+            bool deferredArchive = createZip && !archive && !packer;
+            std::vector<int> onDisk = manifest.present(targetRes);
+
+            size_t started = 0;
+            size_t visited = 0;
+            try
+            {
+                for (auto batch = nextBatch(); !batch.empty(); batch = nextBatch())
+                {
+                    visited += batch.size();
+                    int lastNumber = batch.back().number;
+                    std::vector<Episode> missing = skip_present(batch, manifest, targetRes, archive.get(), packer.get());
+                    started += batch.size() - missing.size();
+                    if (missing.empty())
+                    {
+                        continue;
+                    }
+
+                    std::vector<std::pair<Episode, Variant>> resolved;
+                    std::vector<std::string> directLinks = resolve_direct_links(extract_link_content(missing, targetRes, isSeries), nullptr, &resolved);
+                    if (directLinks.empty())
+                    {
+                        continue;
+                    }
+
+                    /**
+                     * Sizes, free space and download order are settled before the
+                     * batch's first byte is fetched. Pages not requested yet are
+                     * counted at this batch's average size, so a selection that
+                     * cannot fit fails before its first download.
+                     */
+                    size_t later = 0;
+                    if (cursor)
+                    {
+                        size_t presentLater = std::count_if(onDisk.begin(), onDisk.end(), [&ranges, lastNumber](int number)
+                                                            { return number > lastNumber && isEpisodeSelected(ranges, number); });
+                        later = cursor->selected() - std::min(cursor->selected(), visited + presentLater);
+                    }
+                    uint64_t archived = deferredArchive ? directoryBytes(dirName) : 0;
+
+                    /**
+                     * A file from before the manifest that matches an episode by
+                     * name is only taken once its size matches the server's; it
+                     * is then recorded. One whose size the server does not tell
+                     * is kept as it is but not recorded, a different one is
+                     * downloaded again.
+                     */
+                    std::vector<std::optional<Manifest::Entry>> named;
+                    std::vector<uint64_t> namedBytes;
+                    for (const auto &[episode, variant] : resolved)
+                    {
+                        named.push_back(manifest.findNamed(episode.number, targetRes));
+                        namedBytes.push_back(named.back() ? named.back()->bytes : 0);
+                    }
+                    std::vector<uint64_t> sizes = preflight(directLinks, !(createZip && removeSource), createZip, later, archived, namedBytes);
+
+                    size_t kept = 0;
+                    for (size_t i = 0; i < resolved.size(); ++i)
+                    {
+                        bool matches = named[i] && (sizes[i] == 0 || sizes[i] == named[i]->bytes);
+                        if (matches && keep_present(resolved[i].first, *named[i], manifest, archive.get(), packer.get()))
+                        {
+                            if (sizes[i] > 0)
+                            {
+                                manifest.adopt(resolved[i].first.link, *named[i]);
+                            }
+                            continue;
+                        }
+                        if (kept != i)
+                        {
+                            directLinks[kept] = std::move(directLinks[i]);
+                            sizes[kept] = sizes[i];
+                            resolved[kept] = std::move(resolved[i]);
+                        }
+                        kept++;
+                    }
+                    if (kept < resolved.size())
+                    {
+                        started += resolved.size() - kept;
+                        Events::print(" * Present : ");
+                        Events::print(fmt::fg(fmt::color::lime_green), "{}", resolved.size() - kept);
+                        Events::print(" already downloaded (matched by name), skipped\n");
+                    }
+                    directLinks.resize(kept);
+                    sizes.resize(kept);
+                    resolved.resize(kept);
+                    if (directLinks.empty())
+                    {
+                        continue;
+                    }
+                    if (order != "index")
+                    {
+                        std::vector<size_t> positions(directLinks.size());
+                        for (size_t i = 0; i < positions.size(); ++i)
+                        {
+                            positions[i] = i;
+                        }
+                        /* unknown sizes (0) go last either way */
+                        std::stable_sort(positions.begin(), positions.end(), [&sizes, &order](size_t a, size_t b)
+                        {
+                            if (sizes[a] == 0 || sizes[b] == 0)
+                            {
+                                return sizes[a] != 0 && sizes[b] == 0;
+                            }
+                            return order == "smallest" ? sizes[a] < sizes[b] : sizes[a] > sizes[b];
+                        });
+
+                        std::vector<std::string> orderedLinks;
+                        std::vector<uint64_t> orderedSizes;
+                        std::vector<std::pair<Episode, Variant>> orderedEpisodes;
+                        for (size_t position : positions)
+                        {
+                            orderedLinks.push_back(directLinks[position]);
+                            orderedSizes.push_back(sizes[position]);
+                            orderedEpisodes.push_back(resolved[position]);
+                        }
+                        directLinks = std::move(orderedLinks);
+                        sizes = std::move(orderedSizes);
+                        resolved = std::move(orderedEpisodes);
+                    }
+
+                    size_t total = cursor && !wholeSelection ? cursor->selected() : directLinks.size();
+                    downloader.setBatch(directLinks, started, total);
+                    downloader.setExpectedSizes(sizes);
+                    downloader.setEpisodes(resolved);
+                    downloader.startDownloads();
+                    started += directLinks.size();
+                }
+            }
+            catch (const std::exception &e)
+            {
+                /* with --rm-source the streamed episodes exist nowhere else, the committed ones are kept */
+                if (archive && removeSource && archive->committed() > 0)
+                {
+                    throw std::runtime_error(keepStreamedArchive(*archive, e.what()));
+                }
+                throw;
+            }
+            if (live)
+            {
+                /* a player still watching the last episode keeps the server up */
+                live->finish();
+            }
+            Events::print("\n\x1b[2K\r");
+
+            if (archive)
+            {
+                Metrics::Timer zipTimer(Metrics::Phase::Zip);
+                bool success = true;
+                std::string error;
+                try
+                {
+                    archive->close();
+                }
+                catch (const std::exception &e)
+                {
+                    success = false;
+                    error = e.what();
+                }
+                success ? zipTimer.success(archive->bytes()) : zipTimer.failure();
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - streamStarted).count();
+
+                if (success && removeSource)
+                {
+                    /* only the empty series folder is left */
+                    std::error_code ec;
+                    std::filesystem::remove_all(dirName, ec);
+                }
+
+                Events::print("\n * Zipping : ");
+                (success ? Events::print(fmt::fg(fmt::color::lime_green), "OK ") : Events::print(fmt::fg(fmt::color::indian_red), "FAIL! {}\n", error));
+                if (success)
+                {
+                    Events::print("(");
+                    Events::print(fmt::fg(fmt::color::cyan), "{}.zip", zipName);
+                    Events::print(") streamed in {:.1f}s [{} stored, 0 deflated]\n", seconds, archive->entries());
+                }
+                Events::emit("zip_done", {{"archive", fmt::format("{}.zip", zipName)},
+                                          {"ok", success},
+                                          {"streamed", true},
+                                          {"seconds", seconds},
+                                          {"stored", archive->entries()},
+                                          {"deflated", 0},
+                                          {"bytes", archive->bytes()}});
+            }
 
-            /* create zip of downloaded items */
-            if (createZip)
+            if (packer)
+            {
+                Metrics::Timer zipTimer(Metrics::Phase::Zip);
+                bool success = true;
+                std::string error;
+                try
+                {
+                    packer->finish();
+                }
+                catch (const std::exception &e)
+                {
+                    success = false;
+                    error = e.what();
+                }
+                success ? zipTimer.success(packer->bytes()) : zipTimer.failure();
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - streamStarted).count();
+
+                if (success)
+                {
+                    /* every episode went as it was packed, only the folder and the manifest are left */
+                    std::error_code ec;
+                    std::filesystem::remove_all(dirName, ec);
+                }
+
+                Events::print("\n * Archiving : ");
+                (success ? Events::print(fmt::fg(fmt::color::lime_green), "OK ") : Events::print(fmt::fg(fmt::color::indian_red), "FAIL! {}\n", error));
+                if (success)
+                {
+                    Events::print("(");
+                    Events::print(fmt::fg(fmt::color::cyan), "{}", packedName);
+                    Events::print(") packed while downloading in {:.1f}s [{} entries, {:.1f}s waited for room]\n", seconds, packer->entries(), packer->waited());
+                }
+                Events::emit("zip_done", {{"archive", packedName},
+                                          {"ok", success},
+                                          {"format", archiveFormat},
+                                          {"streamed", true},
+                                          {"seconds", seconds},
+                                          {"entries", success ? packer->entries() : 0},
+                                          {"waited_seconds", packer->waited()},
+                                          {"bytes", success ? packer->bytes() : 0}});
+            }
+
+            /* create zip (or tar) of downloaded items */
+            if (createZip && !archive && !packer)
             {
                 /* Create Zip logic */
-                auto enhanced_progress = [](size_t current, size_t total, const std::string &file, size_t bytes_done, size_t bytes_total)
+                /* called per entry and per copied chunk, json events are rate limited like download_progress */
+                auto last_event = std::chrono::steady_clock::now() - std::chrono::milliseconds(Events::getProgressInterval());
+                size_t last_index = SIZE_MAX;
+                auto enhanced_progress = [&last_event, &last_index](size_t current, size_t total, const std::string &file, size_t bytes_done, size_t bytes_total)
                 {
-                    double file_progress = total > 0 ? (double(current) / total) * 100.0 : 0.0;
+                    if (Events::isJsonMode())
+                    {
+                        auto now = std::chrono::steady_clock::now();
+                        if (current != last_index || now - last_event >= std::chrono::milliseconds(Events::getProgressInterval()))
+                        {
+                            Events::emit("zip_progress", {{"file", file}, {"index", current}, {"total", total}, {"bytes", bytes_done}, {"total_bytes", bytes_total}});
+                            last_event = now;
+                            last_index = current;
+                        }
+                        return;
+                    }
+
                     double byte_progress = bytes_total > 0 ? (double(bytes_done) / bytes_total) * 100.0 : 0.0;
 
                     /* Create progress bar */
                     const int bar_width = 30;
-                    int filled = static_cast<int>(file_progress * bar_width / 100.0);
+                    int filled = static_cast<int>(byte_progress * bar_width / 100.0);
 
                     std::ostringstream progress_stream;
 
@@ -485,38 +836,90 @@ namespace AnimepaheCLI
                         else
                             progress_stream << " ";
                     }
-                    progress_stream << "] " << std::fixed << std::setprecision(1) << "(" << current << "/" << total << ") " << file_progress << "% ";
+                    progress_stream << "] " << std::fixed << std::setprecision(1) << "(" << current << "/" << total << ") " << byte_progress << "% ";
                     std::string new_line = progress_stream.str();
 
                     std::cout << new_line << std::flush;
                 };
 
-                std::cout << "\n * Zipping..\n";
+                Metrics::Timer zipTimer(Metrics::Phase::Zip);
+                if (archiveFormat != "zip")
+                {
+                    /* headers are written here, file bodies are copied by the kernel */
+                    Events::print("\n * Archiving..\n");
+                    std::string archiveName = fmt::format("{}.{}", zipName, archiveFormat);
+                    TarUtils::TarStats tarStats;
+                    bool success = TarUtils::tar_directory(
+                        fmt::format("./{}", dirName),
+                        archiveName,
+                        archiveFormat == "tar.zst" ? TarUtils::Compression::Zstd : TarUtils::Compression::None,
+                        removeSource,
+                        enhanced_progress,
+                        &tarStats
+                    );
+                    success ? zipTimer.success(tarStats.archive_bytes) : zipTimer.failure();
+
+                    for (int i = 0; i < 2; ++i)
+                    {
+                        Events::print("{}{}{}", CLEAR_LINE, MOVE_UP, CURSOR_START);
+                    }
+
+                    Events::print("\n * Archiving : ");
+                    (success ? Events::print(fmt::fg(fmt::color::lime_green), "OK ") : Events::print(fmt::fg(fmt::color::indian_red), "FAIL!\n"));
+                    if (success)
+                    {
+                        Events::print("(");
+                        Events::print(fmt::fg(fmt::color::cyan), "{}", archiveName);
+                        Events::print(") in {:.1f}s [{} copied, {} compressed]\n", tarStats.seconds, tarStats.copied, tarStats.compressed);
+                    }
+                    Events::emit("zip_done", {{"archive", archiveName},
+                                              {"ok", success},
+                                              {"format", archiveFormat},
+                                              {"streamed", false},
+                                              {"seconds", tarStats.seconds},
+                                              {"copied", tarStats.copied},
+                                              {"compressed", tarStats.compressed},
+                                              {"kernel_bytes", tarStats.kernel_bytes},
+                                              {"bytes", tarStats.archive_bytes}});
+                    Events::print("\n");
+                    return;
+                }
+
+                Events::print("\n * Zipping..\n");
 
                 /* Use the enhanced progress callback */
-                std::string zipName = replaceSpacesWithUnderscore(dirName);
+                ZipUtils::ZipStats zipStats;
                 bool success = ZipUtils::zip_directory(
                     fmt::format("./{}", dirName),
                     fmt::format("{}.zip", zipName),
                     removeSource,
-                    enhanced_progress
+                    enhanced_progress,
+                    &zipStats
                 );
+                success ? zipTimer.success(zipStats.archive_bytes) : zipTimer.failure();
 
                 for (int i = 0; i < 2; ++i)
                 {
-                    fmt::print("{}{}{}", CLEAR_LINE, MOVE_UP, CURSOR_START);
+                    Events::print("{}{}{}", CLEAR_LINE, MOVE_UP, CURSOR_START);
                 }
 
-                fmt::print("\n * Zipping : ");
-                (success ? fmt::print(fmt::fg(fmt::color::lime_green), "OK ") : fmt::print(fmt::fg(fmt::color::indian_red), "FAIL!\n"));
+                Events::print("\n * Zipping : ");
+                (success ? Events::print(fmt::fg(fmt::color::lime_green), "OK ") : Events::print(fmt::fg(fmt::color::indian_red), "FAIL!\n"));
                 if (success)
                 {
-                    std::cout << "(";
-                    fmt::print(fmt::fg(fmt::color::cyan), fmt::format("{}.zip", zipName));
-                    std::cout << ")" << std::endl;
+                    Events::print("(");
+                    Events::print(fmt::fg(fmt::color::cyan), "{}.zip", zipName);
+                    Events::print(") in {:.1f}s [{} stored, {} deflated]\n", zipStats.seconds, zipStats.stored, zipStats.deflated);
                 }
+                Events::emit("zip_done", {{"archive", fmt::format("{}.zip", zipName)},
+                                          {"ok", success},
+                                          {"streamed", false},
+                                          {"seconds", zipStats.seconds},
+                                          {"stored", zipStats.stored},
+                                          {"deflated", zipStats.deflated},
+                                          {"bytes", zipStats.archive_bytes}});
             }
-            std::cout << std::endl;
+            Events::print("\n");
         }
     }
 }
@@ -0,0 +1,318 @@
+#include <catalog.hpp>
+#include <utils.hpp>
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <unordered_map>
+
+using json = nlohmann::json;
+
+namespace AnimepaheCLI
+{
+    namespace Catalog
+    {
+        namespace
+        {
+            /* below this a name shares too little with the query to be worth showing */
+            constexpr double MIN_SCORE = 0.3;
+
+            struct Series
+            {
+                std::string id;
+                std::string title;
+                std::vector<std::string> names; /* as seen, title excluded */
+                std::vector<uint32_t> indexed;  /* into entries, title first */
+            };
+
+            /* one normalized name of a series */
+            struct Entry
+            {
+                uint32_t series = 0;
+                std::string text;
+                uint32_t grams = 0; /* distinct trigrams */
+            };
+
+            std::mutex catalogMutex;
+            std::string catalogPath;
+            bool dirty = false;
+            std::vector<Series> series;
+            std::unordered_map<std::string, uint32_t> byId;
+            std::vector<Entry> entries;
+            std::unordered_map<uint32_t, std::vector<uint32_t>> postings; /* trigram -> entries */
+
+            /* "Frieren: Beyond Journey's End" -> "frieren beyond journeys end", non-ASCII bytes kept as they are */
+            std::string normalize(const std::string &text)
+            {
+                std::string folded;
+                folded.reserve(text.size());
+                for (unsigned char c : text)
+                {
+                    if (c == '\'')
+                    {
+                        continue;
+                    }
+                    if (c >= 0x80 || std::isalnum(c))
+                    {
+                        folded += static_cast<char>(c >= 0x80 ? c : std::tolower(c));
+                    }
+                    else if (!folded.empty() && folded.back() != ' ')
+                    {
+                        folded += ' ';
+                    }
+                }
+                if (!folded.empty() && folded.back() == ' ')
+                {
+                    folded.pop_back();
+                }
+                return folded;
+            }
+
+            /* distinct trigrams of " text ", three bytes packed into one integer */
+            std::vector<uint32_t> trigrams(const std::string &text)
+            {
+                std::string padded = " " + text + " ";
+                std::vector<uint32_t> grams;
+                grams.reserve(padded.size());
+                for (size_t i = 0; i + 2 < padded.size(); ++i)
+                {
+                    grams.push_back(static_cast<uint32_t>(static_cast<unsigned char>(padded[i])) << 16 |
+                                    static_cast<uint32_t>(static_cast<unsigned char>(padded[i + 1])) << 8 |
+                                    static_cast<uint32_t>(static_cast<unsigned char>(padded[i + 2])));
+                }
+                std::sort(grams.begin(), grams.end());
+                grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+                return grams;
+            }
+
+            /* add a name to the index unless the series already has it (caller holds catalogMutex) */
+            void index(uint32_t position, const std::string &name)
+            {
+                std::string text = normalize(name);
+                if (text.empty())
+                {
+                    return;
+                }
+                for (uint32_t entry : series[position].indexed)
+                {
+                    if (entries[entry].text == text)
+                    {
+                        return;
+                    }
+                }
+                std::vector<uint32_t> grams = trigrams(text);
+                uint32_t entry = static_cast<uint32_t>(entries.size());
+                entries.push_back(Entry{position, std::move(text), static_cast<uint32_t>(grams.size())});
+                series[position].indexed.push_back(entry);
+                for (uint32_t gram : grams)
+                {
+                    postings[gram].push_back(entry);
+                }
+            }
+
+            /* caller holds catalogMutex, true when anything was new */
+            bool add(const std::string &id, const std::string &title, const std::vector<std::string> &names)
+            {
+                if (id.empty() || title.empty())
+                {
+                    return false;
+                }
+                bool changed = false;
+                auto [found, created] = byId.try_emplace(id, static_cast<uint32_t>(series.size()));
+                if (created)
+                {
+                    series.push_back(Series{id, title, {}, {}});
+                    changed = true;
+                }
+                uint32_t position = found->second;
+                if (series[position].title != title)
+                {
+                    series[position].title = title;
+                    changed = true;
+                }
+                index(position, title);
+                for (const auto &name : names)
+                {
+                    auto &known = series[position].names;
+                    if (name.empty() || name == title || std::find(known.begin(), known.end(), name) != known.end())
+                    {
+                        continue;
+                    }
+                    known.push_back(name);
+                    index(position, name);
+                    changed = true;
+                }
+                return changed;
+            }
+
+            void load()
+            {
+                std::ifstream file(catalogPath);
+                if (!file)
+                {
+                    return;
+                }
+                json state = json::parse(file, nullptr, false);
+                if (state.is_discarded() || !state.is_object())
+                {
+                    return;
+                }
+                /* a damaged or hand-edited file only loses the entries that are not what save() writes */
+                const json &list = state.contains("series") && state["series"].is_array() ? state["series"] : json::array();
+                for (const auto &entry : list)
+                {
+                    auto id = entry.is_object() ? entry.find("id") : entry.end();
+                    auto title = entry.is_object() ? entry.find("title") : entry.end();
+                    if (id == entry.end() || !id->is_string() || title == entry.end() || !title->is_string())
+                    {
+                        continue;
+                    }
+                    std::vector<std::string> names;
+                    auto aliases = entry.find("names");
+                    if (aliases != entry.end() && aliases->is_array())
+                    {
+                        for (const auto &name : *aliases)
+                        {
+                            if (name.is_string())
+                            {
+                                names.push_back(name.get<std::string>());
+                            }
+                        }
+                    }
+                    add(id->get<std::string>(), title->get<std::string>(), names);
+                }
+            }
+        }
+
+        void open(const std::string &path)
+        {
+            std::lock_guard<std::mutex> lock(catalogMutex);
+            catalogPath = path;
+            series.clear();
+            byId.clear();
+            entries.clear();
+            postings.clear();
+            dirty = false;
+            if (!catalogPath.empty())
+            {
+                load();
+            }
+        }
+
+        std::string defaultPath()
+        {
+            std::string directory = userCacheDirectory();
+            return directory.empty() ? "" : (std::filesystem::path(directory) / "catalog.json").string();
+        }
+
+        void remember(const std::string &id, const std::string &title, const std::vector<std::string> &names)
+        {
+            std::lock_guard<std::mutex> lock(catalogMutex);
+            dirty = add(id, title, names) || dirty;
+        }
+
+        std::vector<Match> search(const std::string &query, size_t limit)
+        {
+            std::string text = normalize(query);
+            if (text.empty())
+            {
+                return {};
+            }
+            std::vector<uint32_t> grams = trigrams(text);
+
+            std::lock_guard<std::mutex> lock(catalogMutex);
+            /* only names sharing a trigram with the query are ever looked at */
+            std::unordered_map<uint32_t, uint32_t> shared;
+            for (uint32_t gram : grams)
+            {
+                auto posting = postings.find(gram);
+                if (posting == postings.end())
+                {
+                    continue;
+                }
+                for (uint32_t entry : posting->second)
+                {
+                    shared[entry]++;
+                }
+            }
+
+            std::unordered_map<uint32_t, double> best; /* series -> score */
+            for (const auto &[entry, count] : shared)
+            {
+                const Entry &name = entries[entry];
+                /* dice coefficient over distinct trigrams, or how much of the query the name holds when that is more */
+                double score = std::max(2.0 * count / static_cast<double>(grams.size() + name.grams),
+                                        0.75 * count / static_cast<double>(grams.size()));
+                if (name.text == text)
+                {
+                    score = 1.0;
+                }
+                else
+                {
+                    /* a whole-word part of the name ("frieren" in "sousou no frieren"), shorter names first */
+                    size_t at = name.text.find(text);
+                    while (at != std::string::npos)
+                    {
+                        bool startsWord = at == 0 || name.text[at - 1] == ' ';
+                        bool endsWord = at + text.size() == name.text.size() || name.text[at + text.size()] == ' ';
+                        if (startsWord && endsWord)
+                        {
+                            score = std::max(score, 0.6 + 0.3 * static_cast<double>(text.size()) / static_cast<double>(name.text.size()));
+                            break;
+                        }
+                        at = name.text.find(text, at + 1);
+                    }
+                }
+                double &current = best[name.series];
+                current = std::max(current, score);
+            }
+
+            std::vector<Match> matches;
+            for (const auto &[position, score] : best)
+            {
+                if (score >= MIN_SCORE)
+                {
+                    matches.push_back(Match{series[position].id, series[position].title, score});
+                }
+            }
+            std::sort(matches.begin(), matches.end(), [](const Match &a, const Match &b)
+                      { return a.score != b.score ? a.score > b.score : a.title < b.title; });
+            if (matches.size() > limit)
+            {
+                matches.resize(limit);
+            }
+            return matches;
+        }
+
+        size_t size()
+        {
+            std::lock_guard<std::mutex> lock(catalogMutex);
+            return series.size();
+        }
+
+        bool save()
+        {
+            std::lock_guard<std::mutex> lock(catalogMutex);
+            if (catalogPath.empty() || !dirty)
+            {
+                return true;
+            }
+
+            json state = {{"version", 1}, {"series", json::array()}};
+            for (const auto &entry : series)
+            {
+                state["series"].push_back({{"id", entry.id}, {"title", entry.title}, {"names", entry.names}});
+            }
+
+            if (!writeFileAtomically(catalogPath, state.dump(-1, ' ', false, json::error_handler_t::replace)))
+            {
+                return false;
+            }
+            dirty = false;
+            return true;
+        }
+    }
+}
@@ -0,0 +1,1117 @@
+#include <client.hpp>
+#include <kwikpahe.hpp>
+#include <hls.hpp>
+#include <aes.hpp>
+#include <utils.hpp>
+#include <events.hpp>
+#include <metrics.hpp>
+#include <http.hpp>
+#include <eventloop.hpp>
+#include <session.hpp>
+#include <fmt/core.h>
+#include <re2/re2.h>
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <coroutine>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using json = nlohmann::json;
+
+namespace AnimepaheCLI
+{
+    namespace
+    {
+        cpr::Header getHeaders(const std::string &link)
+        {
+            const cpr::Header HEADERS = {
+                {"accept", "application/json, text/javascript, */*; q=0.0"},
+                {"accept-language", "en-US,en;q=0.9"},
+                {"referer", link},
+                {"user-agent", "Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/138.0.0.0 Safari/537.36 Edg/138.0.0.0"}};
+            return HEADERS;
+        }
+
+        /* stored DDoS-Guard cookies for the url's host, an empty __ddg2_ until it set any */
+        std::string ddosGuardCookies(const std::string &url)
+        {
+            std::string cookie = Session::cookieHeader(url);
+            return cookie.empty() ? "__ddg2_=" : cookie;
+        }
+
+        std::string seriesId(const std::string &link)
+        {
+            std::string id;
+            RE2::PartialMatch(link, R"(anime/([a-f0-9-]{36}))", &id);
+            return id;
+        }
+
+        std::string releaseUrl(const std::string &id, int page)
+        {
+            return fmt::format("https://animepahe.si/api?m=release&id={}&sort=episode_asc&page={}", id, page);
+        }
+
+        std::string searchUrl(const std::string &query)
+        {
+            static const char *HEX = "0123456789ABCDEF";
+            std::string escaped;
+            for (unsigned char c : query)
+            {
+                if (std::isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~')
+                {
+                    escaped += static_cast<char>(c);
+                }
+                else
+                {
+                    escaped += '%';
+                    escaped += HEX[c >> 4];
+                    escaped += HEX[c & 15];
+                }
+            }
+            return fmt::format("https://animepahe.si/api?m=search&q={}", escaped);
+        }
+
+        /* segments are a few seconds of video, one that takes this long is stalled */
+        constexpr int SEGMENT_TIMEOUT_MS = 120000;
+        constexpr int SEGMENT_RETRIES = 4;
+        /* first wait before a retry, doubled each time; a Retry-After up to the cap is honoured instead */
+        constexpr int SEGMENT_BACKOFF_MS = 500;
+        constexpr int SEGMENT_BACKOFF_CAP_MS = 10000;
+        /* segments handed out past the last written one, per worker, so a stalled segment holds a few in memory and not the episode */
+        constexpr size_t SEGMENT_WINDOW = 2;
+
+        /* resumes the coroutine on the loop thread once delay has passed */
+        struct Sleep
+        {
+            std::chrono::milliseconds delay;
+
+            bool await_ready() const noexcept { return delay.count() <= 0; }
+            void await_suspend(std::coroutine_handle<> handle) const
+            {
+                EventLoop::shared().after(delay, [handle]()
+                                          { handle.resume(); });
+            }
+            void await_resume() const noexcept {}
+        };
+
+        /* wait before retry `attempt` (1-based) of a segment */
+        std::chrono::milliseconds segmentBackoff(int attempt, const cpr::Response &response)
+        {
+            auto retryAfter = response.header.find("retry-after");
+            if ((response.status_code == 429 || response.status_code == 503) && retryAfter != response.header.end())
+            {
+                char *end = nullptr;
+                long seconds = std::strtol(retryAfter->second.c_str(), &end, 10);
+                if (end != retryAfter->second.c_str() && seconds >= 0)
+                {
+                    return std::chrono::milliseconds(std::min<long>(seconds * 1000, SEGMENT_BACKOFF_CAP_MS));
+                }
+            }
+            return std::chrono::milliseconds(std::min(SEGMENT_BACKOFF_MS << (attempt - 1), SEGMENT_BACKOFF_CAP_MS));
+        }
+
+        /* AnimePahe_<title>_-_01_1080p_<group>.ts from the player title, the kwik id when it names no file */
+        std::string streamFileName(const std::string &title, const std::string &kwikLink)
+        {
+            std::string name;
+            if (!RE2::PartialMatch(title, R"re((\S+)\.mp4)re", &name) &&
+                !RE2::PartialMatch(kwikLink, R"re(/[efd]/([A-Za-z0-9]+))re", &name))
+            {
+                name = "stream";
+            }
+            if (name.find("AnimePahe_") != 0)
+            {
+                name.insert(0, "kwik_");
+            }
+            for (char &c : name)
+            {
+                if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_' && c != '-' && c != '.')
+                {
+                    c = '_';
+                }
+            }
+            return name + ".ts";
+        }
+
+        /* one playlist download, shared by its segment workers */
+        struct SegmentFetch
+        {
+            Hls::Playlist playlist;
+            std::vector<std::shared_ptr<Aes128>> ciphers; /* per key */
+            std::string referer;
+            std::ofstream *file = nullptr;
+            DownloadCallbacks *callbacks = nullptr;
+            std::chrono::steady_clock::time_point started;
+            size_t window = 1; /* indices handed out past written */
+
+            std::mutex mutex;
+            size_t next = 0;                     /* next segment to hand out */
+            size_t written = 0;                  /* segments written, in order */
+            std::map<size_t, std::string> ready; /* fetched while an earlier one is still missing */
+            std::vector<std::coroutine_handle<>> parked; /* workers waiting for the window to move */
+            size_t bytes = 0;
+            double writtenDuration = 0.0;
+            std::string error; /* first failure, nothing more is handed out */
+        };
+
+        /**
+         * The next segment index for a worker, suspending it while that index
+         * would be more than the window ahead of the writer. The worker that
+         * writes resumes parked ones; the segment right after `written` is
+         * always in the window, so the writer itself never waits.
+         */
+        struct NextSegment
+        {
+            SegmentFetch &fetch;
+            std::optional<size_t> index; /* empty = nothing left or failed */
+
+            bool await_ready() const noexcept { return false; }
+
+            bool await_suspend(std::coroutine_handle<> handle)
+            {
+                std::lock_guard<std::mutex> lock(fetch.mutex);
+                if (!fetch.error.empty() || fetch.next >= fetch.playlist.segments.size())
+                {
+                    return false;
+                }
+                if (fetch.next < fetch.written + fetch.window)
+                {
+                    index = fetch.next++;
+                    return false;
+                }
+                fetch.parked.push_back(handle);
+                return true;
+            }
+
+            /* true when index holds a segment, false when resumed from parking and it has to ask again */
+            bool await_resume() const noexcept { return index.has_value(); }
+        };
+
+        /**
+         * Takes the next segment until none is left: fetch with retries and
+         * backoff, decrypt, then write every segment that is now in order.
+         * Writes and callbacks happen under the mutex, one worker at a time.
+         */
+        Task<void> fetchSegments(Executor &executor, std::shared_ptr<SegmentFetch> fetch)
+        {
+            while (true)
+            {
+                NextSegment take{*fetch, std::nullopt};
+                if (!co_await take)
+                {
+                    std::lock_guard<std::mutex> lock(fetch->mutex);
+                    if (!fetch->error.empty() || fetch->next >= fetch->playlist.segments.size())
+                    {
+                        break;
+                    }
+                    /* woken because the window moved, possibly on the loop thread */
+                    continue;
+                }
+                size_t index = *take.index;
+                const Hls::Segment &segment = fetch->playlist.segments[index];
+
+                std::string body;
+                std::string error;
+                for (int attempt = 0; attempt < SEGMENT_RETRIES && body.empty(); ++attempt)
+                {
+                    cpr::Header headers = cpr::Header{{"referer", fetch->referer}};
+                    cpr::Response response = co_await Http::AsyncGet("GET segment", cpr::Url{segment.url}, headers, cpr::Timeout{SEGMENT_TIMEOUT_MS});
+                    co_await executor.schedule();
+                    if (response.status_code == 200 && !response.text.empty())
+                    {
+                        body = std::move(response.text);
+                        break;
+                    }
+                    error = fmt::format("Segment {} of {} failed, StatusCode: {}", index + 1, fetch->playlist.segments.size(), response.status_code);
+                    if (attempt + 1 < SEGMENT_RETRIES)
+                    {
+                        /* a 429/503 or a reset is retried later, not four times in a row */
+                        Metrics::retry(Metrics::Phase::Download);
+                        co_await Sleep{segmentBackoff(attempt + 1, response)};
+                        co_await executor.schedule();
+                    }
+                }
+                if (!body.empty() && segment.key >= 0)
+                {
+                    try
+                    {
+                        const Hls::Key &key = fetch->playlist.keys[segment.key];
+                        body = fetch->ciphers[segment.key]->decryptCbc(body, Hls::segmentIv(key, segment.sequence));
+                    }
+                    catch (const std::exception &e)
+                    {
+                        error = fmt::format("Segment {}: {}", index + 1, e.what());
+                        body.clear();
+                    }
+                }
+
+                std::vector<std::coroutine_handle<>> wake;
+                bool stop = false;
+                {
+                    std::lock_guard<std::mutex> lock(fetch->mutex);
+                    if (body.empty())
+                    {
+                        if (fetch->error.empty())
+                        {
+                            fetch->error = error;
+                        }
+                        stop = true;
+                    }
+                    else
+                    {
+                        fetch->ready.emplace(index, std::move(body));
+                    }
+                    while (!fetch->ready.empty() && fetch->ready.begin()->first == fetch->written && fetch->error.empty())
+                    {
+                        const std::string &data = fetch->ready.begin()->second;
+                        if (fetch->file)
+                        {
+                            fetch->file->write(data.data(), data.size());
+                            /* readers of the file (--stream http) are told about bytes only once they reached it */
+                            if (fetch->callbacks->flush)
+                            {
+                                fetch->file->flush();
+                            }
+                            if (!fetch->file->good())
+                            {
+                                fetch->error = "Failed to write the stream file";
+                            }
+                        }
+                        if (fetch->callbacks->onData)
+                        {
+                            fetch->callbacks->onData(data.data(), data.size());
+                        }
+                        fetch->bytes += data.size();
+                        fetch->writtenDuration += fetch->playlist.segments[fetch->written].duration;
+                        fetch->written++;
+                        fetch->ready.erase(fetch->ready.begin());
+                    }
+                    if (!stop && fetch->callbacks->onProgress && fetch->error.empty())
+                    {
+                        /* the size is known once done, until then it is extrapolated from the playtime written */
+                        double share = fetch->playlist.duration > 0 ? fetch->writtenDuration / fetch->playlist.duration
+                                                                    : static_cast<double>(fetch->written) / fetch->playlist.segments.size();
+                        size_t total = share > 0 ? static_cast<size_t>(fetch->bytes / share) : 0;
+                        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - fetch->started).count();
+                        if (!fetch->callbacks->onProgress(DownloadProgress{fetch->bytes, std::max(total, fetch->bytes), elapsed}))
+                        {
+                            fetch->error = "Stream download aborted";
+                        }
+                    }
+                    /* the window moved or the download failed, parked workers ask again */
+                    wake.swap(fetch->parked);
+                }
+                for (auto handle : wake)
+                {
+                    executor.post(handle);
+                }
+                if (stop)
+                {
+                    break;
+                }
+            }
+        }
+
+        void checkSelection(const std::vector<EpisodeRange> &ranges, int total)
+        {
+            for (const auto &range : ranges)
+            {
+                if (range.first > total || range.last > total)
+                {
+                    std::string last = range.last == 0 ? "" : std::to_string(range.last);
+                    throw std::runtime_error(fmt::format("Invalid episode range: {}-{} for series with {} episodes", range.first, last, total));
+                }
+            }
+        }
+
+        /* selected entries of a fetched page, moved out of it */
+        std::vector<Episode> selectFromPage(ReleasePage &release, int page, const std::vector<EpisodeRange> &ranges)
+        {
+            std::vector<Episode> episodes;
+            int number = (page - 1) * 30;
+            for (auto &episodeLink : release.links)
+            {
+                ++number;
+                if (isEpisodeSelected(ranges, number))
+                {
+                    episodes.push_back(Episode{number, std::move(episodeLink)});
+                }
+            }
+            return episodes;
+        }
+
+        /* allocate blocks for bytes without changing the file size, false only when the disk is full */
+        bool reserveSpace(const std::string &path, uint64_t bytes)
+        {
+#ifdef __linux__
+            int fd = ::open(path.c_str(), O_WRONLY | O_CLOEXEC);
+            if (fd < 0)
+            {
+                return true;
+            }
+            int result = fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(bytes));
+            int error = errno;
+            ::close(fd);
+            return result == 0 || error != ENOSPC;
+#else
+            (void)path;
+            (void)bytes;
+            return true;
+#endif
+        }
+    }
+
+    Task<cpr::Response> Client::fetchPage(std::string span, std::string url, std::string referer)
+    {
+        cpr::Header headers = getHeaders(referer);
+        headers["cookie"] = ddosGuardCookies(url);
+        cpr::Response response = co_await Http::AsyncGet(span, cpr::Url{url}, headers, Http::Hedge{});
+        /* parse on the executor, the event loop thread only moves bytes */
+        co_await executor_.schedule();
+        Session::storeCookies(url, response.raw_header);
+        co_return response;
+    }
+
+    Task<SeriesInfo> Client::resolveSeries(std::string link)
+    {
+        bool isSeries = isFullSeriesURL(link);
+        Metrics::Timer timer(Metrics::Phase::Metadata);
+        cpr::Response response = co_await fetchPage(isSeries ? "GET series page" : "GET play page (metadata)", link, link);
+
+        Events::emit("page_fetched", {{"kind", "metadata"}, {"url", link}, {"status", response.status_code}, {"bytes", response.text.size()}, {"ok", response.status_code == 200}});
+        if (response.status_code != 200)
+        {
+            timer.failure(response.text.size());
+            throw std::runtime_error(fmt::format("Failed to fetch {}, StatusCode: {}", link, response.status_code));
+        }
+        timer.success(response.text.size());
+
+        SeriesInfo info = parseSeriesPage(std::move(response.text), isSeries);
+        info.link = link;
+        info.id = seriesId(link);
+        co_return info;
+    }
+
+    Task<std::vector<SeriesInfo>> Client::search(std::string query)
+    {
+        std::string url = searchUrl(query);
+        Metrics::Timer timer(Metrics::Phase::Metadata);
+        cpr::Response response = co_await fetchPage("GET search", url, "https://animepahe.si/");
+
+        Events::emit("page_fetched", {{"kind", "search"}, {"url", url}, {"status", response.status_code}, {"bytes", response.text.size()}, {"ok", response.status_code == 200}});
+        if (response.status_code != 200)
+        {
+            timer.failure(response.text.size());
+            throw std::runtime_error(fmt::format("Failed to search for {}, StatusCode: {}", query, response.status_code));
+        }
+        timer.success(response.text.size());
+        co_return parseSearchResults(response.text);
+    }
+
+    Task<std::vector<Episode>> Client::listEpisodes(std::string link, int first, int last)
+    {
+        std::vector<EpisodeRange> ranges{EpisodeRange{std::max(1, first), last}};
+        std::vector<Episode> episodes = co_await listEpisodes(std::move(link), std::move(ranges));
+        co_return episodes;
+    }
+
+    Task<std::vector<Episode>> Client::listEpisodes(std::string link, std::vector<EpisodeRange> ranges)
+    {
+        if (ranges.empty())
+        {
+            ranges.push_back(EpisodeRange{});
+        }
+
+        /* the lowest requested page also carries the total, ranges arrive sorted */
+        int firstPage = getPage(ranges.front().first);
+        ReleasePage head = co_await fetchReleasePage(link, firstPage);
+        int total = head.total;
+        checkSelection(ranges, total);
+
+        /* every other page any range touches, all at once */
+        std::vector<int> pageNumbers = getSelectionPages(ranges, total);
+        std::vector<Task<ReleasePage>> pending;
+        for (int page : pageNumbers)
+        {
+            if (page != firstPage)
+            {
+                pending.push_back(fetchReleasePage(link, page));
+            }
+        }
+        std::vector<ReleasePage> pages = co_await whenAll(std::move(pending));
+        pages.insert(pages.begin(), std::move(head));
+
+        std::vector<Episode> episodes;
+        for (size_t p = 0; p < pages.size(); ++p)
+        {
+            std::vector<Episode> selected = selectFromPage(pages[p], pageNumbers[p], ranges);
+            std::move(selected.begin(), selected.end(), std::back_inserter(episodes));
+        }
+        co_return episodes;
+    }
+
+    Task<ReleasePage> Client::fetchReleasePage(std::string link, int page)
+    {
+        std::string id = seriesId(link);
+        Metrics::Timer timer(Metrics::Phase::Pagination);
+        cpr::Response response = co_await fetchPage(fmt::format("GET api page {}", page), releaseUrl(id, page), link);
+
+        Events::emit("page_fetched", {{"kind", "api"}, {"page", page}, {"status", response.status_code}, {"bytes", response.text.size()}, {"ok", response.status_code == 200}});
+        if (response.status_code != 200)
+        {
+            timer.failure(response.text.size());
+            throw std::runtime_error(fmt::format("Failed to fetch {}, StatusCode {}", link, response.status_code));
+        }
+        ReleasePage release = parseReleasePage(response.text, id);
+        timer.success(response.text.size());
+        co_return release;
+    }
+
+    EpisodeCursor::EpisodeCursor(Client &client, std::string link, std::vector<EpisodeRange> ranges)
+        : client_(client), link_(std::move(link)), ranges_(std::move(ranges))
+    {
+        if (ranges_.empty())
+        {
+            ranges_.push_back(EpisodeRange{});
+        }
+    }
+
+    Task<std::vector<Episode>> EpisodeCursor::next()
+    {
+        /* a page can hold nothing selected only past the end of the list, keep going until one does */
+        while (!started_ || position_ < pages_.size())
+        {
+            int page = 0;
+            ReleasePage release;
+            if (!started_)
+            {
+                page = getPage(ranges_.front().first);
+                release = co_await client_.fetchReleasePage(link_, page);
+
+                /* the lowest page carries the total, the rest of the walk follows from it */
+                started_ = true;
+                total_ = release.total;
+                checkSelection(ranges_, total_);
+                for (int candidate : getSelectionPages(ranges_, total_))
+                {
+                    if (candidate != page)
+                    {
+                        pages_.push_back(candidate);
+                    }
+                }
+                for (int number = 1; number <= total_; ++number)
+                {
+                    selected_ += isEpisodeSelected(ranges_, number) ? 1 : 0;
+                }
+            }
+            else
+            {
+                page = pages_[position_++];
+                release = prefetched_ ? co_await prefetched_ : co_await client_.fetchReleasePage(link_, page);
+            }
+
+            /* the next page is on its way while the caller resolves this one */
+            if (position_ < pages_.size())
+            {
+                prefetched_ = Spawned<ReleasePage>(client_.fetchReleasePage(link_, pages_[position_]));
+            }
+
+            std::vector<Episode> episodes = selectFromPage(release, page, ranges_);
+            if (!episodes.empty())
+            {
+                co_return episodes;
+            }
+        }
+        co_return std::vector<Episode>();
+    }
+
+    Task<std::vector<Variant>> Client::resolveVariants(std::string episodeLink)
+    {
+        Metrics::Timer timer(Metrics::Phase::PlayPage);
+        cpr::Response response = co_await fetchPage("GET play page", episodeLink, episodeLink);
+
+        Events::emit("page_fetched", {{"kind", "play"}, {"url", episodeLink}, {"status", response.status_code}, {"bytes", response.text.size()}, {"ok", response.status_code == 200}});
+        if (response.status_code != 200)
+        {
+            timer.failure(response.text.size());
+            throw std::runtime_error(fmt::format("Failed to fetch {}, StatusCode {}", episodeLink, response.status_code));
+        }
+
+        std::vector<Variant> variants = parseEpisodeVariants(response.text);
+        if (variants.empty())
+        {
+            timer.failure(response.text.size());
+            throw std::runtime_error(fmt::format("No episodes found in {}", episodeLink));
+        }
+        timer.success(response.text.size());
+        co_return variants;
+    }
+
+    Task<std::string> Client::resolveDirectLink(std::string paheLink)
+    {
+        Metrics::Timer timer(Metrics::Phase::Kwik);
+        cpr::Header headers = cpr::Header{{"cookie", ddosGuardCookies(paheLink)}};
+        cpr::Response response = co_await Http::AsyncGet("GET pahe.win", cpr::Url{paheLink}, headers, Http::Hedge{});
+        co_await executor_.schedule();
+        Session::storeCookies(paheLink, response.raw_header);
+
+        Events::emit("page_fetched", {{"kind", "pahe"}, {"url", paheLink}, {"status", response.status_code}, {"bytes", response.text.size()}, {"ok", response.status_code == 200}});
+        if (response.status_code != 200)
+        {
+            throw std::runtime_error(fmt::format("Failed to Get Kwik from {}, StatusCode: {}", paheLink, response.status_code));
+        }
+
+        std::string kwikLink;
+        try
+        {
+            kwikLink = KwikPahe().parse_pahe_page(response.text);
+        }
+        catch (const std::exception &e)
+        {
+            throw std::runtime_error(fmt::format("{} in {}", e.what(), paheLink));
+        }
+
+        /* --source stream asks the player first, auto only once the download route gave up */
+        Hls::Source source = Hls::source();
+        if (source == Hls::Source::Stream)
+        {
+            std::string streamLink;
+            try
+            {
+                streamLink = co_await resolveStreamLink(kwikLink);
+            }
+            catch (const std::exception &)
+            {
+            }
+            if (!streamLink.empty())
+            {
+                timer.success();
+                co_return streamLink;
+            }
+        }
+
+        std::string directLink;
+        std::string error;
+        try
+        {
+            directLink = co_await resolveKwikLink(kwikLink, 5);
+        }
+        catch (const std::exception &e)
+        {
+            if (source != Hls::Source::Auto)
+            {
+                throw;
+            }
+            error = e.what();
+        }
+        if (directLink.empty())
+        {
+            Events::emit("stream_fallback", {{"kwik", kwikLink}, {"error", error}});
+            std::string streamError;
+            try
+            {
+                directLink = co_await resolveStreamLink(kwikLink);
+            }
+            catch (const std::exception &e)
+            {
+                streamError = e.what();
+            }
+            if (directLink.empty())
+            {
+                throw std::runtime_error(fmt::format("{} (player stream: {})", error, streamError));
+            }
+        }
+        timer.success();
+        co_return directLink;
+    }
+
+    Task<std::string> Client::resolveStreamLink(std::string kwikLink)
+    {
+        /* the player lives at /e/ under the same id as the download page */
+        std::string embedLink = kwikLink;
+        RE2::Replace(&embedLink, R"re((https?://kwik\.[^/]+/)[fd]/)re", "\\1e/");
+        std::string origin;
+        RE2::PartialMatch(embedLink, R"re((https?://[^/]+/))re", &origin);
+
+        cpr::Header headers = cpr::Header{{"referer", "https://animepahe.si/"}, {"cookie", Session::cookieHeader(embedLink)}};
+        cpr::Response response = co_await Http::AsyncGet("GET kwik embed", cpr::Url{embedLink}, headers, Http::Hedge{});
+        co_await executor_.schedule();
+        Events::emit("page_fetched", {{"kind", "kwik_embed"}, {"url", embedLink}, {"status", response.status_code}, {"bytes", response.text.size()}, {"ok", response.status_code == 200}});
+        if (response.status_code != 200)
+        {
+            throw std::runtime_error(fmt::format("Failed to Get Kwik player from {}, StatusCode: {}", embedLink, response.status_code));
+        }
+        Session::storeCookies(embedLink, response.raw_header);
+
+        KwikPahe::KwikStream stream;
+        try
+        {
+            stream = KwikPahe().parse_embed_page(response.text);
+        }
+        catch (const std::exception &e)
+        {
+            throw std::runtime_error(fmt::format("{} in {}", e.what(), embedLink));
+        }
+        co_return Hls::makeLink(Hls::Link{stream.source, streamFileName(stream.title, kwikLink), origin});
+    }
+
+    Task<std::string> Client::postKwikForm(std::string action, std::string token, std::string cookie, bool reused)
+    {
+        // Make POST request with redirects disabled
+        cpr::Header headers = cpr::Header{{"referer", action}, {"cookie", cookie}};
+        cpr::Payload payload = cpr::Payload{{"_token", token}};
+        cpr::Response redirect = co_await Http::AsyncPost(
+            "POST kwik",
+            cpr::Url{action},
+            headers,
+            payload,
+            cpr::Redirect(false),
+            cpr::HttpVersion{cpr::HttpVersionCode::VERSION_1_1});
+        co_await executor_.schedule();
+        Events::emit("page_fetched", {{"kind", "kwik_post"}, {"url", action}, {"status", redirect.status_code}, {"bytes", redirect.text.size()}, {"ok", redirect.status_code == 302}, {"reused", reused}});
+
+        co_return redirect.status_code == 302 ? KwikPahe::parse_redirect_location(redirect.raw_header) : "";
+    }
+
+    Task<std::string> Client::resolveKwikLink(std::string kwikLink, int retries)
+    {
+        /* the form only differs per file in its action (f/ -> d/), a live session and token skip the kwik page */
+        std::string token = Session::kwikToken(kwikLink);
+        if (!token.empty())
+        {
+            std::string action = kwikLink;
+            RE2::Replace(&action, R"re((https?://kwik\.[^/]+/)f/)re", "\\1d/");
+            std::string location = co_await postKwikForm(action, token, Session::cookieHeader(kwikLink), true);
+            if (!location.empty())
+            {
+                co_return location;
+            }
+            Session::dropKwik(kwikLink);
+        }
+
+        /* kwik regularly serves pages that do not decode or tokens it rejects, asking again fixes it */
+        for (int attempt = 0; attempt < retries; ++attempt)
+        {
+            if (attempt > 0)
+            {
+                Metrics::retry(Metrics::Phase::Kwik);
+            }
+            cpr::Header headers = cpr::Header{{"cookie", Session::cookieHeader(kwikLink)}};
+            cpr::Response response = co_await Http::AsyncGet("GET kwik", cpr::Url{kwikLink}, headers, Http::Hedge{});
+            co_await executor_.schedule();
+            Events::emit("page_fetched", {{"kind", "kwik"}, {"url", kwikLink}, {"status", response.status_code}, {"bytes", response.text.size()}, {"ok", response.status_code == 200}});
+            if (response.status_code != 200)
+            {
+                throw std::runtime_error(fmt::format("Failed to Get Kwik from {}, StatusCode: {}", kwikLink, response.status_code));
+            }
+            Session::storeCookies(kwikLink, response.raw_header);
+
+            KwikPahe::KwikForm form = KwikPahe().parse_kwik_page(response.text, response.raw_header);
+            if (form.action.empty())
+            {
+                continue;
+            }
+
+            std::string cookie = Session::cookieHeader(form.action);
+            std::string location = co_await postKwikForm(form.action, form.token, cookie.empty() ? "kwik_session=" + form.session : cookie, false);
+            if (!location.empty())
+            {
+                Session::storeKwikToken(form.action, form.token);
+                co_return location;
+            }
+        }
+        throw std::runtime_error(fmt::format("Kwik fetch failed: exceeded retry limit : {}", kwikLink));
+    }
+
+    Task<uint64_t> Client::contentLength(std::string url)
+    {
+        /* a playlist's length says nothing about its segments */
+        if (Hls::isLink(url))
+        {
+            co_return 0;
+        }
+        cpr::Response response = co_await Http::AsyncHead("HEAD cdn", cpr::Url{url});
+        co_await executor_.schedule();
+
+        auto length = response.header.find("Content-Length");
+        if (response.status_code != 200 || length == response.header.end())
+        {
+            co_return 0;
+        }
+        try
+        {
+            co_return static_cast<uint64_t>(std::stoull(length->second));
+        }
+        catch (const std::exception &)
+        {
+            co_return 0;
+        }
+    }
+
+    Task<DownloadResult> Client::download(std::string url, std::string path, DownloadCallbacks callbacks, uint64_t expectedSize)
+    {
+        if (Hls::isLink(url))
+        {
+            DownloadResult streamed = co_await downloadPlaylist(url, path, callbacks);
+            co_return streamed;
+        }
+
+        DownloadResult result;
+        result.path = path;
+
+        /* without a path the body only goes to onData */
+        std::ofstream outfile;
+        if (!path.empty())
+        {
+            outfile.open(path, std::ios::binary);
+            if (!outfile.is_open())
+            {
+                throw std::runtime_error(fmt::format("Failed to open file: {}", path));
+            }
+            if (expectedSize > 0 && !reserveSpace(path, expectedSize))
+            {
+                throw std::runtime_error(fmt::format("Not enough disk space for {} ({} bytes)", path, expectedSize));
+            }
+        }
+
+        auto started = std::chrono::steady_clock::now();
+        auto elapsed = [&started]() {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        };
+
+        /* callbacks run on the event loop thread while the transfer is in flight */
+        cpr::Response response = co_await Http::AsyncGet(
+            "GET cdn",
+            cpr::Url{url},
+            cpr::WriteCallback{
+                [&outfile, &result, &callbacks](std::string data, intptr_t)
+                {
+                    if (outfile.is_open())
+                    {
+                        outfile.write(data.data(), data.size());
+                        if (callbacks.flush)
+                        {
+                            outfile.flush();
+                        }
+                    }
+                    result.bytes += data.size();
+                    if (callbacks.onData)
+                    {
+                        callbacks.onData(data.data(), data.size());
+                    }
+                    return outfile.good();
+                }},
+            cpr::ProgressCallback{
+                [&callbacks, &elapsed](size_t downloadTotal, size_t downloadNow, size_t, size_t, intptr_t)
+                {
+                    if (!callbacks.onProgress)
+                    {
+                        return true;
+                    }
+                    return callbacks.onProgress(DownloadProgress{downloadNow, downloadTotal, elapsed()});
+                }});
+
+        co_await executor_.schedule();
+        if (outfile.is_open())
+        {
+            outfile.close();
+        }
+        result.status = static_cast<int>(response.status_code);
+        result.elapsed = elapsed();
+        result.ok = response.status_code == 200 && outfile.good();
+        Metrics::observe(Metrics::Phase::Download, result.elapsed, result.bytes, result.ok);
+        co_return result;
+    }
+
+    Task<DownloadResult> Client::downloadPlaylist(std::string url, std::string path, DownloadCallbacks callbacks)
+    {
+        DownloadResult result;
+        result.path = path;
+        auto started = std::chrono::steady_clock::now();
+
+        Hls::Link link = Hls::parseLink(url);
+        cpr::Header headers = cpr::Header{{"referer", link.referer}};
+        auto fetch = std::make_shared<SegmentFetch>();
+        fetch->referer = link.referer;
+
+        /* a master playlist points at one media playlist per rendition */
+        std::string playlistUrl = link.url;
+        for (int level = 0; level < 2; ++level)
+        {
+            cpr::Response response = co_await Http::AsyncGet("GET playlist", cpr::Url{playlistUrl}, headers, Http::Hedge{});
+            co_await executor_.schedule();
+            Events::emit("page_fetched", {{"kind", "playlist"}, {"url", playlistUrl}, {"status", response.status_code}, {"bytes", response.text.size()}, {"ok", response.status_code == 200}});
+            if (response.status_code != 200)
+            {
+                throw std::runtime_error(fmt::format("Failed to fetch playlist {}, StatusCode: {}", playlistUrl, response.status_code));
+            }
+            fetch->playlist = Hls::parse(response.text, playlistUrl);
+            if (fetch->playlist.renditions.empty())
+            {
+                break;
+            }
+            /* each kwik file is a single quality, the best rendition is taken when there are more */
+            const auto &renditions = fetch->playlist.renditions;
+            playlistUrl = std::max_element(renditions.begin(), renditions.end(), [](const Hls::Rendition &a, const Hls::Rendition &b)
+                                           { return a.bandwidth != b.bandwidth ? a.bandwidth < b.bandwidth : a.height < b.height; })
+                              ->url;
+        }
+        const Hls::Playlist &playlist = fetch->playlist;
+        if (playlist.segments.empty())
+        {
+            throw std::runtime_error(fmt::format("Playlist {} lists no segments", playlistUrl));
+        }
+
+        /* keys are tiny and usually one per playlist, fetched once before the segments */
+        std::map<std::string, std::shared_ptr<Aes128>> ciphers;
+        for (const auto &key : playlist.keys)
+        {
+            auto known = ciphers.find(key.uri);
+            if (known == ciphers.end())
+            {
+                cpr::Response response = co_await Http::AsyncGet("GET hls key", cpr::Url{key.uri}, headers);
+                co_await executor_.schedule();
+                if (response.status_code != 200 || response.text.size() != 16)
+                {
+                    throw std::runtime_error(fmt::format("Failed to fetch key {}, StatusCode: {}", key.uri, response.status_code));
+                }
+                known = ciphers.emplace(key.uri, std::make_shared<Aes128>(response.text)).first;
+            }
+            fetch->ciphers.push_back(known->second);
+        }
+
+        std::ofstream outfile;
+        if (!path.empty())
+        {
+            outfile.open(path, std::ios::binary);
+            if (!outfile.is_open())
+            {
+                throw std::runtime_error(fmt::format("Failed to open file: {}", path));
+            }
+            fetch->file = &outfile;
+        }
+        fetch->callbacks = &callbacks;
+        fetch->started = started;
+
+        size_t parallel = std::min(static_cast<size_t>(Hls::parallel()), playlist.segments.size());
+        fetch->window = parallel * SEGMENT_WINDOW;
+        Events::emit("stream_started", {{"file", link.file}, {"playlist", playlistUrl}, {"segments", playlist.segments.size()}, {"duration_s", playlist.duration}, {"encrypted", !playlist.keys.empty()}, {"parallel", parallel}});
+        std::vector<Task<void>> workers;
+        for (size_t i = 0; i < parallel; ++i)
+        {
+            workers.push_back(fetchSegments(executor_, fetch));
+        }
+        co_await whenAll(std::move(workers));
+
+        if (outfile.is_open())
+        {
+            outfile.close();
+        }
+        result.bytes = fetch->bytes;
+        result.elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        result.ok = fetch->error.empty() && fetch->written == playlist.segments.size() && (path.empty() || outfile.good());
+        result.status = result.ok ? 200 : 0;
+        Metrics::observe(Metrics::Phase::Download, result.elapsed, result.bytes, result.ok);
+        if (!fetch->error.empty())
+        {
+            throw std::runtime_error(fetch->error);
+        }
+        co_return result;
+    }
+
+    SeriesInfo Client::parseSeriesPage(std::string html, bool isSeries)
+    {
+        SeriesInfo info;
+        info.isSeries = isSeries;
+        RE2::GlobalReplace(&html, R"((\r\n|\r|\n))", "");
+
+        if (isSeries)
+        {
+            re2::StringPiece TITLE_CONSUME = html;
+            re2::StringPiece TYPE_CONSUME = html;
+
+            if (RE2::FindAndConsume(&TITLE_CONSUME, R"re(style=[^=]+title="([^"]+)")re", &info.title))
+            {
+                info.title = unescape_html_entities(info.title);
+            }
+
+            if (RE2::FindAndConsume(&TYPE_CONSUME, R"re(Type:[^>]*title="[^"]*"[^>]*>([^<]+)</a>)re", &info.type))
+            {
+                info.type = unescape_html_entities(info.type);
+            }
+
+            if (RE2::FindAndConsume(&TYPE_CONSUME, R"re(Episode[^>]*>\s*(\S*)</p)re", &info.episodes))
+            {
+                info.episodes = unescape_html_entities(info.episodes);
+            }
+
+            /* <p><strong>Synonyms:</strong> A, B</p>, English and Japanese hold a single name */
+            re2::StringPiece NAMES_CONSUME = html;
+            std::string kind, names;
+            while (RE2::FindAndConsume(&NAMES_CONSUME, R"re(<strong>(Synonyms|English|Japanese):\s*</strong>\s*([^<]+)</p)re", &kind, &names))
+            {
+                names = unescape_html_entities(names);
+                size_t begin = 0;
+                while (begin <= names.size())
+                {
+                    size_t end = kind == "Synonyms" ? names.find(',', begin) : std::string::npos;
+                    std::string name = names.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+                    name.erase(0, name.find_first_not_of(' '));
+                    name.erase(name.find_last_not_of(' ') + 1);
+                    if (!name.empty())
+                    {
+                        info.alternatives.push_back(name);
+                    }
+                    if (end == std::string::npos)
+                    {
+                        break;
+                    }
+                    begin = end + 1;
+                }
+            }
+        }
+        else
+        {
+            re2::StringPiece TITLE_TYPE_CONSUME = html;
+
+            if (RE2::FindAndConsume(&TITLE_TYPE_CONSUME, R"re(title="[^>]*>([^<]*)</a>\D*(\d*)<span)re", &info.title, &info.episode))
+            {
+                info.episode = unescape_html_entities(info.episode);
+                info.title = unescape_html_entities(info.title);
+            }
+        }
+        return info;
+    }
+
+    std::vector<Variant> Client::parseEpisodeVariants(std::string html)
+    {
+        std::vector<Variant> variants;
+        RE2::GlobalReplace(&html, R"((\r\n|\r|\n))", "");
+        re2::StringPiece EP_CONSUME = html;
+        std::string dPaheLink;
+        std::string epName;
+
+        while (RE2::FindAndConsume(&EP_CONSUME, R"re(href="(https://pahe\.win/\S*)"[^>]*>([^)]*\))[^<]*<)re", &dPaheLink, &epName))
+        {
+            Variant variant;
+            variant.paheLink = unescape_html_entities(dPaheLink);
+            variant.name = unescape_html_entities(epName);
+
+            re2::StringPiece RES_CONSUME = epName;
+            std::string epRes;
+            if (RE2::FindAndConsume(&RES_CONSUME, R"re(\b(\d{3,4})p\b)re", &epRes))
+            {
+                variant.resolution = std::stoi(epRes);
+            }
+
+            variants.push_back(variant);
+        }
+
+        return variants;
+    }
+
+    ReleasePage Client::parseReleasePage(const std::string &body, const std::string &id)
+    {
+        ReleasePage release;
+        auto parsed = json::parse(body);
+
+        if (parsed.contains("total") && parsed["total"].is_number_integer())
+        {
+            release.total = parsed["total"];
+        }
+
+        if (parsed.contains("data") && parsed["data"].is_array())
+        {
+            for (const auto &episode : parsed["data"])
+            {
+                std::string session = episode.value("session", "unknown");
+                release.links.push_back(fmt::format("https://animepahe.si/play/{}/{}", id, session));
+            }
+        }
+        return release;
+    }
+
+    std::vector<SeriesInfo> Client::parseSearchResults(const std::string &body)
+    {
+        std::vector<SeriesInfo> results;
+        auto parsed = json::parse(body, nullptr, false);
+        if (parsed.is_discarded() || !parsed.is_object() || !parsed.contains("data") || !parsed["data"].is_array())
+        {
+            /* no hits come back without a data array */
+            return results;
+        }
+
+        for (const auto &entry : parsed["data"])
+        {
+            SeriesInfo info;
+            info.id = entry.value("session", "");
+            info.title = entry.value("title", "");
+            info.type = entry.value("type", "");
+            if (entry.contains("episodes") && entry["episodes"].is_number_integer() && entry["episodes"].get<int>() > 0)
+            {
+                info.episodes = std::to_string(entry["episodes"].get<int>());
+            }
+            else
+            {
+                info.episodes = "?";
+            }
+            if (info.id.empty() || info.title.empty())
+            {
+                continue;
+            }
+            info.link = fmt::format("https://animepahe.si/anime/{}", info.id);
+            results.push_back(std::move(info));
+        }
+        return results;
+    }
+
+    Variant Client::selectVariant(const std::vector<Variant> &variants, int targetRes)
+    {
+        /**
+         * check if there is a provided resolution
+         * if there is a match then return it otherwise Find the episode with the highest resolution
+         * Since Animepahe sort JPN episodes at top this selects the highest resolution
+         * JPN Episode and igore all others. btw who wants to watch anime in ENG anyway ?
+         */
+        if (variants.empty())
+        {
+            throw std::runtime_error("No variants to select from");
+        }
+
+        const Variant *maxVariant = &variants.front();
+        const Variant *minVariant = &variants.front();
+
+        for (const auto &variant : variants)
+        {
+            /* If custom quality requested, exact match wins */
+            if (targetRes > 0 && variant.resolution == targetRes)
+            {
+                return variant;
+            }
+            if (variant.resolution > maxVariant->resolution)
+            {
+                maxVariant = &variant;
+            }
+            if (variant.resolution < minVariant->resolution)
+            {
+                minVariant = &variant;
+            }
+        }
+
+        /* lowest on request, otherwise highest (also when a custom quality is missing) */
+        return targetRes == -1 ? *minVariant : *maxVariant;
+    }
+}
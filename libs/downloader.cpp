@@ -1,4 +1,5 @@
 #include "downloader.hpp"
+#include <events.hpp>
 #include <fmt/core.h>
 #include <fmt/color.h>
 #include <iostream>
@@ -10,7 +11,9 @@
 #include <sstream>
 #include <regex>
 
-Downloader::Downloader(const std::vector<std::string> &urls) : urls_(urls) {}
+namespace Events = AnimepaheCLI::Events;
+
+Downloader::Downloader(AnimepaheCLI::Client &client, const std::vector<std::string> &urls) : client_(client), urls_(urls), total_(urls.size()) {}
 
 void Downloader::setDownloadDirectory(const std::string &dir)
 {
@@ -21,15 +24,53 @@ void Downloader::setDownloadDirectory(const std::string &dir)
     }
 }
 
+void Downloader::setArchive(ZipUtils::ZipWriter *archive, bool keepFiles)
+{
+    archive_ = archive;
+    keep_files_ = keepFiles;
+}
+
+void Downloader::setExpectedSizes(const std::vector<uint64_t> &sizes)
+{
+    expected_sizes_ = sizes;
+}
+
+void Downloader::setBatch(const std::vector<std::string> &urls, size_t firstIndex, size_t total)
+{
+    urls_ = urls;
+    first_index_ = firstIndex;
+    total_ = total;
+}
+
+void Downloader::setLiveStream(AnimepaheCLI::LiveStream *live)
+{
+    live_ = live;
+}
+
+void Downloader::setManifest(AnimepaheCLI::Manifest *manifest)
+{
+    manifest_ = manifest;
+}
+
+void Downloader::setEpisodes(const std::vector<std::pair<AnimepaheCLI::Episode, AnimepaheCLI::Variant>> &episodes)
+{
+    episodes_ = episodes;
+}
+
+void Downloader::setPacker(AnimepaheCLI::Packer *packer)
+{
+    packer_ = packer;
+}
 
 void Downloader::startDownloads()
 {
     // Ensure "videos" folder exists inside download_dir_
     std::string videos_dir = download_dir_ + "/videos";
-    if (!std::filesystem::exists(videos_dir))
+    if (keep_files_ && !std::filesystem::exists(videos_dir))
         std::filesystem::create_directory(videos_dir);
 
-    fmt::print("\n");
+    Events::print("\n");
+    size_t index = 0;
     for (const auto &url : urls_)
     {
         std::string filename = extractFilename(url);
@@ -37,29 +78,87 @@ void Downloader::startDownloads()
         // Sanitize filename: replace any / or \ to prevent folder creation
         filename = std::regex_replace(filename, std::regex(R"([\\/])"), "_");
 
-        std::string filepath = videos_dir + "/" + filename;
+        std::string filepath = keep_files_ ? videos_dir + "/" + filename : "";
 
-        fmt::print("\n * Downloading : ");
-        fmt::print(fmt::fg(fmt::color::cyan), fmt::format("{}\n", filename));
+        Events::print("\n * Downloading : ");
+        Events::print(fmt::fg(fmt::color::cyan), "{}\n", filename);
+        Events::emit("download_started", {{"file", filename}, {"index", first_index_ + index}, {"total", total_}});
+
+        uint64_t expected = index < expected_sizes_.size() ? expected_sizes_[index] : 0;
+        if (packer_)
+        {
+            packer_->waitForRoom(expected);
+        }
+
+        auto started = std::chrono::steady_clock::now();
+        if (archive_)
+        {
+            archive_->begin_entry("videos/" + filename);
+        }
+        size_t bytes = 0;
+        if (live_)
+        {
+            live_->begin(filename, filepath, expected);
+        }
+        /* a run that stops now leaves a partial file the manifest knows not to trust, packed files do not stay */
+        AnimepaheCLI::Manifest *manifest = keep_files_ && !packer_ && index < episodes_.size() ? manifest_ : nullptr;
+        if (manifest)
+        {
+            manifest->start(filename);
+        }
+        bool dlStatus = downloadFile(url, filepath, expected, bytes);
+        if (live_)
+        {
+            live_->end(dlStatus);
+        }
+        auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count();
+        index++;
+
+        if (archive_)
+        {
+            if (dlStatus)
+            {
+                /* synced before the next download, a run that fails later keeps the episode */
+                archive_->end_entry();
+                archive_->commit();
+            }
+            else
+            {
+                archive_->discard_entry();
+            }
+        }
 
-        bool dlStatus = downloadFile(url, filepath);
         if (!dlStatus)
         {
-            fmt::print("\n * DL (");
-            fmt::print(fmt::fg(fmt::color::indian_red), "FAIL");
-            fmt::print(")   : {}", url);
-            std::filesystem::remove(filepath);
+            Events::print("\n * DL (");
+            Events::print(fmt::fg(fmt::color::indian_red), "FAIL");
+            Events::print(")   : {}", url);
+            Events::emit("download_failed", {{"file", filename}, {"url", url}, {"bytes", bytes}, {"elapsed_ms", elapsed_ms}});
+            if (!filepath.empty())
+            {
+                std::filesystem::remove(filepath);
+            }
             continue;
         }
         else
         {
             // Move cursor up and clear line for clean output
-            std::cout << "\x1b[1A";
-            std::cout << "\x1b[2K\r";
+            Events::print("\x1b[1A");
+            Events::print("\x1b[2K\r");
 
-            fmt::print(" * DL (");
-            fmt::print(fmt::fg(fmt::color::lime_green), "DONE");
-            fmt::print(")   : {}", filename);
+            Events::print(" * DL (");
+            Events::print(fmt::fg(fmt::color::lime_green), "DONE");
+            Events::print(")   : {}", filename);
+            Events::emit("download_done", {{"file", filename}, {"bytes", bytes}, {"elapsed_ms", elapsed_ms}});
+            if (packer_)
+            {
+                packer_->add(filepath, "videos/" + filename);
+            }
+            if (manifest)
+            {
+                const auto &[episode, variant] = episodes_[index - 1];
+                manifest->record({AnimepaheCLI::Manifest::sessionOf(episode.link), episode.number, filename, bytes, variant.resolution});
+            }
         }
     }
 }
@@ -67,12 +166,10 @@ void Downloader::startDownloads()
 std::string Downloader::extractFilename(const std::string &url) const
 {
     /* Try to find "?file=" followed by the filename */
-    std::regex filenamePattern(R"([\?&]file=([^&]+))");
-    std::smatch match;
-
-    if (std::regex_search(url, match, filenamePattern) && match.size() > 1)
+    std::string name = AnimepaheCLI::fileParameter(url);
+    if (!name.empty())
     {
-        return match[1];
+        return name;
     }
 
     /* If not found, generate a unique filename with timestamp */
@@ -116,68 +213,116 @@ auto formatSizeMB = [](size_t bytes) -> std::string {
     return oss.str();
 };
 
-bool Downloader::downloadFile(const std::string &url, const std::string &filepath)
+bool Downloader::downloadFile(const std::string &url, const std::string &filepath, uint64_t expected, size_t &bytes)
 {
-    std::ofstream outfile(filepath, std::ios::binary);
-    if (!outfile.is_open())
+    auto last_event_time = std::chrono::steady_clock::now() - std::chrono::milliseconds(Events::getProgressInterval());
+    std::string last_progress_line;
+    const std::string filename = filepath.empty() ? extractFilename(url) : std::filesystem::path(filepath).filename().string();
+    std::string archive_error;
+
+    AnimepaheCLI::DownloadCallbacks callbacks;
+    if (archive_ || live_)
     {
-        fmt::print("\n * Failed to open file: {}\n", filepath);
-        return false;
+        /* the chunk goes straight into the open archive entry, CRC-32 included */
+        callbacks.onData = [this, &archive_error](const char *data, size_t size)
+        {
+            if (live_)
+            {
+                live_->append(data, size);
+            }
+            if (!archive_ || !archive_error.empty())
+            {
+                return;
+            }
+            try
+            {
+                archive_->write(data, size);
+            }
+            catch (const std::exception &e)
+            {
+                archive_error = e.what();
+            }
+        };
     }
+    /* the stream server reads the file back, it may only see bytes that were flushed */
+    callbacks.flush = live_ && live_->isHttp();
+    callbacks.onProgress = [this, &last_event_time, &last_progress_line, &filename, &archive_error](const AnimepaheCLI::DownloadProgress &progress)
+    {
+        if (!archive_error.empty())
+        {
+            return false;
+        }
+        if (live_ && progress.totalBytes > 0)
+        {
+            live_->setTotal(progress.totalBytes);
+        }
 
-    auto start_time = std::chrono::steady_clock::now();
-    std::string last_progress_line;
-    
-    cpr::Response r = cpr::Get(
-        cpr::Url{url},
-        cpr::WriteCallback{
-            [&outfile](std::string data, intptr_t)
-            {
-                outfile.write(data.data(), data.size());
-                return true;
-            }},
-        cpr::ProgressCallback{[&start_time, &last_progress_line](size_t downloadTotal, size_t downloadNow, size_t, size_t, intptr_t)
+        if (Events::isJsonMode())
         {
-            if (downloadTotal > 0)
+            auto now = std::chrono::steady_clock::now();
+            if (progress.bytes > 0 && now - last_event_time >= std::chrono::milliseconds(Events::getProgressInterval()))
             {
-                double progress = static_cast<double>(downloadNow) / downloadTotal * 100.0;
-                auto now = std::chrono::steady_clock::now();
-                auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - start_time).count();
-                
-                if (elapsed > 0)
-                {
-                    double speed = static_cast<double>(downloadNow) / elapsed;
-                    double remaining = (downloadTotal - downloadNow) / speed;
-                    
-                    /* Build the complete progress string */
-                    std::ostringstream progress_stream;
-                    progress_stream << std::fixed << std::setprecision(2)
-                    << " * Progress: " << progress
-                    << "% ETA: " << formatTime(remaining)
-                    << " | " << formatSpeedMB(speed)
-                    << " | [" << formatSizeMB(downloadNow) << "/" << formatSizeMB(downloadTotal) << "]";
-                    
-                    std::string new_line = progress_stream.str();
-                    
-                    /* Clear the current progress line and rewrite it */
-                    if (!last_progress_line.empty()) {
-                        /*  Clear the previous progress line */
-                        std::cout << "\r" << std::string(last_progress_line.length(), ' ') << "\r";
-                    }
-                    
-                    std::cout << new_line << std::flush;
-                    last_progress_line = new_line;
-                }
+                Events::emit("download_progress", {
+                    {"file", filename},
+                    {"bytes", progress.bytes},
+                    {"total_bytes", progress.totalBytes},
+                    {"elapsed_ms", static_cast<int64_t>(progress.elapsed * 1000)},
+                    {"speed_bps", progress.elapsed > 0 ? progress.bytes / progress.elapsed : 0.0}
+                });
+                last_event_time = now;
             }
             return true;
         }
-    });
+
+        if (progress.totalBytes > 0 && progress.elapsed >= 1.0)
+        {
+            double percent = static_cast<double>(progress.bytes) / progress.totalBytes * 100.0;
+            double speed = static_cast<double>(progress.bytes) / progress.elapsed;
+            double remaining = speed > 0 ? (progress.totalBytes - progress.bytes) / speed : 0.0;
+
+            /* Build the complete progress string */
+            std::ostringstream progress_stream;
+            progress_stream << std::fixed << std::setprecision(2)
+            << " * Progress: " << percent
+            << "% ETA: " << formatTime(remaining)
+            << " | " << formatSpeedMB(speed)
+            << " | [" << formatSizeMB(progress.bytes) << "/" << formatSizeMB(progress.totalBytes) << "]";
+
+            std::string new_line = progress_stream.str();
+
+            /* Clear the current progress line and rewrite it */
+            if (!last_progress_line.empty()) {
+                /*  Clear the previous progress line */
+                std::cout << "\r" << std::string(last_progress_line.length(), ' ') << "\r";
+            }
+
+            std::cout << new_line << std::flush;
+            last_progress_line = new_line;
+        }
+        return true;
+    };
+
+    AnimepaheCLI::DownloadResult result;
+    try
+    {
+        result = AnimepaheCLI::syncWait(client_.download(url, filepath, callbacks, expected));
+    }
+    catch (const std::exception &e)
+    {
+        Events::print("\n * {}\n", e.what());
+        return false;
+    }
+    bytes = result.bytes;
 
     /* Clear the final progress line but leave cursor positioned for cleanup */
-    if (!last_progress_line.empty()) {
+    if (!last_progress_line.empty() && !Events::isJsonMode()) {
         std::cout << "\r" << std::string(last_progress_line.length(), ' ') << "\r";
     }
 
-    outfile.close();
-    return r.status_code == 200;
+    if (!archive_error.empty())
+    {
+        Events::print("\n * {}\n", archive_error);
+        return false;
+    }
+    return result.ok;
 }
@@ -0,0 +1,344 @@
+#include <eventloop.hpp>
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+namespace AnimepaheCLI
+{
+    namespace
+    {
+        /* idle connections curl keeps for reuse across transfers */
+        constexpr long CONNECTION_CACHE = 64;
+    }
+
+    EventLoop &EventLoop::shared()
+    {
+        static EventLoop loop;
+        return loop;
+    }
+
+    EventLoop::EventLoop()
+    {
+        curl_global_init(CURL_GLOBAL_DEFAULT);
+        multi_ = curl_multi_init();
+        if (multi_ == nullptr)
+        {
+            throw std::runtime_error("Failed to create curl multi handle");
+        }
+        curl_multi_setopt(multi_, CURLMOPT_MAXCONNECTS, CONNECTION_CACHE);
+
+#ifdef __linux__
+        epoll_ = epoll_create1(EPOLL_CLOEXEC);
+        wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epoll_ < 0 || wakeFd_ < 0)
+        {
+            throw std::runtime_error("Failed to create epoll instance");
+        }
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = wakeFd_;
+        epoll_ctl(epoll_, EPOLL_CTL_ADD, wakeFd_, &event);
+
+        curl_multi_setopt(multi_, CURLMOPT_SOCKETFUNCTION, &EventLoop::onSocket);
+        curl_multi_setopt(multi_, CURLMOPT_SOCKETDATA, this);
+        curl_multi_setopt(multi_, CURLMOPT_TIMERFUNCTION, &EventLoop::onTimer);
+        curl_multi_setopt(multi_, CURLMOPT_TIMERDATA, this);
+#endif
+
+        thread_ = std::thread(&EventLoop::run, this);
+    }
+
+    EventLoop::~EventLoop()
+    {
+        stopping_ = true;
+        wake();
+        if (thread_.joinable())
+        {
+            thread_.join();
+        }
+
+        /* whatever is left never completes, fail it so nobody waits forever */
+        std::vector<Job *> orphans;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            orphans.swap(pending_);
+        }
+        for (Job *job : orphans)
+        {
+            job->done(CURLE_ABORTED_BY_CALLBACK);
+            delete job;
+        }
+
+        curl_multi_cleanup(multi_);
+#ifdef __linux__
+        close(wakeFd_);
+        close(epoll_);
+#endif
+    }
+
+    void EventLoop::add(CURL *handle, Completion done)
+    {
+        active_++;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pending_.push_back(new Job{handle, std::move(done)});
+        }
+        wake();
+    }
+
+    void EventLoop::after(std::chrono::milliseconds delay, std::function<void()> fn)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            timers_.push_back(Timer{std::chrono::steady_clock::now() + delay, std::move(fn)});
+        }
+        wake();
+    }
+
+    void EventLoop::cancel(CURL *handle)
+    {
+        Job *job = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto queued = std::find_if(pending_.begin(), pending_.end(), [handle](Job *candidate)
+                                       { return candidate->handle == handle; });
+            if (queued != pending_.end())
+            {
+                job = *queued;
+                pending_.erase(queued);
+            }
+        }
+        if (job == nullptr)
+        {
+            /* attached jobs are found through the handle, removing it also drops a queued done message */
+            curl_easy_getinfo(handle, CURLINFO_PRIVATE, &job);
+            if (job == nullptr)
+            {
+                return;
+            }
+            curl_multi_remove_handle(multi_, handle);
+        }
+        /* the handle may be reused or cancelled again, it must not point at the freed job */
+        curl_easy_setopt(handle, CURLOPT_PRIVATE, nullptr);
+        active_--;
+        job->done(CURLE_ABORTED_BY_CALLBACK);
+        delete job;
+    }
+
+    std::chrono::steady_clock::time_point EventLoop::runTimers()
+    {
+        auto now = std::chrono::steady_clock::now();
+        std::vector<Timer> due;
+        auto next = std::chrono::steady_clock::time_point::max();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto it = timers_.begin(); it != timers_.end();)
+            {
+                if (it->due <= now)
+                {
+                    due.push_back(std::move(*it));
+                    it = timers_.erase(it);
+                }
+                else
+                {
+                    next = std::min(next, it->due);
+                    ++it;
+                }
+            }
+        }
+        /* a timer may add transfers or timers of its own, the lock is not held */
+        for (Timer &timer : due)
+        {
+            timer.fn();
+        }
+        if (!due.empty())
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (const Timer &timer : timers_)
+            {
+                next = std::min(next, timer.due);
+            }
+        }
+        return next;
+    }
+
+    void EventLoop::wake()
+    {
+#ifdef __linux__
+        uint64_t one = 1;
+        [[maybe_unused]] auto written = write(wakeFd_, &one, sizeof(one));
+#else
+        curl_multi_wakeup(multi_);
+#endif
+    }
+
+    void EventLoop::attachPending()
+    {
+        std::vector<Job *> jobs;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            jobs.swap(pending_);
+        }
+        for (Job *job : jobs)
+        {
+            curl_easy_setopt(job->handle, CURLOPT_PRIVATE, job);
+            if (curl_multi_add_handle(multi_, job->handle) != CURLM_OK)
+            {
+                curl_easy_setopt(job->handle, CURLOPT_PRIVATE, nullptr);
+                active_--;
+                job->done(CURLE_FAILED_INIT);
+                delete job;
+            }
+        }
+    }
+
+    void EventLoop::finishTransfers()
+    {
+        int queued = 0;
+        while (CURLMsg *message = curl_multi_info_read(multi_, &queued))
+        {
+            if (message->msg != CURLMSG_DONE)
+            {
+                continue;
+            }
+            Job *job = nullptr;
+            curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, &job);
+            CURLcode result = message->data.result;
+            curl_multi_remove_handle(multi_, message->easy_handle);
+            curl_easy_setopt(message->easy_handle, CURLOPT_PRIVATE, nullptr);
+
+            /* the completion may resume a coroutine that queues the next request right away */
+            active_--;
+            job->done(result);
+            delete job;
+        }
+    }
+
+#ifdef __linux__
+    int EventLoop::onSocket(CURL *, curl_socket_t socket, int what, void *loop, void *socketData)
+    {
+        auto *self = static_cast<EventLoop *>(loop);
+        if (what == CURL_POLL_REMOVE)
+        {
+            epoll_ctl(self->epoll_, EPOLL_CTL_DEL, socket, nullptr);
+            curl_multi_assign(self->multi_, socket, nullptr);
+            return 0;
+        }
+
+        epoll_event event{};
+        event.events = ((what & CURL_POLL_IN) ? EPOLLIN : 0) | ((what & CURL_POLL_OUT) ? EPOLLOUT : 0);
+        event.data.fd = socket;
+
+        /* socketData marks sockets that are already registered */
+        if (socketData != nullptr)
+        {
+            epoll_ctl(self->epoll_, EPOLL_CTL_MOD, socket, &event);
+        }
+        else
+        {
+            epoll_ctl(self->epoll_, EPOLL_CTL_ADD, socket, &event);
+            curl_multi_assign(self->multi_, socket, self);
+        }
+        return 0;
+    }
+
+    int EventLoop::onTimer(CURLM *, long timeoutMs, void *loop)
+    {
+        auto *self = static_cast<EventLoop *>(loop);
+        self->timeoutMs_ = timeoutMs;
+        self->timerChanged_ = true;
+        return 0;
+    }
+
+    void EventLoop::run()
+    {
+        constexpr int MAX_EVENTS = 256;
+        epoll_event events[MAX_EVENTS];
+        int running = 0;
+        auto deadline = std::chrono::steady_clock::time_point::max();
+
+        while (!stopping_)
+        {
+            /* curl reports timer changes through onTimer, turn them into a deadline */
+            if (timerChanged_)
+            {
+                timerChanged_ = false;
+                deadline = timeoutMs_ < 0 ? std::chrono::steady_clock::time_point::max()
+                                          : std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs_);
+            }
+
+            /* sleep until curl's deadline or the next timer, whichever comes first */
+            auto wakeAt = std::min(deadline, runTimers());
+            int wait = -1;
+            if (wakeAt != std::chrono::steady_clock::time_point::max())
+            {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(wakeAt - std::chrono::steady_clock::now()).count();
+                wait = left > 0 ? static_cast<int>(left) + 1 : 0;
+            }
+
+            int count = epoll_wait(epoll_, events, MAX_EVENTS, wait);
+            for (int i = 0; i < count; ++i)
+            {
+                if (events[i].data.fd == wakeFd_)
+                {
+                    uint64_t value;
+                    while (read(wakeFd_, &value, sizeof(value)) > 0)
+                    {
+                    }
+                    attachPending();
+                    continue;
+                }
+
+                int flags = ((events[i].events & EPOLLIN) ? CURL_CSELECT_IN : 0) |
+                            ((events[i].events & EPOLLOUT) ? CURL_CSELECT_OUT : 0) |
+                            ((events[i].events & (EPOLLERR | EPOLLHUP)) ? CURL_CSELECT_ERR : 0);
+                curl_multi_socket_action(multi_, events[i].data.fd, flags, &running);
+            }
+
+            if (deadline != std::chrono::steady_clock::time_point::max() && std::chrono::steady_clock::now() >= deadline)
+            {
+                deadline = std::chrono::steady_clock::time_point::max();
+                curl_multi_socket_action(multi_, CURL_SOCKET_TIMEOUT, 0, &running);
+            }
+
+            finishTransfers();
+        }
+    }
+#else
+    int EventLoop::onSocket(CURL *, curl_socket_t, int, void *, void *)
+    {
+        return 0;
+    }
+
+    int EventLoop::onTimer(CURLM *, long, void *)
+    {
+        return 0;
+    }
+
+    void EventLoop::run()
+    {
+        int running = 0;
+        while (!stopping_)
+        {
+            attachPending();
+            curl_multi_perform(multi_, &running);
+            finishTransfers();
+            auto next = runTimers();
+            int wait = 1000;
+            if (next != std::chrono::steady_clock::time_point::max())
+            {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(next - std::chrono::steady_clock::now()).count();
+                wait = static_cast<int>(std::clamp<long long>(left + 1, 0, 1000));
+            }
+            /* returns early on socket activity or curl_multi_wakeup */
+            curl_multi_poll(multi_, nullptr, 0, wait, nullptr);
+        }
+    }
+#endif
+}
@@ -0,0 +1,99 @@
+#include <events.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using json = nlohmann::json;
+
+namespace AnimepaheCLI
+{
+    namespace Events
+    {
+        namespace
+        {
+            bool jsonMode = false;
+            int progressInterval = 1000;
+            std::mutex emitMutex;
+            const auto startTime = std::chrono::steady_clock::now();
+
+            std::string isoTimestamp()
+            {
+                auto now = std::chrono::system_clock::now();
+                auto now_time = std::chrono::system_clock::to_time_t(now);
+                auto ms_part = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count() % 1000;
+
+                std::tm utc{};
+#ifdef _WIN32
+                gmtime_s(&utc, &now_time);
+#else
+                gmtime_r(&now_time, &utc);
+#endif
+                std::ostringstream oss;
+                oss << std::put_time(&utc, "%Y-%m-%dT%H:%M:%S") << "." << std::setw(3) << std::setfill('0') << ms_part << "Z";
+                return oss.str();
+            }
+        }
+
+        void setJsonMode(bool enabled)
+        {
+            jsonMode = enabled;
+        }
+
+        bool isJsonMode()
+        {
+            return jsonMode;
+        }
+
+        bool isInteractive()
+        {
+#ifdef _WIN32
+            return !jsonMode && _isatty(_fileno(stdout));
+#else
+            return !jsonMode && isatty(fileno(stdout));
+#endif
+        }
+
+        void setProgressInterval(int milliseconds)
+        {
+            progressInterval = std::max(0, milliseconds);
+        }
+
+        int getProgressInterval()
+        {
+            return progressInterval;
+        }
+
+        void emit(const std::string &event, json fields)
+        {
+            if (!jsonMode)
+            {
+                return;
+            }
+
+            nlohmann::ordered_json line = nlohmann::ordered_json::object();
+            line["event"] = event;
+            line["ts"] = isoTimestamp();
+            line["t_ms"] = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+            for (auto &[key, value] : fields.items())
+            {
+                line[key] = value;
+            }
+
+            /* invalid UTF-8 in titles must not abort the stream */
+            std::string serialized = line.dump(-1, ' ', false, nlohmann::ordered_json::error_handler_t::replace);
+
+            std::lock_guard<std::mutex> lock(emitMutex);
+            std::cout << serialized << "\n" << std::flush;
+        }
+    }
+}
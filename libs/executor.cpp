@@ -0,0 +1,60 @@
+#include <executor.hpp>
+#include <algorithm>
+
+namespace AnimepaheCLI
+{
+    Executor::Executor(size_t threads)
+    {
+        if (threads == 0)
+        {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        threads_.reserve(threads);
+        for (size_t i = 0; i < threads; ++i)
+        {
+            threads_.emplace_back(&Executor::run, this);
+        }
+    }
+
+    Executor::~Executor()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wakeup_.notify_all();
+        for (auto &thread : threads_)
+        {
+            thread.join();
+        }
+    }
+
+    void Executor::post(std::coroutine_handle<> handle)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back(handle);
+        }
+        wakeup_.notify_one();
+    }
+
+    void Executor::run()
+    {
+        while (true)
+        {
+            std::coroutine_handle<> handle;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wakeup_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+                /* drain what is queued before stopping, suspended frames would leak otherwise */
+                if (queue_.empty())
+                {
+                    return;
+                }
+                handle = queue_.front();
+                queue_.pop_front();
+            }
+            handle.resume();
+        }
+    }
+}
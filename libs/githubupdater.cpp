@@ -1,4 +1,7 @@
 #include "githubupdater.hpp"
+#include <http.hpp>
+#include <sha256.hpp>
+#include <utils.hpp>
 #include <cpr/cpr.h>
 #include <nlohmann/json.hpp>
 #include <fmt/core.h>
@@ -12,8 +15,54 @@
 #include <iomanip>
 #include <ctime>
 #include <algorithm>
+#include <cstdlib>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <zstd.h>
+#ifdef _WIN32
 #include <windows.h>
 #include <shellapi.h>
+#endif
+
+namespace {
+    nlohmann::json releaseToJson(const GitHubUpdater::Release& release) {
+        nlohmann::json assets = nlohmann::json::array();
+        for (const auto& asset : release.assets) {
+            assets.push_back({{"name", asset.name}, {"browser_download_url", asset.url}, {"size", asset.size}, {"digest", asset.digest}});
+        }
+        return {
+            {"tag_name", release.tag_name},
+            {"name", release.name},
+            {"body", release.body},
+            {"prerelease", release.prerelease},
+            {"assets", assets}
+        };
+    }
+
+    /* the fields we use from a GitHub release object, throws on a malformed one */
+    GitHubUpdater::Release releaseFromJson(const nlohmann::json& json) {
+        GitHubUpdater::Release release;
+        release.tag_name = json.at("tag_name").get<std::string>();
+        release.name = json.value("name", "");
+        release.body = json.value("body", "");
+        release.prerelease = json.value("prerelease", false);
+        for (const auto& asset : json.value("assets", nlohmann::json::array())) {
+            GitHubUpdater::Asset entry;
+            entry.name = asset.at("name").get<std::string>();
+            entry.url = asset.at("browser_download_url").get<std::string>();
+            entry.size = asset.value("size", uint64_t{0});
+            /* null for assets uploaded before GitHub started listing digests */
+            entry.digest = asset.contains("digest") && asset["digest"].is_string() ? asset["digest"].get<std::string>() : "";
+            release.assets.push_back(std::move(entry));
+        }
+        return release;
+    }
+
+    int64_t unixNow() {
+        return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+}
 
 GitHubUpdater::GitHubUpdater(
     const std::string& owner,
@@ -48,7 +97,7 @@ bool GitHubUpdater::isNewerVersion(const std::string& latest, const std::string&
     return latest_patch > current_patch;
 }
 
-std::optional<GitHubUpdater::Release> GitHubUpdater::checkForUpdate() {
+std::optional<GitHubUpdater::Release> GitHubUpdater::fetchLatestRelease(std::string* error) {
     std::string url = "https://api.github.com/repos/" + repo_owner + "/" + repo_name + "/releases/latest";
     
     cpr::Header headers;
@@ -57,126 +106,311 @@ std::optional<GitHubUpdater::Release> GitHubUpdater::checkForUpdate() {
         headers["Authorization"] = "token " + github_token;
     }
     
-    auto response = cpr::Get(cpr::Url{url}, headers);
+    /* bounded, a slow API must never hold up the end of a run */
+    auto response = AnimepaheCLI::Http::Get("GET github release", cpr::Url{url}, headers, cpr::Timeout{5000});
     
     if (response.status_code != 200) {
-        std::cerr << "Failed to check for updates: " << response.status_code << std::endl;
+        if (error) {
+            *error = "Failed to check for updates: " + std::to_string(response.status_code);
+        }
         return std::nullopt;
     }
     
     try {
-        auto json = nlohmann::json::parse(response.text);
-        Release release;
-        release.tag_name = json["tag_name"];
-        release.name = json["name"];
-        release.body = json["body"];
-        release.prerelease = json["prerelease"];
-        
-        /* Extract assets */
-        for (const auto& asset : json["assets"]) {
-            release.assets.emplace_back(asset["name"], asset["browser_download_url"]);
-        }
-        
-        if (isNewerVersion(release.tag_name, current_version)) {
-            return release;
-        }
+        return releaseFromJson(nlohmann::json::parse(response.text));
     } catch (const std::exception& e) {
-        std::cerr << "Error parsing release data: " << e.what() << std::endl;
+        if (error) {
+            *error = std::string("Error parsing release data: ") + e.what();
+        }
     }
     
     return std::nullopt;
 }
 
+std::optional<GitHubUpdater::Release> GitHubUpdater::checkForUpdate() {
+    std::string error;
+    auto release = fetchLatestRelease(&error);
+    if (!release.has_value()) {
+        std::cerr << error << std::endl;
+        return std::nullopt;
+    }
+    if (isNewerVersion(release->tag_name, current_version)) {
+        return release;
+    }
+    return std::nullopt;
+}
+
+std::optional<GitHubUpdater::Release> GitHubUpdater::checkForUpdateCached(const std::string& cache_path, std::chrono::seconds interval) {
+    std::optional<Release> latest;
+    bool fresh = false;
+
+    /* {"checked_at": unix seconds, "release": {...}} */
+    std::ifstream cached(cache_path);
+    if (cached.is_open()) {
+        auto json = nlohmann::json::parse(cached, nullptr, false);
+        if (json.is_object() && unixNow() - json.value("checked_at", int64_t{0}) < interval.count()) {
+            try {
+                if (json.contains("release") && json["release"].is_object()) {
+                    latest = releaseFromJson(json["release"]);
+                    fresh = true;
+                }
+            } catch (const std::exception&) {
+                fresh = false;
+            }
+        }
+    }
+
+    /* only an answer is cached, a failed lookup is tried again on the next run */
+    if (!fresh) {
+        latest = fetchLatestRelease();
+    }
+    if (!fresh && latest.has_value()) {
+        nlohmann::json json = {
+            {"checked_at", unixNow()},
+            {"release", releaseToJson(*latest)}
+        };
+
+        AnimepaheCLI::writeFileAtomically(cache_path, json.dump(2));
+    }
+
+    /* compared on every read, an upgrade makes a cached release stale by itself */
+    if (latest.has_value() && isNewerVersion(latest->tag_name, current_version)) {
+        return latest;
+    }
+    return std::nullopt;
+}
+
 bool GitHubUpdater::downloadFile(
     const std::string& url,
     const std::string& filepath, 
-    std::function<void(double)> progress_callback
+    std::function<void(double)> progress_callback,
+    uint64_t expected_size
 ) {
-    std::ofstream file(filepath, std::ios::binary);
-    if (!file.is_open()) {
-        std::cerr << "Cannot open file for writing: " << filepath << std::endl;
-        return false;
-    }
-    
     cpr::Header headers;
     headers["User-Agent"] = "GitHubUpdater/1.0";
     if (!github_token.empty()) {
         headers["Authorization"] = "token " + github_token;
     }
     
-    auto response = cpr::Get(
-        cpr::Url{url},
-        headers,
-        cpr::WriteCallback([&file](std::string data, intptr_t userdata) -> bool {
-            file.write(data.c_str(), data.size());
-            return true;
-        }),
-        cpr::ProgressCallback([progress_callback](
-            cpr::cpr_off_t downloadTotal, cpr::cpr_off_t downloadNow,
-            cpr::cpr_off_t uploadTotal, cpr::cpr_off_t uploadNow,
-            intptr_t userdata
-        ) -> bool {
-            if (progress_callback && downloadTotal > 0) {
-                double progress = static_cast<double>(downloadNow) / downloadTotal * 100.0;
-                progress_callback(progress);
+    /* a partial file from an interrupted attempt (or run) is continued, not fetched again */
+    constexpr int ATTEMPTS = 4;
+    for (int attempt = 0; attempt < ATTEMPTS; ++attempt) {
+        std::error_code ec;
+        uintmax_t have = std::filesystem::exists(filepath, ec) ? std::filesystem::file_size(filepath, ec) : 0;
+        if (ec) {
+            have = 0;
+        }
+        if (have > 0) {
+            headers["Range"] = "bytes=" + std::to_string(have) + "-";
+        } else {
+            headers.erase("Range");
+        }
+        
+        std::ofstream file(filepath, std::ios::binary | (have > 0 ? std::ios::app : std::ios::trunc));
+        if (!file.is_open()) {
+            std::cerr << "Cannot open file for writing: " << filepath << std::endl;
+            return false;
+        }
+        
+        /* status of the final response, redirects included, decides between append and restart */
+        long status = 0;
+        bool restarted = false;
+        auto response = AnimepaheCLI::Http::Get(
+            "GET update asset",
+            cpr::Url{url},
+            headers,
+            cpr::HeaderCallback([&status](std::string header, intptr_t userdata) -> bool {
+                if (header.rfind("HTTP/", 0) == 0) {
+                    size_t space = header.find(' ');
+                    status = space == std::string::npos ? 0 : std::strtol(header.c_str() + space + 1, nullptr, 10);
+                }
+                return true;
+            }),
+            cpr::WriteCallback([&file, &status, &restarted, &filepath, have](std::string data, intptr_t userdata) -> bool {
+                if (status == 200 && have > 0 && !restarted) {
+                    /* the server ignored the range, start over */
+                    file.close();
+                    file.open(filepath, std::ios::binary | std::ios::trunc);
+                    restarted = true;
+                }
+                file.write(data.c_str(), data.size());
+                return file.good();
+            }),
+            cpr::ProgressCallback([progress_callback, &status, have](
+                cpr::cpr_off_t downloadTotal, cpr::cpr_off_t downloadNow,
+                cpr::cpr_off_t uploadTotal, cpr::cpr_off_t uploadNow,
+                intptr_t userdata
+            ) -> bool {
+                if (progress_callback && downloadTotal > 0) {
+                    double offset = status == 206 ? static_cast<double>(have) : 0.0;
+                    double progress = (offset + downloadNow) / (offset + downloadTotal) * 100.0;
+                    progress_callback(progress);
+                }
+                return true;
+            })
+        );
+        
+        file.close();
+        
+        if (response.status_code == 416 && have > 0) {
+            /* the range starts at or past the end; done only when the file has the length Content-Range (or the asset) gives */
+            uint64_t total = expected_size;
+            auto range = response.header.find("Content-Range");
+            if (range != response.header.end() && range->second.find("*/") != std::string::npos) {
+                total = std::strtoull(range->second.c_str() + range->second.find("*/") + 2, nullptr, 10);
             }
-            return true;
-        })
-    );
-    
-    file.close();
-    
-    if (response.status_code != 200) {
-        std::cerr << "Download failed: " << response.status_code << std::endl;
-        std::filesystem::remove(filepath);
-        return false;
+            if (total > 0 && have == total) {
+                return true;
+            }
+            /* a longer leftover or one of unknown length, fetch it again */
+            std::cerr << "\n Partial download does not match the asset, starting over" << std::endl;
+            std::filesystem::remove(filepath, ec);
+            continue;
+        }
+        if (response.status_code == 200 || response.status_code == 206) {
+            if (response.error.code == cpr::ErrorCode::OK) {
+                return true;
+            }
+        } else if (response.status_code != 0) {
+            std::cerr << "Download failed: " << response.status_code << std::endl;
+            std::filesystem::remove(filepath, ec);
+            return false;
+        }
+        
+        /* dropped connection, keep what arrived and continue from there */
+        std::cerr << "\n Download interrupted (" << response.error.message << "), resuming..." << std::endl;
+        std::this_thread::sleep_for(std::chrono::seconds(1 << attempt));
     }
     
-    return true;
+    std::cerr << "Download failed: too many interruptions, the partial file is kept for the next attempt" << std::endl;
+    return false;
 }
 
-std::string GitHubUpdater::findPlatformAsset(const Release& release) {
+const GitHubUpdater::Asset* GitHubUpdater::findPlatformAsset(const Release& release) {
     /* Look for platform-specific executable */
     for (const auto& asset : release.assets) {
-        std::string asset_name_lower = asset.first;
+        std::string asset_name_lower = asset.name;
         std::transform(
             asset_name_lower.begin(),
             asset_name_lower.end(), 
             asset_name_lower.begin(), ::tolower
         );
         
-        if ((asset_name_lower.find(".exe") != std::string::npos)) {
-            return asset.second; /* Return download URL */
+#ifdef _WIN32
+        if (asset_name_lower.size() > 4 && asset_name_lower.compare(asset_name_lower.size() - 4, 4, ".exe") == 0) {
+            return &asset;
+        }
+#else
+        if (asset_name_lower.find("linux") != std::string::npos && asset_name_lower.find(".exe") == std::string::npos &&
+            asset_name_lower.find(".zst") == std::string::npos && asset_name_lower.find(".sha256") == std::string::npos) {
+            return &asset;
+        }
+#endif
+    }
+    
+    return nullptr;
+}
+
+std::string GitHubUpdater::publishedSha256(const Release& release, const Asset& asset) {
+    static const std::regex hex_digest(R"(\b([0-9a-fA-F]{64})\b)");
+    std::smatch match;
+    
+    if (asset.digest.rfind("sha256:", 0) == 0 && asset.digest.size() == 7 + 64) {
+        std::string digest = asset.digest.substr(7);
+        std::transform(digest.begin(), digest.end(), digest.begin(), ::tolower);
+        return digest;
+    }
+    
+    for (const auto& candidate : release.assets) {
+        std::string name_lower = candidate.name;
+        std::transform(name_lower.begin(), name_lower.end(), name_lower.begin(), ::tolower);
+        bool sidecar = candidate.name == asset.name + ".sha256";
+        bool sums = name_lower == "sha256sums" || name_lower == "sha256sums.txt" || name_lower == "checksums.txt";
+        if (!sidecar && !sums) {
+            continue;
+        }
+        
+        auto response = AnimepaheCLI::Http::Get("GET update checksum", cpr::Url{candidate.url}, cpr::Timeout{10000});
+        if (response.status_code != 200) {
+            continue;
+        }
+        
+        /* "<hex>  <name>" lines, a sidecar may hold the bare digest */
+        std::istringstream lines(response.text);
+        std::string line;
+        while (std::getline(lines, line)) {
+            bool names_asset = line.find(asset.name) != std::string::npos;
+            if ((sidecar || names_asset) && std::regex_search(line, match, hex_digest)) {
+                std::string digest = match[1];
+                std::transform(digest.begin(), digest.end(), digest.begin(), ::tolower);
+                return digest;
+            }
         }
     }
     
     return "";
 }
 
-bool GitHubUpdater::performUpdate(const Release& release) {
-    std::string download_url = findPlatformAsset(release);
-    if (download_url.empty()) {
-        std::cerr << "No suitable asset found for current platform" << std::endl;
+bool GitHubUpdater::unpackAsset(const std::string& packed, const std::string& output, const std::string& dictionary_file) {
+    std::ifstream in(packed, std::ios::binary);
+    std::ofstream out(output, std::ios::binary | std::ios::trunc);
+    if (!in.is_open() || !out.is_open()) {
         return false;
     }
     
-    std::cout << "\n Downloading update " << release.tag_name << "..." << std::endl;
+    /* the old binary is the window a --patch-from delta refers back into */
+    std::vector<char> dictionary;
+    if (!dictionary_file.empty()) {
+        std::ifstream old(dictionary_file, std::ios::binary);
+        dictionary.assign(std::istreambuf_iterator<char>(old), std::istreambuf_iterator<char>());
+        if (dictionary.empty()) {
+            return false;
+        }
+    }
     
-    std::string temp_file = "update_temp_" + std::to_string(std::time(nullptr));
-#ifdef _WIN32
-    temp_file += ".exe";
-#endif
+    std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> dctx(ZSTD_createDCtx(), ZSTD_freeDCtx);
+    if (!dctx) {
+        return false;
+    }
+    ZSTD_DCtx_setParameter(dctx.get(), ZSTD_d_windowLogMax, 31);
     
-    /* Download with progress */
-    bool download_success = downloadFile(download_url, temp_file, [](double progress) {
-        std::cout << " \r Progress: " << std::fixed
-        << std::setprecision(1) 
-        << progress << "%" << std::flush;
-    });
+    auto referencePrefix = [&dictionary, &dctx]() {
+        return dictionary.empty() || !ZSTD_isError(ZSTD_DCtx_refPrefix(dctx.get(), dictionary.data(), dictionary.size()));
+    };
+    if (!referencePrefix()) {
+        return false;
+    }
     
-    std::cout << std::endl;
+    std::vector<char> input(ZSTD_DStreamInSize());
+    std::vector<char> decoded(ZSTD_DStreamOutSize());
+    size_t last = 0;
+    bool any = false;
+    while (in) {
+        in.read(input.data(), static_cast<std::streamsize>(input.size()));
+        ZSTD_inBuffer source{input.data(), static_cast<size_t>(in.gcount()), 0};
+        any = any || source.size > 0;
+        while (source.pos < source.size) {
+            if (last == 0 && source.pos > 0 && !referencePrefix()) {
+                return false;
+            }
+            ZSTD_outBuffer target{decoded.data(), decoded.size(), 0};
+            last = ZSTD_decompressStream(dctx.get(), &target, &source);
+            if (ZSTD_isError(last)) {
+                std::cerr << "Cannot unpack " << packed << ": " << ZSTD_getErrorName(last) << std::endl;
+                return false;
+            }
+            out.write(decoded.data(), static_cast<std::streamsize>(target.pos));
+        }
+    }
     
-    if (!download_success) {
+    /* last == 0 means the final frame ended where the input did */
+    return any && last == 0 && out.good();
+}
+
+bool GitHubUpdater::performUpdate(const Release& release) {
+    const Asset* binary = findPlatformAsset(release);
+    if (binary == nullptr) {
+        std::cerr << "No suitable asset found for current platform" << std::endl;
         return false;
     }
     
@@ -184,23 +418,132 @@ bool GitHubUpdater::performUpdate(const Release& release) {
     std::string current_exe = getCurrentExecutablePath();
     if (current_exe.empty()) {
         std::cerr << "Cannot determine current executable path" << std::endl;
-        std::filesystem::remove(temp_file);
         return false;
     }
     
-    /* Apply the update */
-    return applyUpdate(temp_file, current_exe);
+    std::string expected = publishedSha256(release, *binary);
+    if (expected.empty()) {
+        if (!allow_unverified) {
+            fmt::print(fmt::fg(fmt::color::indian_red), "\n No SHA-256 published for {}, refusing to install an unverified binary (--allow-unverified to override)\n", binary->name);
+            return false;
+        }
+        fmt::print(fmt::fg(fmt::color::yellow), "\n No SHA-256 published for {}, only its size is checked\n", binary->name);
+    }
+    
+    /* cheapest first: a delta against this version, the compressed binary, the binary itself */
+    struct Candidate {
+        const Asset* asset;
+        bool packed;
+        bool delta;
+    };
+    std::vector<Candidate> candidates;
+    for (const auto& asset : release.assets) {
+        if (asset.name == binary->name + ".patch-from-" + current_version + ".zst") {
+            candidates.insert(candidates.begin(), Candidate{&asset, true, true});
+        } else if (asset.name == binary->name + ".zst") {
+            candidates.push_back(Candidate{&asset, true, false});
+        }
+    }
+    candidates.push_back(Candidate{binary, false, false});
+    
+#ifdef _WIN32
+    std::string temp_file = "update_" + release.tag_name;
+    std::string target = temp_file + ".exe";
+#else
+    /* next to the executable, so the final rename stays on one filesystem */
+    std::string temp_file = current_exe + ".update-" + release.tag_name;
+    std::string target = temp_file;
+#endif
+    
+    for (const auto& candidate : candidates) {
+        /* named after the asset, so an interrupted download resumes on the next --upgrade */
+        std::string partial = temp_file + "." + candidate.asset->name + ".part";
+        fmt::print("\n Downloading update {} ({}{:.1f} MB)...\n", release.tag_name,
+            candidate.delta ? "delta, " : candidate.packed ? "compressed, " : "",
+            static_cast<double>(candidate.asset->size) / (1024.0 * 1024.0));
+        
+        /* Download with progress */
+        bool download_success = downloadFile(candidate.asset->url, partial, [](double progress) {
+            std::cout << " \r Progress: " << std::fixed
+            << std::setprecision(1) 
+            << progress << "%" << std::flush;
+        }, candidate.asset->size);
+        
+        std::cout << std::endl;
+        
+        if (!download_success) {
+            continue;
+        }
+        
+        std::error_code ec;
+        bool ready = candidate.packed
+            ? unpackAsset(partial, target, candidate.delta ? current_exe : "")
+            : (std::filesystem::rename(partial, target, ec), !ec);
+        std::filesystem::remove(partial, ec);
+        if (!ready) {
+            std::cerr << " Cannot rebuild the update from " << candidate.asset->name << std::endl;
+            std::filesystem::remove(target, ec);
+            continue;
+        }
+        
+        /* never swap in a binary that does not match what was published */
+        uint64_t size = std::filesystem::file_size(target, ec);
+        if (binary->size > 0 && (ec || size != binary->size)) {
+            fmt::print(fmt::fg(fmt::color::indian_red), " Size mismatch for {} ({} != {} bytes)\n", candidate.asset->name, ec ? 0 : size, binary->size);
+            std::filesystem::remove(target, ec);
+            continue;
+        }
+        if (!expected.empty()) {
+            std::string actual = AnimepaheCLI::Sha256::file(target);
+            if (actual != expected) {
+                fmt::print(fmt::fg(fmt::color::indian_red), " SHA-256 mismatch for {} ({} != {})\n", candidate.asset->name, actual, expected);
+                std::filesystem::remove(target, ec);
+                continue;
+            }
+            fmt::print(" SHA-256 : ");
+            fmt::print(fmt::fg(fmt::color::lime_green), "OK\n");
+        }
+        
+        /* Apply the update */
+        return applyUpdate(target, current_exe);
+    }
+    
+    return false;
 }
 
 std::string GitHubUpdater::getCurrentExecutablePath() {
+#ifdef _WIN32
     char path[MAX_PATH];
     GetModuleFileNameA(NULL, path, MAX_PATH);
     return std::string(path);
+#else
+    std::error_code ec;
+    std::filesystem::path path = std::filesystem::read_symlink("/proc/self/exe", ec);
+    return ec ? "" : path.string();
+#endif
 }
 
 bool GitHubUpdater::applyUpdate(const std::string& new_file, const std::string& current_file) {
     fmt::print("\n\r Applying update..");
     
+#ifndef _WIN32
+    /* the running image stays valid after its path is replaced, a rename is all it takes */
+    std::error_code ec;
+    std::filesystem::permissions(new_file, std::filesystem::perms::owner_all | std::filesystem::perms::group_read |
+        std::filesystem::perms::group_exec | std::filesystem::perms::others_read | std::filesystem::perms::others_exec,
+        std::filesystem::perm_options::replace, ec);
+    std::filesystem::rename(new_file, current_file, ec);
+    if (ec) {
+        std::filesystem::remove(new_file);
+        fmt::print("\r Applying update : ");
+        fmt::print(fmt::fg(fmt::color::indian_red), "FAIL! ({})\n\n", ec.message());
+        return false;
+    }
+    fmt::print("\r Applying update : ");
+    fmt::print(fmt::fg(fmt::color::lime_green), "OK!\n\n");
+    return true;
+#else
+    
     /* Windows: Use batch script to replace executable after exit */
     std::string batch_script = R"(
     @echo off
@@ -221,6 +564,7 @@ bool GitHubUpdater::applyUpdate(const std::string& new_file, const std::string&
     std::exit(0);
     
     return true;
+#endif
 }
 
 bool GitHubUpdater::checkAndUpdate(bool auto_update) {
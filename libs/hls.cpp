@@ -0,0 +1,244 @@
+#include <hls.hpp>
+#include <fmt/core.h>
+#include <re2/re2.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+
+namespace AnimepaheCLI
+{
+    namespace Hls
+    {
+        namespace
+        {
+            std::atomic<Source> configuredSource{Source::Auto};
+            std::atomic<int> configuredParallel{8};
+
+            /* KEY="value",KEY=value of a tag, value without quotes or empty */
+            std::string attribute(const std::string &attributes, const std::string &name)
+            {
+                re2::StringPiece input(attributes);
+                std::string key, value;
+                while (RE2::FindAndConsume(&input, R"re(([A-Z0-9-]+)=("[^"]*"|[^,]*))re", &key, &value))
+                {
+                    if (key == name)
+                    {
+                        return value.size() >= 2 && value.front() == '"' ? value.substr(1, value.size() - 2) : value;
+                    }
+                }
+                return "";
+            }
+
+            bool startsWith(const std::string &text, const char *prefix)
+            {
+                return text.rfind(prefix, 0) == 0;
+            }
+
+            /* 0x00112233... -> 16 bytes */
+            std::string hexBytes(const std::string &text)
+            {
+                std::string digits = startsWith(text, "0x") || startsWith(text, "0X") ? text.substr(2) : text;
+                if (digits.size() > 32 || digits.empty())
+                {
+                    throw std::runtime_error(fmt::format("HLS IV {} is not 16 bytes", text));
+                }
+                digits.insert(0, 32 - digits.size(), '0');
+                std::string bytes(16, '\0');
+                for (size_t i = 0; i < 16; ++i)
+                {
+                    bytes[i] = static_cast<char>(std::stoi(digits.substr(i * 2, 2), nullptr, 16));
+                }
+                return bytes;
+            }
+        }
+
+        void configure(Source source, int parallel)
+        {
+            configuredSource = source;
+            configuredParallel = parallel < 1 ? 1 : parallel;
+        }
+
+        Source source()
+        {
+            return configuredSource;
+        }
+
+        int parallel()
+        {
+            return configuredParallel;
+        }
+
+        std::string resolve(const std::string &base, const std::string &reference)
+        {
+            if (reference.find("://") != std::string::npos)
+            {
+                return reference;
+            }
+            size_t scheme = base.find("://");
+            if (scheme == std::string::npos)
+            {
+                return reference;
+            }
+            if (startsWith(reference, "//"))
+            {
+                return base.substr(0, scheme + 1) + reference;
+            }
+            if (startsWith(reference, "/"))
+            {
+                size_t path = base.find('/', scheme + 3);
+                return base.substr(0, path) + reference;
+            }
+            std::string directory = base.substr(0, base.find_first_of("?#"));
+            return directory.substr(0, directory.find_last_of('/') + 1) + reference;
+        }
+
+        Playlist parse(const std::string &text, const std::string &url)
+        {
+            Playlist playlist;
+            std::istringstream lines(text);
+            std::string line;
+            bool header = false;
+            bool rendition = false;
+            Rendition pending;
+            double duration = 0.0;
+            uint64_t sequence = 0;
+            int key = -1;
+
+            while (std::getline(lines, line))
+            {
+                if (!line.empty() && line.back() == '\r')
+                {
+                    line.pop_back();
+                }
+                if (line.empty())
+                {
+                    continue;
+                }
+                if (!header)
+                {
+                    if (!startsWith(line, "#EXTM3U"))
+                    {
+                        throw std::runtime_error("Not an HLS playlist");
+                    }
+                    header = true;
+                    continue;
+                }
+
+                if (startsWith(line, "#EXT-X-STREAM-INF:"))
+                {
+                    std::string attributes = line.substr(18);
+                    pending = Rendition{};
+                    std::string bandwidth = attribute(attributes, "BANDWIDTH");
+                    pending.bandwidth = bandwidth.empty() ? 0 : std::stoull(bandwidth);
+                    RE2::PartialMatch(attribute(attributes, "RESOLUTION"), R"(\d+x(\d+))", &pending.height);
+                    rendition = true;
+                }
+                else if (startsWith(line, "#EXT-X-MEDIA-SEQUENCE:"))
+                {
+                    sequence = std::stoull(line.substr(22));
+                }
+                else if (startsWith(line, "#EXT-X-KEY:"))
+                {
+                    std::string attributes = line.substr(11);
+                    std::string method = attribute(attributes, "METHOD");
+                    if (method == "NONE")
+                    {
+                        key = -1;
+                        continue;
+                    }
+                    if (method != "AES-128")
+                    {
+                        throw std::runtime_error(fmt::format("HLS encryption {} is not supported", method));
+                    }
+                    std::string iv = attribute(attributes, "IV");
+                    playlist.keys.push_back(Key{resolve(url, attribute(attributes, "URI")), iv.empty() ? "" : hexBytes(iv)});
+                    key = static_cast<int>(playlist.keys.size()) - 1;
+                }
+                else if (startsWith(line, "#EXTINF:"))
+                {
+                    duration = std::strtod(line.c_str() + 8, nullptr);
+                }
+                else if (startsWith(line, "#EXT-X-BYTERANGE") || startsWith(line, "#EXT-X-MAP"))
+                {
+                    throw std::runtime_error(fmt::format("HLS {} is not supported", line.substr(0, line.find(':'))));
+                }
+                else if (line[0] != '#')
+                {
+                    if (rendition)
+                    {
+                        pending.url = resolve(url, line);
+                        playlist.renditions.push_back(pending);
+                        rendition = false;
+                        continue;
+                    }
+                    playlist.segments.push_back(Segment{resolve(url, line), duration, sequence++, key});
+                    playlist.duration += duration;
+                    duration = 0.0;
+                }
+            }
+
+            if (!header)
+            {
+                throw std::runtime_error("Not an HLS playlist");
+            }
+            return playlist;
+        }
+
+        std::string segmentIv(const Key &key, uint64_t sequence)
+        {
+            if (!key.iv.empty())
+            {
+                return key.iv;
+            }
+            /* the media sequence number as a 128-bit big-endian integer */
+            std::string iv(16, '\0');
+            for (int i = 0; i < 8; ++i)
+            {
+                iv[15 - i] = static_cast<char>((sequence >> (8 * i)) & 0xff);
+            }
+            return iv;
+        }
+
+        std::string makeLink(const Link &link)
+        {
+            /* '&' and '#' would end the fragment fields early */
+            std::string file = link.file;
+            for (char &c : file)
+            {
+                if (c == '&' || c == '#')
+                {
+                    c = '_';
+                }
+            }
+            return fmt::format("{}#file={}&referer={}", link.url, file, link.referer);
+        }
+
+        bool isLink(const std::string &url)
+        {
+            size_t fragment = url.find('#');
+            if (fragment == std::string::npos)
+            {
+                return false;
+            }
+            std::string path = url.substr(0, std::min(fragment, url.find('?')));
+            return path.size() > 5 && path.compare(path.size() - 5, 5, ".m3u8") == 0;
+        }
+
+        Link parseLink(const std::string &url)
+        {
+            Link link;
+            size_t fragment = url.find('#');
+            link.url = url.substr(0, fragment);
+            if (fragment == std::string::npos)
+            {
+                return link;
+            }
+            std::string fields = url.substr(fragment + 1);
+            RE2::PartialMatch(fields, R"((?:^|&)file=([^&]*))", &link.file);
+            RE2::PartialMatch(fields, R"((?:^|&)referer=(.*)$)", &link.referer);
+            return link;
+        }
+    }
+}
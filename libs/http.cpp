@@ -0,0 +1,457 @@
+#include <http.hpp>
+#include <trace.hpp>
+#include <metrics.hpp>
+#include <scheduler.hpp>
+#include <eventloop.hpp>
+#include <curl/curl.h>
+#include <fmt/core.h>
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <map>
+#include <mutex>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace AnimepaheCLI
+{
+    namespace Http
+    {
+        namespace
+        {
+            std::string endpoint;
+
+            std::mutex recordMutex;
+            std::string recordDirectory;
+            size_t recordSequence = 0;
+
+            const char *methodName(Method method)
+            {
+                switch (method)
+                {
+                case Method::Post:
+                    return "POST";
+                case Method::Head:
+                    return "HEAD";
+                default:
+                    return "GET";
+                }
+            }
+
+            int64_t timeInfo(CURL *handle, CURLINFO info)
+            {
+                curl_off_t value = 0;
+                if (curl_easy_getinfo(handle, info, &value) != CURLE_OK)
+                {
+                    return 0;
+                }
+                return static_cast<int64_t>(value);
+            }
+
+            void record(Method method, const std::string &url, const cpr::Response &response)
+            {
+                namespace fs = std::filesystem;
+                std::lock_guard<std::mutex> lock(recordMutex);
+                if (recordDirectory.empty())
+                {
+                    return;
+                }
+
+                size_t sequence = ++recordSequence;
+                json entry = {
+                    {"seq", sequence},
+                    {"method", methodName(method)},
+                    {"url", url},
+                    {"final_url", response.url.str()},
+                    {"status", response.status_code},
+                    {"elapsed", response.elapsed},
+                    {"headers", json::object()},
+                    {"body", nullptr},
+                    {"body_size", response.downloaded_bytes > 0 ? static_cast<int64_t>(response.downloaded_bytes) : static_cast<int64_t>(response.text.size())}};
+
+                for (const auto &[name, value] : response.header)
+                {
+                    entry["headers"][name] = value;
+                }
+
+                /* streamed bodies (downloads) never reach response.text */
+                if (!response.text.empty())
+                {
+                    std::string bodyFile = fmt::format("{:06}.body", sequence);
+                    std::ofstream body(fs::path(recordDirectory) / bodyFile, std::ios::binary);
+                    body.write(response.text.data(), response.text.size());
+                    entry["body"] = bodyFile;
+                }
+
+                std::ofstream index(fs::path(recordDirectory) / "index.jsonl", std::ios::app);
+                index << entry.dump(-1, ' ', false, json::error_handler_t::replace) << "\n";
+            }
+        }
+
+        void setEndpoint(const std::string &value)
+        {
+            endpoint = value;
+            while (!endpoint.empty() && endpoint.back() == '/')
+            {
+                endpoint.pop_back();
+            }
+        }
+
+        const std::string &getEndpoint()
+        {
+            return endpoint;
+        }
+
+        std::string resolveUrl(const std::string &url)
+        {
+            if (endpoint.empty())
+            {
+                return url;
+            }
+            size_t scheme = url.find("://");
+            if (scheme == std::string::npos || url.compare(0, endpoint.size(), endpoint) == 0)
+            {
+                return url;
+            }
+            return endpoint + "/" + url.substr(scheme + 3);
+        }
+
+        namespace
+        {
+            /* latencies kept per span, and how many must be known before a span is hedged */
+            constexpr size_t HEDGE_WINDOW = 128;
+            constexpr size_t HEDGE_MIN_SAMPLES = 16;
+            /* never hedge sooner than this, a duplicate of a fast request only adds load */
+            constexpr long HEDGE_MIN_DELAY_MS = 50;
+
+            std::mutex hedgeMutex;
+            double hedgePercentile = 0.0;
+            double hedgeBudget = 0.0;
+            std::map<std::string, std::deque<long>> latencies;
+            std::atomic<size_t> hedgeable{0};
+            std::atomic<size_t> hedgesSent{0};
+
+            /* "GET api page 12" and "GET api page 3" share their latencies */
+            std::string latencyKey(const std::string &span)
+            {
+                size_t end = span.size();
+                while (end > 0 && (std::isdigit(static_cast<unsigned char>(span[end - 1])) || span[end - 1] == ' '))
+                {
+                    end--;
+                }
+                return span.substr(0, end);
+            }
+
+            void learnLatency(const std::string &span, long milliseconds)
+            {
+                std::lock_guard<std::mutex> lock(hedgeMutex);
+                std::deque<long> &window = latencies[latencyKey(span)];
+                window.push_back(milliseconds);
+                if (window.size() > HEDGE_WINDOW)
+                {
+                    window.pop_front();
+                }
+            }
+
+            /* delay before the duplicate is sent, -1 when the request is not hedged */
+            long hedgeDelay(const std::string &span)
+            {
+                std::lock_guard<std::mutex> lock(hedgeMutex);
+                if (hedgePercentile <= 0.0)
+                {
+                    return -1;
+                }
+                auto found = latencies.find(latencyKey(span));
+                if (found == latencies.end() || found->second.size() < HEDGE_MIN_SAMPLES)
+                {
+                    return -1;
+                }
+                std::vector<long> sorted(found->second.begin(), found->second.end());
+                size_t rank = static_cast<size_t>(hedgePercentile / 100.0 * (sorted.size() - 1) + 0.5);
+                std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+                return std::max(sorted[rank], HEDGE_MIN_DELAY_MS);
+            }
+
+            /* the duplicate may go out while hedges stay within the budget share of hedgeable requests */
+            bool takeHedge()
+            {
+                double allowed = hedgeBudget * static_cast<double>(hedgeable.load());
+                if (static_cast<double>(hedgesSent.load() + 1) > allowed)
+                {
+                    return false;
+                }
+                hedgesSent++;
+                return true;
+            }
+
+            /**
+             * Both transfers of a hedged request. Slot callbacks run on
+             * whichever thread released the slot, so they only post to the
+             * event loop; everything below is touched on the loop thread.
+             */
+            struct HedgedTransfer
+            {
+                std::shared_ptr<cpr::Session> primary;
+                std::shared_ptr<cpr::Session> backup;
+                AsyncRequest::Configure configure;
+                std::string url;
+                bool done = false;
+                bool primaryRunning = false;
+                bool backupRunning = false;
+                int64_t backupStart = 0; /* trace clock, the backup's timings count from here */
+            };
+        }
+
+        void setHedging(double percentile, double budget)
+        {
+            std::lock_guard<std::mutex> lock(hedgeMutex);
+            hedgePercentile = std::clamp(percentile, 0.0, 100.0);
+            hedgeBudget = std::max(budget, 0.0);
+        }
+
+        void setRecordDirectory(const std::string &directory)
+        {
+            std::lock_guard<std::mutex> lock(recordMutex);
+            recordDirectory = directory;
+            if (!directory.empty())
+            {
+                std::filesystem::create_directories(directory);
+            }
+        }
+
+        namespace
+        {
+            /* trace span and recording of a finished transfer, the handle still holds its info */
+            void observe(const std::string &span, cpr::Session &session, const std::string &url, Method method, int64_t start, const cpr::Response &response)
+            {
+                if (Trace::isEnabled())
+                {
+                    CURL *handle = session.GetCurlHolder()->handle;
+                    Trace::HttpTimings timings;
+                    timings.dns = timeInfo(handle, CURLINFO_NAMELOOKUP_TIME_T);
+                    timings.connect = timeInfo(handle, CURLINFO_CONNECT_TIME_T);
+                    timings.tls = timeInfo(handle, CURLINFO_APPCONNECT_TIME_T);
+                    timings.ttfb = timeInfo(handle, CURLINFO_STARTTRANSFER_TIME_T);
+                    timings.total = timeInfo(handle, CURLINFO_TOTAL_TIME_T);
+                    timings.redirect = timeInfo(handle, CURLINFO_REDIRECT_TIME_T);
+
+                    int64_t bytes = response.downloaded_bytes > 0 ? static_cast<int64_t>(response.downloaded_bytes) : static_cast<int64_t>(response.text.size());
+                    Trace::httpRequest(span, methodName(method), response.url.str(), start, timings, response.status_code, bytes);
+                }
+
+                if (!recordDirectory.empty())
+                {
+                    record(method, url, response);
+                }
+            }
+        }
+
+        namespace
+        {
+            /* what the host's scheduler slot learns from a finished transfer */
+            Scheduler::Outcome outcomeOf(CURLcode result, const cpr::Response &response)
+            {
+                /* aborted by a callback or a full disk on our side, the host did nothing wrong */
+                if (result == CURLE_ABORTED_BY_CALLBACK || result == CURLE_WRITE_ERROR)
+                {
+                    return Scheduler::Outcome::Cancelled;
+                }
+                if (result != CURLE_OK)
+                {
+                    return Scheduler::Outcome::Failed;
+                }
+                if (response.status_code == 429 || response.status_code == 503)
+                {
+                    return Scheduler::Outcome::Throttled;
+                }
+                /* an overloaded gateway (500, 502, 504) has to see fewer requests, not more */
+                if (response.status_code >= 500)
+                {
+                    return Scheduler::Outcome::Failed;
+                }
+                return Scheduler::Outcome::Ok;
+            }
+
+            double ttfbOf(cpr::Session &session)
+            {
+                return timeInfo(session.GetCurlHolder()->handle, CURLINFO_STARTTRANSFER_TIME_T) / 1e6;
+            }
+
+            void prepare(cpr::Session &session, Method method)
+            {
+                switch (method)
+                {
+                case Method::Post:
+                    session.PreparePost();
+                    break;
+                case Method::Head:
+                    session.PrepareHead();
+                    break;
+                default:
+                    session.PrepareGet();
+                    break;
+                }
+            }
+        }
+
+        cpr::Response perform(const std::string &span, cpr::Session &session, const std::string &url, Method method)
+        {
+            /* blocking requests wait for a slot of their host like every other one */
+            std::promise<void> slot;
+            Scheduler::acquire(url, [&slot]()
+                               { slot.set_value(); });
+            slot.get_future().wait();
+
+            int64_t start = Trace::now();
+            cpr::Response response;
+            switch (method)
+            {
+            case Method::Post:
+                response = session.Post();
+                break;
+            case Method::Head:
+                response = session.Head();
+                break;
+            default:
+                response = session.Get();
+                break;
+            }
+
+            observe(span, session, url, method, start, response);
+            Scheduler::Outcome outcome = response.error ? Scheduler::Outcome::Failed : outcomeOf(CURLE_OK, response);
+            Scheduler::release(url, outcome, ttfbOf(session));
+            return response;
+        }
+
+        void AsyncRequest::await_suspend(std::coroutine_handle<> handle)
+        {
+            if (configure_)
+            {
+                hedgeable++;
+                long delay = hedgeDelay(span_);
+                if (delay >= 0)
+                {
+                    suspendHedged(handle, delay);
+                    return;
+                }
+            }
+
+            /* queued behind the host's limit, the clock starts when the transfer does */
+            Scheduler::acquire(url_, [this, handle]()
+                               {
+                start_ = Trace::now();
+                prepare(*session_, method_);
+                EventLoop::shared().add(session_->GetCurlHolder()->handle, [this, handle](CURLcode result) {
+                    response_ = session_->Complete(result);
+                    observe(span_, *session_, url_, method_, start_, response_);
+                    Scheduler::release(url_, outcomeOf(result, response_), ttfbOf(*session_));
+                    if (configure_ && result == CURLE_OK)
+                    {
+                        learnLatency(span_, static_cast<long>((Trace::now() - start_) / 1000));
+                    }
+                    handle.resume();
+                }); });
+        }
+
+        void AsyncRequest::suspendHedged(std::coroutine_handle<> handle, long delayMs)
+        {
+            /* hedged requests are idempotent GETs */
+            auto transfer = std::make_shared<HedgedTransfer>();
+            transfer->primary = session_;
+            transfer->configure = configure_;
+            transfer->url = url_;
+
+            /**
+             * The first answer resumes the coroutine and cancels the other
+             * transfer; `this` is gone after resume. A transport error (reset,
+             * connect failure) only wins when the other copy is not running,
+             * otherwise the healthy one still can.
+             */
+            auto finish = [this, handle, transfer](bool fromBackup, CURLcode result)
+            {
+                cpr::Session &session = fromBackup ? *transfer->backup : *transfer->primary;
+                (fromBackup ? transfer->backupRunning : transfer->primaryRunning) = false;
+                if (transfer->done)
+                {
+                    /* the cancelled loser only hands its slot back */
+                    Scheduler::release(transfer->url, Scheduler::Outcome::Cancelled, 0.0);
+                    return;
+                }
+                bool otherRunning = fromBackup ? transfer->primaryRunning : transfer->backupRunning;
+                if (result != CURLE_OK && result != CURLE_ABORTED_BY_CALLBACK && otherRunning)
+                {
+                    Scheduler::release(transfer->url, Scheduler::Outcome::Failed, 0.0);
+                    return;
+                }
+                transfer->done = true;
+
+                response_ = session.Complete(result);
+                observe(span_, session, url_, method_, fromBackup ? transfer->backupStart : start_, response_);
+                Scheduler::release(url_, outcomeOf(result, response_), ttfbOf(session));
+                /* from the first attempt on: a won hedge still tells how long the primary took at least */
+                if (result == CURLE_OK)
+                {
+                    learnLatency(span_, static_cast<long>((Trace::now() - start_) / 1000));
+                }
+                if (fromBackup)
+                {
+                    Metrics::hedge(Metrics::Hedge::Won);
+                }
+                if (otherRunning)
+                {
+                    std::shared_ptr<cpr::Session> loser = fromBackup ? transfer->primary : transfer->backup;
+                    EventLoop::shared().cancel(loser->GetCurlHolder()->handle);
+                }
+                handle.resume();
+            };
+
+            /* the duplicate goes through the scheduler too, a loser still waiting for a slot never starts */
+            auto sendBackup = [transfer, finish]()
+            {
+                if (transfer->done)
+                {
+                    return;
+                }
+                if (!takeHedge())
+                {
+                    Metrics::hedge(Metrics::Hedge::Capped);
+                    return;
+                }
+                Metrics::hedge(Metrics::Hedge::Sent);
+                transfer->backup = std::make_shared<cpr::Session>();
+                std::string url;
+                transfer->configure(*transfer->backup, url);
+                Scheduler::acquire(transfer->url, [transfer, finish]()
+                                   { EventLoop::shared().after(std::chrono::milliseconds(0), [transfer, finish]()
+                                                               {
+                    if (transfer->done)
+                    {
+                        Scheduler::release(transfer->url, Scheduler::Outcome::Cancelled, 0.0);
+                        return;
+                    }
+                    transfer->backupStart = Trace::now();
+                    transfer->backup->PrepareGet();
+                    transfer->backupRunning = true;
+                    EventLoop::shared().add(transfer->backup->GetCurlHolder()->handle, [finish](CURLcode result)
+                                            { finish(true, result); }); }); });
+            };
+
+            Scheduler::acquire(url_, [this, transfer, finish, sendBackup, delayMs]()
+                               { EventLoop::shared().after(std::chrono::milliseconds(0), [this, transfer, finish, sendBackup, delayMs]()
+                                                           {
+                start_ = Trace::now();
+                transfer->primary->PrepareGet();
+                transfer->primaryRunning = true;
+                EventLoop::shared().add(transfer->primary->GetCurlHolder()->handle, [finish](CURLcode result)
+                                        { finish(false, result); });
+                /* the hedge clock starts with the primary transfer, not while it waited for a slot */
+                EventLoop::shared().after(std::chrono::milliseconds(delayMs), sendBackup); }); });
+        }
+    }
+}
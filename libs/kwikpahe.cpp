@@ -1,8 +1,6 @@
 #include <kwikpahe.hpp>
 #include <utils.hpp>
-#include <cpr/cpr.h>
 #include <fmt/core.h>
-#include <fmt/color.h>
 #include <re2/re2.h>
 #include <string>
 /* DECODER LIBS */
@@ -17,14 +15,10 @@
 
 namespace AnimepaheCLI
 {
-    std::string encodedString = "XXX"; // Encoded string
-    int zp = 17;                       // Not used in decoding
-    std::string alphabetKey = "XXX";   // Alphabet key
-    int offset = 1;                    // Offset
-    int base = 5;                      // Base
-    int placeholder = 24;              // Placeholder (unused)
+    const int zp = 17;          // Not used in decoding
+    const int placeholder = 24; // Placeholder (unused)
 
-    std::string baseAlphabet = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ+/";
+    const std::string baseAlphabet = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ+/";
 
     int KwikPahe::_0xe16c(const std::string &IS, int Iy, int ms)
     {
@@ -90,182 +84,206 @@ namespace AnimepaheCLI
         return gj;
     }
 
-    std::string KwikPahe::fetch_kwik_direct(const std::string &kwikLink, const std::string &token, const std::string &kwik_session)
+    bool KwikPahe::decode_packed(const std::string &text, std::string &decoded)
     {
-        // Set up cookies
-        cpr::Header headers = cpr::Header{
-            {"referer", kwikLink},
-            {"cookie", "kwik_session=" + kwik_session},
-        };
-        // Set up form data
-        cpr::Payload data = cpr::Payload{{"_token", token}};
-
-        // Make POST request with redirects disabled
-        cpr::Response response = cpr::Post(
-            cpr::Url{kwikLink},
-            headers,
-            data,
-            cpr::Redirect(false),
-            cpr::HttpVersion{cpr::HttpVersionCode::VERSION_1_1}
+        re2::StringPiece encode_search(text);
+        std::string encoded, alphabet, offset_str, base_str;
+
+        bool found_params = RE2::FindAndConsume(
+            &encode_search,
+            R"re(\(\s*"([^",]*)"\s*,\s*\d+\s*,\s*"([^",]*)"\s*,\s*(\d+)\s*,\s*(\d+)\s*,\s*\d+[a-zA-Z]?\s*\))re",
+            &encoded, &alphabet, &offset_str, &base_str
         );
 
-        // Check if status code is 302 (redirect)
-        if (response.status_code == 302)
+        if (!found_params || encoded.empty() || alphabet.empty())
         {
-            // Extract the redirect location from the response header
-            std::string redirectLocation;
-            re2::StringPiece rawHeader(response.raw_header);
-            if (RE2::FindAndConsume(&rawHeader, R"re(ocation:\s*(https?://\S+))re", &redirectLocation))
-            {
-                return redirectLocation;
-            }
-            throw std::runtime_error(fmt::format("Redirect Location not found in response from {}", kwikLink));
+            return false;
         }
-        else
+
+        try
+        {
+            decoded = decodeJSStyle(encoded, zp, alphabet, std::stoi(offset_str), std::stoi(base_str), placeholder);
+        }
+        catch (const std::exception &)
         {
-            throw std::runtime_error(fmt::format("Redirect Location not found in response from {}", kwikLink));
+            return false;
         }
+        return true;
     }
 
-    std::string KwikPahe::fetch_kwik_dlink(const std::string &kwikLink, int retries)
+    std::string KwikPahe::parse_pahe_page(const std::string &html)
     {
-        if (retries <= 0)
-        {
-            throw std::runtime_error(fmt::format("Kwik fetch failed: exceeded retry limit : {}", kwikLink));
-        }
+        std::string cleanText = html;
+        RE2::GlobalReplace(&cleanText, R"((\r\n|\r|\n))", "");
+        cleanText = sanitize_utf8(cleanText);
 
-        cpr::Response response = cpr::Get(cpr::Url{kwikLink});
-        if (response.status_code != 200)
+        std::string kwikLink;
+
+        // First attempt: direct link extraction
+        re2::StringPiece normal_search(cleanText);
+        bool found_direct = RE2::FindAndConsume(&normal_search, R"re("(https?://kwik\.[^/\s"]+/[^/\s"]+/[^"\s]*)")re", &kwikLink);
+
+        if (!found_direct || kwikLink.empty())
         {
-            throw std::runtime_error(fmt::format("Failed to Get Kwik from {}, StatusCode: {}", kwikLink, response.status_code));
+            // Second attempt: decode and extract
+            std::string decodedString;
+            if (!decode_packed(cleanText, decodedString))
+            {
+                throw std::runtime_error("Failed to extract encoding parameters");
+            }
+
+            re2::StringPiece decoded_search(decodedString);
+            bool found_decoded = RE2::FindAndConsume(&decoded_search, R"re("(https?://kwik\.[^/\s"]+/[^/\s"]+/[^"\s]*)")re", &kwikLink);
+
+            if (!found_decoded || kwikLink.empty())
+            {
+                throw std::runtime_error("Failed to extract Kwik link from decoded content");
+            }
+
+            RE2::Replace(&kwikLink, R"re((https:\/\/kwik\.[^\/]+\/)d\/)re", "\\1f/");
         }
 
+        return kwikLink;
+    }
+
+    KwikPahe::KwikForm KwikPahe::parse_kwik_page(const std::string &html, const std::string &rawHeader)
+    {
+        KwikForm form;
+
         // Clean the response text
-        std::string cleanText = response.text;
+        std::string cleanText = html;
         RE2::GlobalReplace(&cleanText, R"((\r\n|\r|\n))", "");
-        
+
         // Extract session from headers
-        std::string kwik_session;
-        re2::StringPiece input(response.raw_header);
-        RE2::FindAndConsume(&input, R"re(kwik_session=([^;]*);)re", &kwik_session);
-
-        std::string link, token;
-        std::string directLink;
-
-        // Try to extract encoded parameters - use separate StringPiece for each attempt
-        re2::StringPiece encode_text(cleanText);
-        std::string temp_encoded, temp_alphabet, temp_offset_str, temp_base_str;
-        
-        bool found_encoded = RE2::FindAndConsume(
-            &encode_text,
-            R"re(\(\s*"([^",]*)"\s*,\s*\d+\s*,\s*"([^",]*)"\s*,\s*(\d+)\s*,\s*(\d+)\s*,\s*\d+[a-zA-Z]?\s*\))re",
-            &temp_encoded, &temp_alphabet, &temp_offset_str, &temp_base_str
-        );
+        re2::StringPiece input(rawHeader);
+        RE2::FindAndConsume(&input, R"re(kwik_session=([^;]*);)re", &form.session);
 
-        if (!found_encoded || temp_encoded.empty() || temp_alphabet.empty())
+        std::string decodedString;
+        if (!decode_packed(cleanText, decodedString))
         {
-            return fetch_kwik_dlink(kwikLink, retries - 1);
+            return {};
         }
 
-        // Update global variables only if extraction succeeded
-        encodedString = temp_encoded;
-        alphabetKey = temp_alphabet;  
-        offset = std::stoi(temp_offset_str);
-        base = std::stoi(temp_base_str);
+        // Use fresh StringPiece objects for each search
+        re2::StringPiece link_search(decodedString);
+        re2::StringPiece token_search(decodedString);
 
-        try 
-        {
-            std::string decodedString = decodeJSStyle(encodedString, zp, alphabetKey, offset, base, placeholder);
-            
-            // Use fresh StringPiece objects for each search
-            re2::StringPiece link_search(decodedString);
-            re2::StringPiece token_search(decodedString);
-            
-            bool found_link = RE2::FindAndConsume(&link_search, R"re("(https?://kwik\.[^/\s"]+/[^/\s"]+/[^"\s]*)")re", &link);
-            bool found_token = RE2::FindAndConsume(&token_search, R"re(name="_token"[^"]*"(\S*)">)re", &token);
-
-            if (!found_link || !found_token || link.empty() || token.empty())
-            {
-                return fetch_kwik_dlink(kwikLink, retries - 1);
-            }
+        bool found_link = RE2::FindAndConsume(&link_search, R"re("(https?://kwik\.[^/\s"]+/[^/\s"]+/[^"\s]*)")re", &form.action);
+        bool found_token = RE2::FindAndConsume(&token_search, R"re(name="_token"[^"]*"(\S*)">)re", &form.token);
 
-            directLink = fetch_kwik_direct(link, token, kwik_session);
-        }
-        catch (const std::exception& e)
+        if (!found_link || !found_token || form.action.empty() || form.token.empty())
         {
-            return fetch_kwik_dlink(kwikLink, retries - 1);
+            return {};
         }
-
-        return directLink;
+        return form;
     }
 
-    std::string KwikPahe::extract_kwik_link(const std::string &link)
+    bool KwikPahe::unpack_eval(const std::string &text, std::string &decoded)
     {
-        fmt::print("\n\r * Extracting Kwik Link...");
-        cpr::Response response = cpr::Get(cpr::Url{link});
-        if (response.status_code != 200)
+        /* }('payload',radix,count,'word|word|...'.split('|') */
+        std::string payload, radix_str, words_str;
+        if (!RE2::PartialMatch(text, R"re(\}\s*\(\s*'((?:[^'\\]|\\.)*)'\s*,\s*(\d+)\s*,\s*\d+\s*,\s*'((?:[^'\\]|\\.)*)'\.split\(\s*'\|'\s*\))re",
+                               &payload, &radix_str, &words_str))
         {
-            throw std::runtime_error(fmt::format("Failed to Get Kwik from {}, StatusCode: {}", link, response.status_code));
+            return false;
         }
-        
-        std::string cleanText = response.text;
-        RE2::GlobalReplace(&cleanText, R"((\r\n|\r|\n))", "");
-        cleanText = sanitize_utf8(cleanText);
-        
-        std::string kwikLink;
-        
-        // First attempt: direct link extraction
-        re2::StringPiece normal_search(cleanText);
-        bool found_direct = RE2::FindAndConsume(&normal_search, R"re("(https?://kwik\.[^/\s"]+/[^/\s"]+/[^"\s]*)")re", &kwikLink);
-        
-        if (!found_direct || kwikLink.empty())
+        RE2::GlobalReplace(&payload, R"re(\\(.))re", "\\1");
+
+        std::vector<std::string> words;
+        size_t begin = 0;
+        while (true)
         {
-            // Second attempt: decode and extract
-            re2::StringPiece encode_search(cleanText);
-            std::string temp_encoded, temp_alphabet, temp_offset_str, temp_base_str;
-            
-            bool found_params = RE2::FindAndConsume(
-                &encode_search,
-                R"re(\(\s*"([^",]*)"\s*,\s*\d+\s*,\s*"([^",]*)"\s*,\s*(\d+)\s*,\s*(\d+)\s*,\s*\d+[a-zA-Z]?\s*\))re",
-                &temp_encoded, &temp_alphabet, &temp_offset_str, &temp_base_str
-            );
-
-            if (!found_params)
+            size_t end = words_str.find('|', begin);
+            words.push_back(words_str.substr(begin, end == std::string::npos ? std::string::npos : end - begin));
+            if (end == std::string::npos)
             {
-                throw std::runtime_error(fmt::format("Failed to extract encoding parameters from {}", link));
+                break;
             }
+            begin = end + 1;
+        }
 
-            try 
+        /* every word of the payload is an index into words, written in base radix (0-9, a-z, A-Z) */
+        int radix = std::stoi(radix_str);
+        auto digit = [](char c)
+        {
+            if (c >= '0' && c <= '9')
+                return c - '0';
+            if (c >= 'a' && c <= 'z')
+                return c - 'a' + 10;
+            if (c >= 'A' && c <= 'Z')
+                return c - 'A' + 36;
+            return 99;
+        };
+
+        decoded.clear();
+        decoded.reserve(payload.size() * 2);
+        size_t i = 0;
+        while (i < payload.size())
+        {
+            unsigned char c = static_cast<unsigned char>(payload[i]);
+            if (!std::isalnum(c) && c != '_')
             {
-                int temp_offset = std::stoi(temp_offset_str);
-                int temp_base = std::stoi(temp_base_str);
-                
-                std::string decodedString = decodeJSStyle(temp_encoded, zp, temp_alphabet, temp_offset, temp_base, placeholder);
-                re2::StringPiece decoded_search(decodedString);
-                
-                bool found_decoded = RE2::FindAndConsume(&decoded_search, R"re("(https?://kwik\.[^/\s"]+/[^/\s"]+/[^"\s]*)")re", &kwikLink);
-                
-                if (!found_decoded || kwikLink.empty())
-                {
-                    throw std::runtime_error(fmt::format("Failed to extract Kwik link from decoded content"));
-                }
-                
-                RE2::Replace(&kwikLink, R"re((https:\/\/kwik\.[^\/]+\/)d\/)re", "\\1f/");
+                decoded += payload[i++];
+                continue;
+            }
+            size_t start = i;
+            while (i < payload.size() && (std::isalnum(static_cast<unsigned char>(payload[i])) || payload[i] == '_'))
+            {
+                ++i;
             }
-            catch (const std::exception& e)
+            std::string word = payload.substr(start, i - start);
+            size_t index = 0;
+            bool valid = true;
+            for (char ch : word)
             {
-                throw std::runtime_error(fmt::format("Failed to decode and extract Kwik link: {}", e.what()));
+                int value = digit(ch);
+                if (value >= radix || index > words.size())
+                {
+                    valid = false;
+                    break;
+                }
+                index = index * radix + value;
             }
+            decoded += valid && index < words.size() && !words[index].empty() ? words[index] : word;
+        }
+        return true;
+    }
+
+    KwikPahe::KwikStream KwikPahe::parse_embed_page(const std::string &html)
+    {
+        std::string cleanText = html;
+        RE2::GlobalReplace(&cleanText, R"((\r\n|\r|\n))", "");
+
+        KwikStream stream;
+        if (RE2::PartialMatch(cleanText, R"re(<title>\s*([^<]*?)\s*</title>)re", &stream.title))
+        {
+            stream.title = unescape_html_entities(sanitize_utf8(stream.title));
         }
 
-        fmt::print("\r * Extracting Kwik Link :");
-        fmt::print(fmt::fg(fmt::color::lime_green), " OK!\n");
-        fmt::print(" * Fetching Kwik Direct Link...");
-        
-        std::string directLink = fetch_kwik_dlink(kwikLink);
-        
-        fmt::print("\r * Fetching Kwik Direct Link :");
-        fmt::print(fmt::fg(fmt::color::lime_green), " OK!\n");
-        return directLink;
+        /* the player script is packed, older pages carry the source in the clear */
+        static const char *SOURCE = R"re(['"](https?://[^'"\s]+\.m3u8[^'"\s]*)['"])re";
+        if (RE2::PartialMatch(cleanText, SOURCE, &stream.source))
+        {
+            return stream;
+        }
+        std::string decodedString;
+        if (!unpack_eval(cleanText, decodedString))
+        {
+            throw std::runtime_error("Failed to unpack the kwik player script");
+        }
+        if (!RE2::PartialMatch(decodedString, SOURCE, &stream.source))
+        {
+            throw std::runtime_error("Failed to extract the stream source from the kwik player");
+        }
+        return stream;
+    }
+
+    std::string KwikPahe::parse_redirect_location(const std::string &rawHeader)
+    {
+        // Extract the redirect location from the response header
+        std::string redirectLocation;
+        re2::StringPiece header(rawHeader);
+        RE2::FindAndConsume(&header, R"re(ocation:\s*(https?://\S+))re", &redirectLocation);
+        return redirectLocation;
     }
 }
@@ -0,0 +1,126 @@
+#include <linkexport.hpp>
+#include <hls.hpp>
+#include <utils.hpp>
+#include <fmt/core.h>
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <stdexcept>
+
+namespace AnimepaheCLI
+{
+    namespace
+    {
+        /* aria2c segments per episode, kwik serves ranges from a single host */
+        constexpr int ARIA2_SPLIT = 4;
+
+        bool endsWith(const std::string &text, const std::string &suffix)
+        {
+            return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+        }
+    }
+
+    LinkExport::LinkExport(const std::string &path, const std::string &format, const std::string &seriesDir)
+        : format_(format), dir_(seriesDir)
+    {
+        if (!isFormat(format_))
+        {
+            throw std::runtime_error(fmt::format("{} is not valid for --export-format [txt|aria2|jsonl|m3u]", format_));
+        }
+        file_.open(path, std::ios::binary | std::ios::trunc);
+        if (!file_.is_open())
+        {
+            throw std::runtime_error(fmt::format("Cannot create export file {}", path));
+        }
+        if (format_ == "m3u")
+        {
+            file_ << "#EXTM3U\n";
+            file_.flush();
+        }
+    }
+
+    std::string LinkExport::formatFor(const std::string &path)
+    {
+        std::string lower = path;
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        if (endsWith(lower, ".aria2"))
+            return "aria2";
+        if (endsWith(lower, ".jsonl") || endsWith(lower, ".json"))
+            return "jsonl";
+        if (endsWith(lower, ".m3u") || endsWith(lower, ".m3u8"))
+            return "m3u";
+        return "txt";
+    }
+
+    bool LinkExport::isFormat(const std::string &format)
+    {
+        return format == "txt" || format == "aria2" || format == "jsonl" || format == "m3u";
+    }
+
+    void LinkExport::add(const Episode &episode, const Variant &variant, const std::string &url)
+    {
+        /* a player playlist has no single file to fetch, only players and the built-in downloader take it */
+        bool playlist = Hls::isLink(url);
+        Hls::Link stream = playlist ? Hls::parseLink(url) : Hls::Link{};
+
+        /* same name the built-in downloader would save the episode under, the .ts of a playlist */
+        std::string file = playlist ? stream.file : fileParameter(url);
+        std::replace(file.begin(), file.end(), '/', '_');
+        std::replace(file.begin(), file.end(), '\\', '_');
+        if (file.empty())
+        {
+            file = fmt::format("{} - EP{}.{}", dir_, padIntWithZero(episode.number), playlist ? "ts" : "mp4");
+        }
+
+        if (format_ == "aria2" && playlist)
+        {
+            file_ << "# HLS playlist, not downloadable by aria2: " << stream.url << "\n";
+        }
+        else if (format_ == "aria2")
+        {
+            /* kwik publishes no digest, so there is no checksum= to hand over */
+            file_ << url << "\n"
+                  << "  out=" << file << "\n"
+                  << "  dir=" << dir_ << "/videos\n"
+                  << "  split=" << ARIA2_SPLIT << "\n"
+                  << "  max-connection-per-server=" << ARIA2_SPLIT << "\n"
+                  << "  continue=true\n";
+        }
+        else if (format_ == "jsonl")
+        {
+            nlohmann::json entry = {
+                {"episode", episode.number},
+                {"file", file},
+                {"dir", dir_},
+                {"quality", variant.resolution},
+                {"variant", variant.name},
+                {"url", playlist ? stream.url : url}};
+            if (playlist)
+            {
+                entry["hls"] = true;
+                entry["referer"] = stream.referer;
+            }
+            file_ << entry.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace) << "\n";
+        }
+        else if (format_ == "m3u")
+        {
+            if (playlist)
+            {
+                file_ << "#EXTINF:-1," << file << "\n"
+                      << "#EXTVLCOPT:http-referrer=" << stream.referer << "\n";
+            }
+            else
+            {
+                file_ << "#EXTINF:-1," << dir_ << " - EP" << padIntWithZero(episode.number) << "\n";
+            }
+            file_ << (playlist ? stream.url : url) << "\n";
+        }
+        else
+        {
+            /* the playlist itself, the internal link only means something to this program */
+            file_ << (playlist ? stream.url : url) << "\n";
+        }
+        /* a consumer tailing the file sees every entry as soon as it resolved */
+        file_.flush();
+        count_++;
+    }
+}
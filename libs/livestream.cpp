@@ -0,0 +1,441 @@
+#include <livestream.hpp>
+#include <fmt/core.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <csignal>
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+namespace AnimepaheCLI
+{
+    namespace
+    {
+        /* bytes read back from the file per send */
+        constexpr size_t SERVE_CHUNK = 256 * 1024;
+
+        /* stdout mode, bytes of an episode without a file that may wait for a slow player before the download is held back */
+        constexpr size_t PIPE_QUEUE_LIMIT = 64 * 1024 * 1024;
+
+#ifdef _WIN32
+        int duplicate(int fd) { return _dup(fd); }
+        int redirect(int from, int to) { return _dup2(from, to); }
+        long long writeSome(int fd, const char *data, size_t size) { return _write(fd, data, static_cast<unsigned>(size)); }
+        void closeFd(int fd) { _close(fd); }
+        int descriptor(FILE *stream) { return _fileno(stream); }
+#else
+        int duplicate(int fd) { return dup(fd); }
+        int redirect(int from, int to) { return dup2(from, to); }
+        long long writeSome(int fd, const char *data, size_t size) { return ::write(fd, data, size); }
+        void closeFd(int fd) { ::close(fd); }
+        int descriptor(FILE *stream) { return fileno(stream); }
+#endif
+
+        std::string contentType(const std::string &name)
+        {
+            auto endsWith = [&name](const std::string &suffix)
+            {
+                return name.size() >= suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+            };
+            if (endsWith(".mkv"))
+                return "video/x-matroska";
+            if (endsWith(".webm"))
+                return "video/webm";
+            if (endsWith(".ts"))
+                return "video/mp2t";
+            return "video/mp4";
+        }
+
+        /* "bytes=a-b", "bytes=a-" or "bytes=-n" against total, false when it does not apply */
+        bool parseRange(const std::string &header, uint64_t total, uint64_t &first, uint64_t &last)
+        {
+            unsigned long long a = 0, b = 0;
+            if (header.rfind("bytes=", 0) != 0 || total == 0)
+            {
+                return false;
+            }
+            if (std::sscanf(header.c_str(), "bytes=-%llu", &b) == 1)
+            {
+                first = total - std::min<uint64_t>(b, total);
+                last = total - 1;
+                return b > 0;
+            }
+            int matched = std::sscanf(header.c_str(), "bytes=%llu-%llu", &a, &b);
+            if (matched < 1)
+            {
+                return false;
+            }
+            first = a;
+            last = matched == 2 ? std::min<uint64_t>(b, total - 1) : total - 1;
+            return true;
+        }
+    }
+
+    LiveStream::LiveStream(const std::string &mode)
+    {
+        if (mode == "stdout" || mode == "-")
+        {
+            /* keep the real stdout for the video, everything printed from here on goes to stderr */
+            fflush(stdout);
+            pipe_ = duplicate(descriptor(stdout));
+            if (pipe_ < 0 || redirect(descriptor(stderr), descriptor(stdout)) < 0)
+            {
+                throw std::runtime_error("Cannot redirect stdout for --stream stdout");
+            }
+#ifdef _WIN32
+            _setmode(pipe_, _O_BINARY);
+#endif
+            toStdout_ = true;
+            writer_ = std::thread(&LiveStream::pipeEpisodes, state_, pipe_);
+            return;
+        }
+
+        int port = 0;
+        if (mode != "http" && std::sscanf(mode.c_str(), "http:%d", &port) != 1)
+        {
+            throw std::runtime_error(fmt::format("{} is not valid for --stream [http|http:port|stdout]", mode));
+        }
+        if (port < 0 || port > 65535)
+        {
+            throw std::runtime_error(fmt::format("{} is not a valid port for --stream", port));
+        }
+        std::shared_ptr<State> state = state_;
+        server_.start("127.0.0.1", static_cast<uint16_t>(port), [state](const LocalServer::Request &request, LocalServer::Connection &connection)
+                      { serve(state, request, connection); });
+    }
+
+    LiveStream::~LiveStream()
+    {
+        {
+            std::lock_guard<std::mutex> lock(state_->mutex);
+            state_->stopping = true;
+        }
+        state_->changed.notify_all();
+        server_.stop();
+        if (writer_.joinable())
+        {
+            writer_.join();
+        }
+        if (pipe_ >= 0)
+        {
+            closeFd(pipe_);
+        }
+    }
+
+    std::string LiveStream::url() const
+    {
+        return toStdout_ ? "" : fmt::format("http://127.0.0.1:{}/", server_.port());
+    }
+
+    void LiveStream::begin(const std::string &name, const std::string &path, uint64_t expected)
+    {
+        auto episode = std::make_shared<Episode>();
+        episode->name = name;
+        episode->path = path;
+        episode->total = expected;
+        {
+            std::lock_guard<std::mutex> lock(state_->mutex);
+            if (toStdout_ && !state_->pipeClosed)
+            {
+                state_->piped.push_back(episode);
+            }
+            state_->current = std::move(episode);
+        }
+        state_->changed.notify_all();
+    }
+
+    void LiveStream::setTotal(uint64_t total)
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        if (state_->current && state_->current->total != total)
+        {
+            state_->current->total = total;
+            state_->changed.notify_all();
+        }
+    }
+
+    void LiveStream::append(const char *data, size_t size)
+    {
+        std::unique_lock<std::mutex> lock(state_->mutex);
+        std::shared_ptr<Episode> episode = state_->current;
+        if (!episode)
+        {
+            return;
+        }
+        if (toStdout_)
+        {
+            if (state_->pipeClosed)
+            {
+                return;
+            }
+            /* opened with the first flushed chunk, so the writer can still read it after --rm-source packed it away */
+            if (!episode->source && !episode->memory && !episode->path.empty())
+            {
+                auto source = std::make_shared<std::ifstream>(episode->path, std::ios::binary);
+                if (source->is_open())
+                {
+                    episode->source = std::move(source);
+                }
+            }
+            if (!episode->source)
+            {
+                /* nothing to read back, the bytes wait in memory and a full queue holds this download back */
+                episode->memory = true;
+                state_->changed.wait(lock, [this, &episode]()
+                                     { return state_->stopping || state_->pipeClosed || episode->queued < PIPE_QUEUE_LIMIT; });
+                if (state_->stopping || state_->pipeClosed)
+                {
+                    return;
+                }
+                episode->chunks.emplace_back(data, size);
+                episode->queued += size;
+            }
+        }
+        episode->available += size;
+        lock.unlock();
+        state_->changed.notify_all();
+    }
+
+    void LiveStream::end(bool ok)
+    {
+        {
+            std::lock_guard<std::mutex> lock(state_->mutex);
+            if (state_->current)
+            {
+                state_->current->finished = true;
+                state_->current->failed = !ok;
+            }
+        }
+        state_->changed.notify_all();
+    }
+
+    void LiveStream::finish()
+    {
+        /* the player gets the rest of the last episode before the run ends */
+        std::unique_lock<std::mutex> lock(state_->mutex);
+        state_->changed.wait(lock, [this]()
+                             { return state_->readers == 0 && (state_->piped.empty() || state_->pipeClosed); });
+    }
+
+    void LiveStream::pipeEpisodes(const std::shared_ptr<State> &state, int pipe)
+    {
+#ifndef _WIN32
+        /* a player that quit makes write() fail with EPIPE instead of killing the process */
+        sigset_t pipeSignal;
+        sigemptyset(&pipeSignal);
+        sigaddset(&pipeSignal, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &pipeSignal, nullptr);
+#endif
+        auto writeAll = [pipe](const char *data, size_t size)
+        {
+            while (size > 0)
+            {
+                long long written = writeSome(pipe, data, std::min<size_t>(size, 1 << 20));
+                if (written <= 0)
+                {
+                    return false;
+                }
+                data += written;
+                size -= static_cast<size_t>(written);
+            }
+            return true;
+        };
+
+        std::vector<char> buffer(SERVE_CHUNK);
+        while (true)
+        {
+            std::shared_ptr<Episode> episode;
+            {
+                std::unique_lock<std::mutex> lock(state->mutex);
+                state->changed.wait(lock, [&state]()
+                                    { return state->stopping || !state->piped.empty(); });
+                if (state->stopping)
+                {
+                    return;
+                }
+                episode = state->piped.front();
+            }
+
+            uint64_t offset = 0;
+            bool ok = true;
+            while (ok)
+            {
+                std::string chunk;
+                size_t length = 0;
+                {
+                    std::unique_lock<std::mutex> lock(state->mutex);
+                    state->changed.wait(lock, [&]()
+                                        { return state->stopping || episode->available > offset || episode->finished; });
+                    if (state->stopping)
+                    {
+                        return;
+                    }
+                    if (episode->available <= offset)
+                    {
+                        break;
+                    }
+                    if (episode->memory)
+                    {
+                        chunk = std::move(episode->chunks.front());
+                        episode->chunks.pop_front();
+                        episode->queued -= chunk.size();
+                    }
+                    else
+                    {
+                        length = static_cast<size_t>(std::min<uint64_t>(episode->available - offset, buffer.size()));
+                    }
+                }
+                state->changed.notify_all();
+
+                if (!chunk.empty())
+                {
+                    ok = writeAll(chunk.data(), chunk.size());
+                    offset += chunk.size();
+                    continue;
+                }
+                /* the downloader flushes before it reports bytes, so everything below available is on disk */
+                std::ifstream &source = *episode->source;
+                source.clear();
+                source.seekg(static_cast<std::streamoff>(offset));
+                source.read(buffer.data(), static_cast<std::streamsize>(length));
+                std::streamsize got = source.gcount();
+                ok = got > 0 && writeAll(buffer.data(), static_cast<size_t>(got));
+                offset += static_cast<uint64_t>(std::max<std::streamsize>(got, 0));
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (ok)
+                {
+                    state->piped.pop_front();
+                }
+                else
+                {
+                    /* the player is gone, nothing more is queued for it */
+                    state->pipeClosed = true;
+                    state->piped.clear();
+                }
+            }
+            state->changed.notify_all();
+            if (!ok)
+            {
+                return;
+            }
+        }
+    }
+
+    void LiveStream::serve(const std::shared_ptr<State> &state, const LocalServer::Request &request, LocalServer::Connection &connection)
+    {
+        if (request.path != "/" && request.path != "/current")
+        {
+            connection.respond(404, "Not Found");
+            return;
+        }
+
+        /* counted while it sends, finish() waits for the player instead of cutting it off */
+        struct Reader
+        {
+            std::shared_ptr<State> state;
+            ~Reader()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    state->readers--;
+                }
+                state->changed.notify_all();
+            }
+        };
+
+        /* a player may connect before the first episode starts or its length is known */
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->changed.wait(lock, [&state]()
+                            { return state->stopping || (state->current && (state->current->total > 0 || state->current->finished)); });
+        if (state->stopping)
+        {
+            lock.unlock();
+            connection.respond(503, "Service Unavailable");
+            return;
+        }
+        /* the request stays on this episode even when the next one begins */
+        std::shared_ptr<Episode> episode = state->current;
+        uint64_t total = episode->total;
+        state->readers++;
+        lock.unlock();
+        Reader reader{state};
+
+        if (episode->path.empty() || episode->failed)
+        {
+            connection.respond(503, "Service Unavailable");
+            return;
+        }
+
+        uint64_t first = 0, last = total > 0 ? total - 1 : UINT64_MAX;
+        int status = 200;
+        std::string range = request.header("range");
+        if (!range.empty() && total > 0)
+        {
+            if (!parseRange(range, total, first, last) || first >= total || first > last)
+            {
+                connection.respond(416, "", {{"Content-Range", fmt::format("bytes */{}", total)}});
+                return;
+            }
+            status = 206;
+        }
+
+        std::map<std::string, std::string> headers = {
+            {"Content-Type", contentType(episode->name)},
+            {"Accept-Ranges", total > 0 ? "bytes" : "none"},
+            {"Cache-Control", "no-store"}};
+        if (total > 0)
+        {
+            headers["Content-Length"] = std::to_string(last - first + 1);
+        }
+        if (status == 206)
+        {
+            headers["Content-Range"] = fmt::format("bytes {}-{}/{}", first, last, total);
+        }
+        if (!connection.sendHead(status, headers) || request.method == "HEAD")
+        {
+            return;
+        }
+
+        std::ifstream file(episode->path, std::ios::binary);
+        std::vector<char> chunk(SERVE_CHUNK);
+        uint64_t offset = first;
+        while (offset <= last)
+        {
+            uint64_t available = 0;
+            {
+                std::unique_lock<std::mutex> wait(state->mutex);
+                state->changed.wait(wait, [&]()
+                                    { return state->stopping || episode->available > offset || episode->finished; });
+                if (state->stopping || episode->failed || episode->available <= offset)
+                {
+                    return;
+                }
+                available = episode->available;
+            }
+
+            /* the writer flushes before it reports bytes, so everything below available is on disk */
+            uint64_t wanted = last == UINT64_MAX ? UINT64_MAX : last - offset + 1;
+            size_t length = static_cast<size_t>(std::min<uint64_t>({available - offset, wanted, chunk.size()}));
+            file.clear();
+            file.seekg(static_cast<std::streamoff>(offset));
+            file.read(chunk.data(), static_cast<std::streamsize>(length));
+            if (file.gcount() <= 0 || !connection.send(chunk.data(), static_cast<size_t>(file.gcount())))
+            {
+                return;
+            }
+            offset += static_cast<uint64_t>(file.gcount());
+        }
+    }
+}
@@ -0,0 +1,309 @@
+#include <localserver.hpp>
+#include <fmt/core.h>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+using socket_t = SOCKET;
+#define CLOSE_SOCKET closesocket
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+using socket_t = int;
+#define CLOSE_SOCKET close
+#endif
+
+namespace AnimepaheCLI
+{
+    namespace
+    {
+        /* upper bound for request line + headers */
+        constexpr size_t MAX_HEAD_SIZE = 64 * 1024;
+
+        std::string toLower(std::string text)
+        {
+            std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return std::tolower(c); });
+            return text;
+        }
+
+        std::string trim(const std::string &text)
+        {
+            size_t start = text.find_first_not_of(" \t");
+            size_t end = text.find_last_not_of(" \t\r");
+            return start == std::string::npos ? "" : text.substr(start, end - start + 1);
+        }
+    }
+
+    std::string LocalServer::Request::header(const std::string &name, const std::string &fallback) const
+    {
+        auto it = headers.find(toLower(name));
+        return it == headers.end() ? fallback : it->second;
+    }
+
+    const char *LocalServer::statusText(int status)
+    {
+        switch (status)
+        {
+        case 200: return "OK";
+        case 206: return "Partial Content";
+        case 302: return "Found";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 416: return "Range Not Satisfiable";
+        case 429: return "Too Many Requests";
+        case 500: return "Internal Server Error";
+        case 503: return "Service Unavailable";
+        default: return "Unknown";
+        }
+    }
+
+    bool LocalServer::Connection::sendHead(int status, const std::map<std::string, std::string> &headers)
+    {
+        std::string head = fmt::format("HTTP/1.1 {} {}\r\n", status, statusText(status));
+        bool hasLength = false;
+        for (const auto &[name, value] : headers)
+        {
+            head += fmt::format("{}: {}\r\n", name, value);
+            hasLength = hasLength || toLower(name) == "content-length";
+        }
+        /* without a length the body ends when the connection closes */
+        if (!hasLength)
+        {
+            keepAlive_ = false;
+            head += "Connection: close\r\n";
+        }
+        head += "\r\n";
+        return send(head);
+    }
+
+    bool LocalServer::Connection::send(const char *data, size_t size)
+    {
+        while (size > 0)
+        {
+#ifdef _WIN32
+            int sent = ::send(static_cast<socket_t>(socket_), data, static_cast<int>(std::min<size_t>(size, 1 << 30)), 0);
+#else
+            ssize_t sent = ::send(static_cast<socket_t>(socket_), data, size, MSG_NOSIGNAL);
+#endif
+            if (sent <= 0)
+            {
+                keepAlive_ = false;
+                return false;
+            }
+            data += sent;
+            size -= static_cast<size_t>(sent);
+        }
+        return true;
+    }
+
+    bool LocalServer::Connection::respond(int status, const std::string &body, const std::map<std::string, std::string> &headers)
+    {
+        std::map<std::string, std::string> all = headers;
+        all["Content-Length"] = std::to_string(body.size());
+        if (all.find("Content-Type") == all.end())
+        {
+            all["Content-Type"] = "text/html; charset=UTF-8";
+        }
+        return sendHead(status, all) && send(body);
+    }
+
+    LocalServer::~LocalServer()
+    {
+        stop();
+    }
+
+    void LocalServer::start(const std::string &host, uint16_t port, Handler handler)
+    {
+#ifdef _WIN32
+        WSADATA wsa;
+        WSAStartup(MAKEWORD(2, 2), &wsa);
+#endif
+        handler_ = std::move(handler);
+
+        socket_t listener = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (listener == static_cast<socket_t>(-1))
+        {
+            throw std::runtime_error("Failed to create server socket");
+        }
+
+        int reuse = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&reuse), sizeof(reuse));
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1)
+        {
+            CLOSE_SOCKET(listener);
+            throw std::runtime_error(fmt::format("Invalid listen address: {}", host));
+        }
+
+        if (::bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || ::listen(listener, 512) != 0)
+        {
+            CLOSE_SOCKET(listener);
+            throw std::runtime_error(fmt::format("Failed to listen on {}:{}", host, port));
+        }
+
+        socklen_t length = sizeof(address);
+        getsockname(listener, reinterpret_cast<sockaddr *>(&address), &length);
+        port_ = ntohs(address.sin_port);
+        listener_ = static_cast<intptr_t>(listener);
+
+        running_ = true;
+        acceptThread_ = std::thread(&LocalServer::acceptLoop, this);
+    }
+
+    void LocalServer::stop()
+    {
+        if (!running_.exchange(false))
+        {
+            return;
+        }
+#ifdef _WIN32
+        CLOSE_SOCKET(static_cast<socket_t>(listener_));
+#else
+        ::shutdown(static_cast<socket_t>(listener_), SHUT_RDWR);
+        CLOSE_SOCKET(static_cast<socket_t>(listener_));
+#endif
+        if (acceptThread_.joinable())
+        {
+            acceptThread_.join();
+        }
+        /* connection threads are detached, give them a moment to notice */
+        for (int i = 0; i < 100 && activeConnections_ > 0; ++i)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+
+    void LocalServer::acceptLoop()
+    {
+        while (running_)
+        {
+            socket_t client = ::accept(static_cast<socket_t>(listener_), nullptr, nullptr);
+            if (client == static_cast<socket_t>(-1))
+            {
+                if (!running_)
+                {
+                    break;
+                }
+                continue;
+            }
+            int nodelay = 1;
+            setsockopt(client, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char *>(&nodelay), sizeof(nodelay));
+
+            activeConnections_++;
+            std::thread([this, client]() {
+                serveConnection(static_cast<intptr_t>(client));
+                CLOSE_SOCKET(client);
+                activeConnections_--;
+            }).detach();
+        }
+    }
+
+    void LocalServer::serveConnection(intptr_t client)
+    {
+        std::string buffer;
+        char chunk[16 * 1024];
+
+        while (running_)
+        {
+            /* read until the end of the header block */
+            size_t headEnd;
+            while ((headEnd = buffer.find("\r\n\r\n")) == std::string::npos)
+            {
+                if (buffer.size() > MAX_HEAD_SIZE)
+                {
+                    return;
+                }
+                auto received = ::recv(static_cast<socket_t>(client), chunk, sizeof(chunk), 0);
+                if (received <= 0)
+                {
+                    return;
+                }
+                buffer.append(chunk, static_cast<size_t>(received));
+            }
+
+            Request request;
+            std::string head = buffer.substr(0, headEnd);
+            buffer.erase(0, headEnd + 4);
+
+            size_t lineEnd = head.find("\r\n");
+            std::string requestLine = head.substr(0, lineEnd);
+            size_t firstSpace = requestLine.find(' ');
+            size_t secondSpace = requestLine.find(' ', firstSpace + 1);
+            if (firstSpace == std::string::npos || secondSpace == std::string::npos)
+            {
+                return;
+            }
+            request.method = requestLine.substr(0, firstSpace);
+            request.target = requestLine.substr(firstSpace + 1, secondSpace - firstSpace - 1);
+            size_t queryStart = request.target.find('?');
+            request.path = request.target.substr(0, queryStart);
+            request.query = queryStart == std::string::npos ? "" : request.target.substr(queryStart + 1);
+
+            size_t pos = lineEnd == std::string::npos ? head.size() : lineEnd + 2;
+            while (pos < head.size())
+            {
+                size_t next = head.find("\r\n", pos);
+                std::string line = head.substr(pos, next == std::string::npos ? std::string::npos : next - pos);
+                size_t colon = line.find(':');
+                if (colon != std::string::npos)
+                {
+                    request.headers[toLower(trim(line.substr(0, colon)))] = trim(line.substr(colon + 1));
+                }
+                if (next == std::string::npos)
+                {
+                    break;
+                }
+                pos = next + 2;
+            }
+
+            size_t contentLength = 0;
+            try
+            {
+                contentLength = std::stoul(request.header("content-length", "0"));
+            }
+            catch (const std::exception &)
+            {
+                return;
+            }
+            while (buffer.size() < contentLength)
+            {
+                auto received = ::recv(static_cast<socket_t>(client), chunk, sizeof(chunk), 0);
+                if (received <= 0)
+                {
+                    return;
+                }
+                buffer.append(chunk, static_cast<size_t>(received));
+            }
+            request.body = buffer.substr(0, contentLength);
+            buffer.erase(0, contentLength);
+
+            Connection connection(client);
+            try
+            {
+                handler_(request, connection);
+            }
+            catch (const std::exception &e)
+            {
+                connection.respond(500, e.what());
+            }
+
+            if (!connection.keepAlive() || toLower(request.header("connection")) == "close")
+            {
+                return;
+            }
+        }
+    }
+}
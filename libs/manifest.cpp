@@ -0,0 +1,185 @@
+#include <manifest.hpp>
+#include <utils.hpp>
+#include <nlohmann/json.hpp>
+#include <re2/re2.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+using json = nlohmann::json;
+
+namespace AnimepaheCLI
+{
+    namespace
+    {
+        const char *MANIFEST_NAME = ".manifest.json";
+
+        bool qualityMatches(int resolution, int targetRes)
+        {
+            return targetRes <= 0 || resolution == 0 || resolution == targetRes;
+        }
+    }
+
+    Manifest::Manifest(const std::string &seriesDir) : dir_(seriesDir)
+    {
+        std::ifstream file(std::filesystem::path(dir_) / MANIFEST_NAME);
+        json state = file ? json::parse(file, nullptr, false) : json();
+        if (state.is_object())
+        {
+            if (state.contains("downloading") && state["downloading"].is_string())
+            {
+                downloading_ = state["downloading"].get<std::string>();
+            }
+            /* an entry that is not an object or has a field of the wrong type is skipped, as if it was never recorded */
+            const json &episodes = state.contains("episodes") && state["episodes"].is_array() ? state["episodes"] : json::array();
+            for (const auto &episode : episodes)
+            {
+                if (!episode.is_object())
+                {
+                    continue;
+                }
+                Entry entry;
+                try
+                {
+                    entry = Entry{episode.value("session", ""), episode.value("number", 0), episode.value("file", ""),
+                                  episode.value("bytes", uint64_t{0}), episode.value("resolution", 0)};
+                }
+                catch (const json::exception &)
+                {
+                    continue;
+                }
+                if (!entry.session.empty() && !entry.file.empty())
+                {
+                    entries_[entry.session] = std::move(entry);
+                }
+            }
+        }
+
+        /* files the manifest does not know, named like AnimePahe_<title>_-_12_1080p_<group>.mp4 */
+        std::error_code ec;
+        for (const auto &item : std::filesystem::directory_iterator(std::filesystem::path(dir_) / "videos", ec))
+        {
+            std::string name = item.path().filename().string();
+            bool known = name == downloading_ || std::any_of(entries_.begin(), entries_.end(), [&name](const auto &entry)
+                                                             { return entry.second.file == name; });
+            int number = 0, resolution = 0;
+            std::string quality;
+            if (known || !item.is_regular_file(ec) || !RE2::PartialMatch(name, R"(_-_0*(\d+)(?:_(\d{3,4})p)?[_.])", &number, &quality))
+            {
+                continue;
+            }
+            resolution = quality.empty() ? 0 : std::stoi(quality);
+            named_.push_back(Entry{"", number, name, static_cast<uint64_t>(item.file_size(ec)), resolution});
+        }
+    }
+
+    std::string Manifest::sessionOf(const std::string &episodeLink)
+    {
+        size_t slash = episodeLink.find_last_of('/');
+        return slash == std::string::npos ? episodeLink : episodeLink.substr(slash + 1);
+    }
+
+    bool Manifest::isManifestFile(const std::string &fileName)
+    {
+        return fileName == MANIFEST_NAME || fileName == std::string(MANIFEST_NAME) + ".tmp";
+    }
+
+    std::string Manifest::pathOf(const Entry &entry) const
+    {
+        return (std::filesystem::path(dir_) / "videos" / entry.file).string();
+    }
+
+    std::vector<int> Manifest::present(int targetRes) const
+    {
+        std::vector<int> numbers;
+        for (const auto &[session, entry] : entries_)
+        {
+            if (qualityMatches(entry.resolution, targetRes))
+            {
+                numbers.push_back(entry.number);
+            }
+        }
+        for (const auto &entry : named_)
+        {
+            if (entry.bytes > 0 && qualityMatches(entry.resolution, targetRes))
+            {
+                numbers.push_back(entry.number);
+            }
+        }
+        std::sort(numbers.begin(), numbers.end());
+        numbers.erase(std::unique(numbers.begin(), numbers.end()), numbers.end());
+        return numbers;
+    }
+
+    std::optional<Manifest::Entry> Manifest::find(const std::string &episodeLink, int targetRes) const
+    {
+        auto known = entries_.find(sessionOf(episodeLink));
+        if (known == entries_.end())
+        {
+            return std::nullopt;
+        }
+
+        /* a file that changed size since it was recorded is downloaded again */
+        std::error_code ec;
+        const Entry &entry = known->second;
+        uint64_t bytes = std::filesystem::file_size(pathOf(entry), ec);
+        if (ec || bytes != entry.bytes || !qualityMatches(entry.resolution, targetRes))
+        {
+            return std::nullopt;
+        }
+        return entry;
+    }
+
+    std::optional<Manifest::Entry> Manifest::findNamed(int number, int targetRes) const
+    {
+        for (const auto &candidate : named_)
+        {
+            if (candidate.number == number && candidate.bytes > 0 && qualityMatches(candidate.resolution, targetRes))
+            {
+                return candidate;
+            }
+        }
+        return std::nullopt;
+    }
+
+    void Manifest::adopt(const std::string &episodeLink, const Entry &entry)
+    {
+        named_.erase(std::remove_if(named_.begin(), named_.end(), [&entry](const Entry &candidate)
+                                    { return candidate.file == entry.file; }),
+                     named_.end());
+        Entry adopted = entry;
+        adopted.session = sessionOf(episodeLink);
+        record(adopted);
+    }
+
+    void Manifest::start(const std::string &file)
+    {
+        downloading_ = file;
+        save();
+    }
+
+    void Manifest::record(const Entry &entry)
+    {
+        entries_[entry.session] = entry;
+        if (downloading_ == entry.file)
+        {
+            downloading_.clear();
+        }
+        save();
+    }
+
+    void Manifest::save() const
+    {
+        json state = {{"version", 1}, {"downloading", downloading_}, {"episodes", json::array()}};
+        for (const auto &[session, entry] : entries_)
+        {
+            state["episodes"].push_back({{"session", session},
+                                         {"number", entry.number},
+                                         {"file", entry.file},
+                                         {"bytes", entry.bytes},
+                                         {"resolution", entry.resolution}});
+        }
+
+        writeFileAtomically((std::filesystem::path(dir_) / MANIFEST_NAME).string(), state.dump(-1, ' ', false, json::error_handler_t::replace));
+    }
+}
@@ -0,0 +1,277 @@
+#include <metrics.hpp>
+#include <events.hpp>
+#include <trace.hpp>
+#include <fmt/core.h>
+#include <fmt/color.h>
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace AnimepaheCLI
+{
+    namespace Metrics
+    {
+        namespace
+        {
+            constexpr size_t PHASE_COUNT = 6;
+
+            /* latency buckets in seconds, shared by every phase (downloads and zips need the long tail) */
+            constexpr std::array<double, 13> BUCKETS = {0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60, 300, 900, 3600};
+
+            struct PhaseStats
+            {
+                size_t ok = 0;
+                size_t failed = 0;
+                size_t retries = 0;
+                size_t bytes = 0;
+                double seconds = 0.0;
+                std::array<size_t, BUCKETS.size()> buckets{};
+                std::vector<double> samples;
+            };
+
+            std::mutex statsMutex;
+            std::array<PhaseStats, PHASE_COUNT> stats;
+            std::array<size_t, 3> hedges{}; /* indexed by Hedge */
+
+            PhaseStats &at(Phase phase)
+            {
+                return stats[static_cast<size_t>(phase)];
+            }
+
+            double percentile(std::vector<double> samples, double p)
+            {
+                if (samples.empty())
+                {
+                    return 0.0;
+                }
+                std::sort(samples.begin(), samples.end());
+                size_t rank = static_cast<size_t>(p * (samples.size() - 1) + 0.5);
+                return samples[std::min(rank, samples.size() - 1)];
+            }
+
+            std::string formatBytes(size_t bytes)
+            {
+                if (bytes >= 1024ull * 1024 * 1024)
+                    return fmt::format("{:.2f}GB", bytes / (1024.0 * 1024.0 * 1024.0));
+                if (bytes >= 1024ull * 1024)
+                    return fmt::format("{:.2f}MB", bytes / (1024.0 * 1024.0));
+                if (bytes >= 1024)
+                    return fmt::format("{:.2f}KB", bytes / 1024.0);
+                return fmt::format("{}B", bytes);
+            }
+        }
+
+        const char *phaseName(Phase phase)
+        {
+            switch (phase)
+            {
+            case Phase::Metadata:
+                return "metadata";
+            case Phase::Pagination:
+                return "pagination";
+            case Phase::PlayPage:
+                return "play_page";
+            case Phase::Kwik:
+                return "kwik";
+            case Phase::Download:
+                return "download";
+            case Phase::Zip:
+                return "zip";
+            }
+            return "unknown";
+        }
+
+        void observe(Phase phase, double seconds, size_t bytes, bool ok)
+        {
+            std::lock_guard<std::mutex> lock(statsMutex);
+            PhaseStats &s = at(phase);
+            ok ? s.ok++ : s.failed++;
+            s.bytes += bytes;
+            s.seconds += seconds;
+            for (size_t i = 0; i < BUCKETS.size(); ++i)
+            {
+                if (seconds <= BUCKETS[i])
+                {
+                    s.buckets[i]++;
+                }
+            }
+            s.samples.push_back(seconds);
+        }
+
+        void retry(Phase phase)
+        {
+            std::lock_guard<std::mutex> lock(statsMutex);
+            at(phase).retries++;
+        }
+
+        void hedge(Hedge outcome)
+        {
+            std::lock_guard<std::mutex> lock(statsMutex);
+            hedges[static_cast<size_t>(outcome)]++;
+        }
+
+        Timer::Timer(Phase phase) : phase_(phase), start_(std::chrono::steady_clock::now()), traceStart_(Trace::now()) {}
+
+        Timer::~Timer()
+        {
+            if (!finished_)
+            {
+                finish(false, 0);
+            }
+        }
+
+        void Timer::success(size_t bytes)
+        {
+            finish(true, bytes);
+        }
+
+        void Timer::failure(size_t bytes)
+        {
+            finish(false, bytes);
+        }
+
+        void Timer::finish(bool ok, size_t bytes)
+        {
+            if (finished_)
+            {
+                return;
+            }
+            finished_ = true;
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_;
+            observe(phase_, elapsed.count(), bytes, ok);
+            Trace::complete(phaseName(phase_), "stage", traceStart_, Trace::now(), {{"ok", ok}, {"bytes", bytes}});
+        }
+
+        void printSummary()
+        {
+            std::lock_guard<std::mutex> lock(statsMutex);
+
+            if (Events::isJsonMode())
+            {
+                json phases = json::object();
+                for (size_t i = 0; i < PHASE_COUNT; ++i)
+                {
+                    const PhaseStats &s = stats[i];
+                    phases[phaseName(static_cast<Phase>(i))] = {
+                        {"ok", s.ok},
+                        {"failed", s.failed},
+                        {"retries", s.retries},
+                        {"bytes", s.bytes},
+                        {"seconds", s.seconds},
+                        {"p50_seconds", percentile(s.samples, 0.50)},
+                        {"p95_seconds", percentile(s.samples, 0.95)}};
+                }
+                Events::emit("stats", {{"phases", phases},
+                                       {"hedges", {{"sent", hedges[0]}, {"won", hedges[1]}, {"capped", hedges[2]}}}});
+                return;
+            }
+
+            Events::print("\n * Run Statistics\n\n");
+            Events::print("   {:<11}{:>7}{:>7}{:>9}{:>11}{:>10}{:>10}{:>12}{:>12}\n",
+                          "phase", "ok", "fail", "retries", "total(s)", "p50(s)", "p95(s)", "bytes", "rate");
+            for (size_t i = 0; i < PHASE_COUNT; ++i)
+            {
+                const PhaseStats &s = stats[i];
+                if (s.ok + s.failed + s.retries == 0)
+                {
+                    continue;
+                }
+                std::string rate = (s.bytes > 0 && s.seconds > 0) ? fmt::format("{}/s", formatBytes(static_cast<size_t>(s.bytes / s.seconds))) : "-";
+                Events::print("   {:<11}{:>7}{:>7}{:>9}{:>11.2f}{:>10.2f}{:>10.2f}{:>12}{:>12}\n",
+                              phaseName(static_cast<Phase>(i)), s.ok, s.failed, s.retries, s.seconds,
+                              percentile(s.samples, 0.50), percentile(s.samples, 0.95),
+                              s.bytes > 0 ? formatBytes(s.bytes) : "-", rate);
+            }
+            if (hedges[0] + hedges[2] > 0)
+            {
+                Events::print("\n   hedged requests: {} sent, {} answered first, {} over budget\n", hedges[0], hedges[1], hedges[2]);
+            }
+            Events::print("\n");
+        }
+
+        bool writePrometheus(const std::string &path)
+        {
+            namespace fs = std::filesystem;
+            std::string tmpPath = path + ".tmp";
+
+            {
+                std::ofstream out(tmpPath, std::ios::trunc);
+                if (!out.is_open())
+                {
+                    return false;
+                }
+
+                std::lock_guard<std::mutex> lock(statsMutex);
+
+                out << "# HELP animepahe_phase_duration_seconds Time spent per operation in each pipeline phase.\n";
+                out << "# TYPE animepahe_phase_duration_seconds histogram\n";
+                for (size_t i = 0; i < PHASE_COUNT; ++i)
+                {
+                    const PhaseStats &s = stats[i];
+                    const char *name = phaseName(static_cast<Phase>(i));
+                    for (size_t b = 0; b < BUCKETS.size(); ++b)
+                    {
+                        out << fmt::format("animepahe_phase_duration_seconds_bucket{{phase=\"{}\",le=\"{}\"}} {}\n", name, BUCKETS[b], s.buckets[b]);
+                    }
+                    out << fmt::format("animepahe_phase_duration_seconds_bucket{{phase=\"{}\",le=\"+Inf\"}} {}\n", name, s.ok + s.failed);
+                    out << fmt::format("animepahe_phase_duration_seconds_sum{{phase=\"{}\"}} {}\n", name, s.seconds);
+                    out << fmt::format("animepahe_phase_duration_seconds_count{{phase=\"{}\"}} {}\n", name, s.ok + s.failed);
+                }
+
+                out << "# HELP animepahe_phase_operations_total Completed operations per phase and result.\n";
+                out << "# TYPE animepahe_phase_operations_total counter\n";
+                for (size_t i = 0; i < PHASE_COUNT; ++i)
+                {
+                    const char *name = phaseName(static_cast<Phase>(i));
+                    out << fmt::format("animepahe_phase_operations_total{{phase=\"{}\",result=\"ok\"}} {}\n", name, stats[i].ok);
+                    out << fmt::format("animepahe_phase_operations_total{{phase=\"{}\",result=\"failed\"}} {}\n", name, stats[i].failed);
+                }
+
+                out << "# HELP animepahe_phase_retries_total Retried attempts per phase.\n";
+                out << "# TYPE animepahe_phase_retries_total counter\n";
+                for (size_t i = 0; i < PHASE_COUNT; ++i)
+                {
+                    out << fmt::format("animepahe_phase_retries_total{{phase=\"{}\"}} {}\n", phaseName(static_cast<Phase>(i)), stats[i].retries);
+                }
+
+                out << "# HELP animepahe_phase_bytes_total Bytes transferred or written per phase.\n";
+                out << "# TYPE animepahe_phase_bytes_total counter\n";
+                for (size_t i = 0; i < PHASE_COUNT; ++i)
+                {
+                    out << fmt::format("animepahe_phase_bytes_total{{phase=\"{}\"}} {}\n", phaseName(static_cast<Phase>(i)), stats[i].bytes);
+                }
+
+                out << "# HELP animepahe_hedged_requests_total Duplicate requests sent after the learned latency percentile, by outcome.\n";
+                out << "# TYPE animepahe_hedged_requests_total counter\n";
+                out << fmt::format("animepahe_hedged_requests_total{{result=\"sent\"}} {}\n", hedges[0]);
+                out << fmt::format("animepahe_hedged_requests_total{{result=\"won\"}} {}\n", hedges[1]);
+                out << fmt::format("animepahe_hedged_requests_total{{result=\"capped\"}} {}\n", hedges[2]);
+
+                auto now = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+                out << "# HELP animepahe_last_run_timestamp_seconds Unix time the metrics were written.\n";
+                out << "# TYPE animepahe_last_run_timestamp_seconds gauge\n";
+                out << fmt::format("animepahe_last_run_timestamp_seconds {}\n", now);
+
+                if (!out.good())
+                {
+                    return false;
+                }
+            }
+
+            std::error_code ec;
+            fs::rename(tmpPath, path, ec);
+            if (ec)
+            {
+                fs::remove(tmpPath, ec);
+                return false;
+            }
+            return true;
+        }
+    }
+}
@@ -0,0 +1,213 @@
+#include <packer.hpp>
+#include <events.hpp>
+#include <fmt/core.h>
+#include <fmt/color.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <stdexcept>
+
+namespace AnimepaheCLI
+{
+    Packer::Packer(const std::string &archiveName, const std::string &format, uint64_t limit) : archiveName_(archiveName), limit_(limit)
+    {
+        if (format == "zip")
+        {
+            zip_ = std::make_unique<ZipUtils::ZipWriter>(archiveName);
+        }
+        else if (format == "tar" || format == "tar.zst")
+        {
+            tar_ = std::make_unique<TarUtils::TarStream>(archiveName, format == "tar.zst" ? TarUtils::Compression::Zstd : TarUtils::Compression::None);
+        }
+        else
+        {
+            throw std::runtime_error(fmt::format("{} is not valid for --archive [zip|tar|tar.zst]", format));
+        }
+        worker_ = std::thread([this]()
+                              { run(); });
+    }
+
+    Packer::~Packer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+            queue_.clear();
+        }
+        changed_.notify_all();
+        if (worker_.joinable())
+        {
+            worker_.join();
+        }
+        if (!finished_ && removed_ > 0)
+        {
+            /* unwinding from an error elsewhere, the episodes already deleted only exist in the archive */
+            try
+            {
+                std::string message = abort("the run was aborted");
+                Events::print(fmt::fg(fmt::color::indian_red), "\n * Archiving : FAIL! {}\n", message);
+            }
+            catch (...)
+            {
+            }
+        }
+    }
+
+    std::string Packer::abort(const std::string &reason)
+    {
+        finished_ = true;
+        if (removed_ == 0)
+        {
+            /* every source is still on disk, the archive goes with the writer */
+            return reason;
+        }
+        std::string closeError;
+        try
+        {
+            zip_ ? zip_->close_committed() : tar_->close_committed();
+        }
+        catch (const std::exception &e)
+        {
+            closeError = e.what();
+        }
+        /* a zip stays a .part file when an archive of the same name was already there */
+        std::string kept = zip_ ? zip_->path() : archiveName_;
+        Events::emit("archive_partial", {{"archive", kept}, {"entries", entries()}, {"error", reason}, {"close_error", closeError}});
+        if (!closeError.empty())
+        {
+            return fmt::format("{}; {} episodes were already packed and deleted, {} is kept but could not be finished ({})", reason, removed_, kept, closeError);
+        }
+        return fmt::format("{}; the {} episodes packed before it are kept in {}", reason, entries(), kept);
+    }
+
+    void Packer::add(const std::string &path, const std::string &name)
+    {
+        std::error_code ec;
+        uint64_t size = std::filesystem::file_size(path, ec);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (error_)
+            {
+                /* finish() reports it, the file stays where it is */
+                return;
+            }
+            queue_.push_back(Item{path, name, ec ? 0 : size});
+            staged_ += ec ? 0 : size;
+        }
+        changed_.notify_all();
+    }
+
+    void Packer::waitForRoom(uint64_t expected)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto full = [this, expected]()
+        {
+            /* with nothing staged the next episode always goes, however large it is */
+            return limit_ > 0 && !error_ && staged_ > 0 && staged_ + expected > limit_;
+        };
+        if (!full())
+        {
+            return;
+        }
+
+        Events::print("\n * Waiting for packing : {:.2f} GB staged, limit {:.2f} GB", staged_ / 1073741824.0, limit_ / 1073741824.0);
+        Events::emit("disk_wait", {{"staged_bytes", staged_}, {"expected_bytes", expected}, {"limit_bytes", limit_}});
+        auto started = std::chrono::steady_clock::now();
+        changed_.wait(lock, [&full]()
+                      { return !full(); });
+        waited_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        Events::print("\r\x1b[2K");
+    }
+
+    void Packer::run()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true)
+        {
+            changed_.wait(lock, [this]()
+                          { return stopping_ || !queue_.empty(); });
+            if (queue_.empty())
+            {
+                return;
+            }
+            Item item = queue_.front();
+            lock.unlock();
+
+            /* the source goes only once its entry is on the disk */
+            std::exception_ptr error;
+            try
+            {
+                if (zip_)
+                {
+                    zip_->add_file(item.path, item.name);
+                    zip_->commit();
+                }
+                else
+                {
+                    tar_->add_file(item.path, item.name);
+                    tar_->commit();
+                }
+                std::error_code ec;
+                std::filesystem::remove(item.path, ec);
+                removed_++;
+                Events::emit("source_removed", {{"file", item.name}, {"bytes", item.size}});
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+
+            lock.lock();
+            if (!queue_.empty())
+            {
+                queue_.pop_front();
+            }
+            staged_ -= std::min(staged_, item.size);
+            if (error)
+            {
+                /* nothing more is packed or deleted, the rest stays on disk */
+                error_ = error;
+                queue_.clear();
+                staged_ = 0;
+            }
+            changed_.notify_all();
+        }
+    }
+
+    void Packer::finish()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        changed_.notify_all();
+        if (worker_.joinable())
+        {
+            worker_.join();
+        }
+        try
+        {
+            if (error_)
+            {
+                std::rethrow_exception(error_);
+            }
+            zip_ ? zip_->close() : tar_->close();
+            finished_ = true;
+        }
+        catch (const std::exception &e)
+        {
+            /* once a source is gone the archive is all there is of it, so it is finished with what was committed */
+            throw std::runtime_error(abort(e.what()));
+        }
+    }
+
+    size_t Packer::entries() const
+    {
+        return zip_ ? zip_->entries() : tar_->entries();
+    }
+
+    uint64_t Packer::bytes() const
+    {
+        return zip_ ? zip_->bytes() : tar_->bytes();
+    }
+}
@@ -0,0 +1,180 @@
+#include <scheduler.hpp>
+#include <events.hpp>
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace AnimepaheCLI
+{
+    namespace Scheduler
+    {
+        namespace
+        {
+            /* starting point before a host said anything */
+            constexpr double INITIAL_LIMIT = 4.0;
+            /* ttfb this many times the best seen counts as queueing on the host */
+            constexpr double INFLATION = 2.5;
+
+            struct Host
+            {
+                double limit = INITIAL_LIMIT;
+                int inflight = 0;
+                std::deque<std::function<void()>> waiting;
+                double baseTtfb = 0.0; /* best recent time to first byte */
+                double ttfb = 0.0;     /* smoothed */
+                size_t sinceCut = 0;   /* answers since the last cut, one cut per window */
+                int peak = 0;
+                size_t cuts = 0;
+            };
+
+            std::mutex mutex;
+            int floorLimit = 1;
+            int ceilingLimit = 16;
+            std::map<std::string, Host> hosts;
+
+            std::string hostOf(const std::string &url)
+            {
+                size_t begin = url.find("://");
+                begin = begin == std::string::npos ? 0 : begin + 3;
+                size_t end = url.find_first_of(":/?", begin);
+                return url.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+            }
+
+            Host &hostFor(const std::string &name)
+            {
+                auto [it, created] = hosts.try_emplace(name);
+                if (created)
+                {
+                    it->second.limit = std::clamp(INITIAL_LIMIT, static_cast<double>(floorLimit), static_cast<double>(ceilingLimit));
+                }
+                return it->second;
+            }
+
+            /* lock held; reports whole-number changes */
+            void setLimit(const std::string &name, Host &host, double limit, const char *reason)
+            {
+                limit = std::clamp(limit, static_cast<double>(floorLimit), static_cast<double>(ceilingLimit));
+                int before = static_cast<int>(host.limit);
+                host.limit = limit;
+                if (static_cast<int>(limit) != before)
+                {
+                    Events::emit("host_limit", {{"host", name}, {"limit", static_cast<int>(limit)}, {"reason", reason}});
+                }
+            }
+
+            void cut(const std::string &name, Host &host, double factor, const char *reason)
+            {
+                if (host.sinceCut < static_cast<size_t>(host.limit))
+                {
+                    return;
+                }
+                host.sinceCut = 0;
+                host.cuts++;
+                setLimit(name, host, host.limit * factor, reason);
+            }
+        }
+
+        void configure(int floor, int ceiling)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            floorLimit = std::max(1, floor);
+            ceilingLimit = std::max(floorLimit, ceiling);
+        }
+
+        void acquire(const std::string &url, std::function<void()> start)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                Host &host = hostFor(hostOf(url));
+                if (host.inflight >= static_cast<int>(host.limit))
+                {
+                    host.waiting.push_back(std::move(start));
+                    return;
+                }
+                host.inflight++;
+                host.peak = std::max(host.peak, host.inflight);
+            }
+            start();
+        }
+
+        void release(const std::string &url, Outcome outcome, double ttfb)
+        {
+            std::vector<std::function<void()>> runnable;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                std::string name = hostOf(url);
+                Host &host = hostFor(name);
+                host.inflight = std::max(0, host.inflight - 1);
+                host.sinceCut++;
+
+                switch (outcome)
+                {
+                case Outcome::Ok:
+                    /* the baseline follows the best answers and slowly forgets them */
+                    host.baseTtfb = host.baseTtfb == 0.0 ? ttfb : std::min(ttfb, host.baseTtfb * 1.01);
+                    host.ttfb = host.ttfb == 0.0 ? ttfb : host.ttfb * 0.8 + ttfb * 0.2;
+                    if (host.baseTtfb > 0.0 && host.ttfb > host.baseTtfb * INFLATION)
+                    {
+                        cut(name, host, 0.8, "latency");
+                    }
+                    else
+                    {
+                        setLimit(name, host, host.limit + 1.0 / host.limit, "increase");
+                    }
+                    break;
+                case Outcome::Throttled:
+                    cut(name, host, 0.5, "throttled");
+                    break;
+                case Outcome::Failed:
+                    cut(name, host, 0.5, "failed");
+                    break;
+                case Outcome::Cancelled:
+                    break;
+                }
+
+                while (!host.waiting.empty() && host.inflight < static_cast<int>(host.limit))
+                {
+                    runnable.push_back(std::move(host.waiting.front()));
+                    host.waiting.pop_front();
+                    host.inflight++;
+                    host.peak = std::max(host.peak, host.inflight);
+                }
+            }
+            /* started outside the lock, a start may complete and release right away */
+            for (auto &start : runnable)
+            {
+                start();
+            }
+        }
+
+        void printSummary()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (hosts.empty())
+            {
+                return;
+            }
+
+            if (Events::isJsonMode())
+            {
+                nlohmann::json list = nlohmann::json::array();
+                for (const auto &[name, host] : hosts)
+                {
+                    list.push_back({{"host", name}, {"limit", static_cast<int>(host.limit)}, {"peak", host.peak}, {"cuts", host.cuts}});
+                }
+                Events::emit("host_limits", {{"hosts", list}});
+                return;
+            }
+
+            Events::print("   {:<28}{:>7}{:>7}{:>7}\n", "host", "limit", "peak", "cuts");
+            for (const auto &[name, host] : hosts)
+            {
+                Events::print("   {:<28}{:>7}{:>7}{:>7}\n", name, static_cast<int>(host.limit), host.peak, host.cuts);
+            }
+            Events::print("\n");
+        }
+    }
+}
@@ -0,0 +1,321 @@
+#include <session.hpp>
+#include <utils.hpp>
+#include <nlohmann/json.hpp>
+#include <re2/re2.h>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+
+using json = nlohmann::json;
+
+namespace AnimepaheCLI
+{
+    namespace Session
+    {
+        namespace
+        {
+            /* cookies sent without an expiry (session cookies) */
+            constexpr int64_t DEFAULT_LIFETIME = 30 * 60;
+
+            struct Cookie
+            {
+                std::string value;
+                int64_t expires = 0; /* unix seconds */
+            };
+
+            struct KwikToken
+            {
+                std::string token;
+                int64_t expires = 0;
+            };
+
+            std::mutex sessionMutex;
+            std::string sessionPath;
+            bool dirty = false;
+            std::map<std::string, std::map<std::string, Cookie>> jar; /* host -> name -> cookie */
+            std::map<std::string, KwikToken> kwikTokens;              /* host -> token */
+
+            int64_t now()
+            {
+                return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+            }
+
+            std::string hostOf(const std::string &url)
+            {
+                std::string host;
+                RE2::PartialMatch(url, R"(^https?://([^/:?#]+))", &host);
+                return host;
+            }
+
+            /* "Wed, 21 Oct 2026 07:28:00 GMT" or "21-Oct-2026 07:28:00", 0 when it does not parse */
+            int64_t parseExpires(const std::string &text)
+            {
+                static const char *MONTHS[] = {"jan", "feb", "mar", "apr", "may", "jun", "jul", "aug", "sep", "oct", "nov", "dec"};
+                int day = 0, year = 0, hour = 0, minute = 0, second = 0;
+                std::string monthName;
+                if (!RE2::PartialMatch(text, R"((\d{1,2})[ -]([A-Za-z]{3})[ -](\d{2,4}) (\d{2}):(\d{2}):(\d{2}))",
+                                       &day, &monthName, &year, &hour, &minute, &second))
+                {
+                    return 0;
+                }
+                unsigned month = 0;
+                for (unsigned m = 0; m < 12; ++m)
+                {
+                    if (monthName.size() == 3 && std::tolower(monthName[0]) == MONTHS[m][0] &&
+                        std::tolower(monthName[1]) == MONTHS[m][1] && std::tolower(monthName[2]) == MONTHS[m][2])
+                    {
+                        month = m + 1;
+                    }
+                }
+                if (month == 0)
+                {
+                    return 0;
+                }
+                if (year < 100)
+                {
+                    year += year < 70 ? 2000 : 1900;
+                }
+                std::chrono::year_month_day date{std::chrono::year{year}, std::chrono::month{month}, std::chrono::day{static_cast<unsigned>(day)}};
+                if (!date.ok())
+                {
+                    return 0;
+                }
+                int64_t days = std::chrono::sys_days{date}.time_since_epoch().count();
+                return days * 86400 + hour * 3600 + minute * 60 + second;
+            }
+
+            /* drop expired entries (caller holds sessionMutex) */
+            void prune(int64_t at)
+            {
+                for (auto host = jar.begin(); host != jar.end();)
+                {
+                    std::erase_if(host->second, [at](const auto &cookie)
+                                  { return cookie.second.expires <= at; });
+                    host = host->second.empty() ? jar.erase(host) : std::next(host);
+                }
+                std::erase_if(kwikTokens, [at](const auto &token)
+                              { return token.second.expires <= at; });
+            }
+
+            void load()
+            {
+                std::ifstream file(sessionPath);
+                if (!file)
+                {
+                    return;
+                }
+                json state = json::parse(file, nullptr, false);
+                if (state.is_discarded() || !state.is_object())
+                {
+                    return;
+                }
+                /* an entry that is not an object or has a field of the wrong type is skipped, the rest of the session still counts */
+                const json &cookies = state.contains("cookies") && state["cookies"].is_array() ? state["cookies"] : json::array();
+                for (const auto &cookie : cookies)
+                {
+                    if (!cookie.is_object())
+                    {
+                        continue;
+                    }
+                    try
+                    {
+                        std::string host = cookie.value("host", ""), name = cookie.value("name", "");
+                        Cookie entry{cookie.value("value", ""), cookie.value("expires", int64_t{0})};
+                        if (!host.empty() && !name.empty())
+                        {
+                            jar[host][name] = std::move(entry);
+                        }
+                    }
+                    catch (const json::exception &)
+                    {
+                    }
+                }
+                const json &tokens = state.contains("kwik") && state["kwik"].is_array() ? state["kwik"] : json::array();
+                for (const auto &token : tokens)
+                {
+                    if (!token.is_object())
+                    {
+                        continue;
+                    }
+                    try
+                    {
+                        std::string host = token.value("host", "");
+                        KwikToken entry{token.value("token", ""), token.value("expires", int64_t{0})};
+                        if (!host.empty())
+                        {
+                            kwikTokens[host] = std::move(entry);
+                        }
+                    }
+                    catch (const json::exception &)
+                    {
+                    }
+                }
+                prune(now());
+            }
+        }
+
+        void open(const std::string &path)
+        {
+            std::lock_guard<std::mutex> lock(sessionMutex);
+            sessionPath = path;
+            jar.clear();
+            kwikTokens.clear();
+            dirty = false;
+            if (!sessionPath.empty())
+            {
+                load();
+            }
+        }
+
+        std::string defaultPath()
+        {
+            std::string directory = userCacheDirectory();
+            return directory.empty() ? "" : (std::filesystem::path(directory) / "session.json").string();
+        }
+
+        std::string cookieHeader(const std::string &url)
+        {
+            std::lock_guard<std::mutex> lock(sessionMutex);
+            auto host = jar.find(hostOf(url));
+            if (host == jar.end())
+            {
+                return "";
+            }
+            int64_t at = now();
+            std::string header;
+            for (const auto &[name, cookie] : host->second)
+            {
+                if (cookie.expires > at)
+                {
+                    header += (header.empty() ? "" : "; ") + name + "=" + cookie.value;
+                }
+            }
+            return header;
+        }
+
+        void storeCookies(const std::string &url, const std::string &rawHeader)
+        {
+            std::string host = hostOf(url);
+            int64_t at = now();
+
+            std::lock_guard<std::mutex> lock(sessionMutex);
+            std::istringstream lines(rawHeader);
+            std::string line;
+            while (std::getline(lines, line))
+            {
+                std::string name, value, attributes;
+                if (!RE2::PartialMatch(line, R"((?i)^set-cookie:\s*([^=;\s]+)=([^;\r]*)(.*))", &name, &value, &attributes))
+                {
+                    continue;
+                }
+
+                int64_t expires = at + DEFAULT_LIFETIME;
+                int64_t maxAge = 0;
+                std::string date;
+                if (RE2::PartialMatch(attributes, R"((?i);\s*max-age=(-?\d+))", &maxAge))
+                {
+                    expires = at + maxAge;
+                }
+                else if (RE2::PartialMatch(attributes, R"((?i);\s*expires=([^;\r]+))", &date) && parseExpires(date) != 0)
+                {
+                    expires = parseExpires(date);
+                }
+
+                if (expires <= at)
+                {
+                    jar[host].erase(name);
+                }
+                else
+                {
+                    jar[host][name] = Cookie{value, expires};
+                }
+                dirty = true;
+            }
+        }
+
+        std::string kwikToken(const std::string &url)
+        {
+            std::string host = hostOf(url);
+            int64_t at = now();
+
+            std::lock_guard<std::mutex> lock(sessionMutex);
+            auto token = kwikTokens.find(host);
+            auto cookies = jar.find(host);
+            if (token == kwikTokens.end() || token->second.expires <= at || cookies == jar.end())
+            {
+                return "";
+            }
+            auto session = cookies->second.find("kwik_session");
+            if (session == cookies->second.end() || session->second.expires <= at)
+            {
+                return "";
+            }
+            return token->second.token;
+        }
+
+        void storeKwikToken(const std::string &url, const std::string &token)
+        {
+            std::string host = hostOf(url);
+
+            std::lock_guard<std::mutex> lock(sessionMutex);
+            auto cookies = jar.find(host);
+            if (cookies == jar.end() || !cookies->second.count("kwik_session"))
+            {
+                return;
+            }
+            /* the token is bound to the session, it lives exactly as long */
+            kwikTokens[host] = KwikToken{token, cookies->second["kwik_session"].expires};
+            dirty = true;
+        }
+
+        void dropKwik(const std::string &url)
+        {
+            std::string host = hostOf(url);
+
+            std::lock_guard<std::mutex> lock(sessionMutex);
+            kwikTokens.erase(host);
+            auto cookies = jar.find(host);
+            if (cookies != jar.end())
+            {
+                cookies->second.erase("kwik_session");
+            }
+            dirty = true;
+        }
+
+        bool save()
+        {
+            std::lock_guard<std::mutex> lock(sessionMutex);
+            if (sessionPath.empty() || !dirty)
+            {
+                return true;
+            }
+            prune(now());
+
+            json state = {{"version", 1}, {"cookies", json::array()}, {"kwik", json::array()}};
+            for (const auto &[host, cookies] : jar)
+            {
+                for (const auto &[name, cookie] : cookies)
+                {
+                    state["cookies"].push_back({{"host", host}, {"name", name}, {"value", cookie.value}, {"expires", cookie.expires}});
+                }
+            }
+            for (const auto &[host, token] : kwikTokens)
+            {
+                state["kwik"].push_back({{"host", host}, {"token", token.token}, {"expires", token.expires}});
+            }
+
+            /* cookies and tokens are credentials */
+            if (!writeFileAtomically(sessionPath, state.dump(2), true))
+            {
+                return false;
+            }
+            dirty = false;
+            return true;
+        }
+    }
+}
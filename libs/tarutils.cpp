@@ -0,0 +1,591 @@
+#include "tarutils.hpp"
+#include "manifest.hpp"
+#include <filesystem>
+#include <stdexcept>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <vector>
+#include <zstd.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+namespace TarUtils {
+
+    namespace {
+        namespace fs = std::filesystem;
+
+        constexpr size_t BLOCK = 512;
+        constexpr size_t COPY_CHUNK = 8 << 20;          // progress granularity of kernel copies
+        constexpr size_t ZSTD_RAW_BLOCK = 128 << 10;    // largest zstd block
+        constexpr size_t ZSTD_FRAME_BUFFER = 4 << 20;   // small data collected per compressed frame
+        constexpr int ZSTD_LEVEL = 3;
+
+        struct Entry {
+            fs::path path;
+            std::string name;      // path inside the archive, '/' separated
+            bool directory = false;
+            bool media = false;
+            uint64_t size = 0;
+            int64_t mtime = 0;
+        };
+
+#ifdef _WIN32
+        int open_read(const fs::path& path) { return _wopen(path.c_str(), _O_RDONLY | _O_BINARY); }
+        int open_write(const fs::path& path) {
+            return _wopen(path.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+        }
+        long long sys_read(int fd, void* data, size_t size) { return _read(fd, data, static_cast<unsigned>(std::min<size_t>(size, 1u << 30))); }
+        long long sys_write(int fd, const void* data, size_t size) { return _write(fd, data, static_cast<unsigned>(std::min<size_t>(size, 1u << 30))); }
+        int sys_close(int fd) { return _close(fd); }
+        bool sys_truncate(int fd, uint64_t size) {
+            return _chsize_s(fd, static_cast<long long>(size)) == 0 && _lseeki64(fd, static_cast<long long>(size), SEEK_SET) >= 0;
+        }
+#else
+        int open_read(const fs::path& path) { return ::open(path.c_str(), O_RDONLY | O_CLOEXEC); }
+        int open_write(const fs::path& path) { return ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644); }
+        long long sys_read(int fd, void* data, size_t size) { return ::read(fd, data, size); }
+        long long sys_write(int fd, const void* data, size_t size) { return ::write(fd, data, size); }
+        int sys_close(int fd) { return ::close(fd); }
+        bool sys_truncate(int fd, uint64_t size) {
+            return ::ftruncate(fd, static_cast<off_t>(size)) == 0 && ::lseek(fd, static_cast<off_t>(size), SEEK_SET) >= 0;
+        }
+#endif
+
+        /* closes the descriptor on every path out */
+        struct Fd {
+            int fd = -1;
+            explicit Fd(int value) : fd(value) {}
+            ~Fd() {
+                if (fd >= 0) {
+                    sys_close(fd);
+                }
+            }
+            Fd(const Fd&) = delete;
+            Fd& operator=(const Fd&) = delete;
+        };
+
+        int64_t unix_mtime(const fs::path& path) {
+            std::error_code ec;
+            auto written = fs::last_write_time(path, ec);
+            if (ec) {
+                return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+            }
+            /* file_clock has no portable conversion yet, go through both clocks' now() */
+            auto system = written - fs::file_time_type::clock::now() + std::chrono::system_clock::now();
+            return std::chrono::duration_cast<std::chrono::seconds>(system.time_since_epoch()).count();
+        }
+
+        /* NUL terminated octal field, false when the value needs more digits than the field has */
+        bool octal(char* field, size_t width, uint64_t value) {
+            if (width < 22 && value >= (1ull << (3 * (width - 1)))) {
+                return false;
+            }
+            std::snprintf(field, width, "%0*llo", static_cast<int>(width - 1), static_cast<unsigned long long>(value));
+            return true;
+        }
+
+        /* "<length> key=value\n", where length counts the whole record including its own digits */
+        std::string pax_record(const std::string& key, const std::string& value) {
+            size_t payload = key.size() + value.size() + 3;
+            size_t length = payload + 1;
+            while (std::to_string(length).size() + payload != length) {
+                length = std::to_string(length).size() + payload;
+            }
+            return std::to_string(length) + " " + key + "=" + value + "\n";
+        }
+
+        void checksum(char* header) {
+            std::memset(header + 148, ' ', 8);
+            unsigned sum = 0;
+            for (size_t i = 0; i < BLOCK; ++i) {
+                sum += static_cast<unsigned char>(header[i]);
+            }
+            std::snprintf(header + 148, 7, "%06o", sum);
+            header[155] = ' ';
+        }
+
+        /* 512 byte ustar header, the caller fills name/prefix */
+        std::vector<char> ustar_header(char type, uint64_t size, int64_t mtime, unsigned mode) {
+            std::vector<char> header(BLOCK, 0);
+            octal(&header[100], 8, mode);
+            octal(&header[108], 8, 0);
+            octal(&header[116], 8, 0);
+            octal(&header[124], 12, size);
+            octal(&header[136], 12, static_cast<uint64_t>(std::max<int64_t>(mtime, 0)));
+            header[156] = type;
+            std::memcpy(&header[257], "ustar", 6);
+            std::memcpy(&header[263], "00", 2);
+            return header;
+        }
+
+        /* split a path over the 155 byte prefix and 100 byte name fields, false if it does not fit */
+        bool split_name(const std::string& name, char* header) {
+            if (name.size() <= 100) {
+                std::memcpy(header, name.data(), name.size());
+                return true;
+            }
+            for (size_t slash = name.find('/'); slash != std::string::npos; slash = name.find('/', slash + 1)) {
+                if (slash <= 155 && name.size() - slash - 1 <= 100 && name.size() - slash - 1 > 0) {
+                    std::memcpy(header + 345, name.data(), slash);
+                    std::memcpy(header, name.data() + slash + 1, name.size() - slash - 1);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /**
+         * Output archive. Plain tar goes straight to the file. For .tar.zst,
+         * small data is collected and written as compressed frames, and file
+         * bodies that should not be compressed become frames of raw blocks,
+         * so the decompressed stream is exactly the plain tar.
+         */
+        class TarWriter {
+        public:
+            TarWriter(const fs::path& path, bool zstd) : out_(open_write(path)), zstd_(zstd) {
+                if (out_.fd < 0) {
+                    throw std::runtime_error("Failed to create archive: " + path.string());
+                }
+            }
+
+            void add_directory(const Entry& entry) {
+                write_header(entry.name + "/", '5', 0, entry.mtime, 0755);
+            }
+
+            /* returns the bytes the kernel moved for this file */
+            uint64_t add_file(const Entry& entry, bool compress, const std::function<void(uint64_t)>& on_copied) {
+                write_header(entry.name, '0', entry.size, entry.mtime, 0644);
+
+                Fd in(open_read(entry.path));
+                if (in.fd < 0) {
+                    throw std::runtime_error("Failed to open file: " + entry.path.string());
+                }
+
+                uint64_t kernel = 0;
+                if (compress && zstd_) {
+                    read_into_pending(in.fd, entry, on_copied);
+                } else if (zstd_) {
+                    kernel = raw_frame(in.fd, entry, on_copied);
+                } else {
+                    kernel = copy(in.fd, 0, entry.size, entry, on_copied);
+                }
+                pad(entry.size);
+                return kernel;
+            }
+
+            void finish() {
+                std::vector<char> end(2 * BLOCK, 0);
+                put(end.data(), end.size());
+                flush_pending();
+                int fd = out_.fd;
+                out_.fd = -1;
+                if (sys_close(fd) != 0) {
+                    throw std::runtime_error("Failed to finish archive");
+                }
+            }
+
+            /* everything added so far is on the disk, compressed data included */
+            void commit() {
+                flush_pending();
+#ifdef _WIN32
+                int result = _commit(out_.fd);
+#else
+                int result = fsync(out_.fd);
+#endif
+                if (result != 0) {
+                    throw std::runtime_error(std::string("Failed to flush archive: ") + std::strerror(errno));
+                }
+                committed_ = written_;
+            }
+
+            /* cut off whatever came after the last commit(), e.g. a body that failed half way */
+            void rollback() {
+                pending_.clear();
+                if (!sys_truncate(out_.fd, committed_)) {
+                    throw std::runtime_error(std::string("Failed to truncate archive: ") + std::strerror(errno));
+                }
+                written_ = committed_;
+            }
+
+            uint64_t size() const { return written_; }
+
+        private:
+            void write_header(const std::string& name, char type, uint64_t size, int64_t mtime, unsigned mode) {
+                std::vector<char> header = ustar_header(type, size, mtime, mode);
+
+                /* names and sizes the ustar fields cannot hold go into a pax header first */
+                std::string records;
+                if (!split_name(name, header.data())) {
+                    records += pax_record("path", name);
+                    std::memcpy(header.data(), name.data(), 100);
+                }
+                if (!octal(&header[124], 12, size)) {
+                    records += pax_record("size", std::to_string(size));
+                    octal(&header[124], 12, 0);
+                }
+                if (!records.empty()) {
+                    std::vector<char> pax = ustar_header('x', records.size(), mtime, 0644);
+                    std::string pax_name = "PaxHeaders/" + fs::path(name).filename().string();
+                    std::memcpy(pax.data(), pax_name.data(), std::min<size_t>(pax_name.size(), 100));
+                    checksum(pax.data());
+                    put(pax.data(), pax.size());
+                    put(records.data(), records.size());
+                    pad(records.size());
+                }
+
+                checksum(header.data());
+                put(header.data(), header.size());
+            }
+
+            void pad(uint64_t size) {
+                static const char zeros[BLOCK] = {};
+                size_t rest = static_cast<size_t>((BLOCK - size % BLOCK) % BLOCK);
+                put(zeros, rest);
+            }
+
+            /* headers, padding and compressed bodies */
+            void put(const char* data, size_t size) {
+                if (zstd_) {
+                    pending_.insert(pending_.end(), data, data + size);
+                    if (pending_.size() >= ZSTD_FRAME_BUFFER) {
+                        flush_pending();
+                    }
+                } else {
+                    write_all(data, size);
+                }
+            }
+
+            void read_into_pending(int in, const Entry& entry, const std::function<void(uint64_t)>& on_copied) {
+                std::vector<char> buffer(ZSTD_RAW_BLOCK);
+                uint64_t done = 0;
+                while (done < entry.size) {
+                    long long got = sys_read(in, buffer.data(), static_cast<size_t>(std::min<uint64_t>(buffer.size(), entry.size - done)));
+                    if (got <= 0) {
+                        throw std::runtime_error("File changed while archiving: " + entry.path.string());
+                    }
+                    put(buffer.data(), static_cast<size_t>(got));
+                    done += static_cast<uint64_t>(got);
+                }
+                if (on_copied) {
+                    on_copied(done);
+                }
+            }
+
+            void flush_pending() {
+                if (pending_.empty()) {
+                    return;
+                }
+                std::vector<char> frame(ZSTD_compressBound(pending_.size()));
+                size_t size = ZSTD_compress(frame.data(), frame.size(), pending_.data(), pending_.size(), ZSTD_LEVEL);
+                if (ZSTD_isError(size)) {
+                    throw std::runtime_error(std::string("zstd compression failed: ") + ZSTD_getErrorName(size));
+                }
+                write_all(frame.data(), size);
+                pending_.clear();
+            }
+
+            /**
+             * One zstd frame of raw blocks around a kernel copy of the body:
+             * magic, a descriptor without content size, a 128 KiB window, and
+             * a 3 byte header (last flag, type 0 = raw, size) before every block.
+             */
+            uint64_t raw_frame(int in, const Entry& entry, const std::function<void(uint64_t)>& on_copied) {
+                flush_pending();
+                if (entry.size == 0) {
+                    return 0;
+                }
+                const unsigned char header[6] = {0x28, 0xB5, 0x2F, 0xFD, 0x00, (17 - 10) << 3};
+                write_all(reinterpret_cast<const char*>(header), sizeof(header));
+
+                uint64_t kernel = 0;
+                for (uint64_t done = 0; done < entry.size;) {
+                    uint32_t block = static_cast<uint32_t>(std::min<uint64_t>(ZSTD_RAW_BLOCK, entry.size - done));
+                    uint32_t last = done + block == entry.size ? 1 : 0;
+                    uint32_t value = last | (block << 3);
+                    const unsigned char block_header[3] = {
+                        static_cast<unsigned char>(value), static_cast<unsigned char>(value >> 8), static_cast<unsigned char>(value >> 16)};
+                    write_all(reinterpret_cast<const char*>(block_header), sizeof(block_header));
+                    kernel += copy(in, done, block, entry, nullptr);
+                    done += block;
+                    if (on_copied && (done % COPY_CHUNK == 0 || done == entry.size)) {
+                        on_copied(done);
+                    }
+                }
+                return kernel;
+            }
+
+            /* copy size bytes of in starting at offset, kernel-side where the platform allows */
+            uint64_t copy(int in, uint64_t offset, uint64_t size, const Entry& entry, const std::function<void(uint64_t)>& on_copied) {
+                uint64_t done = 0;
+                uint64_t kernel = 0;
+#ifdef __linux__
+                while (done < size && copy_mode_ != Copy::User) {
+                    size_t want = static_cast<size_t>(std::min<uint64_t>(COPY_CHUNK, size - done));
+                    ssize_t got = -1;
+                    loff_t in_offset = static_cast<loff_t>(offset + done);
+                    if (copy_mode_ == Copy::Range) {
+                        got = copy_file_range(in, &in_offset, out_.fd, nullptr, want, 0);
+                        if (got < 0 && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP || errno == EPERM)) {
+                            copy_mode_ = Copy::Sendfile;
+                            continue;
+                        }
+                    } else {
+                        off_t send_offset = static_cast<off_t>(offset + done);
+                        got = sendfile(out_.fd, in, &send_offset, want);
+                        if (got < 0 && (errno == EINVAL || errno == ENOSYS)) {
+                            copy_mode_ = Copy::User;
+                            continue;
+                        }
+                    }
+                    if (got < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    if (got <= 0) {
+                        throw std::runtime_error("Failed to copy " + entry.path.string() + ": " + (got == 0 ? "unexpected end of file" : std::strerror(errno)));
+                    }
+                    done += static_cast<uint64_t>(got);
+                    kernel += static_cast<uint64_t>(got);
+                    written_ += static_cast<uint64_t>(got);
+                    if (on_copied) {
+                        on_copied(done);
+                    }
+                }
+#endif
+                /* portable fallback through a user-space buffer */
+                if (done < size) {
+#ifdef _WIN32
+                    _lseeki64(in, static_cast<long long>(offset + done), SEEK_SET);
+#else
+                    ::lseek(in, static_cast<off_t>(offset + done), SEEK_SET);
+#endif
+                    std::vector<char> buffer(std::min<uint64_t>(COPY_CHUNK, size - done));
+                    while (done < size) {
+                        long long got = sys_read(in, buffer.data(), static_cast<size_t>(std::min<uint64_t>(buffer.size(), size - done)));
+                        if (got <= 0) {
+                            throw std::runtime_error("File changed while archiving: " + entry.path.string());
+                        }
+                        write_all(buffer.data(), static_cast<size_t>(got));
+                        done += static_cast<uint64_t>(got);
+                        if (on_copied) {
+                            on_copied(done);
+                        }
+                    }
+                }
+                return kernel;
+            }
+
+            void write_all(const char* data, size_t size) {
+                while (size > 0) {
+                    long long put = sys_write(out_.fd, data, size);
+                    if (put < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    if (put <= 0) {
+                        throw std::runtime_error(std::string("Failed to write archive: ") + std::strerror(errno));
+                    }
+                    data += put;
+                    size -= static_cast<size_t>(put);
+                    written_ += static_cast<uint64_t>(put);
+                }
+            }
+
+            enum class Copy { Range, Sendfile, User };
+
+            Fd out_;
+            bool zstd_;
+            Copy copy_mode_ = Copy::Range;
+            uint64_t written_ = 0;
+            uint64_t committed_ = 0;  // written_ at the last commit()
+            std::vector<char> pending_;
+        };
+    }
+
+    struct TarStream::Impl {
+        Impl(const fs::path& path, bool zstd) : path(path), writer(path, zstd), zstd(zstd) {}
+
+        fs::path path;
+        TarWriter writer;
+        bool zstd;
+        size_t entries = 0;
+        size_t committed = 0;   // entries at the last commit()
+        bool closed = false;
+    };
+
+    TarStream::TarStream(const std::string& tar_name, Compression compression)
+        : impl_(std::make_unique<Impl>(fs::path(tar_name), compression == Compression::Zstd)) {}
+
+    TarStream::~TarStream() {
+        if (!impl_->closed) {
+            // Without the end blocks the archive is truncated, do not leave it behind
+            fs::path path = impl_->path;
+            impl_.reset();
+            std::error_code ec;
+            fs::remove(path, ec);
+        }
+    }
+
+    void TarStream::add_file(const std::string& path, const std::string& name) {
+        Entry entry;
+        entry.path = fs::path(path);
+        entry.name = name;
+        std::error_code ec;
+        entry.size = fs::file_size(entry.path, ec);
+        if (ec) {
+            throw std::runtime_error("Failed to open file: " + path);
+        }
+        entry.mtime = unix_mtime(entry.path);
+        entry.media = ZipUtils::is_compressed_media(path);
+        impl_->writer.add_file(entry, impl_->zstd && !entry.media, nullptr);
+        impl_->entries++;
+    }
+
+    void TarStream::commit() {
+        impl_->writer.commit();
+        impl_->committed = impl_->entries;
+    }
+
+    void TarStream::close() {
+        impl_->writer.finish();
+        impl_->closed = true;
+    }
+
+    void TarStream::close_committed() {
+        // Kept even if the end blocks fail, every committed entry is readable without them
+        impl_->closed = true;
+        impl_->writer.rollback();
+        impl_->entries = impl_->committed;
+        impl_->writer.finish();
+    }
+
+    size_t TarStream::entries() const {
+        return impl_->entries;
+    }
+
+    uint64_t TarStream::bytes() const {
+        return impl_->writer.size();
+    }
+
+    bool tar_directory(
+        const std::string& directory_path,
+        const std::string& tar_name,
+        Compression compression,
+        bool delete_source,
+        ProgressCallback progress_callback,
+        TarStats* stats
+    ) {
+        auto started = std::chrono::steady_clock::now();
+
+        /* Check if source directory exists */
+        if (!fs::exists(directory_path) || !fs::is_directory(directory_path)) {
+            throw std::runtime_error("Directory does not exist: " + directory_path);
+        }
+
+        // First pass: collect entries and sizes for progress tracking
+        std::vector<Entry> entries;
+        uint64_t total_bytes = 0;
+        fs::path base_path(directory_path);
+
+        for (const auto& item : fs::recursive_directory_iterator(directory_path)) {
+            if (!item.is_directory() && !item.is_regular_file()) {
+                continue;
+            }
+            // The download manifest is bookkeeping of the CLI, not part of the series
+            if (item.is_regular_file() && AnimepaheCLI::Manifest::isManifestFile(item.path().filename().string())) {
+                continue;
+            }
+
+            Entry entry;
+            entry.path = item.path();
+            entry.directory = item.is_directory();
+            std::u8string relative = fs::relative(item.path(), base_path).generic_u8string();
+            entry.name.assign(relative.begin(), relative.end());
+            entry.mtime = unix_mtime(item.path());
+
+            if (!entry.directory) {
+                std::error_code ec;
+                entry.size = fs::file_size(item.path(), ec);
+                if (ec) {
+                    entry.size = 0;
+                }
+                entry.media = ZipUtils::is_compressed_media(entry.path.string());
+                total_bytes += entry.size;
+            }
+            entries.push_back(std::move(entry));
+        }
+
+        TarStats summary;
+        summary.entries = entries.size();
+        summary.input_bytes = total_bytes;
+
+        try {
+            TarWriter writer(fs::path(tar_name), compression == Compression::Zstd);
+            uint64_t bytes_processed = 0;
+
+            for (size_t i = 0; i < entries.size(); ++i) {
+                const Entry& entry = entries[i];
+
+                // Report progress before processing each entry
+                if (progress_callback) {
+                    progress_callback(i, entries.size(), entry.path.string(), bytes_processed, total_bytes);
+                }
+
+                if (entry.directory) {
+                    writer.add_directory(entry);
+                    continue;
+                }
+
+                bool compress = compression == Compression::Zstd && !entry.media;
+                summary.kernel_bytes += writer.add_file(entry, compress, [&](uint64_t copied) {
+                    if (progress_callback) {
+                        progress_callback(i, entries.size(), entry.path.string(), bytes_processed + copied, total_bytes);
+                    }
+                });
+                compress ? summary.compressed++ : summary.copied++;
+                bytes_processed += entry.size;
+            }
+
+            writer.finish();
+            summary.archive_bytes = writer.size();
+        } catch (...) {
+            // Do not leave a truncated archive behind
+            std::error_code ec;
+            fs::remove(tar_name, ec);
+            throw;
+        }
+
+        // Final progress update
+        if (progress_callback) {
+            progress_callback(entries.size(), entries.size(), "Archive complete", total_bytes, total_bytes);
+        }
+
+        // Delete source directory if requested
+        if (delete_source) {
+            std::error_code ec;
+            fs::remove_all(directory_path, ec);
+            if (ec) {
+                throw std::runtime_error("Failed to delete source directory: " + ec.message());
+            }
+        }
+
+        summary.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        if (stats) {
+            *stats = summary;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,194 @@
+#include <trace.hpp>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace AnimepaheCLI
+{
+    namespace Trace
+    {
+        namespace
+        {
+            bool enabled = false;
+            std::string tracePath;
+            std::mutex traceMutex;
+            std::vector<json> events;
+            std::map<std::thread::id, int> threadIds;
+            uint64_t requestIds = 0;
+            const auto startTime = std::chrono::steady_clock::now();
+
+            /* small stable thread ids, Perfetto shows one track per id (caller holds traceMutex) */
+            int currentThreadId()
+            {
+                auto [it, inserted] = threadIds.try_emplace(std::this_thread::get_id(), static_cast<int>(threadIds.size()) + 1);
+                return it->second;
+            }
+
+            void pushComplete(const std::string &name, const std::string &category, int64_t start, int64_t duration, int tid, json args)
+            {
+                events.push_back({
+                    {"name", name},
+                    {"cat", category},
+                    {"ph", "X"},
+                    {"ts", start},
+                    {"dur", std::max<int64_t>(duration, 0)},
+                    {"pid", 1},
+                    {"tid", tid},
+                    {"args", std::move(args)}});
+            }
+
+            /* nestable async event: "b"/"e" pairs with the same category and id stack on one track of their own */
+            void pushAsync(const std::string &name, const std::string &category, const char *phase, int64_t timestamp, uint64_t id, int tid, json args)
+            {
+                events.push_back({
+                    {"name", name},
+                    {"cat", category},
+                    {"ph", phase},
+                    {"ts", timestamp},
+                    {"id", id},
+                    {"pid", 1},
+                    {"tid", tid},
+                    {"args", std::move(args)}});
+            }
+        }
+
+        void enable(const std::string &path)
+        {
+            std::lock_guard<std::mutex> lock(traceMutex);
+            tracePath = path;
+            enabled = !path.empty();
+            /* the enabling thread is the main thread, keep it on track 1 */
+            currentThreadId();
+        }
+
+        bool isEnabled()
+        {
+            return enabled;
+        }
+
+        int64_t now()
+        {
+            return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+        }
+
+        void complete(const std::string &name, const std::string &category, int64_t start, int64_t end, json args)
+        {
+            if (!enabled)
+            {
+                return;
+            }
+            std::lock_guard<std::mutex> lock(traceMutex);
+            pushComplete(name, category, start, end - start, currentThreadId(), std::move(args));
+        }
+
+        void httpRequest(
+            const std::string &name,
+            const std::string &method,
+            const std::string &url,
+            int64_t start,
+            const HttpTimings &timings,
+            long status,
+            int64_t bytes)
+        {
+            if (!enabled)
+            {
+                return;
+            }
+
+            /* curl reports cumulative times; a stage that did not happen repeats the previous mark */
+            int64_t dnsEnd = timings.dns;
+            int64_t connectEnd = std::max(timings.connect, dnsEnd);
+            int64_t tlsEnd = std::max(timings.tls, connectEnd);
+            int64_t ttfbEnd = std::max(timings.ttfb, tlsEnd);
+            int64_t totalEnd = std::max(timings.total, ttfbEnd);
+
+            json args = {
+                {"method", method},
+                {"url", url},
+                {"status", status},
+                {"bytes", bytes},
+                {"dns_us", dnsEnd},
+                {"connect_us", connectEnd - dnsEnd},
+                {"tls_us", tlsEnd - connectEnd},
+                {"ttfb_us", ttfbEnd},
+                {"total_us", totalEnd},
+                {"redirect_us", timings.redirect}};
+
+            /**
+             * Requests overlap on the event loop thread, so they are async
+             * spans with an id each instead of "X" slices on the thread's
+             * track, which only nest and would cut each other up.
+             */
+            std::lock_guard<std::mutex> lock(traceMutex);
+            int tid = currentThreadId();
+            uint64_t id = ++requestIds;
+            pushAsync(name, "http", "b", start, id, tid, std::move(args));
+
+            const std::pair<const char *, std::pair<int64_t, int64_t>> slices[] = {
+                {"dns", {0, dnsEnd}},
+                {"connect", {dnsEnd, connectEnd}},
+                {"tls", {connectEnd, tlsEnd}},
+                {"wait", {tlsEnd, ttfbEnd}},
+                {"transfer", {ttfbEnd, totalEnd}}};
+            for (const auto &[slice, range] : slices)
+            {
+                if (range.second > range.first)
+                {
+                    pushAsync(slice, "http", "b", start + range.first, id, tid, json::object());
+                    pushAsync(slice, "http", "e", start + range.second, id, tid, json::object());
+                }
+            }
+            pushAsync(name, "http", "e", start + totalEnd, id, tid, json::object());
+        }
+
+        Span::Span(std::string name, std::string category)
+            : name_(std::move(name)), category_(std::move(category)), start_(now()), args_(json::object()) {}
+
+        Span::~Span()
+        {
+            complete(name_, category_, start_, now(), std::move(args_));
+        }
+
+        void Span::arg(const std::string &key, json value)
+        {
+            args_[key] = std::move(value);
+        }
+
+        bool write()
+        {
+            if (!enabled)
+            {
+                return true;
+            }
+
+            std::lock_guard<std::mutex> lock(traceMutex);
+            json trace = {
+                {"traceEvents", json::array()},
+                {"displayTimeUnit", "ms"}};
+
+            trace["traceEvents"].push_back({{"name", "process_name"}, {"ph", "M"}, {"pid", 1}, {"args", {{"name", "animepahe-cli"}}}});
+            for (const auto &[id, tid] : threadIds)
+            {
+                trace["traceEvents"].push_back({{"name", "thread_name"}, {"ph", "M"}, {"pid", 1}, {"tid", tid}, {"args", {{"name", tid == 1 ? "main" : "worker " + std::to_string(tid)}}}});
+            }
+            for (const auto &event : events)
+            {
+                trace["traceEvents"].push_back(event);
+            }
+
+            std::ofstream out(tracePath, std::ios::trunc);
+            if (!out.is_open())
+            {
+                return false;
+            }
+            out << trace.dump(-1, ' ', false, json::error_handler_t::replace);
+            return out.good();
+        }
+    }
+}
@@ -1,3 +1,4 @@
+#include <utils.hpp>
 #include <re2/re2.h>
 #include <pugixml.hpp>
 #include <set>
@@ -5,7 +6,11 @@
 #include <iomanip>
 #include <iostream>
 #include <algorithm>
+#include <cctype>
 #include <string_view>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
 #include <string>
 #include <regex>
 #include <unordered_set>
@@ -147,22 +152,105 @@ namespace AnimepaheCLI
         if (input == "all")
             return true;
 
-        int start, end;
-        return RE2::FullMatch(input, R"((\d+)-(\d+))", &start, &end) && start > 0 && end > start;
+        try
+        {
+            parseEpisodeRange(input);
+            return true;
+        }
+        catch (const std::exception &)
+        {
+            return false;
+        }
     }
 
-    /* parse episodes 1-15 */
-    std::vector<int> parseEpisodeRange(const std::string &input)
+    /* parse selections like 1,5,12-20,150,400- into sorted, merged ranges */
+    std::vector<EpisodeRange> parseEpisodeRange(const std::string &input)
     {
-        int start, end;
-        if (RE2::FullMatch(input, R"((\d+)-(\d+))", &start, &end))
+        std::vector<EpisodeRange> ranges;
+        std::stringstream items(input);
+        std::string item;
+        while (std::getline(items, item, ','))
         {
-            if (start > 0 && end > start)
+            int start = 0, end = 0;
+            std::string open;
+            if (RE2::FullMatch(item, R"((\d{1,6}))", &start))
+            {
+                end = start;
+            }
+            else if (!RE2::FullMatch(item, R"((\d{1,6})-(\d{0,6}))", &start, &open) ||
+                     (!open.empty() && (end = std::stoi(open)) < start))
+            {
+                throw std::invalid_argument("Invalid episode range format");
+            }
+            if (start <= 0)
             {
-                return {start, end};
+                throw std::invalid_argument("Invalid episode range format");
             }
+            ranges.push_back(EpisodeRange{start, end});
         }
-        throw std::invalid_argument("Invalid episode range format");
+        if (ranges.empty() || input.back() == ',')
+        {
+            throw std::invalid_argument("Invalid episode range format");
+        }
+
+        std::sort(ranges.begin(), ranges.end(), [](const EpisodeRange &a, const EpisodeRange &b)
+                  { return a.first < b.first; });
+
+        /* overlapping or adjacent items collapse, an open end swallows everything after it */
+        std::vector<EpisodeRange> merged{ranges.front()};
+        for (size_t i = 1; i < ranges.size(); ++i)
+        {
+            EpisodeRange &back = merged.back();
+            if (back.last == 0 || ranges[i].first <= back.last + 1)
+            {
+                if (back.last != 0)
+                {
+                    back.last = ranges[i].last == 0 ? 0 : std::max(back.last, ranges[i].last);
+                }
+                continue;
+            }
+            merged.push_back(ranges[i]);
+        }
+        return merged;
+    }
+
+    /* API pages (30 episodes each) that hold the selection, ascending and without repeats */
+    std::vector<int> getSelectionPages(const std::vector<EpisodeRange> &ranges, int total)
+    {
+        std::set<int> pages;
+        for (const auto &range : ranges)
+        {
+            int last = range.last == 0 ? total : std::min(range.last, total);
+            for (int page = getPage(range.first); page <= getPage(last) && range.first <= last; ++page)
+            {
+                pages.insert(page);
+            }
+        }
+        return std::vector<int>(pages.begin(), pages.end());
+    }
+
+    bool isEpisodeSelected(const std::vector<EpisodeRange> &ranges, int number)
+    {
+        return std::any_of(ranges.begin(), ranges.end(), [number](const EpisodeRange &range)
+                           { return number >= range.first && (range.last == 0 || number <= range.last); });
+    }
+
+    std::string selectionToString(const std::vector<EpisodeRange> &ranges)
+    {
+        std::ostringstream oss;
+        oss << "[";
+        for (size_t i = 0; i < ranges.size(); ++i)
+        {
+            oss << "EP" << padIntWithZero(ranges[i].first);
+            if (ranges[i].last == 0)
+                oss << "-";
+            else if (ranges[i].last != ranges[i].first)
+                oss << "-EP" << padIntWithZero(ranges[i].last);
+            if (i != ranges.size() - 1)
+                oss << ", ";
+        }
+        oss << "]";
+        return oss.str();
     }
 
     std::string unescape_html_entities(const std::string &input)
@@ -188,4 +276,92 @@ namespace AnimepaheCLI
         oss << std::setw(2) << std::setfill('0') << num;
         return oss.str();
     }
+
+    std::string fileParameter(const std::string &url)
+    {
+        static const std::regex filenamePattern(R"([\?&#]file=([^&]+))");
+        std::smatch match;
+        return std::regex_search(url, match, filenamePattern) && match.size() > 1 ? match[1].str() : "";
+    }
+
+    bool parseByteSize(const std::string &text, uint64_t &bytes)
+    {
+        double value = 0.0;
+        std::string unit;
+        if (!RE2::FullMatch(text, R"((?i)\s*(\d+(?:\.\d+)?)\s*([kmgt]?)(?:i?b)?\s*)", &value, &unit))
+        {
+            return false;
+        }
+        static const std::string UNITS = "kmgt";
+        size_t power = unit.empty() ? 0 : UNITS.find(static_cast<char>(std::tolower(static_cast<unsigned char>(unit[0])))) + 1;
+        for (size_t i = 0; i < power; ++i)
+        {
+            value *= 1024.0;
+        }
+        if (value >= 18446744073709551615.0)
+        {
+            return false;
+        }
+        bytes = static_cast<uint64_t>(value);
+        return true;
+    }
+
+    std::string userCacheDirectory()
+    {
+        std::filesystem::path base;
+#ifdef _WIN32
+        if (const char *local = std::getenv("LOCALAPPDATA"))
+        {
+            base = local;
+        }
+#else
+        if (const char *cache = std::getenv("XDG_CACHE_HOME"); cache && *cache)
+        {
+            base = cache;
+        }
+        else if (const char *home = std::getenv("HOME"); home && *home)
+        {
+            base = std::filesystem::path(home) / ".cache";
+        }
+#endif
+        return base.empty() ? "" : (base / "animepahe-cli").string();
+    }
+
+    bool writeFileAtomically(const std::string &path, const std::string &contents, bool ownerOnly)
+    {
+        std::error_code ec;
+        std::filesystem::path target(path);
+        if (target.has_parent_path())
+        {
+            std::filesystem::create_directories(target.parent_path(), ec);
+        }
+        std::filesystem::path temporary = target;
+        temporary += ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            if (!file)
+            {
+                return false;
+            }
+            file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+            if (!file.flush())
+            {
+                file.close();
+                std::filesystem::remove(temporary, ec);
+                return false;
+            }
+        }
+        if (ownerOnly)
+        {
+            std::filesystem::permissions(temporary, std::filesystem::perms::owner_read | std::filesystem::perms::owner_write,
+                                         std::filesystem::perm_options::replace, ec);
+        }
+        std::filesystem::rename(temporary, target, ec);
+        if (ec)
+        {
+            std::filesystem::remove(temporary, ec);
+            return false;
+        }
+        return true;
+    }
 }
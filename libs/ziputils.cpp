@@ -1,133 +1,1081 @@
 #include "ziputils.hpp"
+#include "manifest.hpp"
 #include <filesystem>
 #include <stdexcept>
 #include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <ctime>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <thread>
 #include <vector>
-#include <zip.h>
+#include <libdeflate.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 
 namespace ZipUtils {
-    
+
+    namespace {
+        namespace fs = std::filesystem;
+
+        constexpr uint64_t ZIP32_LIMIT = 0xFFFFFFFFull;
+        constexpr size_t ZIP32_MAX_ENTRIES = 0xFFFF;
+        constexpr uint16_t VERSION_DEFAULT = 20;
+        constexpr uint16_t VERSION_ZIP64 = 45;
+        constexpr uint16_t FLAG_UTF8 = 0x0800;
+        constexpr uint16_t METHOD_STORE = 0;
+        constexpr uint16_t METHOD_DEFLATE = 8;
+        constexpr size_t COPY_BUFFER = 1 << 20;
+
+        /* same ratio as zlib's default level, at several times the speed */
+        constexpr int DEFLATE_LEVEL = 6;
+
+        /* compressible files are deflated in memory, anything larger is stored */
+        constexpr uint64_t DEFLATE_LIMIT = 64ull << 20;
+
+        /* finished entries the workers may keep ahead of the writer, per thread */
+        constexpr size_t PENDING_PER_THREAD = 2;
+
+        /* source bytes the workers may hold in memory at once (input and output buffers roughly double it) */
+        constexpr uint64_t DEFLATE_MEMORY_BUDGET = 256ull << 20;
+
+        const char* const MEDIA_EXTENSIONS[] = {
+            ".mp4", ".m4v", ".mkv", ".webm", ".avi", ".mov", ".ts", ".flv", ".wmv",
+            ".mp3", ".m4a", ".aac", ".ogg", ".opus", ".flac",
+            ".jpg", ".jpeg", ".png", ".gif", ".webp", ".avif",
+            ".zip", ".7z", ".rar", ".gz", ".xz", ".bz2", ".zst",
+        };
+
+        struct Entry {
+            fs::path path;
+            std::string name;      // path inside the archive, '/' separated
+            bool directory = false;
+            bool store = false;
+            uint64_t size = 0;
+            uint16_t time = 0;     // MS-DOS format
+            uint16_t date = 0;
+        };
+
+        /* result of a worker: deflated (or, when that did not pay off, raw) bytes of one entry */
+        struct Packed {
+            std::vector<unsigned char> data;
+            uint32_t crc = 0;
+            bool deflated = false;
+            bool ready = false;
+            std::exception_ptr error;
+        };
+
+        uint32_t crc32_update(uint32_t crc, const unsigned char* data, size_t size) {
+            return libdeflate_crc32(crc, data, size);
+        }
+
+        void dos_time(std::time_t seconds, uint16_t& time, uint16_t& date) {
+            std::tm local{};
+#ifdef _WIN32
+            localtime_s(&local, &seconds);
+#else
+            localtime_r(&seconds, &local);
+#endif
+            /* MS-DOS dates start in 1980 */
+            int year = std::max(local.tm_year + 1900, 1980) - 1980;
+            time = static_cast<uint16_t>((local.tm_hour << 11) | (local.tm_min << 5) | (local.tm_sec / 2));
+            date = static_cast<uint16_t>((year << 9) | ((local.tm_mon + 1) << 5) | local.tm_mday);
+        }
+
+        void dos_time(const fs::path& path, uint16_t& time, uint16_t& date) {
+            std::error_code ec;
+            auto written = fs::last_write_time(path, ec);
+            std::time_t seconds = std::time(nullptr);
+            if (!ec) {
+                /* file_clock has no portable conversion yet, go through both clocks' now() */
+                auto system = std::chrono::time_point_cast<std::chrono::system_clock::duration>(
+                    written - fs::file_time_type::clock::now() + std::chrono::system_clock::now());
+                seconds = std::chrono::system_clock::to_time_t(system);
+            }
+            dos_time(seconds, time, date);
+        }
+
+        std::vector<unsigned char> read_file(const fs::path& path, uint64_t size) {
+            std::ifstream in(path, std::ios::binary);
+            if (!in) {
+                throw std::runtime_error("Failed to open file: " + path.string());
+            }
+            std::vector<unsigned char> data(static_cast<size_t>(size));
+            if (size > 0 && !in.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(size))) {
+                throw std::runtime_error("Failed to read file: " + path.string());
+            }
+            return data;
+        }
+
+        /* one compressor per worker thread, libdeflate compressors are not shareable */
+        class Deflater {
+        public:
+            Deflater() : compressor_(libdeflate_alloc_compressor(DEFLATE_LEVEL)) {
+                if (!compressor_) {
+                    throw std::runtime_error("Failed to allocate deflate compressor");
+                }
+            }
+            ~Deflater() { libdeflate_free_compressor(compressor_); }
+            Deflater(const Deflater&) = delete;
+            Deflater& operator=(const Deflater&) = delete;
+
+            Packed pack(const Entry& entry) {
+                Packed packed;
+                std::vector<unsigned char> raw = read_file(entry.path, entry.size);
+                packed.crc = crc32_update(0, raw.data(), raw.size());
+
+                std::vector<unsigned char> out(libdeflate_deflate_compress_bound(compressor_, raw.size()));
+                size_t size = libdeflate_deflate_compress(compressor_, raw.data(), raw.size(), out.data(), out.size());
+                if (size > 0 && size < raw.size()) {
+                    out.resize(size);
+                    packed.data = std::move(out);
+                    packed.deflated = true;
+                } else {
+                    packed.data = std::move(raw);
+                }
+                return packed;
+            }
+
+        private:
+            libdeflate_compressor* compressor_;
+        };
+
+        /**
+         * Sequential ZIP writer. Entries are written in the order they are
+         * added; sizes, offsets and entry counts past the 32-bit fields get
+         * ZIP64 extra fields and end records.
+         */
+        class ArchiveWriter {
+        public:
+            explicit ArchiveWriter(const fs::path& path) : path_(path) {
+#ifdef _WIN32
+                file_ = _wfopen(path.c_str(), L"wb");
+#else
+                file_ = std::fopen(path.c_str(), "wb");
+#endif
+                if (!file_) {
+                    throw std::runtime_error("Failed to create ZIP file: " + path.string());
+                }
+                std::setvbuf(file_, nullptr, _IOFBF, COPY_BUFFER);
+            }
+
+            ~ArchiveWriter() {
+                if (file_) {
+                    std::fclose(file_);
+                }
+            }
+
+            ArchiveWriter(const ArchiveWriter&) = delete;
+            ArchiveWriter& operator=(const ArchiveWriter&) = delete;
+
+            void add_directory(const Entry& entry) {
+                Record record = make_record(entry.name + "/", entry, METHOD_STORE, 0, 0, 0);
+                record.directory = true;
+                write_local_header(record);
+                records_.push_back(std::move(record));
+            }
+
+            void add_packed(const Entry& entry, const Packed& packed) {
+                Record record = make_record(entry.name, entry, packed.deflated ? METHOD_DEFLATE : METHOD_STORE,
+                                            packed.crc, packed.data.size(), entry.size);
+                write_local_header(record);
+                write(packed.data.data(), packed.data.size());
+                records_.push_back(std::move(record));
+            }
+
+            /**
+             * Copy a file into a stored entry in COPY_BUFFER chunks, so memory
+             * does not grow with the file. The CRC is computed on the way and
+             * patched into the header; on_copied sees the running byte count.
+             */
+            void add_stored(const Entry& entry, const std::function<void(uint64_t)>& on_copied) {
+                Record record = make_record(entry.name, entry, METHOD_STORE, 0, entry.size, entry.size);
+                write_local_header(record);
+
+                std::ifstream in(entry.path, std::ios::binary);
+                if (!in) {
+                    throw std::runtime_error("Failed to open file: " + entry.path.string());
+                }
+                std::vector<unsigned char> buffer(COPY_BUFFER);
+                uint64_t copied = 0;
+                uint32_t crc = 0;
+                while (copied < entry.size) {
+                    size_t want = static_cast<size_t>(std::min<uint64_t>(buffer.size(), entry.size - copied));
+                    in.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(want));
+                    size_t got = static_cast<size_t>(in.gcount());
+                    if (got == 0) {
+                        break;
+                    }
+                    crc = crc32_update(crc, buffer.data(), got);
+                    write(buffer.data(), got);
+                    copied += got;
+                    if (on_copied) {
+                        on_copied(copied);
+                    }
+                }
+                if (copied != entry.size) {
+                    throw std::runtime_error("File changed while zipping: " + entry.path.string());
+                }
+
+                record.crc = crc;
+                Bytes field;
+                field.u32(crc);
+                patch(record.offset + 14, field);
+                records_.push_back(std::move(record));
+            }
+
+            /**
+             * Stored entry whose data arrives in chunks. The final size is not
+             * known yet, so the local header always reserves the ZIP64 extra;
+             * CRC and sizes are patched in by end_streamed().
+             */
+            void begin_streamed(const Entry& entry) {
+                open_ = make_record(entry.name, entry, METHOD_STORE, 0, 0, 0);
+                open_.zip64 = true;
+                write_local_header(open_);
+            }
+
+            void append(const unsigned char* data, size_t size) {
+                open_.crc = crc32_update(open_.crc, data, size);
+                write(data, size);
+                open_.compressed += size;
+                open_.uncompressed += size;
+            }
+
+            void end_streamed() {
+                Bytes crc;
+                crc.u32(open_.crc);
+                patch(open_.offset + 14, crc);
+
+                /* local header is 30 bytes, then the name and the extra's id and length */
+                Bytes sizes;
+                sizes.u64(open_.uncompressed);
+                sizes.u64(open_.compressed);
+                patch(open_.offset + 30 + open_.name.size() + 4, sizes);
+                records_.push_back(std::move(open_));
+                open_ = {};
+            }
+
+            /* forget the open entry, whatever comes next overwrites its bytes */
+            void discard_streamed() {
+                offset_ = open_.offset;
+                seek(offset_);
+                open_ = {};
+            }
+
+            /* central directory and end records */
+            void finish() {
+                uint64_t directory_offset = offset_;
+                for (const Record& record : records_) {
+                    write_central_header(record);
+                }
+                uint64_t directory_size = offset_ - directory_offset;
+
+                bool zip64 = records_.size() >= ZIP32_MAX_ENTRIES ||
+                             directory_size >= ZIP32_LIMIT ||
+                             directory_offset >= ZIP32_LIMIT;
+                if (zip64) {
+                    uint64_t end64_offset = offset_;
+                    Bytes end64;
+                    end64.u32(0x06064b50);
+                    end64.u64(44);
+                    end64.u16(VERSION_ZIP64);
+                    end64.u16(VERSION_ZIP64);
+                    end64.u32(0);
+                    end64.u32(0);
+                    end64.u64(records_.size());
+                    end64.u64(records_.size());
+                    end64.u64(directory_size);
+                    end64.u64(directory_offset);
+                    write(end64);
+
+                    Bytes locator;
+                    locator.u32(0x07064b50);
+                    locator.u32(0);
+                    locator.u64(end64_offset);
+                    locator.u32(1);
+                    write(locator);
+                }
+
+                uint16_t count = static_cast<uint16_t>(std::min<size_t>(records_.size(), ZIP32_MAX_ENTRIES));
+                Bytes end;
+                end.u32(0x06054b50);
+                end.u16(0);
+                end.u16(0);
+                end.u16(count);
+                end.u16(count);
+                end.u32(static_cast<uint32_t>(std::min(directory_size, ZIP32_LIMIT)));
+                end.u32(static_cast<uint32_t>(std::min(directory_offset, ZIP32_LIMIT)));
+                end.u16(0);
+                write(end);
+
+                if (std::fclose(file_) != 0) {
+                    file_ = nullptr;
+                    throw std::runtime_error("Failed to finish ZIP file");
+                }
+                file_ = nullptr;
+
+                /* a discarded entry may have been longer than what followed it */
+                if (end_ > offset_) {
+                    std::error_code ec;
+                    fs::resize_file(path_, offset_, ec);
+                    if (ec) {
+                        throw std::runtime_error("Failed to finish ZIP file: " + ec.message());
+                    }
+                }
+            }
+
+            /* everything written so far is on the disk, not only in buffers */
+            void sync() {
+                if (std::fflush(file_) != 0) {
+                    throw std::runtime_error("Failed to write ZIP file");
+                }
+#ifdef _WIN32
+                int result = _commit(_fileno(file_));
+#else
+                int result = fsync(fileno(file_));
+#endif
+                if (result != 0) {
+                    throw std::runtime_error("Failed to flush ZIP file");
+                }
+                committed_ = records_.size();
+                committed_offset_ = offset_;
+            }
+
+            /**
+             * Back to the last sync(), e.g. after an entry failed half way.
+             * The stream is reopened, a failed write may have left it
+             * unusable, and the file is cut so the central directory fits.
+             */
+            void rollback() {
+                if (file_) {
+                    std::fclose(file_);
+                }
+#ifdef _WIN32
+                file_ = _wfopen(path_.c_str(), L"r+b");
+#else
+                file_ = std::fopen(path_.c_str(), "r+b");
+#endif
+                if (!file_) {
+                    throw std::runtime_error("Failed to reopen ZIP file: " + path_.string());
+                }
+                std::error_code ec;
+                fs::resize_file(path_, committed_offset_, ec);
+                if (ec) {
+                    throw std::runtime_error("Failed to truncate ZIP file: " + ec.message());
+                }
+                records_.resize(committed_);
+                open_ = {};
+                offset_ = end_ = committed_offset_;
+                seek(offset_);
+            }
+
+            uint64_t size() const { return offset_; }
+            size_t count() const { return records_.size(); }
+            size_t committed() const { return committed_; }
+
+        private:
+            struct Record {
+                std::string name;
+                uint16_t method = METHOD_STORE;
+                uint16_t time = 0;
+                uint16_t date = 0;
+                uint32_t crc = 0;
+                uint64_t compressed = 0;
+                uint64_t uncompressed = 0;
+                uint64_t offset = 0;
+                bool directory = false;
+                bool zip64 = false;   // sizes do not fit the local header
+            };
+
+            /* little-endian field builder */
+            struct Bytes {
+                std::vector<unsigned char> data;
+                void u16(uint16_t value) {
+                    data.push_back(static_cast<unsigned char>(value));
+                    data.push_back(static_cast<unsigned char>(value >> 8));
+                }
+                void u32(uint32_t value) {
+                    u16(static_cast<uint16_t>(value));
+                    u16(static_cast<uint16_t>(value >> 16));
+                }
+                void u64(uint64_t value) {
+                    u32(static_cast<uint32_t>(value));
+                    u32(static_cast<uint32_t>(value >> 32));
+                }
+                void str(const std::string& value) {
+                    data.insert(data.end(), value.begin(), value.end());
+                }
+            };
+
+            Record make_record(std::string name, const Entry& entry, uint16_t method,
+                               uint32_t crc, uint64_t compressed, uint64_t uncompressed) {
+                Record record;
+                record.name = std::move(name);
+                record.method = method;
+                record.time = entry.time;
+                record.date = entry.date;
+                record.crc = crc;
+                record.compressed = compressed;
+                record.uncompressed = uncompressed;
+                record.offset = offset_;
+                record.zip64 = compressed >= ZIP32_LIMIT || uncompressed >= ZIP32_LIMIT;
+                return record;
+            }
+
+            void write_local_header(const Record& record) {
+                Bytes header;
+                header.u32(0x04034b50);
+                header.u16(record.zip64 ? VERSION_ZIP64 : VERSION_DEFAULT);
+                header.u16(FLAG_UTF8);
+                header.u16(record.method);
+                header.u16(record.time);
+                header.u16(record.date);
+                header.u32(record.crc);
+                header.u32(record.zip64 ? static_cast<uint32_t>(ZIP32_LIMIT) : static_cast<uint32_t>(record.compressed));
+                header.u32(record.zip64 ? static_cast<uint32_t>(ZIP32_LIMIT) : static_cast<uint32_t>(record.uncompressed));
+                header.u16(static_cast<uint16_t>(record.name.size()));
+                header.u16(record.zip64 ? 20 : 0);
+                header.str(record.name);
+                if (record.zip64) {
+                    header.u16(0x0001);
+                    header.u16(16);
+                    header.u64(record.uncompressed);
+                    header.u64(record.compressed);
+                }
+                write(header);
+            }
+
+            void write_central_header(const Record& record) {
+                bool big_uncompressed = record.uncompressed >= ZIP32_LIMIT;
+                bool big_compressed = record.compressed >= ZIP32_LIMIT;
+                bool big_offset = record.offset >= ZIP32_LIMIT;
+
+                /* the ZIP64 extra holds exactly the fields that overflowed, in this order */
+                Bytes extra;
+                if (big_uncompressed || big_compressed || big_offset) {
+                    extra.u16(0x0001);
+                    extra.u16(static_cast<uint16_t>(8 * (big_uncompressed + big_compressed + big_offset)));
+                    if (big_uncompressed) extra.u64(record.uncompressed);
+                    if (big_compressed) extra.u64(record.compressed);
+                    if (big_offset) extra.u64(record.offset);
+                }
+                uint16_t version = extra.data.empty() ? VERSION_DEFAULT : VERSION_ZIP64;
+
+                Bytes header;
+                header.u32(0x02014b50);
+                header.u16(version);
+                header.u16(version);
+                header.u16(FLAG_UTF8);
+                header.u16(record.method);
+                header.u16(record.time);
+                header.u16(record.date);
+                header.u32(record.crc);
+                header.u32(static_cast<uint32_t>(std::min(record.compressed, ZIP32_LIMIT)));
+                header.u32(static_cast<uint32_t>(std::min(record.uncompressed, ZIP32_LIMIT)));
+                header.u16(static_cast<uint16_t>(record.name.size()));
+                header.u16(static_cast<uint16_t>(extra.data.size()));
+                header.u16(0);
+                header.u16(0);
+                header.u16(0);
+                header.u32(record.directory ? 0x10 : 0);
+                header.u32(static_cast<uint32_t>(std::min(record.offset, ZIP32_LIMIT)));
+                header.str(record.name);
+                header.data.insert(header.data.end(), extra.data.begin(), extra.data.end());
+                write(header);
+            }
+
+            /* overwrite already written header fields */
+            void patch(uint64_t position, const Bytes& field) {
+                seek(position);
+                if (std::fwrite(field.data.data(), 1, field.data.size(), file_) != field.data.size()) {
+                    throw std::runtime_error("Failed to write ZIP file");
+                }
+                seek(offset_);
+            }
+
+            void seek(uint64_t position) {
+#ifdef _WIN32
+                int result = _fseeki64(file_, static_cast<long long>(position), SEEK_SET);
+#else
+                int result = fseeko(file_, static_cast<off_t>(position), SEEK_SET);
+#endif
+                if (result != 0) {
+                    throw std::runtime_error("Failed to seek in ZIP file");
+                }
+            }
+
+            void write(const Bytes& bytes) {
+                write(bytes.data.data(), bytes.data.size());
+            }
+
+            void write(const unsigned char* data, size_t size) {
+                if (size > 0 && std::fwrite(data, 1, size, file_) != size) {
+                    throw std::runtime_error("Failed to write ZIP file");
+                }
+                offset_ += size;
+                end_ = std::max(end_, offset_);
+            }
+
+            fs::path path_;
+            std::FILE* file_ = nullptr;
+            uint64_t offset_ = 0;
+            uint64_t end_ = 0;        // furthest byte ever written
+            std::vector<Record> records_;
+            Record open_;             // streamed entry in progress
+            size_t committed_ = 0;    // records_ at the last sync()
+            uint64_t committed_offset_ = 0;
+        };
+
+        /**
+         * Deflates the compressible entries on worker threads, in entry order,
+         * at most `window` entries and DEFLATE_MEMORY_BUDGET bytes ahead of
+         * the writer so memory stays bounded however many cores there are.
+         */
+        class DeflatePool {
+        public:
+            DeflatePool(const std::vector<Entry>& entries, std::vector<size_t> jobs, size_t threads)
+                : entries_(entries), jobs_(std::move(jobs)), packed_(entries.size()),
+                  window_(std::max<size_t>(threads, 1) * PENDING_PER_THREAD) {
+                for (size_t i = 0; i < threads; ++i) {
+                    workers_.emplace_back(&DeflatePool::work, this);
+                }
+            }
+
+            ~DeflatePool() {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    stopping_ = true;
+                }
+                changed_.notify_all();
+                for (auto& worker : workers_) {
+                    worker.join();
+                }
+            }
+
+            DeflatePool(const DeflatePool&) = delete;
+            DeflatePool& operator=(const DeflatePool&) = delete;
+
+            /* wait for an entry, the caller releases it with release() once written */
+            Packed& take(size_t index) {
+                std::unique_lock<std::mutex> lock(mutex_);
+                changed_.wait(lock, [&] { return packed_[index].ready; });
+                if (packed_[index].error) {
+                    std::rethrow_exception(packed_[index].error);
+                }
+                return packed_[index];
+            }
+
+            void release(size_t index) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    packed_[index].data = {};
+                    released_++;
+                    held_bytes_ -= entries_[index].size;
+                }
+                changed_.notify_all();
+            }
+
+        private:
+            void work() {
+                Deflater deflater;
+                while (true) {
+                    size_t job;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex_);
+                        changed_.wait(lock, [&] {
+                            return stopping_ || next_ >= jobs_.size() || claimable();
+                        });
+                        if (stopping_ || next_ >= jobs_.size()) {
+                            return;
+                        }
+                        job = jobs_[next_++];
+                        held_bytes_ += entries_[job].size;
+                    }
+
+                    Packed packed;
+                    try {
+                        packed = deflater.pack(entries_[job]);
+                    } catch (...) {
+                        packed.error = std::current_exception();
+                    }
+                    packed.ready = true;
+
+                    {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        packed_[job] = std::move(packed);
+                    }
+                    changed_.notify_all();
+                }
+            }
+
+            /* the entry the writer waits for is always claimable, nothing before it is held then */
+            bool claimable() const {
+                if (next_ >= released_ + window_) {
+                    return false;
+                }
+                return held_bytes_ == 0 || held_bytes_ + entries_[jobs_[next_]].size <= DEFLATE_MEMORY_BUDGET;
+            }
+
+            const std::vector<Entry>& entries_;
+            std::vector<size_t> jobs_;
+            std::vector<Packed> packed_;
+            size_t window_;
+            size_t next_ = 0;
+            size_t released_ = 0;
+            uint64_t held_bytes_ = 0;   // sizes of claimed, not yet released entries
+            bool stopping_ = false;
+            std::mutex mutex_;
+            std::condition_variable changed_;
+            std::vector<std::thread> workers_;
+        };
+    }
+
+    namespace {
+        uint16_t le16(const unsigned char* p) {
+            return static_cast<uint16_t>(p[0] | (p[1] << 8));
+        }
+
+        uint32_t le32(const unsigned char* p) {
+            return le16(p) | (static_cast<uint32_t>(le16(p + 2)) << 16);
+        }
+
+        uint64_t le64(const unsigned char* p) {
+            return le32(p) | (static_cast<uint64_t>(le32(p + 4)) << 32);
+        }
+
+        /* values of the ZIP64 extra (0x0001) for the fields that hold 0xFFFFFFFF, false when it is missing or short */
+        bool read_zip64_extra(const unsigned char* extra, size_t size,
+                              uint64_t* uncompressed, uint64_t* compressed, uint64_t* offset) {
+            size_t pos = 0;
+            while (pos + 4 <= size) {
+                uint16_t id = le16(extra + pos);
+                uint16_t length = le16(extra + pos + 2);
+                if (pos + 4 + length > size) {
+                    return false;
+                }
+                if (id == 0x0001) {
+                    const unsigned char* field = extra + pos + 4;
+                    size_t left = length;
+                    for (uint64_t* value : {uncompressed, compressed, offset}) {
+                        if (value && *value == ZIP32_LIMIT) {
+                            if (left < 8) {
+                                return false;
+                            }
+                            *value = le64(field);
+                            field += 8;
+                            left -= 8;
+                        }
+                    }
+                    return true;
+                }
+                pos += 4 + length;
+            }
+            return false;
+        }
+    }
+
+    size_t verify_archive(const std::string& zip_name) {
+        auto fail = [&zip_name](const std::string& what) {
+            throw std::runtime_error("Invalid ZIP file " + zip_name + ": " + what);
+        };
+
+        fs::path path(zip_name);
+        std::error_code ec;
+        uint64_t size = fs::file_size(path, ec);
+        std::ifstream in(path, std::ios::binary);
+        if (ec || !in) {
+            fail("cannot be opened");
+        }
+        auto read_at = [&](uint64_t position, size_t length) {
+            if (position > size || length > size - position) {
+                fail("truncated");
+            }
+            std::vector<unsigned char> data(length);
+            in.seekg(static_cast<std::streamoff>(position));
+            if (length > 0 && !in.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(length))) {
+                fail("read error");
+            }
+            return data;
+        };
+
+        // End of central directory, followed by a comment of up to 64 KiB
+        if (size < 22) {
+            fail("too small");
+        }
+        uint64_t tail_size = std::min<uint64_t>(size, 22 + 0xFFFF);
+        std::vector<unsigned char> tail = read_at(size - tail_size, static_cast<size_t>(tail_size));
+        size_t found = tail.size();
+        for (size_t i = tail.size() - 22 + 1; i-- > 0;) {
+            if (le32(tail.data() + i) == 0x06054b50) {
+                found = i;
+                break;
+            }
+        }
+        if (found == tail.size()) {
+            fail("no end of central directory record");
+        }
+        const unsigned char* end = tail.data() + found;
+        uint64_t end_offset = size - tail_size + found;
+        uint64_t count = le16(end + 10);
+        uint64_t directory_size = le32(end + 12);
+        uint64_t directory_offset = le32(end + 16);
+
+        if (count == ZIP32_MAX_ENTRIES || directory_size == ZIP32_LIMIT || directory_offset == ZIP32_LIMIT) {
+            if (end_offset < 20) {
+                fail("no ZIP64 end of central directory locator");
+            }
+            std::vector<unsigned char> locator = read_at(end_offset - 20, 20);
+            if (le32(locator.data()) != 0x07064b50) {
+                fail("no ZIP64 end of central directory locator");
+            }
+            std::vector<unsigned char> end64 = read_at(le64(locator.data() + 8), 56);
+            if (le32(end64.data()) != 0x06064b50) {
+                fail("no ZIP64 end of central directory record");
+            }
+            count = le64(end64.data() + 32);
+            directory_size = le64(end64.data() + 40);
+            directory_offset = le64(end64.data() + 48);
+        }
+        if (directory_offset > end_offset || directory_size > end_offset - directory_offset) {
+            fail("central directory out of bounds");
+        }
+
+        std::vector<unsigned char> directory = read_at(directory_offset, static_cast<size_t>(directory_size));
+        std::vector<std::pair<uint64_t, uint64_t>> spans;
+        size_t pos = 0;
+        for (uint64_t i = 0; i < count; ++i) {
+            if (pos + 46 > directory.size() || le32(directory.data() + pos) != 0x02014b50) {
+                fail("central directory truncated");
+            }
+            const unsigned char* header = directory.data() + pos;
+            uint64_t compressed = le32(header + 20);
+            uint64_t uncompressed = le32(header + 24);
+            size_t name_length = le16(header + 28);
+            size_t extra_length = le16(header + 30);
+            size_t comment_length = le16(header + 32);
+            uint64_t offset = le32(header + 42);
+            if (pos + 46 + name_length + extra_length + comment_length > directory.size()) {
+                fail("central directory truncated");
+            }
+            std::string name(reinterpret_cast<const char*>(header + 46), name_length);
+            if ((compressed == ZIP32_LIMIT || uncompressed == ZIP32_LIMIT || offset == ZIP32_LIMIT) &&
+                !read_zip64_extra(header + 46 + name_length, extra_length, &uncompressed, &compressed, &offset)) {
+                fail("missing ZIP64 extra for " + name);
+            }
+
+            // The local header must name the same entry with the same sizes
+            std::vector<unsigned char> local = read_at(offset, 30);
+            if (le32(local.data()) != 0x04034b50) {
+                fail("bad local header for " + name);
+            }
+            size_t local_name_length = le16(local.data() + 26);
+            size_t local_extra_length = le16(local.data() + 28);
+            std::vector<unsigned char> local_tail = read_at(offset + 30, local_name_length + local_extra_length);
+            if (std::string(local_tail.begin(), local_tail.begin() + local_name_length) != name) {
+                fail("local header name differs for " + name);
+            }
+            uint64_t local_compressed = le32(local.data() + 18);
+            uint64_t local_uncompressed = le32(local.data() + 22);
+            bool descriptor = (le16(local.data() + 6) & 0x0008) != 0;
+            if (!descriptor) {
+                if ((local_compressed == ZIP32_LIMIT || local_uncompressed == ZIP32_LIMIT) &&
+                    !read_zip64_extra(local_tail.data() + local_name_length, local_extra_length,
+                                      &local_uncompressed, &local_compressed, nullptr)) {
+                    fail("missing local ZIP64 extra for " + name);
+                }
+                if (local_compressed != compressed || local_uncompressed != uncompressed ||
+                    le32(local.data() + 14) != le32(header + 16)) {
+                    fail("local header sizes or CRC differ for " + name);
+                }
+            }
+
+            uint64_t data_end = offset + 30 + local_name_length + local_extra_length + compressed;
+            if (data_end > directory_offset) {
+                fail("data of " + name + " runs into the central directory");
+            }
+            spans.emplace_back(offset, data_end);
+            pos += 46 + name_length + extra_length + comment_length;
+        }
+        if (pos != directory.size()) {
+            fail("central directory size mismatch");
+        }
+
+        std::sort(spans.begin(), spans.end());
+        for (size_t i = 1; i < spans.size(); ++i) {
+            if (spans[i].first < spans[i - 1].second) {
+                fail("overlapping entries");
+            }
+        }
+        return static_cast<size_t>(count);
+    }
+
+    struct ZipWriter::Impl {
+        explicit Impl(const fs::path& target) : target(target), path(part_path(target)), writer(path) {}
+
+        static fs::path part_path(fs::path target) {
+            target += ".part";
+            return target;
+        }
+
+        fs::path target;   // replaced only by a finished archive
+        fs::path path;     // <target>.part while writing
+        ArchiveWriter writer;
+        bool open = false;
+        bool closed = false;
+    };
+
+    ZipWriter::ZipWriter(const std::string& zip_name) : impl_(std::make_unique<Impl>(fs::path(zip_name))) {}
+
+    ZipWriter::~ZipWriter() {
+        if (!impl_->closed) {
+            // Without a central directory the archive is unreadable, do not leave it behind
+            fs::path path = impl_->path;
+            impl_.reset();
+            std::error_code ec;
+            fs::remove(path, ec);
+        }
+    }
+
+    void ZipWriter::begin_entry(const std::string& name) {
+        if (impl_->open) {
+            throw std::runtime_error("ZIP entry already open: " + name);
+        }
+        Entry entry;
+        entry.name = name;
+        dos_time(std::time(nullptr), entry.time, entry.date);
+        impl_->writer.begin_streamed(entry);
+        impl_->open = true;
+    }
+
+    void ZipWriter::write(const char* data, size_t size) {
+        impl_->writer.append(reinterpret_cast<const unsigned char*>(data), size);
+    }
+
+    void ZipWriter::end_entry() {
+        impl_->writer.end_streamed();
+        impl_->open = false;
+    }
+
+    void ZipWriter::add_file(const std::string& path, const std::string& name) {
+        if (impl_->open) {
+            throw std::runtime_error("ZIP entry already open: " + name);
+        }
+        Entry entry;
+        entry.path = fs::path(path);
+        entry.name = name;
+        std::error_code ec;
+        entry.size = fs::file_size(entry.path, ec);
+        if (ec) {
+            throw std::runtime_error("Failed to open file: " + path);
+        }
+        dos_time(entry.path, entry.time, entry.date);
+        impl_->writer.add_stored(entry, nullptr);
+    }
+
+    void ZipWriter::commit() {
+        impl_->writer.sync();
+    }
+
+    void ZipWriter::discard_entry() {
+        if (impl_->open) {
+            impl_->writer.discard_streamed();
+            impl_->open = false;
+        }
+    }
+
+    void ZipWriter::close() {
+        discard_entry();
+        impl_->writer.finish();
+        verify_archive(impl_->path.string());
+
+        // An archive from an earlier run is only replaced by a complete one
+        std::error_code ec;
+        fs::rename(impl_->path, impl_->target, ec);
+        if (ec) {
+            throw std::runtime_error("Failed to replace " + impl_->target.string() + ": " + ec.message());
+        }
+        impl_->path = impl_->target;
+        impl_->closed = true;
+    }
+
+    void ZipWriter::close_committed() {
+        // Kept even if the central directory fails, committed entries can still be recovered (zip -FF)
+        impl_->closed = true;
+        impl_->open = false;
+        impl_->writer.rollback();
+        impl_->writer.finish();
+        verify_archive(impl_->path.string());
+
+        // A partial archive takes the final name only when there is no earlier one to lose
+        std::error_code ec;
+        if (!fs::exists(impl_->target, ec) && !ec) {
+            fs::rename(impl_->path, impl_->target, ec);
+            if (!ec) {
+                impl_->path = impl_->target;
+            }
+        }
+    }
+
+    std::string ZipWriter::path() const {
+        return impl_->path.string();
+    }
+
+    size_t ZipWriter::entries() const {
+        return impl_->writer.count();
+    }
+
+    size_t ZipWriter::committed() const {
+        return impl_->writer.committed();
+    }
+
+    uint64_t ZipWriter::bytes() const {
+        return impl_->writer.size();
+    }
+
+    bool is_compressed_media(const std::string& path) {
+        std::string extension = fs::path(path).extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return std::find(std::begin(MEDIA_EXTENSIONS), std::end(MEDIA_EXTENSIONS), extension) != std::end(MEDIA_EXTENSIONS);
+    }
+
     bool zip_directory(
-        const std::string& directory_path, 
-        const std::string& zip_name, 
+        const std::string& directory_path,
+        const std::string& zip_name,
         bool delete_source,
-        ProgressCallback progress_callback
+        ProgressCallback progress_callback,
+        ZipStats* stats
     ) {
-        namespace fs = std::filesystem;
-        
-        /* Check if source directory exists */ 
+        auto started = std::chrono::steady_clock::now();
+
+        /* Check if source directory exists */
         if (!fs::exists(directory_path) || !fs::is_directory(directory_path)) {
             throw std::runtime_error("Directory does not exist: " + directory_path);
         }
-        
-        // First pass: count files and calculate total size for progress tracking
-        std::vector<fs::directory_entry> entries;
+
+        // First pass: collect entries, sizes and how each file will be written
+        std::vector<Entry> entries;
+        std::vector<size_t> jobs;
         size_t total_bytes = 0;
-        
-        for (const auto& entry : fs::recursive_directory_iterator(directory_path)) {
-            entries.push_back(entry);
-            if (entry.is_regular_file()) {
+        fs::path base_path(directory_path);
+
+        for (const auto& item : fs::recursive_directory_iterator(directory_path)) {
+            if (!item.is_directory() && !item.is_regular_file()) {
+                continue;
+            }
+            // The download manifest is bookkeeping of the CLI, not part of the series
+            if (item.is_regular_file() && AnimepaheCLI::Manifest::isManifestFile(item.path().filename().string())) {
+                continue;
+            }
+
+            Entry entry;
+            entry.path = item.path();
+            entry.directory = item.is_directory();
+
+            // Relative, '/' separated, UTF-8 path inside the archive
+            std::u8string relative = fs::relative(item.path(), base_path).generic_u8string();
+            entry.name.assign(relative.begin(), relative.end());
+            dos_time(item.path(), entry.time, entry.date);
+
+            if (!entry.directory) {
                 std::error_code ec;
-                auto size = fs::file_size(entry.path(), ec);
-                if (!ec) {
-                    total_bytes += size;
+                entry.size = fs::file_size(item.path(), ec);
+                if (ec) {
+                    entry.size = 0;
+                }
+                total_bytes += entry.size;
+                entry.store = entry.size == 0 || entry.size > DEFLATE_LIMIT || is_compressed_media(entry.path.string());
+                if (!entry.store) {
+                    jobs.push_back(entries.size());
                 }
             }
+            entries.push_back(std::move(entry));
         }
-        
-        // Create ZIP file
-        struct zip_t *zip = zip_open(zip_name.c_str(), ZIP_DEFAULT_COMPRESSION_LEVEL, 'w');
-        if (!zip) {
-            throw std::runtime_error("Failed to create ZIP file: " + zip_name);
-        }
-        
+
+        size_t threads = std::min<size_t>(jobs.size(), std::max(1u, std::thread::hardware_concurrency()));
+        ZipStats summary;
+        summary.entries = entries.size();
+        summary.threads = threads;
+        summary.input_bytes = total_bytes;
+
         try {
-            // Get the base directory name for relative paths
-            fs::path base_path(directory_path);
-            size_t current_file_index = 0;
+            ArchiveWriter writer{fs::path(zip_name)};
+            DeflatePool pool(entries, jobs, threads);
             size_t bytes_processed = 0;
-            
-            // Process all files and directories
-            for (const auto& entry : entries) {
-                // Get relative path from base directory
-                fs::path relative_path = fs::relative(entry.path(), base_path);
-                std::string zip_entry_path = relative_path.string();
-                
-                // Convert Windows backslashes to forward slashes for ZIP compatibility
-                std::replace(zip_entry_path.begin(), zip_entry_path.end(), '\\', '/');
-                
+
+            for (size_t i = 0; i < entries.size(); ++i) {
+                const Entry& entry = entries[i];
+
                 // Report progress before processing each entry
                 if (progress_callback) {
-                    progress_callback(current_file_index, entries.size(), entry.path().string(), bytes_processed, total_bytes);
-                }
-                
-                if (entry.is_directory()) {
-                    // Add directory entry (with trailing slash)
-                    zip_entry_path += "/";
-                    if (zip_entry_open(zip, zip_entry_path.c_str()) < 0) {
-                        zip_close(zip);
-                        throw std::runtime_error("Failed to add directory to ZIP: " + zip_entry_path);
-                    }
-                    zip_entry_close(zip);
-                } else if (entry.is_regular_file()) {
-                    // Add file entry
-                    if (zip_entry_open(zip, zip_entry_path.c_str()) < 0) {
-                        zip_close(zip);
-                        throw std::runtime_error("Failed to open ZIP entry: " + zip_entry_path);
-                    }
-                    
-                    if (zip_entry_fwrite(zip, entry.path().string().c_str()) < 0) {
-                        zip_entry_close(zip);
-                        zip_close(zip);
-                        throw std::runtime_error("Failed to write file to ZIP: " + entry.path().string());
-                    }
-                    
-                    // Update bytes processed
-                    std::error_code ec;
-                    auto file_size = fs::file_size(entry.path(), ec);
-                    if (!ec) {
-                        bytes_processed += file_size;
-                    }
-                    
-                    zip_entry_close(zip);
-                }
-                
-                current_file_index++;
-            }
-            
-            // Final progress update
-            if (progress_callback) {
-                progress_callback(entries.size(), entries.size(), "Compression complete", total_bytes, total_bytes);
-            }
-            
-            // Close ZIP file
-            zip_close(zip);
-            
-            // Delete source directory if requested
-            if (delete_source) {
-                std::error_code ec;
-                fs::remove_all(directory_path, ec);
-                if (ec) {
-                    throw std::runtime_error("Failed to delete source directory: " + ec.message());
+                    progress_callback(i, entries.size(), entry.path.string(), bytes_processed, total_bytes);
                 }
+
+                if (entry.directory) {
+                    writer.add_directory(entry);
+                } else if (entry.store) {
+                    writer.add_stored(entry, [&](uint64_t copied) {
+                        if (progress_callback) {
+                            progress_callback(i, entries.size(), entry.path.string(), bytes_processed + copied, total_bytes);
+                        }
+                    });
+                    summary.stored++;
+                } else {
+                    const Packed& packed = pool.take(i);
+                    writer.add_packed(entry, packed);
+                    packed.deflated ? summary.deflated++ : summary.stored++;
+                    pool.release(i);
+                }
+                bytes_processed += entry.size;
             }
-            
-            return true;
-            
+
+            writer.finish();
+            summary.archive_bytes = writer.size();
+            verify_archive(zip_name);
         } catch (...) {
-            // Clean up ZIP file on error
-            zip_close(zip);
+            // Do not leave a truncated archive behind
+            std::error_code ec;
+            fs::remove(zip_name, ec);
             throw;
         }
+
+        // Final progress update
+        if (progress_callback) {
+            progress_callback(entries.size(), entries.size(), "Compression complete", total_bytes, total_bytes);
+        }
+
+        // Delete source directory if requested
+        if (delete_source) {
+            std::error_code ec;
+            fs::remove_all(directory_path, ec);
+            if (ec) {
+                throw std::runtime_error("Failed to delete source directory: " + ec.message());
+            }
+        }
+
+        summary.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        if (stats) {
+            *stats = summary;
+        }
+        return true;
     }
-    
+
     bool zip_directory(const std::string& directory_path, const std::string& zip_name) {
         return zip_directory(directory_path, zip_name, false, nullptr);
     }
-    
+
     bool zip_directory(
-        const std::string& directory_path, 
-        const std::string& zip_name, 
+        const std::string& directory_path,
+        const std::string& zip_name,
         ProgressCallback progress_callback
     ) {
         return zip_directory(directory_path, zip_name, false, progress_callback);
@@ -2,13 +2,24 @@
 #include <fmt/core.h>
 #include <fmt/color.h>
 #include <string>
+#include <chrono>
+#include <filesystem>
+#include <future>
+#include <optional>
 #include <utils.hpp>
 #include <animepahe.hpp>
-#ifdef _WIN32
+#include <events.hpp>
+#include <metrics.hpp>
+#include <trace.hpp>
+#include <http.hpp>
+#include <session.hpp>
+#include <catalog.hpp>
+#include <scheduler.hpp>
+#include <hls.hpp>
 #include <githubupdater.hpp>
-#else
-#include "include/githubupdater_stub.h"
-#endif
+#include <livestream.hpp>
+#include <linkexport.hpp>
+#include <memory>
 
 using namespace AnimepaheCLI;
 
@@ -16,37 +27,133 @@ int main(int argc, char *argv[])
 {
     /**
      * -l, --link
-     * input anime series link or a single episode link
+     * input anime series link, a single episode link or a series title (looked up in the local catalog, then the site search)
      * -e, --episodes
      * all,1-15 all means full series, or episode range
      * -x, --export
      * saves all download links to a text file
      * -f, --filename
      * set custom export filename
+     * --export-format
+     * txt, aria2, jsonl or m3u, taken from the -f extension when not given
      * -q, --quality
      * set target quality, if available it will select otherwise fall back to maximum
      * -z, --zip
      * creates a zip from downloaded items
      * --rm-source
      * remove source files after zipping
+     * --archive
+     * package format for -z: zip (default), tar or tar.zst, implies -z
+     * --disk-limit
+     * with -z --rm-source, most bytes of finished episodes waiting to be packed, downloads pause above it (e.g. 20G)
+     * --order
+     * download order: index (default), smallest or largest first, sizes come from the preflight
+     * --zip-mode
+     * after (default) zips the whole series folder at the end, stream writes this run's episodes into the zip while they download
+     * --events
+     * output format, human (default) or json (one NDJSON event per line, no terminal escapes)
+     * --progress-interval
+     * minimum milliseconds between download_progress events in json mode
+     * --stats
+     * print per-phase counters and latencies at the end of the run
+     * --metrics-file
+     * write per-phase metrics as a prometheus textfile (node_exporter)
+     * --trace
+     * write http request and pipeline spans as chrome trace-event json (perfetto)
+     * --endpoint
+     * route every request through a local replay server, e.g. animepahe-mock
+     * --record
+     * record every response to a directory that animepahe-mock can replay
+     * --hedge
+     * resend a page, pahe.win or kwik request that is slower than this latency percentile (default 95 when given)
+     * --hedge-budget
+     * at most this percent of hedgeable requests get a duplicate
+     * --min-host-concurrency, --max-host-concurrency
+     * floor and ceiling of the requests in flight per host, the limit adapts in between
+     * --source
+     * download (kwik /f/ only), auto (default, the kwik player's HLS playlist when /f/ fails) or stream (playlist first)
+     * --segments
+     * playlist segments fetched at once per episode when it comes from the player
+     * --session-file
+     * where cookies and the kwik session are kept between runs (default in the user cache directory)
+     * --no-session
+     * keep cookies and the kwik session in memory only
+     * --catalog-file
+     * where the titles of searched and visited series are kept for -l "<title>" (default in the user cache directory)
+     * --stream
+     * watch while downloading: http (default, 127.0.0.1 on a free port), http:PORT, or stdout to pipe into a player
+     * --update-interval
+     * hours a cached update check stays valid, 0 disables it (never runs for json, piped or cron output)
      * --update
      * self update to the latest version */
 
     cxxopts::Options options("animepahe-cli", "AnimePahe CLI Downloader");
     options.add_options()
-    ("l,link", "Input anime series link or a single episode link", cxxopts::value<std::string>())
+    ("l,link", "Input anime series link, episode link or title", cxxopts::value<std::string>())
     ("e,episodes", "Specify episodes to download (all, 1-15)", cxxopts::value<std::string>()->default_value("all"))
     ("q,quality", "Set target quality", cxxopts::value<int>()->default_value("0"))
     ("x,export", "Export download links to a text file", cxxopts::value<bool>()->default_value("false"))
     ("f,filename", "Custom filname for exported file", cxxopts::value<std::string>()->default_value("links.txt"))
+    ("export-format", "Export file format (txt, aria2, jsonl, m3u)", cxxopts::value<std::string>()->default_value(""))
     ("z,zip", "Create a zip from downloaded items", cxxopts::value<bool>()->default_value("false"))
     ("rm-source", "Delete source files after zipping", cxxopts::value<bool>()->default_value("false"))
+    ("archive", "Package format (zip, tar, tar.zst), implies -z", cxxopts::value<std::string>()->default_value("zip"))
+    ("disk-limit", "Most bytes of episodes waiting to be packed with --rm-source (e.g. 20G)", cxxopts::value<std::string>()->default_value(""))
+    ("order", "Download order (index, smallest, largest)", cxxopts::value<std::string>()->default_value("index"))
+    ("zip-mode", "When to build the zip (stream, after)", cxxopts::value<std::string>()->default_value("after"))
+    ("events", "Output format (human, json)", cxxopts::value<std::string>()->default_value("human"))
+    ("progress-interval", "Milliseconds between progress events with --events json", cxxopts::value<int>()->default_value("1000"))
+    ("stats", "Print per-phase statistics at the end of the run", cxxopts::value<bool>()->default_value("false"))
+    ("metrics-file", "Write per-phase metrics to a Prometheus textfile", cxxopts::value<std::string>()->default_value(""))
+    ("trace", "Write request and stage spans to a Chrome trace-event file", cxxopts::value<std::string>()->default_value(""))
+    ("endpoint", "Send all requests to a local replay server (animepahe-mock)", cxxopts::value<std::string>()->default_value(""))
+    ("record", "Record every response to a directory for animepahe-mock", cxxopts::value<std::string>()->default_value(""))
+    ("hedge", "Duplicate requests slower than this latency percentile (0 = off)", cxxopts::value<int>()->implicit_value("95")->default_value("0"))
+    ("hedge-budget", "Percent of requests that may be duplicated by --hedge", cxxopts::value<int>()->default_value("10"))
+    ("min-host-concurrency", "Fewest requests in flight per host", cxxopts::value<int>()->default_value("1"))
+    ("max-host-concurrency", "Most requests in flight per host", cxxopts::value<int>()->default_value("16"))
+    ("source", "Episode source (download, auto, stream)", cxxopts::value<std::string>()->default_value("auto"))
+    ("segments", "Playlist segments fetched at once for player streams", cxxopts::value<int>()->default_value("8"))
+    ("session-file", "File that keeps cookies and the kwik session between runs", cxxopts::value<std::string>()->default_value(""))
+    ("no-session", "Do not read or write the session file", cxxopts::value<bool>()->default_value("false"))
+    ("catalog-file", "File that keeps series titles for lookups by name", cxxopts::value<std::string>()->default_value(""))
+    ("stream", "Serve the episode being downloaded (http, http:port, stdout)", cxxopts::value<std::string>()->implicit_value("http")->default_value(""))
+    ("update-interval", "Hours between background update checks (0 = never)", cxxopts::value<int>()->default_value("24"))
     ("upgrade", "Update to the latest version")
+    ("allow-unverified", "Let --upgrade install a release that publishes no SHA-256", cxxopts::value<bool>()->default_value("false"))
     ("h,help", "Print usage");
 
     /* version tag */
     const std::string VERSION = "v0.2.2-beta";
 
+    /* end-of-run reporting and session state, also runs when the pipeline fails half-way */
+    bool showStats = false;
+    std::string metricsFile;
+    auto reportMetrics = [&showStats, &metricsFile]()
+    {
+        if (showStats)
+        {
+            Metrics::printSummary();
+            Scheduler::printSummary();
+        }
+        if (!metricsFile.empty() && !Metrics::writePrometheus(metricsFile))
+        {
+            Events::print("\n * Failed to write metrics file: {}\n", metricsFile);
+        }
+        if (!Trace::write())
+        {
+            Events::print("\n * Failed to write trace file\n");
+        }
+        if (!Session::save())
+        {
+            Events::print("\n * Failed to write session file\n");
+        }
+        if (!Catalog::save())
+        {
+            Events::print("\n * Failed to write catalog file\n");
+        }
+    };
+
     try
     {
         auto result = options.parse(argc, argv);
@@ -60,6 +167,9 @@ int main(int argc, char *argv[])
 
         if (result.count("upgrade"))
         {
+            /* --endpoint also reaches the updater, e.g. animepahe-mock --release-tag */
+            Http::setEndpoint(result["endpoint"].as<std::string>());
+            updater.allowUnverified(result["allow-unverified"].as<bool>());
             updater.checkAndUpdate();
             return 0;
         }
@@ -70,20 +180,108 @@ int main(int argc, char *argv[])
         bool exportLinks = result["export"].as<bool>();
         bool createZip = result["zip"].as<bool>();
         bool removeSource = result["rm-source"].as<bool>();
+        std::string zipMode = result["zip-mode"].as<std::string>();
+        std::string archiveFormat = result["archive"].as<std::string>();
+        std::string order = result["order"].as<std::string>();
         std::string export_filename = result["filename"].as<std::string>();
+        std::string exportFormat = result["export-format"].as<std::string>();
+        std::string eventsFormat = result["events"].as<std::string>();
+        int progressInterval = result["progress-interval"].as<int>();
+
+        if (eventsFormat != "human" && eventsFormat != "json")
+        {
+            throw std::runtime_error(fmt::format("{} is not valid for --events [human|json]", eventsFormat));
+        }
+        if (archiveFormat != "zip" && archiveFormat != "tar" && archiveFormat != "tar.zst")
+        {
+            throw std::runtime_error(fmt::format("{} is not valid for --archive [zip|tar|tar.zst]", archiveFormat));
+        }
+        if (result.count("archive"))
+        {
+            createZip = true;
+        }
+        if (order != "index" && order != "smallest" && order != "largest")
+        {
+            throw std::runtime_error(fmt::format("{} is not valid for --order [index|smallest|largest]", order));
+        }
+        if (zipMode != "stream" && zipMode != "after")
+        {
+            throw std::runtime_error(fmt::format("{} is not valid for --zip-mode [stream|after]", zipMode));
+        }
+        if (progressInterval < 0)
+        {
+            throw std::runtime_error(fmt::format("{} is not valid for --progress-interval [milliseconds]", progressInterval));
+        }
+        Events::setJsonMode(eventsFormat == "json");
+        Events::setProgressInterval(progressInterval);
+        showStats = result["stats"].as<bool>();
+        metricsFile = result["metrics-file"].as<std::string>();
+        Trace::enable(result["trace"].as<std::string>());
+
+        std::string endpoint = result["endpoint"].as<std::string>();
+        if (!endpoint.empty() && endpoint.rfind("http://", 0) != 0 && endpoint.rfind("https://", 0) != 0)
+        {
+            throw std::runtime_error(fmt::format("{} is not valid for --endpoint [http://host:port]", endpoint));
+        }
+        Http::setEndpoint(endpoint);
+        Http::setRecordDirectory(result["record"].as<std::string>());
+
+        int hedgePercentile = result["hedge"].as<int>();
+        int hedgeBudget = result["hedge-budget"].as<int>();
+        if (hedgePercentile < 0 || hedgePercentile >= 100)
+        {
+            throw std::runtime_error(fmt::format("{} is not valid for --hedge [1-99]", hedgePercentile));
+        }
+        if (hedgeBudget < 0 || hedgeBudget > 100)
+        {
+            throw std::runtime_error(fmt::format("{} is not valid for --hedge-budget [0-100]", hedgeBudget));
+        }
+        Http::setHedging(hedgePercentile, hedgeBudget / 100.0);
+
+        int minHostConcurrency = result["min-host-concurrency"].as<int>();
+        int maxHostConcurrency = result["max-host-concurrency"].as<int>();
+        if (minHostConcurrency < 1 || maxHostConcurrency < minHostConcurrency)
+        {
+            throw std::runtime_error(fmt::format("{}-{} is not valid for --min-host-concurrency/--max-host-concurrency", minHostConcurrency, maxHostConcurrency));
+        }
+        Scheduler::configure(minHostConcurrency, maxHostConcurrency);
 
-        if (!isFullSeriesURL(link) && !isEpisodeURL(link))
+        std::string source = result["source"].as<std::string>();
+        int segments = result["segments"].as<int>();
+        if (source != "download" && source != "auto" && source != "stream")
         {
-            throw std::runtime_error("Invalid link format. Please provide a valid AnimePahe series or episode link.");
+            throw std::runtime_error(fmt::format("{} is not valid for --source [download|auto|stream]", source));
+        }
+        if (segments < 1 || segments > 64)
+        {
+            throw std::runtime_error(fmt::format("{} is not valid for --segments [1-64]", segments));
+        }
+        Hls::configure(source == "download" ? Hls::Source::Download : source == "stream" ? Hls::Source::Stream : Hls::Source::Auto, segments);
+
+        std::string sessionFile = result["session-file"].as<std::string>();
+        Session::open(result["no-session"].as<bool>() ? "" : sessionFile.empty() ? Session::defaultPath() : sessionFile);
+
+        std::string catalogFile = result["catalog-file"].as<std::string>();
+        Catalog::open(catalogFile.empty() ? Catalog::defaultPath() : catalogFile);
+
+        /* anything that is not a url is a title, resolved once the header is out */
+        bool isTitle = link.find("://") == std::string::npos;
+        if (!isTitle && !isFullSeriesURL(link) && !isEpisodeURL(link))
+        {
+            throw std::runtime_error("Invalid link format. Please provide a valid AnimePahe series or episode link, or a title.");
         }
         if (!isValidEpisodeRangeFormat(episodes))
         {
-            throw std::runtime_error("Invalid episode range format. Use 'all' or '1-15'.");
+            throw std::runtime_error("Invalid episode range format. Use 'all', '1-15' or a list like '1,5,12-20,400-'.");
         }
         if (!isValidTxtFilename(export_filename))
         {
             throw std::runtime_error(fmt::format("{} is not valid for -f,--filename [filename]", export_filename));
         }
+        if (!exportFormat.empty() && !LinkExport::isFormat(exportFormat))
+        {
+            throw std::runtime_error(fmt::format("{} is not valid for --export-format [txt|aria2|jsonl|m3u]", exportFormat));
+        }
         if (targetRes < -1)
         {
             throw std::runtime_error(fmt::format("{} is not valid for -q,--quality [0-max,-1-min,720|360]", targetRes));
@@ -98,31 +296,92 @@ int main(int argc, char *argv[])
             }
         }
 
-        fmt::print("\n * Animepahe-CLI ({}) https://github.com/Danushka-Madushan/animepahe-cli \n", VERSION);
+        std::string diskLimitText = result["disk-limit"].as<std::string>();
+        uint64_t diskLimit = 0;
+        if (!diskLimitText.empty() && !parseByteSize(diskLimitText, diskLimit))
+        {
+            throw std::runtime_error(fmt::format("{} is not valid for --disk-limit [bytes, or with K|M|G|T]", diskLimitText));
+        }
+        if (diskLimit > 0 && !(createZip && removeSource))
+        {
+            /* nothing is ever freed without packing and removing the sources */
+            throw std::runtime_error("--disk-limit needs -z,--zip and --rm-source");
+        }
 
-        /* check for updates */
-        auto release = updater.checkForUpdate();
-        if (release)
+        /* stdout mode moves all output to stderr, so this happens before anything is printed */
+        std::string streamMode = result["stream"].as<std::string>();
+        std::unique_ptr<LiveStream> live;
+        if (!streamMode.empty())
         {
-            fmt::print("\n * Update available : ");
-            fmt::print(fmt::fg(fmt::color::lime_green), release->tag_name);
-            fmt::print(" (use --upgrade to self update)");
-            fmt::print("\n");
+            if (exportLinks)
+            {
+                throw std::runtime_error("--stream cannot be combined with -x,--export");
+            }
+            live = std::make_unique<LiveStream>(streamMode);
+            if (live->isHttp() && createZip && removeSource)
+            {
+                throw std::runtime_error("--stream http needs the episodes on disk, drop --rm-source or use --stream stdout");
+            }
+        }
+
+        Events::print("\n * Animepahe-CLI ({}) https://github.com/Danushka-Madushan/animepahe-cli \n", VERSION);
+        Events::emit("run_started", {{"version", VERSION}, {"link", link}, {"episodes", episodes}, {"quality", targetRes}, {"export", exportLinks}, {"zip", createZip}});
+
+        /* check for updates next to the real work, answered from the cache most of the time */
+        std::future<std::optional<GitHubUpdater::Release>> pendingUpdate;
+        int updateInterval = result["update-interval"].as<int>();
+        std::string cacheDirectory = userCacheDirectory();
+        if (updateInterval > 0 && Events::isInteractive() && !cacheDirectory.empty())
+        {
+            std::string cachePath = (std::filesystem::path(cacheDirectory) / "update.json").string();
+            pendingUpdate = std::async(std::launch::async, [&updater, cachePath, updateInterval]()
+                                       { return updater.checkForUpdateCached(cachePath, std::chrono::hours(updateInterval)); });
+        }
+
+        if (live)
+        {
+            Events::print(" * Streaming : ");
+            Events::print(fmt::fg(fmt::color::cyan), "{}\n", live->isHttp() ? live->url() : "stdout");
+            Events::emit("stream_ready", {{"mode", live->isHttp() ? "http" : "stdout"}, {"url", live->url()}});
         }
 
         // Create an instance of Animepahe and call the extractor method
         Animepahe animepahe;
+        if (isTitle)
+        {
+            link = animepahe.find_series(link);
+        }
         animepahe.extractor(
             isFullSeriesURL(link),
             link,
             targetRes,
             episodes == "all",
-            episodes == "all" ? std::vector<int>() : parseEpisodeRange(episodes),
+            episodes == "all" ? std::vector<EpisodeRange>() : parseEpisodeRange(episodes),
             export_filename,
             exportLinks,
             createZip,
-            removeSource
+            removeSource,
+            zipMode == "stream",
+            archiveFormat,
+            order,
+            live.get(),
+            exportFormat,
+            diskLimit
         );
+
+        if (pendingUpdate.valid())
+        {
+            auto release = pendingUpdate.get();
+            if (release)
+            {
+                Events::print("\n * Update available : ");
+                Events::print(fmt::fg(fmt::color::lime_green), "{}", release->tag_name);
+                Events::print(" (use --upgrade to self update)");
+                Events::print("\n");
+            }
+        }
+        reportMetrics();
+        Events::emit("run_finished", {{"ok", true}});
     }
     catch (const cxxopts::exceptions::option_has_no_value)
     {
@@ -131,11 +390,17 @@ int main(int argc, char *argv[])
     }
     catch (const cxxopts::exceptions::missing_argument)
     {
-        fmt::print("\n Usage: -l,--link \"https://animepahe.si/anime/....\" -e,--episodes [all,1-12] -q,--quality [0-max,-1-min,720|360] -x,--export, -f,--filename [filename] -z,--zip, --rm-source, --upgrade\n\n");
+        fmt::print("\n Usage: -l,--link \"https://animepahe.si/anime/....\" -e,--episodes [all,1-12] -q,--quality [0-max,-1-min,720|360] -x,--export, -f,--filename [filename] -z,--zip, --rm-source, --events [human|json], --upgrade\n\n");
         return 1;
     }
     catch (const std::runtime_error &e)
     {
+        reportMetrics();
+        if (Events::isJsonMode())
+        {
+            Events::emit("run_finished", {{"ok", false}, {"error", e.what()}});
+            return 1;
+        }
         fmt::print("\n\n * ");
         fmt::print(fmt::fg(fmt::color::indian_red), "ERROR :");
         fmt::print(" {} \n\n", e.what());
@@ -143,6 +408,12 @@ int main(int argc, char *argv[])
     }
     catch (const std::exception &e)
     {
+        reportMetrics();
+        if (Events::isJsonMode())
+        {
+            Events::emit("run_finished", {{"ok", false}, {"error", e.what()}});
+            return 1;
+        }
         fmt::print("\n\n * ");
         fmt::print(fmt::fg(fmt::color::indian_red), "ERROR :");
         fmt::print(" {} \n\n", e.what());
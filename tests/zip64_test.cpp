@@ -0,0 +1,147 @@
+/**
+ * Writes the ZIP64 archives tests/zip_check.py reads back: an entry and an
+ * archive past 4 GB, and more entries than the 16-bit end record can count,
+ * from both zip_directory() and the streamed ZipWriter.
+ *
+ *   animepahe-zip64-test <case> <archive>
+ *
+ * Inputs are sparse where the filesystem supports it, the archives are not.
+ */
+#include <ziputils.hpp>
+#include <fmt/core.h>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    /* past the 32-bit size and offset fields by more than a copy buffer */
+    constexpr uint64_t LARGE_SIZE = (4096ull + 64) << 20;
+    /* past the 16-bit entry count of the end record */
+    constexpr int ENTRY_COUNT = 70000;
+
+    /* a scratch folder next to the archive, removed again afterwards */
+    fs::path sourceFolder(const fs::path &archive)
+    {
+        fs::path folder = archive;
+        folder += ".src";
+        fs::remove_all(folder);
+        fs::create_directories(folder / "season");
+        return folder / "season";
+    }
+
+    void directoryLarge(const fs::path &archive)
+    {
+        fs::path season = sourceFolder(archive);
+        std::ofstream(season / "AnimePahe_Test_-_01_1080p.mp4", std::ios::binary).close();
+        fs::resize_file(season / "AnimePahe_Test_-_01_1080p.mp4", LARGE_SIZE);
+        std::ofstream(season / "episode_02.nfo") << "<episodedetails><title>Episode 2</title></episodedetails>\n";
+        ZipUtils::zip_directory(season.string(), archive.string(), false, nullptr);
+        fs::remove_all(season.parent_path());
+    }
+
+    void directoryCount(const fs::path &archive)
+    {
+        fs::path season = sourceFolder(archive);
+        for (int i = 0; i < ENTRY_COUNT; ++i)
+        {
+            std::ofstream(season / fmt::format("{}.nfo", i)) << "<episode>" << i << "</episode>\n";
+        }
+        ZipUtils::zip_directory(season.string(), archive.string(), false, nullptr);
+        fs::remove_all(season.parent_path());
+    }
+
+    /**
+     * A discarded entry, a large one, a small one past the 4 GB offset and
+     * a commit, then entries close_committed() must drop: the archive holds
+     * videos/large.mp4 and videos/after.nfo only.
+     */
+    void streamLarge(const fs::path &archive)
+    {
+        std::vector<char> zeros(1 << 20, 0);
+        ZipUtils::ZipWriter writer(archive.string());
+
+        writer.begin_entry("videos/discarded.mp4");
+        for (int i = 0; i < 8; ++i)
+        {
+            writer.write(zeros.data(), zeros.size());
+        }
+        writer.discard_entry();
+
+        writer.begin_entry("videos/large.mp4");
+        for (uint64_t written = 0; written < LARGE_SIZE; written += zeros.size())
+        {
+            writer.write(zeros.data(), zeros.size());
+        }
+        writer.end_entry();
+
+        const std::string after = "<episodedetails><title>Episode 2</title></episodedetails>\n";
+        writer.begin_entry("videos/after.nfo");
+        writer.write(after.data(), after.size());
+        writer.end_entry();
+        writer.commit();
+
+        writer.begin_entry("videos/uncommitted.nfo");
+        writer.write(after.data(), after.size());
+        writer.end_entry();
+        writer.begin_entry("videos/open.mp4");
+        writer.write(zeros.data(), zeros.size());
+        writer.close_committed();
+
+        if (writer.path() != archive.string())
+        {
+            throw std::runtime_error("close_committed() left the archive at " + writer.path());
+        }
+    }
+
+    void streamCount(const fs::path &archive)
+    {
+        ZipUtils::ZipWriter writer(archive.string());
+        for (int i = 0; i < ENTRY_COUNT; ++i)
+        {
+            std::string body = fmt::format("<episode>{}</episode>\n", i);
+            writer.begin_entry(fmt::format("{}.nfo", i));
+            writer.write(body.data(), body.size());
+            writer.end_entry();
+        }
+        writer.close();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const std::map<std::string, std::function<void(const fs::path &)>> cases = {
+        {"directory-large", directoryLarge},
+        {"directory-count", directoryCount},
+        {"stream-large", streamLarge},
+        {"stream-count", streamCount},
+    };
+
+    if (argc != 3 || cases.count(argv[1]) == 0)
+    {
+        std::cerr << "usage: animepahe-zip64-test directory-large|directory-count|stream-large|stream-count <archive>\n";
+        return 2;
+    }
+
+    try
+    {
+        fs::path archive = argv[2];
+        fs::remove(archive);
+        cases.at(argv[1])(archive);
+        /* the writer's own structural check, the independent reader comes after */
+        std::cout << argv[1] << ": " << ZipUtils::verify_archive(archive.string()) << " entries\n";
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << argv[1] << ": " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
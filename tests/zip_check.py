@@ -0,0 +1,40 @@
+"""
+Reads an archive written by animepahe-zip64-test back with Python's zipfile,
+a reader that shares no code with ZipUtils, then deletes it.
+
+    zip_check.py <animepahe-zip64-test> <case> <archive> <files> [name=size ...]
+
+Every entry is read and its CRC-32 checked, the archive must hold exactly
+<files> files, and each name=size names the end of an entry and its size.
+"""
+import os
+import subprocess
+import sys
+import zipfile
+
+
+def main():
+    binary, case, archive, files = sys.argv[1:5]
+    expected = dict(pair.rsplit("=", 1) for pair in sys.argv[5:])
+
+    subprocess.run([binary, case, archive], check=True)
+    try:
+        with zipfile.ZipFile(archive) as reader:
+            entries = [info for info in reader.infolist() if not info.is_dir()]
+            if len(entries) != int(files):
+                sys.exit(f"{case}: {len(entries)} files, expected {files}")
+            for name, size in expected.items():
+                found = [info for info in entries if info.filename.endswith(name)]
+                if len(found) != 1 or found[0].file_size != int(size):
+                    sys.exit(f"{case}: {name} is {[(i.filename, i.file_size) for i in found]}, expected one of {size} bytes")
+            bad = reader.testzip()
+            if bad is not None:
+                sys.exit(f"{case}: CRC mismatch in {bad}")
+        print(f"{case}: {len(entries)} files read back OK")
+    finally:
+        if os.path.exists(archive):
+            os.remove(archive)
+
+
+if __name__ == "__main__":
+    main()
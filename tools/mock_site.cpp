@@ -0,0 +1,763 @@
+/**
+ * animepahe-mock
+ * local stand-in for animepahe, pahe.win, kwik and the CDN, for offline load tests.
+ *
+ * Serves responses recorded with `animepahe-cli-beta --record DIR` verbatim and
+ * synthesizes everything else: a series of any size with API pages, play pages,
+ * pahe.win and kwik hops, throttled video endpoints with Range support, the
+ * kwik player with an AES-128 HLS playlist of the same bytes and, with
+ * --release-tag, the GitHub latest-release API the updater asks.
+ *
+ *   animepahe-mock --port 8088 --recordings ./rec --synthetic 1500 --throttle 2048
+ *   animepahe-cli-beta --endpoint http://127.0.0.1:8088 -l https://animepahe.si/anime/<uuid> -e 1-60
+ */
+#include <cxxopts.hpp>
+#include <fmt/core.h>
+#include <fmt/color.h>
+#include <nlohmann/json.hpp>
+#include <localserver.hpp>
+#include <sha256.hpp>
+#include <aes.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using json = nlohmann::json;
+using AnimepaheCLI::LocalServer;
+namespace fs = std::filesystem;
+
+namespace
+{
+    struct Recording
+    {
+        int status = 200;
+        std::map<std::string, std::string> headers;
+        std::string body;
+    };
+
+    struct Options
+    {
+        int episodes = 1500;
+        size_t videoSize = 8 * 1024 * 1024;
+        size_t throttle = 0; /* bytes per second per transfer, 0 = unlimited */
+        int latency = 0;     /* milliseconds added to every non-video response */
+        double failRate = 0.0;
+        double tailRate = 0.0; /* fraction of non-video responses held back by tailLatency */
+        int tailLatency = 2000;
+        std::string title = "Mock Series";
+        std::string releaseTag; /* empty = no release published */
+        size_t segmentSize = 1024 * 1024;
+        bool streamOnly = false; /* kwik refuses every download POST, only the player playlist works */
+    };
+
+    Options options;
+    /* what the search api answers for the synthetic series, any id serves it */
+    const std::string MOCK_SERIES = "4d6f636b-5365-7269-6573-000000000001";
+    std::map<std::string, Recording> recordings; /* "GET https://host/path?query" */
+    std::atomic<size_t> requestCount{0};
+    std::atomic<size_t> videoBytes{0};
+    std::mutex rngMutex;
+    std::mt19937 rng(7);
+
+    /* same packing the kwik pages use, decoded by KwikPahe::decodeJSStyle */
+    const std::string PACK_ALPHABET = "gHzPxTKuc";
+    constexpr int PACK_BASE = 8;
+    constexpr int PACK_OFFSET = 46;
+
+    std::string pack(const std::string &plain)
+    {
+        std::string packed;
+        for (unsigned char c : plain)
+        {
+            int value = c + PACK_OFFSET;
+            std::string digits;
+            do
+            {
+                digits.insert(digits.begin(), PACK_ALPHABET[value % PACK_BASE]);
+                value /= PACK_BASE;
+            } while (value > 0);
+            packed += digits;
+            packed += PACK_ALPHABET[PACK_BASE];
+        }
+        return packed;
+    }
+
+    /* eval(function(p,a,c,k,e,d){...}) packing of the kwik player, decoded by KwikPahe::parse_embed_page */
+    std::string packEval(const std::string &plain)
+    {
+        static const std::string DIGITS = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+        std::vector<std::string> words;
+        std::map<std::string, size_t> indices;
+        std::string payload;
+        for (size_t i = 0; i < plain.size();)
+        {
+            if (!std::isalnum(static_cast<unsigned char>(plain[i])) && plain[i] != '_')
+            {
+                payload += plain[i] == '\'' ? "\\'" : std::string(1, plain[i]);
+                ++i;
+                continue;
+            }
+            size_t start = i;
+            while (i < plain.size() && (std::isalnum(static_cast<unsigned char>(plain[i])) || plain[i] == '_'))
+            {
+                ++i;
+            }
+            std::string word = plain.substr(start, i - start);
+            auto [found, created] = indices.try_emplace(word, words.size());
+            if (created)
+            {
+                words.push_back(word);
+            }
+            std::string encoded;
+            size_t index = found->second;
+            do
+            {
+                encoded.insert(encoded.begin(), DIGITS[index % 62]);
+                index /= 62;
+            } while (index > 0);
+            payload += encoded;
+        }
+        std::string joined;
+        for (size_t i = 0; i < words.size(); ++i)
+        {
+            joined += (i ? "|" : "") + words[i];
+        }
+        return fmt::format("eval(function(p,a,c,k,e,d){{e=function(c){{return c.toString(36)}};return p}}('{}',62,{},'{}'.split('|'),0,{{}}))",
+                           payload, words.size(), joined);
+    }
+
+    std::string queryValue(const std::string &query, const std::string &key)
+    {
+        std::istringstream stream(query);
+        std::string pair;
+        while (std::getline(stream, pair, '&'))
+        {
+            size_t eq = pair.find('=');
+            if (eq != std::string::npos && pair.substr(0, eq) == key)
+            {
+                return pair.substr(eq + 1);
+            }
+        }
+        return "";
+    }
+
+    std::string sessionFor(int episode)
+    {
+        return fmt::format("{:064x}", episode);
+    }
+
+    int episodeFromSession(const std::string &session)
+    {
+        try
+        {
+            return static_cast<int>(std::stoul(session.substr(session.size() > 16 ? session.size() - 16 : 0), nullptr, 16));
+        }
+        catch (const std::exception &)
+        {
+            return 0;
+        }
+    }
+
+    bool shouldFail()
+    {
+        if (options.failRate <= 0.0)
+        {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(rngMutex);
+        return std::uniform_real_distribution<double>(0.0, 1.0)(rng) < options.failRate;
+    }
+
+    /* a long tail on top of --latency, what --hedge is meant to cut */
+    bool shouldStall()
+    {
+        if (options.tailRate <= 0.0)
+        {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(rngMutex);
+        return std::uniform_real_distribution<double>(0.0, 1.0)(rng) < options.tailRate;
+    }
+
+    std::string fileNameFor(int episode, int resolution)
+    {
+        std::string title = options.title;
+        std::replace(title.begin(), title.end(), ' ', '_');
+        return fmt::format("AnimePahe_{}_-_{:02}_{}p_Mock.mp4", title, episode, resolution);
+    }
+
+    void seriesPage(LocalServer::Connection &connection, const std::string &id)
+    {
+        connection.respond(200, fmt::format(
+            "<!DOCTYPE html><html><head><title>{0} :: animepahe</title></head><body>"
+            "<div class=\"anime-poster\"><a style=\"display:block\" title=\"{0}\" href=\"/anime/{1}\"></a></div>"
+            "<div class=\"anime-info\"><p><strong>Type: <a href=\"/anime/type/tv\" title=\"View all TV\">TV</a></strong></p>"
+            "<p><strong>Episodes:</strong> {2}</p>"
+            "<p class=\"anime-synonym\"><strong>Synonyms:</strong> {0} TV, Mock Show</p>"
+            "<p class=\"anime-english\"><strong>English:</strong> The {0}</p></div></body></html>",
+            options.title, id, options.episodes));
+    }
+
+    /* the synthetic series when any word of q (3+ letters) is part of its title */
+    void searchPage(LocalServer::Connection &connection, const std::string &query)
+    {
+        std::string q = queryValue(query, "q");
+        std::string title = options.title;
+        std::transform(title.begin(), title.end(), title.begin(), ::tolower);
+        for (char &c : q)
+        {
+            c = c == '+' || c == '%' ? ' ' : static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+
+        bool hit = false;
+        std::istringstream words(q);
+        std::string word;
+        while (words >> word)
+        {
+            hit = hit || (word.size() >= 3 && title.find(word) != std::string::npos);
+        }
+
+        json data = json::array();
+        if (hit)
+        {
+            data.push_back({{"id", 1}, {"title", options.title}, {"type", "TV"}, {"episodes", options.episodes}, {"status", "Finished Airing"}, {"session", MOCK_SERIES}});
+        }
+        json body = {{"total", data.size()}, {"per_page", 8}, {"current_page", 1}, {"last_page", 1}, {"from", hit ? 1 : 0}, {"to", data.size()}, {"data", data}};
+        connection.respond(200, body.dump(), {{"Content-Type", "application/json"}});
+    }
+
+    void releasePage(LocalServer::Connection &connection, const std::string &query)
+    {
+        int page = std::max(1, std::atoi(queryValue(query, "page").c_str()));
+        int lastPage = std::max(1, (options.episodes + 29) / 30);
+        json data = json::array();
+        for (int episode = (page - 1) * 30 + 1; episode <= std::min(page * 30, options.episodes); ++episode)
+        {
+            data.push_back({
+                {"id", 100000 + episode},
+                {"episode", episode},
+                {"episode2", 0},
+                {"audio", "jpn"},
+                {"duration", "00:23:40"},
+                {"session", sessionFor(episode)},
+                {"filler", 0},
+                {"created_at", "2024-01-01 00:00:00"}});
+        }
+        json body = {
+            {"total", options.episodes},
+            {"per_page", 30},
+            {"current_page", page},
+            {"last_page", lastPage},
+            {"from", (page - 1) * 30 + 1},
+            {"to", std::min(page * 30, options.episodes)},
+            {"data", data}};
+        connection.respond(200, body.dump(), {{"Content-Type", "application/json"}});
+    }
+
+    void playPage(LocalServer::Connection &connection, const std::string &id, int episode)
+    {
+        std::string anchors;
+        for (auto [resolution, size] : {std::pair{360, "60MB"}, std::pair{720, "110MB"}, std::pair{1080, "190MB"}})
+        {
+            anchors += fmt::format("<a href=\"https://pahe.win/e{}r{}\" target=\"_blank\" class=\"dropdown-item\">Mock &amp; Co · {}p ({})</a>", episode, resolution, resolution, size);
+        }
+        connection.respond(200, fmt::format(
+            "<!DOCTYPE html><html><body><div class=\"theatre-info\"><h1><a href=\"/anime/{0}\" title=\"{1}\">{1}</a> - {2}<span class=\"sr-only\">Online</span></h1></div>"
+            "<div id=\"pickDownload\" class=\"dropdown-menu\">{3}</div></body></html>",
+            id, options.title, episode, anchors));
+    }
+
+    void paheWin(LocalServer::Connection &connection, const std::string &code)
+    {
+        connection.respond(200, fmt::format(
+            "<!DOCTYPE html><html><body><script>setTimeout(function(){{window.location=\"https://kwik.si/f/{}\"}},5000)</script></body></html>", code));
+    }
+
+    void kwikPage(LocalServer::Connection &connection, const std::string &code)
+    {
+        std::string form = fmt::format(
+            "<form action=\"https://kwik.si/d/{}\" method=\"POST\"><input type=\"hidden\" name=\"_token\" value=\"mocktoken{}\"><button type=\"submit\">Download</button></form>",
+            code, code);
+        connection.respond(200, fmt::format(
+            "<!DOCTYPE html><html><body><script>eval(function(h,u,n,t,e,r){{return r}}(\"{}\",17,\"{}\",{},{},29))</script></body></html>",
+            pack(form), PACK_ALPHABET, PACK_OFFSET, PACK_BASE),
+            {{"Set-Cookie", fmt::format("kwik_session=mock{}; path=/; httponly", code)}});
+    }
+
+    void kwikPost(LocalServer::Connection &connection, const LocalServer::Request &request, const std::string &code)
+    {
+        if (request.body.find("_token=") == std::string::npos)
+        {
+            connection.respond(419, "Page Expired");
+            return;
+        }
+        int episode = 0, resolution = 0;
+        if (std::sscanf(code.c_str(), "e%dr%d", &episode, &resolution) != 2)
+        {
+            connection.respond(404, "Not Found");
+            return;
+        }
+        if (options.streamOnly)
+        {
+            connection.respond(419, "Page Expired");
+            return;
+        }
+        std::string file = fileNameFor(episode, resolution);
+        connection.respond(302, "", {{"Location", fmt::format("https://cdn.mock.local/stream/{}/{}?file={}", code, file, file)}});
+    }
+
+    char videoByte(size_t position)
+    {
+        return static_cast<char>((position * 2654435761u) >> 13);
+    }
+
+    /* the player of a kwik file, its playlist carries the same bytes as the download */
+    void kwikEmbed(LocalServer::Connection &connection, const std::string &code)
+    {
+        int episode = 0, resolution = 0;
+        if (std::sscanf(code.c_str(), "e%dr%d", &episode, &resolution) != 2)
+        {
+            connection.respond(404, "Not Found");
+            return;
+        }
+        std::string script = packEval(fmt::format(
+            "const source='https://cdn.mock.local/hls/{}/uwu.m3u8';const video=document.querySelector('video');const player=new Plyr(video);", code));
+        connection.respond(200, fmt::format(
+            "<!DOCTYPE html><html><head><title>{}</title></head><body><video id=\"player\"></video><script>{}</script></body></html>",
+            fileNameFor(episode, resolution), script));
+    }
+
+    std::string segmentKey(const std::string &code)
+    {
+        return (code + "0123456789abcdef").substr(0, 16);
+    }
+
+    void playlist(LocalServer::Connection &connection, const std::string &code)
+    {
+        size_t segments = (options.videoSize + options.segmentSize - 1) / options.segmentSize;
+        std::string body = fmt::format("#EXTM3U\n#EXT-X-VERSION:3\n#EXT-X-TARGETDURATION:4\n#EXT-X-MEDIA-SEQUENCE:0\n"
+                                       "#EXT-X-KEY:METHOD=AES-128,URI=\"https://cdn.mock.local/hls/{}/mon.key\"\n", code);
+        for (size_t i = 0; i < segments; ++i)
+        {
+            body += fmt::format("#EXTINF:4.000,\nseg-{}-v1-a1.jpg\n", i);
+        }
+        body += "#EXT-X-ENDLIST\n";
+        connection.respond(200, body, {{"Content-Type", "application/vnd.apple.mpegurl"}});
+    }
+
+    /* slice of the synthetic video, encrypted with the IV HLS derives from the sequence number */
+    void segment(LocalServer::Connection &connection, const std::string &code, size_t index)
+    {
+        size_t first = index * options.segmentSize;
+        if (first >= options.videoSize)
+        {
+            connection.respond(404, "Not Found");
+            return;
+        }
+        std::string plain(std::min(options.segmentSize, options.videoSize - first), '\0');
+        for (size_t i = 0; i < plain.size(); ++i)
+        {
+            plain[i] = videoByte(first + i);
+        }
+        std::string iv(16, '\0');
+        for (int i = 0; i < 8; ++i)
+        {
+            iv[15 - i] = static_cast<char>((index >> (8 * i)) & 0xff);
+        }
+        std::string body = AnimepaheCLI::Aes128(segmentKey(code)).encryptCbc(plain, iv);
+
+        if (!connection.sendHead(200, {{"Content-Type", "image/jpeg"}, {"Content-Length", std::to_string(body.size())}}))
+        {
+            return;
+        }
+        constexpr size_t CHUNK = 64 * 1024;
+        auto started = std::chrono::steady_clock::now();
+        for (size_t offset = 0; offset < body.size(); offset += CHUNK)
+        {
+            size_t length = std::min(CHUNK, body.size() - offset);
+            if (!connection.send(body.data() + offset, length))
+            {
+                return;
+            }
+            videoBytes += length;
+            if (options.throttle > 0)
+            {
+                std::this_thread::sleep_until(started + std::chrono::microseconds(static_cast<int64_t>((offset + length) * 1e6 / options.throttle)));
+            }
+        }
+    }
+
+    /* digest of the synthetic body, published for the release assets it stands in for */
+    std::string videoSha256()
+    {
+        static const std::string digest = []()
+        {
+            AnimepaheCLI::Sha256 hash;
+            std::string chunk(64 * 1024, '\0');
+            for (size_t offset = 0; offset < options.videoSize; offset += chunk.size())
+            {
+                size_t length = std::min(chunk.size(), options.videoSize - offset);
+                for (size_t i = 0; i < length; ++i)
+                {
+                    chunk[i] = videoByte(offset + i);
+                }
+                hash.update(chunk.data(), length);
+            }
+            return hash.finish();
+        }();
+        return digest;
+    }
+
+    void latestRelease(LocalServer::Connection &connection)
+    {
+        if (options.releaseTag.empty())
+        {
+            connection.respond(404, R"({"message":"Not Found"})", {{"Content-Type", "application/json"}});
+            return;
+        }
+        json assets = json::array();
+        for (const char *name : {"animepahe-cli-beta.exe", "animepahe-cli-beta-linux"})
+        {
+            /* ?file= routes the asset to the synthetic video endpoint */
+            assets.push_back({
+                {"name", name},
+                {"browser_download_url", fmt::format("https://github.com/releases/download/{}/{}?file={}", options.releaseTag, name, name)},
+                {"size", options.videoSize},
+                {"digest", "sha256:" + videoSha256()}});
+        }
+        json body = {
+            {"tag_name", options.releaseTag},
+            {"name", options.releaseTag},
+            {"body", "Mock release"},
+            {"prerelease", false},
+            {"assets", assets}};
+        connection.respond(200, body.dump(), {{"Content-Type", "application/json"}});
+    }
+
+    /* deterministic incompressible-looking bytes, throttled per transfer, honours Range */
+    void video(LocalServer::Connection &connection, const LocalServer::Request &request)
+    {
+        size_t size = options.videoSize;
+        size_t first = 0, last = size - 1;
+        int status = 200;
+
+        std::string range = request.header("range");
+        if (range.rfind("bytes=", 0) == 0)
+        {
+            unsigned long long from = 0, to = 0;
+            int matched = std::sscanf(range.c_str(), "bytes=%llu-%llu", &from, &to);
+            if (matched >= 1)
+            {
+                if (from >= size)
+                {
+                    connection.respond(416, "", {{"Content-Range", fmt::format("bytes */{}", size)}});
+                    return;
+                }
+                first = static_cast<size_t>(from);
+                last = matched == 2 ? std::min<size_t>(static_cast<size_t>(to), size - 1) : size - 1;
+                status = 206;
+            }
+        }
+
+        std::map<std::string, std::string> headers = {
+            {"Content-Type", "video/mp4"},
+            {"Accept-Ranges", "bytes"},
+            {"Content-Length", std::to_string(last - first + 1)}};
+        if (status == 206)
+        {
+            headers["Content-Range"] = fmt::format("bytes {}-{}/{}", first, last, size);
+        }
+        if (!connection.sendHead(status, headers) || request.method == "HEAD")
+        {
+            return;
+        }
+
+        constexpr size_t CHUNK = 64 * 1024;
+        std::string chunk(CHUNK, '\0');
+        auto started = std::chrono::steady_clock::now();
+        size_t sent = 0;
+        for (size_t offset = first; offset <= last; offset += CHUNK)
+        {
+            size_t length = std::min(CHUNK, last - offset + 1);
+            for (size_t i = 0; i < length; ++i)
+            {
+                chunk[i] = videoByte(offset + i);
+            }
+            if (!connection.send(chunk.data(), length))
+            {
+                return;
+            }
+            sent += length;
+            videoBytes += length;
+
+            if (options.throttle > 0)
+            {
+                auto due = started + std::chrono::microseconds(static_cast<int64_t>(sent * 1e6 / options.throttle));
+                std::this_thread::sleep_until(due);
+            }
+        }
+    }
+
+    void handle(const LocalServer::Request &request, LocalServer::Connection &connection)
+    {
+        requestCount++;
+
+        /* "/host/path" -> host + "/path" */
+        std::string target = request.target.size() > 1 ? request.target.substr(1) : "";
+        size_t slash = target.find('/');
+        std::string host = target.substr(0, slash == std::string::npos ? target.find('?') : slash);
+        std::string rest = request.path.size() > host.size() + 1 ? request.path.substr(host.size() + 1) : "/";
+
+        auto recorded = recordings.find(fmt::format("{} https://{}", request.method, target));
+        bool isVideo = !request.query.empty() && request.query.find("file=") != std::string::npos;
+        /* segments are video bytes too, never delayed or failed */
+        bool isSegment = host == "cdn.mock.local" && rest.rfind("/hls/", 0) == 0 && rest.find(".jpg") != std::string::npos;
+
+        if (!isVideo && !isSegment && options.latency > 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(options.latency));
+        }
+        if (!isVideo && !isSegment && shouldStall())
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(options.tailLatency));
+        }
+        if (!isVideo && !isSegment && shouldFail())
+        {
+            connection.respond(503, "Service Unavailable", {{"Retry-After", "1"}});
+            return;
+        }
+
+        if (recorded != recordings.end())
+        {
+            std::map<std::string, std::string> headers = recorded->second.headers;
+            headers.erase("Content-Length");
+            headers.erase("content-length");
+            headers.erase("Transfer-Encoding");
+            headers.erase("transfer-encoding");
+            headers.erase("Content-Encoding");
+            headers.erase("content-encoding");
+            connection.respond(recorded->second.status, recorded->second.body, headers);
+            return;
+        }
+
+        if (isVideo)
+        {
+            video(connection, request);
+            return;
+        }
+
+        char id[37] = {0};
+        char session[65] = {0};
+        if (host.rfind("animepahe.", 0) == 0)
+        {
+            if (rest == "/api" && queryValue(request.query, "m") == "release")
+            {
+                releasePage(connection, request.query);
+                return;
+            }
+            if (rest == "/api" && queryValue(request.query, "m") == "search")
+            {
+                searchPage(connection, request.query);
+                return;
+            }
+            if (std::sscanf(rest.c_str(), "/play/%36[a-f0-9-]/%64[a-f0-9]", id, session) == 2)
+            {
+                int episode = episodeFromSession(session);
+                if (episode >= 1 && episode <= options.episodes)
+                {
+                    playPage(connection, id, episode);
+                    return;
+                }
+            }
+            else if (std::sscanf(rest.c_str(), "/anime/%36[a-f0-9-]", id) == 1)
+            {
+                seriesPage(connection, id);
+                return;
+            }
+        }
+        else if (host == "cdn.mock.local" && rest.rfind("/hls/", 0) == 0)
+        {
+            /* /hls/<code>/uwu.m3u8, /hls/<code>/mon.key, /hls/<code>/seg-<n>-v1-a1.jpg */
+            std::string path = rest.substr(5);
+            size_t slash = path.find('/');
+            std::string code = path.substr(0, slash);
+            std::string file = slash == std::string::npos ? "" : path.substr(slash + 1);
+            size_t index = 0;
+            if (file == "uwu.m3u8")
+            {
+                playlist(connection, code);
+                return;
+            }
+            if (file == "mon.key")
+            {
+                connection.respond(200, segmentKey(code), {{"Content-Type", "application/octet-stream"}});
+                return;
+            }
+            if (std::sscanf(file.c_str(), "seg-%zu-", &index) == 1)
+            {
+                segment(connection, code, index);
+                return;
+            }
+        }
+        else if (host == "api.github.com" && rest.find("/releases/latest") != std::string::npos)
+        {
+            latestRelease(connection);
+            return;
+        }
+        else if (host == "pahe.win" && rest.size() > 1)
+        {
+            paheWin(connection, rest.substr(1));
+            return;
+        }
+        else if (host.rfind("kwik.", 0) == 0 && rest.size() > 3)
+        {
+            if (request.method == "GET" && rest.rfind("/f/", 0) == 0)
+            {
+                kwikPage(connection, rest.substr(3));
+                return;
+            }
+            if (request.method == "GET" && rest.rfind("/e/", 0) == 0)
+            {
+                kwikEmbed(connection, rest.substr(3));
+                return;
+            }
+            if (request.method == "POST" && rest.rfind("/d/", 0) == 0)
+            {
+                kwikPost(connection, request, rest.substr(3));
+                return;
+            }
+        }
+
+        connection.respond(404, "Not Found");
+    }
+
+    size_t loadRecordings(const fs::path &directory)
+    {
+        std::ifstream index(directory / "index.jsonl");
+        if (!index.is_open())
+        {
+            throw std::runtime_error(fmt::format("No index.jsonl in {}", directory.string()));
+        }
+
+        std::string line;
+        while (std::getline(index, line))
+        {
+            if (line.empty())
+            {
+                continue;
+            }
+            json entry = json::parse(line);
+            std::string url = entry.value("url", "");
+            size_t scheme = url.find("://");
+            if (scheme == std::string::npos)
+            {
+                continue;
+            }
+
+            Recording recording;
+            recording.status = entry.value("status", 200);
+            for (auto &[name, value] : entry.value("headers", json::object()).items())
+            {
+                recording.headers[name] = value.get<std::string>();
+            }
+            if (entry["body"].is_string())
+            {
+                std::ifstream body(directory / entry["body"].get<std::string>(), std::ios::binary);
+                std::ostringstream oss;
+                oss << body.rdbuf();
+                recording.body = oss.str();
+            }
+            else if (entry.value("body_size", 0) > 0)
+            {
+                /* streamed download, the synthetic video endpoint serves it */
+                continue;
+            }
+
+            /* the latest recording of a url wins */
+            recordings[fmt::format("{} https://{}", entry.value("method", "GET"), url.substr(scheme + 3))] = std::move(recording);
+        }
+        return recordings.size();
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    cxxopts::Options cli("animepahe-mock", "Local AnimePahe replay server for offline load tests");
+    cli.add_options()
+    ("host", "Listen address", cxxopts::value<std::string>()->default_value("127.0.0.1"))
+    ("p,port", "Listen port", cxxopts::value<int>()->default_value("8088"))
+    ("r,recordings", "Directory recorded with animepahe-cli-beta --record", cxxopts::value<std::string>()->default_value(""))
+    ("synthetic", "Episode count of synthetic series", cxxopts::value<int>()->default_value("1500"))
+    ("title", "Title of synthetic series", cxxopts::value<std::string>()->default_value("Mock Series"))
+    ("video-size", "Size of every synthetic video in MB", cxxopts::value<int>()->default_value("8"))
+    ("throttle", "Per-transfer video rate limit in KB/s (0 = unlimited)", cxxopts::value<int>()->default_value("0"))
+    ("latency", "Extra milliseconds before every page/API/kwik response", cxxopts::value<int>()->default_value("0"))
+    ("fail-rate", "Fraction of page/API/kwik requests answered with 503", cxxopts::value<double>()->default_value("0"))
+    ("tail-rate", "Fraction of page/API/kwik responses delayed by --tail-ms", cxxopts::value<double>()->default_value("0"))
+    ("tail-ms", "Milliseconds a --tail-rate response is held back", cxxopts::value<int>()->default_value("2000"))
+    ("release-tag", "Tag of the latest release served to the updater (none when empty)", cxxopts::value<std::string>()->default_value(""))
+    ("segment-size", "Size of every HLS segment of the kwik player in KB", cxxopts::value<int>()->default_value("1024"))
+    ("stream-only", "Refuse every kwik download so only the player playlist works")
+    ("h,help", "Print usage");
+
+    try
+    {
+        auto args = cli.parse(argc, argv);
+        if (args.count("help"))
+        {
+            fmt::print("{}\n", cli.help());
+            return 0;
+        }
+
+        options.episodes = std::max(1, args["synthetic"].as<int>());
+        options.title = args["title"].as<std::string>();
+        options.videoSize = static_cast<size_t>(std::max(1, args["video-size"].as<int>())) * 1024 * 1024;
+        options.throttle = static_cast<size_t>(std::max(0, args["throttle"].as<int>())) * 1024;
+        options.latency = std::max(0, args["latency"].as<int>());
+        options.failRate = std::clamp(args["fail-rate"].as<double>(), 0.0, 1.0);
+        options.tailRate = std::clamp(args["tail-rate"].as<double>(), 0.0, 1.0);
+        options.tailLatency = std::max(0, args["tail-ms"].as<int>());
+        options.releaseTag = args["release-tag"].as<std::string>();
+        options.segmentSize = static_cast<size_t>(std::max(16, args["segment-size"].as<int>())) * 1024;
+        options.streamOnly = args.count("stream-only") > 0;
+
+        if (!args["recordings"].as<std::string>().empty())
+        {
+            size_t loaded = loadRecordings(args["recordings"].as<std::string>());
+            fmt::print("\n * Recordings : {} responses\n", loaded);
+        }
+
+        LocalServer server;
+        server.start(args["host"].as<std::string>(), static_cast<uint16_t>(args["port"].as<int>()), handle);
+
+        fmt::print("\n * animepahe-mock listening on ");
+        fmt::print(fmt::fg(fmt::color::cyan), "http://{}:{}", args["host"].as<std::string>(), server.port());
+        fmt::print("\n * Synthetic series : {} episodes, {}MB videos{}\n", options.episodes, options.videoSize / (1024 * 1024),
+                   options.throttle > 0 ? fmt::format(", {}KB/s per transfer", options.throttle / 1024) : "");
+        fmt::print(" * Use : animepahe-cli-beta --endpoint http://{}:{} -l https://animepahe.si/anime/<uuid>\n\n", args["host"].as<std::string>(), server.port());
+
+        while (true)
+        {
+            std::this_thread::sleep_for(std::chrono::seconds(10));
+            fmt::print("\r * Requests : {}  Video : {:.1f}MB   ", requestCount.load(), videoBytes.load() / (1024.0 * 1024.0));
+            fflush(stdout);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        fmt::print("\n * ");
+        fmt::print(fmt::fg(fmt::color::indian_red), "ERROR :");
+        fmt::print(" {} \n\n", e.what());
+        return 1;
+    }
+}